@@ -0,0 +1,205 @@
+// Compares LveModel::Builder vertex deduplication against the previous std::unordered_map path.
+//
+// usage: DedupBenchmark [model.obj] [iterations]
+// Without a model a synthetic grid of 64 shapes with ~6M indices is generated.
+
+#include "lve_model.hpp"
+#include "lve_utils.hpp"
+
+// libs
+#include <tiny_obj_loader.h>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace std {
+template <>
+struct hash<lve::LveModel::Vertex> {
+  size_t operator()(lve::LveModel::Vertex const &vertex) const {
+    size_t seed = 0;
+    lve::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+    return seed;
+  }
+};
+}  // namespace std
+
+namespace {
+
+using lve::LveModel;
+
+// The dedup loop as it was before the flat table, kept verbatim for comparison
+void legacyDedup(
+    const tinyobj::attrib_t &attrib,
+    const std::vector<tinyobj::shape_t> &shapes,
+    std::vector<LveModel::Vertex> &vertices,
+    std::vector<uint32_t> &indices) {
+  vertices.clear();
+  indices.clear();
+
+  std::unordered_map<LveModel::Vertex, uint32_t> uniqueVertices{};
+  for (const auto &shape : shapes) {
+    for (const auto &index : shape.mesh.indices) {
+      LveModel::Vertex vertex{};
+
+      if (index.vertex_index >= 0) {
+        vertex.position = {
+            attrib.vertices[3 * index.vertex_index + 0],
+            attrib.vertices[3 * index.vertex_index + 1],
+            attrib.vertices[3 * index.vertex_index + 2],
+        };
+
+        vertex.color = {
+            attrib.colors[3 * index.vertex_index + 0],
+            attrib.colors[3 * index.vertex_index + 1],
+            attrib.colors[3 * index.vertex_index + 2],
+        };
+      }
+
+      if (index.normal_index >= 0) {
+        vertex.normal = {
+            attrib.normals[3 * index.normal_index + 0],
+            attrib.normals[3 * index.normal_index + 1],
+            attrib.normals[3 * index.normal_index + 2],
+        };
+      }
+
+      if (index.texcoord_index >= 0) {
+        vertex.uv = {
+            attrib.texcoords[2 * index.texcoord_index + 0],
+            attrib.texcoords[2 * index.texcoord_index + 1],
+        };
+      }
+
+      if (uniqueVertices.count(vertex) == 0) {
+        uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+        vertices.push_back(vertex);
+      }
+      indices.push_back(uniqueVertices[vertex]);
+    }
+  }
+}
+
+// shapeCount grids of size x size quads sharing one position / normal / texcoord per grid point
+void makeSyntheticMesh(
+    uint32_t shapeCount,
+    uint32_t size,
+    tinyobj::attrib_t &attrib,
+    std::vector<tinyobj::shape_t> &shapes) {
+  shapes.resize(shapeCount);
+  for (uint32_t s = 0; s < shapeCount; s++) {
+    int base = static_cast<int>(attrib.vertices.size() / 3);
+    for (uint32_t y = 0; y <= size; y++) {
+      for (uint32_t x = 0; x <= size; x++) {
+        attrib.vertices.insert(attrib.vertices.end(), {float(x), float(s), float(y)});
+        attrib.colors.insert(attrib.colors.end(), {1.f, 1.f, 1.f});
+        attrib.normals.insert(attrib.normals.end(), {0.f, 1.f, 0.f});
+        attrib.texcoords.insert(attrib.texcoords.end(), {float(x) / size, float(y) / size});
+      }
+    }
+
+    auto &indices = shapes[s].mesh.indices;
+    indices.reserve(size * size * 6);
+    auto corner = [&](uint32_t x, uint32_t y) {
+      int i = base + static_cast<int>(y * (size + 1) + x);
+      return tinyobj::index_t{i, i, i};
+    };
+    for (uint32_t y = 0; y < size; y++) {
+      for (uint32_t x = 0; x < size; x++) {
+        indices.insert(
+            indices.end(),
+            {corner(x, y),
+             corner(x + 1, y),
+             corner(x, y + 1),
+             corner(x + 1, y),
+             corner(x + 1, y + 1),
+             corner(x, y + 1)});
+      }
+    }
+  }
+}
+
+template <typename F>
+double bestOfMs(int iterations, F &&f) {
+  double best = 1e30;
+  for (int i = 0; i < iterations; i++) {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best;
+}
+
+// Same mesh modulo vertex order: every index must resolve to an identical vertex
+bool sameMesh(
+    const std::vector<LveModel::Vertex> &aVertices,
+    const std::vector<uint32_t> &aIndices,
+    const std::vector<LveModel::Vertex> &bVertices,
+    const std::vector<uint32_t> &bIndices) {
+  if (aIndices.size() != bIndices.size()) return false;
+  for (size_t i = 0; i < aIndices.size(); i++) {
+    if (!(aVertices[aIndices[i]] == bVertices[bIndices[i]])) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+  if (argc > 1) {
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, argv[1])) {
+      std::cerr << warn + err << '\n';
+      return EXIT_FAILURE;
+    }
+  } else {
+    makeSyntheticMesh(64, 128, attrib, shapes);
+  }
+
+  size_t indexCount = 0;
+  for (auto &shape : shapes) indexCount += shape.mesh.indices.size();
+  std::cout << shapes.size() << " shapes, " << indexCount << " indices, best of " << iterations
+            << " runs\n";
+
+  std::vector<LveModel::Vertex> legacyVertices;
+  std::vector<uint32_t> legacyIndices;
+  double legacyMs =
+      bestOfMs(iterations, [&]() { legacyDedup(attrib, shapes, legacyVertices, legacyIndices); });
+  std::cout << "  unordered_map:      " << legacyMs << " ms, " << legacyVertices.size()
+            << " vertices\n";
+
+  LveModel::Builder builder{};
+  double flatMs = bestOfMs(iterations, [&]() { builder.buildFromObj(attrib, shapes, 1); });
+  std::cout << "  flat table:         " << flatMs << " ms, " << builder.vertices.size()
+            << " vertices (" << legacyMs / flatMs << "x)\n";
+  bool flatMatches =
+      sameMesh(legacyVertices, legacyIndices, builder.vertices, builder.indices);
+
+  uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+  double parallelMs =
+      bestOfMs(iterations, [&]() { builder.buildFromObj(attrib, shapes, threads); });
+  std::cout << "  flat table x" << threads << ":     " << parallelMs << " ms, "
+            << builder.vertices.size() << " vertices (" << legacyMs / parallelMs << "x)\n";
+  bool parallelMatches =
+      sameMesh(legacyVertices, legacyIndices, builder.vertices, builder.indices);
+
+  if (!flatMatches || !parallelMatches) {
+    std::cerr << "dedup output differs from the unordered_map path!\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,897 @@
+// Renders a synthetic scene offscreen on a headless device for a fixed number of frames, then runs
+// microbenchmarks of model loading, transform matrices and buffer uploads. Results go to stdout as
+// one JSON object: CPU time per frame phase, GPU time per frame and render graph pass, objects
+// drawn and culled, and device memory in use.
+//
+// usage: SceneBenchmark [--objects N] [--models M] [--lights K] [--frames F] [--warmup W]
+//                       [--mode direct|instanced|indirect|gpu] [--parallel 0|1]
+//                       [--width W] [--height H] [--obj model.obj]
+// Run from the directory LveEngine runs from so the shaders are found. Without --obj a synthetic
+// OBJ is written to the working directory for the loadModel benchmark and removed afterwards.
+
+#include "lve_buffer.hpp"
+#include "lve_camera.hpp"
+#include "lve_deletion_queue.hpp"
+#include "lve_depth_pyramid.hpp"
+#include "lve_descriptors.hpp"
+#include "lve_device.hpp"
+#include "lve_frame_allocator.hpp"
+#include "lve_gpu_profiler.hpp"
+#include "lve_light_clusters.hpp"
+#include "lve_model.hpp"
+#include "lve_parallel_recorder.hpp"
+#include "lve_pipeline_registry.hpp"
+#include "lve_render_graph.hpp"
+#include "lve_scene.hpp"
+#include "lve_swap_chain.hpp"
+#include "lve_thread_pool.hpp"
+#include "lve_timeline.hpp"
+#include "lve_transform.hpp"
+#include "lve_upload_manager.hpp"
+#include "systems/point_light_system.hpp"
+#include "systems/simple_render_system.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using lve::LveDevice;
+using lve::LveModel;
+using lve::SimpleRenderSystem;
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr LveModel::VertexFormat VERTEX_FORMAT = LveModel::VertexFormat::Quantized;
+constexpr VkFormat COLOR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+constexpr int FRAMES_IN_FLIGHT = 2;
+// every this many objects one spins, so each frame has some transforms to rebuild
+constexpr uint32_t MOVING_OBJECT_STRIDE = 8;
+constexpr float OBJECT_SPACING = 2.f;
+constexpr const char *SYNTHETIC_OBJ_FILE = "scene_benchmark.obj";
+
+struct Options {
+  uint32_t objects = 10000;
+  uint32_t models = 16;
+  uint32_t lights = 64;
+  uint32_t frames = 500;
+  uint32_t warmupFrames = 50;
+  SimpleRenderSystem::Mode mode = SimpleRenderSystem::Mode::Instanced;
+  bool recordInParallel = true;
+  VkExtent2D extent{1280, 720};
+  std::string objPath;
+};
+
+const char *modeName(SimpleRenderSystem::Mode mode) {
+  switch (mode) {
+    case SimpleRenderSystem::Mode::Direct:
+      return "direct";
+    case SimpleRenderSystem::Mode::Instanced:
+      return "instanced";
+    case SimpleRenderSystem::Mode::Indirect:
+      return "indirect";
+    case SimpleRenderSystem::Mode::GpuCulled:
+      return "gpu";
+  }
+  return "unknown";
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i += 2) {
+    if (i + 1 >= argc) {
+      return false;
+    }
+    std::string key = argv[i];
+    std::string value = argv[i + 1];
+    auto count = [&]() { return static_cast<uint32_t>(std::max(0, std::atoi(value.c_str()))); };
+    if (key == "--objects") {
+      options.objects = count();
+    } else if (key == "--models") {
+      options.models = std::max(1u, count());
+    } else if (key == "--lights") {
+      options.lights = count();
+    } else if (key == "--frames") {
+      options.frames = std::max(1u, count());
+    } else if (key == "--warmup") {
+      options.warmupFrames = count();
+    } else if (key == "--parallel") {
+      options.recordInParallel = count() != 0;
+    } else if (key == "--width") {
+      options.extent.width = std::max(1u, count());
+    } else if (key == "--height") {
+      options.extent.height = std::max(1u, count());
+    } else if (key == "--obj") {
+      options.objPath = value;
+    } else if (key == "--mode") {
+      bool known = false;
+      for (auto mode :
+           {SimpleRenderSystem::Mode::Direct,
+            SimpleRenderSystem::Mode::Instanced,
+            SimpleRenderSystem::Mode::Indirect,
+            SimpleRenderSystem::Mode::GpuCulled}) {
+        if (value == modeName(mode)) {
+          options.mode = mode;
+          known = true;
+        }
+      }
+      if (!known) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+double msBetween(Clock::time_point begin, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+template <typename F>
+double bestOfMs(int iterations, F &&f) {
+  double best = 1e30;
+  for (int i = 0; i < iterations; i++) {
+    auto start = Clock::now();
+    f();
+    best = std::min(best, msBetween(start, Clock::now()));
+  }
+  return best;
+}
+
+// Writes mean, median, 95th percentile and max of samples as a JSON object
+void writeSummary(std::ostream &out, std::vector<double> samples) {
+  if (samples.empty()) {
+    out << "null";
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum = 0.;
+  for (double sample : samples) sum += sample;
+  auto percentile = [&](double p) {
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+  };
+  out << R"({"mean":)" << sum / samples.size() << R"(,"median":)" << percentile(.5)
+      << R"(,"p95":)" << percentile(.95) << R"(,"max":)" << samples.back() << "}";
+}
+
+// UV sphere of radius .5, finer spheres for higher detail so every model differs
+LveModel::Builder makeSphere(uint32_t detail, glm::vec3 color) {
+  uint32_t rings = 8 + 4 * detail;
+  uint32_t segments = 2 * rings;
+  LveModel::Builder builder{};
+  for (uint32_t r = 0; r <= rings; r++) {
+    float theta = glm::pi<float>() * r / rings;
+    for (uint32_t s = 0; s <= segments; s++) {
+      float phi = glm::two_pi<float>() * s / segments;
+      LveModel::Vertex vertex{};
+      vertex.normal = {
+          std::sin(theta) * std::cos(phi),
+          std::cos(theta),
+          std::sin(theta) * std::sin(phi)};
+      vertex.position = .5f * vertex.normal;
+      vertex.color = color;
+      vertex.uv = {float(s) / segments, float(r) / rings};
+      builder.vertices.push_back(vertex);
+    }
+  }
+  for (uint32_t r = 0; r < rings; r++) {
+    for (uint32_t s = 0; s < segments; s++) {
+      uint32_t i0 = r * (segments + 1) + s;
+      uint32_t i1 = i0 + segments + 1;
+      // the triangles touching a pole with two corners are degenerate
+      if (r != 0) {
+        builder.indices.insert(builder.indices.end(), {i0, i1, i0 + 1});
+      }
+      if (r != rings - 1) {
+        builder.indices.insert(builder.indices.end(), {i0 + 1, i1, i1 + 1});
+      }
+    }
+  }
+  builder.optimize();
+  return builder;
+}
+
+// size x size quads in the xz plane, one OBJ vertex / texcoord / normal per grid point
+void writeSyntheticObj(const std::string &path, uint32_t size) {
+  std::ofstream out{path};
+  if (!out) {
+    throw std::runtime_error("failed to write " + path + "!");
+  }
+  for (uint32_t y = 0; y <= size; y++) {
+    for (uint32_t x = 0; x <= size; x++) {
+      out << "v " << x << " 0 " << y << "\nvt " << float(x) / size << " " << float(y) / size
+          << "\nvn 0 1 0\n";
+    }
+  }
+  auto corner = [&](uint32_t x, uint32_t y) {
+    uint32_t i = y * (size + 1) + x + 1;
+    return std::to_string(i) + "/" + std::to_string(i) + "/" + std::to_string(i);
+  };
+  for (uint32_t y = 0; y < size; y++) {
+    for (uint32_t x = 0; x < size; x++) {
+      out << "f " << corner(x, y) << " " << corner(x + 1, y) << " " << corner(x, y + 1) << "\n";
+      out << "f " << corner(x + 1, y) << " " << corner(x + 1, y + 1) << " " << corner(x, y + 1)
+          << "\n";
+    }
+  }
+}
+
+// Color and depth attachment the benchmark renders into in place of a swap chain image
+class OffscreenTarget {
+ public:
+  OffscreenTarget(LveDevice &device, VkExtent2D extent) : extent{extent}, device{device} {
+    depthFormat = device.findSupportedFormat(
+        {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    // read back as if for a screenshot, so the main pass has an output
+    createImage(
+        COLOR_FORMAT,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        colorImage,
+        colorMemory,
+        colorView);
+    createImage(
+        depthFormat,
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_IMAGE_ASPECT_DEPTH_BIT,
+        depthImage,
+        depthMemory,
+        depthView);
+    createRenderPass();
+  }
+
+  ~OffscreenTarget() {
+    vkDestroyRenderPass(device.device(), renderPass, nullptr);
+    vkDestroyImageView(device.device(), colorView, nullptr);
+    vkDestroyImage(device.device(), colorImage, nullptr);
+    device.freeMemory(colorMemory);
+    vkDestroyImageView(device.device(), depthView, nullptr);
+    vkDestroyImage(device.device(), depthImage, nullptr);
+    device.freeMemory(depthMemory);
+  }
+
+  OffscreenTarget(const OffscreenTarget &) = delete;
+  OffscreenTarget &operator=(const OffscreenTarget &) = delete;
+
+  VkExtent2D extent;
+  VkFormat depthFormat;
+  VkImage colorImage;
+  VkImageView colorView;
+  VkImage depthImage;
+  VkImageView depthView;
+  // compatible with the render graph's main pass, only used to create the systems' pipelines
+  VkRenderPass renderPass;
+
+ private:
+  void createImage(
+      VkFormat format,
+      VkImageUsageFlags usage,
+      VkImageAspectFlags aspect,
+      VkImage &image,
+      lve::LveAllocation &memory,
+      VkImageView &view) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = aspect;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(device.device(), &viewInfo, nullptr, &view) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create offscreen image view!");
+    }
+  }
+
+  void createRenderPass() {
+    std::array<VkAttachmentDescription, 2> attachments{};
+    attachments[0].format = COLOR_FORMAT;
+    attachments[1].format = depthFormat;
+    for (auto &attachment : attachments) {
+      attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+      attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+      attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depthRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorRef;
+    subpass.pDepthStencilAttachment = &depthRef;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create offscreen render pass!");
+    }
+  }
+
+  LveDevice &device;
+  lve::LveAllocation colorMemory;
+  lve::LveAllocation depthMemory;
+};
+
+// N objects spread over a cube of grid cells, each drawing one of M sphere models, and K lights
+// placed at random inside the cube. The camera looks at the cube from in front of it, so some
+// objects are outside the frustum.
+void buildScene(
+    LveDevice &device,
+    const Options &options,
+    lve::LveScene &scene,
+    std::vector<std::shared_ptr<LveModel>> &models,
+    std::vector<lve::LveEntity> &movingObjects) {
+  std::mt19937 random{1234};
+  std::uniform_real_distribution<float> unit{0.f, 1.f};
+
+  for (uint32_t m = 0; m < options.models; m++) {
+    glm::vec3 color{unit(random), unit(random), unit(random)};
+    models.push_back(std::make_shared<LveModel>(device, makeSphere(m % 8, color), VERTEX_FORMAT));
+  }
+  // models may only be drawn once their uploads completed
+  device.uploadManager().wait(device.uploadManager().submit());
+
+  uint32_t side =
+      std::max(1u, static_cast<uint32_t>(std::ceil(std::cbrt(float(options.objects)))));
+  float halfWidth = .5f * side * OBJECT_SPACING;
+  for (uint32_t i = 0; i < options.objects; i++) {
+    glm::vec3 cell{float(i % side), float(i / side % side), float(i / (side * side))};
+    auto entity = scene.createEntity();
+    auto &transform = scene.transforms.add(entity);
+    transform.setTranslation(
+        (cell + .5f) * OBJECT_SPACING - glm::vec3{halfWidth, halfWidth, 0.f} +
+        (glm::vec3{unit(random), unit(random), unit(random)} - .5f));
+    transform.setRotation(
+        glm::vec3{unit(random), unit(random), unit(random)} * glm::two_pi<float>());
+    transform.setScale(glm::vec3{.5f + unit(random)});
+    scene.models.add(entity, models[i % models.size()]);
+    if (i % MOVING_OBJECT_STRIDE == 0) {
+      movingObjects.push_back(entity);
+    }
+  }
+
+  for (uint32_t i = 0; i < options.lights; i++) {
+    auto light = scene.createPointLight(1.f, .1f, {unit(random), unit(random), unit(random)});
+    scene.transforms.get(light).setTranslation(
+        glm::vec3{unit(random) - .5f, unit(random) - .5f, unit(random)} * 2.f * halfWidth);
+  }
+}
+
+struct SceneResults {
+  std::map<std::string, std::vector<double>> cpuMs;
+  std::vector<double> gpuFrameMs;
+  std::map<std::string, std::vector<double>> gpuScopeMs;
+  double vertexInvocations = 0.;
+  double fragmentInvocations = 0.;
+  SimpleRenderSystem::CullStats cullStats{};
+  lve::LveRenderGraph::Stats graphStats{};
+  lve::LveAllocator::Stats memoryStats{};
+  bool gpuTimingSupported = false;
+};
+
+SceneResults runScene(LveDevice &device, lve::LveThreadPool &threadPool, const Options &options) {
+  lve::LveScene scene;
+  std::vector<std::shared_ptr<LveModel>> models;
+  std::vector<lve::LveEntity> movingObjects;
+  buildScene(device, options, scene, models, movingObjects);
+
+  OffscreenTarget target{device, options.extent};
+  lve::LveGpuProfiler profiler{device};
+  lve::LveParallelRecorder parallelRecorder{device, threadPool};
+  lve::LveRenderGraph renderGraph{device};
+  lve::LveFrameAllocator frameAllocator{device};
+  lve::LveLightClusters lightClusters{device};
+
+  auto globalPool =
+      lve::LveDescriptorAllocator::Builder(device)
+          .setInitialSets(FRAMES_IN_FLIGHT)
+          .addPoolRatio(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f)
+          .addPoolRatio(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.f)
+          .build();
+  auto globalSetLayout =
+      lve::LveDescriptorSetLayout::Builder(device)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+          .addBinding(
+              1,
+              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+              VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .build();
+  std::vector<VkDescriptorSet> globalDescriptorSets(FRAMES_IN_FLIGHT);
+  for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+    auto bufferInfo = frameAllocator.descriptorInfo(i, sizeof(lve::GlobalUbo));
+    auto lightsInfo = lightClusters.lightsInfo(i);
+    auto clustersInfo = lightClusters.clustersInfo(i);
+    auto lightIndicesInfo = lightClusters.lightIndicesInfo(i);
+    lve::LveDescriptorWriter(*globalSetLayout, *globalPool)
+        .writeBuffer(0, &bufferInfo)
+        .writeBuffer(1, &lightsInfo)
+        .writeBuffer(2, &clustersInfo)
+        .writeBuffer(3, &lightIndicesInfo)
+        .build(globalDescriptorSets[i]);
+  }
+
+  SimpleRenderSystem::Shading shading{};
+  shading.vertexFormat = VERTEX_FORMAT;
+  SimpleRenderSystem simpleRenderSystem{
+      device,
+      target.renderPass,
+      globalSetLayout->getDescriptorSetLayout(),
+      shading};
+  simpleRenderSystem.setMode(options.mode);
+  lve::PointLightSystem pointLightSystem{
+      device,
+      target.renderPass,
+      globalSetLayout->getDescriptorSetLayout()};
+  lve::LveDepthPyramid depthPyramid{device, options.extent};
+  simpleRenderSystem.setDepthPyramid(&depthPyramid);
+  device.pipelineRegistry().compilePending(&threadPool);
+  bool gpuCulled = options.mode == SimpleRenderSystem::Mode::GpuCulled;
+
+  float sceneDepth = 2.f * std::cbrt(float(std::max(1u, options.objects))) * OBJECT_SPACING;
+  lve::LveCamera camera{};
+  camera.setViewYXZ({0.f, 0.f, -.25f * sceneDepth}, {0.f, 0.f, 0.f});
+  camera.setPerspectiveProjection(
+      glm::radians(50.f),
+      float(options.extent.width) / float(options.extent.height),
+      .1f,
+      2.f * sceneDepth + 10.f);
+
+  // one transient pool per frame in flight, as in LveRenderer
+  std::array<VkCommandPool, FRAMES_IN_FLIGHT> commandPools{};
+  std::array<VkCommandBuffer, FRAMES_IN_FLIGHT> commandBuffers{};
+  std::array<uint64_t, FRAMES_IN_FLIGHT> frameValues{};
+  for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = device.findPhysicalQueueFamilies().graphicsFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &commandPools[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create frame command pool!");
+    }
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPools[i];
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffers[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate command buffers!");
+    }
+  }
+
+  SceneResults results{};
+  results.gpuTimingSupported = profiler.isSupported();
+  uint32_t totalFrames = options.warmupFrames + options.frames;
+  for (uint32_t frame = 0; frame < totalFrames; frame++) {
+    bool measured = frame >= options.warmupFrames;
+    int frameIndex = static_cast<int>(frame % FRAMES_IN_FLIGHT);
+    float frameTime = 1.f / 60.f;
+
+    // wait: the frame slot's previous submission
+    auto waitBegin = Clock::now();
+    device.graphicsTimeline().wait(frameValues[frameIndex]);
+    device.deletionQueue().collect();
+    vkResetCommandPool(device.device(), commandPools[frameIndex], 0);
+    VkCommandBuffer commandBuffer = commandBuffers[frameIndex];
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+      throw std::runtime_error("failed to begin recording command buffer!");
+    }
+    profiler.beginFrame(commandBuffer, frameIndex);
+    frameAllocator.beginFrame(frameIndex);
+
+    // update
+    auto updateBegin = Clock::now();
+    lve::FrameInfo frameInfo{
+        frameIndex,
+        frameTime,
+        commandBuffer,
+        camera,
+        globalDescriptorSets[frameIndex],
+        0,
+        scene};
+    frameInfo.frameAllocator = &frameAllocator;
+    frameInfo.profiler = &profiler;
+    for (auto entity : movingObjects) {
+      auto &transform = scene.transforms.get(entity);
+      glm::vec3 rotation = transform.getRotation();
+      rotation.y += frameTime;
+      transform.setRotation(rotation);
+    }
+    lve::GlobalUbo ubo{};
+    ubo.projection = camera.getProjection();
+    ubo.view = camera.getView();
+    ubo.inverseView = camera.getInverseView();
+    // lights are gathered at their world positions, so only once the transforms propagated
+    pointLightSystem.animate(frameInfo);
+    scene.updateTransforms(&threadPool);
+    pointLightSystem.update(frameInfo, ubo, lightClusters);
+    frameInfo.globalUboOffset = frameAllocator.pushUniform(ubo);
+
+    // record, the graph's cull pass times itself as the cull phase
+    auto recordBegin = Clock::now();
+    double cullMs = 0.;
+    renderGraph.reset(options.extent);
+    lve::LveRenderGraph::ImportedImage colorImage{
+        target.colorImage,
+        target.colorView,
+        COLOR_FORMAT,
+        options.extent};
+    // the previous frame's final transition to TRANSFER_SRC, which this frame's first barrier
+    // has to chain onto
+    colorImage.initialStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    colorImage.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    colorImage.finalStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    auto color = renderGraph.importImage("offscreen", colorImage);
+
+    lve::LveRenderGraph::ImportedImage depthImage{
+        target.depthImage,
+        target.depthView,
+        target.depthFormat,
+        options.extent};
+    depthImage.initialStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                               VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    auto depth = renderGraph.importImage("depth", depthImage);
+
+    lve::LveRenderGraph::ImageHandle pyramid{};
+    if (gpuCulled) {
+      lve::LveRenderGraph::ImportedImage pyramidImage{
+          depthPyramid.getImage(),
+          VK_NULL_HANDLE,
+          VK_FORMAT_R32_SFLOAT,
+          depthPyramid.getExtent()};
+      pyramidImage.initialLayout = VK_IMAGE_LAYOUT_GENERAL;
+      pyramidImage.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
+      pyramid = renderGraph.importImage("depth pyramid", pyramidImage);
+    }
+
+    renderGraph.addPass(
+        "cull",
+        [&](lve::LveRenderGraph::PassBuilder &pass) {
+          pass.setSideEffects();
+          if (gpuCulled) {
+            pass.readStorage(pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+          }
+        },
+        [&](const lve::LveRenderGraph::PassContext &) {
+          auto cullBegin = Clock::now();
+          simpleRenderSystem.cullGameObjects(frameInfo);
+          cullMs = msBetween(cullBegin, Clock::now());
+        });
+
+    renderGraph.addPass(
+        "main",
+        [&](lve::LveRenderGraph::PassBuilder &pass) {
+          pass.writeColor(color, {{0.01f, 0.01f, 0.01f, 1.0f}});
+          pass.writeDepth(depth, {1.0f, 0});
+          if (options.recordInParallel) {
+            pass.useSecondaryCommandBuffers();
+          }
+        },
+        [&](const lve::LveRenderGraph::PassContext &context) {
+          if (options.recordInParallel) {
+            parallelRecorder.beginFrame(
+                frameIndex,
+                context.renderPass,
+                context.framebuffer,
+                context.extent);
+            frameInfo.recorder = &parallelRecorder;
+          }
+          simpleRenderSystem.renderGameObjects(frameInfo);
+          pointLightSystem.render(frameInfo);
+          if (frameInfo.recorder != nullptr) {
+            parallelRecorder.execute(context.commandBuffer);
+          }
+        });
+
+    if (gpuCulled) {
+      renderGraph.addPass(
+          "depth pyramid",
+          [&](lve::LveRenderGraph::PassBuilder &pass) {
+            pass.readSampled(depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            pass.writeStorage(pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+          },
+          [&](const lve::LveRenderGraph::PassContext &context) {
+            depthPyramid.build(
+                context.commandBuffer,
+                frameIndex,
+                target.depthView,
+                camera.getProjection() * camera.getView());
+          });
+    }
+
+    renderGraph.compile();
+    renderGraph.execute(commandBuffer, &profiler);
+    frameAllocator.flush();
+
+    // submit
+    auto submitBegin = Clock::now();
+    profiler.endFrame(commandBuffer);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record command buffer!");
+    }
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    frameValues[frameIndex] = device.graphicsTimeline().submit(submitInfo);
+    device.deletionQueue().endFrame(frameValues[frameIndex]);
+    auto frameEnd = Clock::now();
+
+    if (measured) {
+      results.cpuMs["wait"].push_back(msBetween(waitBegin, updateBegin));
+      results.cpuMs["update"].push_back(msBetween(updateBegin, recordBegin));
+      results.cpuMs["cull"].push_back(cullMs);
+      results.cpuMs["record"].push_back(msBetween(recordBegin, submitBegin) - cullMs);
+      results.cpuMs["submit"].push_back(msBetween(submitBegin, frameEnd));
+      results.cpuMs["frame"].push_back(msBetween(waitBegin, frameEnd));
+    }
+  }
+  vkDeviceWaitIdle(device.device());
+
+  // the profiler keeps the last HISTORY_FRAMES frames it read back
+  uint64_t statisticsFrames = 0;
+  for (const auto &frame : profiler.getHistory()) {
+    if (frame.frame < options.warmupFrames) {
+      continue;
+    }
+    results.gpuFrameMs.push_back(frame.durationMs);
+    bool hasStatistics = false;
+    for (const auto &scope : frame.scopes) {
+      results.gpuScopeMs[scope.name].push_back(scope.durationMs);
+      if (scope.hasStatistics) {
+        results.vertexInvocations += scope.vertexInvocations;
+        results.fragmentInvocations += scope.fragmentInvocations;
+        hasStatistics = true;
+      }
+    }
+    statisticsFrames += hasStatistics;
+  }
+  if (statisticsFrames > 0) {
+    results.vertexInvocations /= statisticsFrames;
+    results.fragmentInvocations /= statisticsFrames;
+  }
+  results.cullStats = simpleRenderSystem.getCullStats();
+  results.graphStats = renderGraph.getStats();
+  results.memoryStats = device.getMemoryStats();
+
+  for (VkCommandPool pool : commandPools) {
+    vkDestroyCommandPool(device.device(), pool, nullptr);
+  }
+  return results;
+}
+
+void writeSceneResults(std::ostream &out, const Options &options, const SceneResults &results) {
+  out << R"("scene":{"objects":)" << options.objects << R"(,"models":)" << options.models
+      << R"(,"lights":)" << options.lights << R"(,"frames":)" << options.frames
+      << R"(,"warmupFrames":)" << options.warmupFrames << R"(,"mode":")"
+      << modeName(options.mode) << R"(","parallelRecording":)"
+      << (options.recordInParallel ? "true" : "false") << R"(,"width":)"
+      << options.extent.width << R"(,"height":)" << options.extent.height << "},\n";
+
+  out << R"("cpuMs":{)";
+  bool first = true;
+  for (const char *phase : {"wait", "update", "cull", "record", "submit", "frame"}) {
+    out << (first ? "" : ",") << '"' << phase << R"(":)";
+    writeSummary(out, results.cpuMs.at(phase));
+    first = false;
+  }
+  out << "},\n";
+
+  out << R"("gpuMs":{"supported":)" << (results.gpuTimingSupported ? "true" : "false")
+      << R"(,"frames":)" << results.gpuFrameMs.size() << R"(,"frame":)";
+  writeSummary(out, results.gpuFrameMs);
+  out << R"(,"scopes":{)";
+  first = true;
+  for (const auto &scope : results.gpuScopeMs) {
+    out << (first ? "" : ",") << '"' << scope.first << R"(":)";
+    writeSummary(out, scope.second);
+    first = false;
+  }
+  out << "}},\n";
+
+  out << R"("draws":{"objectsDrawn":)" << results.cullStats.drawn << R"(,"objectsCulled":)"
+      << results.cullStats.culled << R"(,"vertexInvocations":)" << results.vertexInvocations
+      << R"(,"fragmentInvocations":)" << results.fragmentInvocations << "},\n";
+
+  const auto &graph = results.graphStats;
+  out << R"("renderGraph":{"executedPasses":)" << graph.executedPasses << R"(,"barriers":)"
+      << graph.barriers << R"(,"transientImages":)" << graph.transientImages
+      << R"(,"transientBytes":)" << graph.transientBytes << "},\n";
+
+  const auto &memory = results.memoryStats;
+  out << R"("memory":{"blocks":)" << memory.blockCount << R"(,"dedicatedAllocations":)"
+      << memory.dedicatedAllocationCount << R"(,"allocations":)" << memory.allocationCount
+      << R"(,"bytesReserved":)" << memory.bytesReserved << R"(,"bytesInUse":)"
+      << memory.bytesInUse << R"(,"fragmentation":)" << memory.fragmentation() << "},\n";
+}
+
+// Builder::loadModel of options.objPath, or of a generated grid when none was given
+void benchmarkLoadModel(std::ostream &out, const Options &options) {
+  std::string path = options.objPath;
+  if (path.empty()) {
+    path = SYNTHETIC_OBJ_FILE;
+    writeSyntheticObj(path, 512);
+  }
+  LveModel::Builder builder{};
+  double singleMs = bestOfMs(5, [&]() { builder.loadModel(path, 1); });
+  uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+  double parallelMs = bestOfMs(5, [&]() { builder.loadModel(path, threads); });
+  if (options.objPath.empty()) {
+    std::remove(path.c_str());
+  }
+
+  out << R"("loadModel":{"indices":)" << builder.indices.size() << R"(,"vertices":)"
+      << builder.vertices.size() << R"(,"ms":)" << singleMs << R"(,"threads":)" << threads
+      << R"(,"parallelMs":)" << parallelMs << "}";
+}
+
+// TransformComponent::mat4 rebuilding dirty matrices one by one, against LveTransformUpdater
+// rebuilding them in one pass
+void benchmarkTransforms(std::ostream &out) {
+  constexpr size_t COUNT = 1 << 18;
+  constexpr int ITERATIONS = 10;
+  std::vector<lve::TransformComponent> transforms(COUNT);
+  auto makeDirty = [&](int iteration) {
+    for (size_t i = 0; i < COUNT; i++) {
+      transforms[i].setRotation({.001f * i, .002f * iteration, .003f * i});
+      transforms[i].setScale({1.f, 1.f + .001f * i, 1.f});
+    }
+  };
+
+  // keeps the matrices from being optimized away
+  volatile float sink = 0.f;
+  double mat4Ms = 1e30;
+  double updaterMs = 1e30;
+  lve::LveTransformUpdater updater{};
+  for (int iteration = 0; iteration < ITERATIONS; iteration++) {
+    makeDirty(iteration);
+    auto start = Clock::now();
+    float sum = 0.f;
+    for (auto &transform : transforms) {
+      sum += transform.mat4()[0][0];
+    }
+    mat4Ms = std::min(mat4Ms, msBetween(start, Clock::now()));
+    sink = sink + sum;
+
+    makeDirty(iteration);
+    start = Clock::now();
+    updater.update(transforms.data(), transforms.size());
+    updaterMs = std::min(updaterMs, msBetween(start, Clock::now()));
+    sink = sink + transforms.back().mat4()[0][0];
+  }
+
+  out << R"("transformMat4":{"transforms":)" << COUNT << R"(,"nsPerMatrix":)"
+      << mat4Ms * 1e6 / COUNT << R"(,"updaterNsPerMatrix":)" << updaterMs * 1e6 / COUNT
+      << R"(,"simdWidth":)" << lve::LveTransformUpdater::SIMD_WIDTH << "}";
+}
+
+// LveUploadManager::uploadBuffer into a device local buffer, in chunks the size of typical mesh
+// and texture uploads, including the submit and the wait for the copies
+void benchmarkUploads(std::ostream &out, LveDevice &device) {
+  constexpr VkDeviceSize TOTAL_SIZE = 64 * 1024 * 1024;
+  constexpr VkDeviceSize CHUNK_SIZE = 1024 * 1024;
+  std::vector<uint8_t> data(CHUNK_SIZE);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<uint8_t>(i);
+  }
+  lve::LveBuffer buffer{
+      device,
+      TOTAL_SIZE,
+      1,
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+
+  auto &uploadManager = device.uploadManager();
+  double ms = bestOfMs(5, [&]() {
+    for (VkDeviceSize offset = 0; offset < TOTAL_SIZE; offset += CHUNK_SIZE) {
+      uploadManager.uploadBuffer(
+          data.data(),
+          CHUNK_SIZE,
+          buffer.getBuffer(),
+          offset,
+          VK_ACCESS_SHADER_READ_BIT,
+          VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+    }
+    uploadManager.wait(uploadManager.submit());
+  });
+
+  out << R"("upload":{"bytes":)" << TOTAL_SIZE << R"(,"chunkBytes":)" << CHUNK_SIZE
+      << R"(,"ms":)" << ms << R"(,"gbPerSecond":)" << TOTAL_SIZE / (ms * 1e6) << "}";
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options options{};
+  if (!parseOptions(argc, argv, options)) {
+    std::cerr << "usage: SceneBenchmark [--objects N] [--models M] [--lights K] [--frames F] "
+                 "[--warmup W] [--mode direct|instanced|indirect|gpu] [--parallel 0|1] "
+                 "[--width W] [--height H] [--obj model.obj]\n";
+    return EXIT_FAILURE;
+  }
+
+  try {
+    LveDevice device{};
+    lve::LveThreadPool threadPool{};
+    if ((options.mode == SimpleRenderSystem::Mode::Indirect &&
+         !SimpleRenderSystem::supportsIndirect(device)) ||
+        (options.mode == SimpleRenderSystem::Mode::GpuCulled &&
+         !SimpleRenderSystem::supportsGpuCulling(device))) {
+      std::cerr << "mode " << modeName(options.mode) << " is not supported by "
+                << device.properties.deviceName << "\n";
+      return EXIT_FAILURE;
+    }
+
+    SceneResults results = runScene(device, threadPool, options);
+
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << R"({"device":")" << device.properties.deviceName << "\",\n";
+    writeSceneResults(std::cout, options, results);
+    std::cout << R"("microbenchmarks":{)";
+    benchmarkLoadModel(std::cout, options);
+    std::cout << ",\n";
+    benchmarkTransforms(std::cout);
+    std::cout << ",\n";
+    benchmarkUploads(std::cout, device);
+    std::cout << "}}\n";
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
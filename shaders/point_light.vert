@@ -10,10 +10,12 @@ const vec2 OFFSETS[6] = vec2[](
 );
 
 layout (location = 0) out vec2 fragOffset;
+layout (location = 1) out vec3 fragColor;
 
 struct PointLight {
-  vec4 position; // ignore w
+  vec4 position; // w is range
   vec4 color; // w is intensity
+  float radius;
 };
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
@@ -21,25 +23,25 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 view;
   mat4 invView;
   vec4 ambientLightColor; // w is intensity
-  PointLight pointLights[10];
-  int numLights;
+  uvec4 clusterGrid; // cluster counts along x, y and z, w is the light count
+  vec4 clusterDepth; // depth slice = log(view depth) * x + y
 } ubo;
 
-layout(push_constant) uniform Push {
-  vec4 position;
-  vec4 color;
-  float radius;
-} push;
-
+// one instance per light
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffer {
+  PointLight lights[];
+};
 
 void main() {
+  PointLight light = lights[gl_InstanceIndex];
   fragOffset = OFFSETS[gl_VertexIndex];
+  fragColor = light.color.xyz;
   vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
   vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 
-  vec3 positionWorld = push.position.xyz
-    + push.radius * fragOffset.x * cameraRightWorld
-    + push.radius * fragOffset.y * cameraUpWorld;
+  vec3 positionWorld = light.position.xyz
+    + light.radius * fragOffset.x * cameraRightWorld
+    + light.radius * fragOffset.y * cameraUpWorld;
 
   gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
 }
\ No newline at end of file
@@ -7,8 +7,9 @@ layout (location = 2) in vec3 fragNormalWorld;
 layout (location = 0) out vec4 outColor;
 
 struct PointLight {
-  vec4 position; // ignore w
+  vec4 position; // w is range
   vec4 color; // w is intensity
+  float radius; // billboard only
 };
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
@@ -16,10 +17,28 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 view;
   mat4 invView;
   vec4 ambientLightColor; // w is intensity
-  PointLight pointLights[10];
-  int numLights;
+  uvec4 clusterGrid; // cluster counts along x, y and z, w is the light count
+  vec4 clusterDepth; // depth slice = log(view depth) * x + y
 } ubo;
 
+// see LveLightClusters
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffer {
+  PointLight lights[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer ClusterBuffer {
+  uvec2 clusters[]; // offset and count into lightIndices
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer LightIndexBuffer {
+  uint lightIndices[];
+};
+
+// specialization constants, set by SimpleRenderSystem::createPipelines
+layout(constant_id = 0) const uint LIGHT_LIMIT = 64; // lights shaded per cluster at most
+layout(constant_id = 1) const bool SPECULAR = true;
+layout(constant_id = 2) const bool VERTEX_COLOR = true;
+
 layout(push_constant) uniform Push {
   mat4 modelMatrix;
   mat4 normalMatrix;
@@ -33,10 +52,28 @@ void main() {
   vec3 cameraPosWorld = ubo.invView[3].xyz;
   vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
 
-  for (int i = 0; i < ubo.numLights; i++) {
-    PointLight light = ubo.pointLights[i];
+  // the cluster this fragment falls in, from its screen position and view depth
+  vec4 positionView = ubo.view * vec4(fragPosWorld, 1.0);
+  vec4 positionClip = ubo.projection * positionView;
+  vec2 tile = (positionClip.xy / positionClip.w * 0.5 + 0.5) * vec2(ubo.clusterGrid.xy);
+  float slice = log(positionView.z) * ubo.clusterDepth.x + ubo.clusterDepth.y;
+  uvec3 cell = uvec3(
+      clamp(tile, vec2(0.0), vec2(ubo.clusterGrid.xy - 1u)),
+      clamp(slice, 0.0, float(ubo.clusterGrid.z - 1u)));
+  uvec2 cluster = clusters[(cell.z * ubo.clusterGrid.y + cell.y) * ubo.clusterGrid.x + cell.x];
+
+  // constant trip count, so the loop can be unrolled
+  for (uint i = 0; i < LIGHT_LIMIT; i++) {
+    if (i >= cluster.y) {
+      break;
+    }
+    PointLight light = lights[lightIndices[cluster.x + i]];
     vec3 directionToLight = light.position.xyz - fragPosWorld;
-    float attenuation = 1.0 / dot(directionToLight, directionToLight); // distance squared
+    float distanceSquared = dot(directionToLight, directionToLight);
+    // inverse square falloff, windowed to reach zero at the light's range
+    float falloff = distanceSquared / (light.position.w * light.position.w);
+    float window = clamp(1.0 - falloff * falloff, 0.0, 1.0);
+    float attenuation = window * window / distanceSquared;
     directionToLight = normalize(directionToLight);
 
     float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
@@ -45,6 +82,9 @@ void main() {
     diffuseLight += intensity * cosAngIncidence;
 
     // specular lighting
+    if (!SPECULAR) {
+      continue;
+    }
     vec3 halfAngle = normalize(directionToLight + viewDirection);
     float blinnTerm = dot(surfaceNormal, halfAngle);
     blinnTerm = clamp(blinnTerm, 0, 1);
@@ -52,5 +92,6 @@ void main() {
     specularLight += intensity * blinnTerm;
   }
   
-  outColor = vec4(diffuseLight * fragColor + specularLight * fragColor, 1.0);
+  vec3 albedo = VERTEX_COLOR ? fragColor : vec3(1.0);
+  outColor = vec4(diffuseLight * albedo + specularLight * albedo, 1.0);
 }
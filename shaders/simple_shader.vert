@@ -5,22 +5,20 @@ layout(location = 1) in vec3 color;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec2 uv;
 
+// the compact vertex formats store normals octahedral encoded in xy
+layout(constant_id = 0) const bool OCTAHEDRAL_NORMALS = false;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
 
-struct PointLight {
-  vec4 position; // ignore w
-  vec4 color; // w is intensity
-};
-
 layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projection;
   mat4 view;
   mat4 invView;
   vec4 ambientLightColor; // w is intensity
-  PointLight pointLights[10];
-  int numLights;
+  uvec4 clusterGrid; // cluster counts along x, y and z, w is the light count
+  vec4 clusterDepth; // depth slice = log(view depth) * x + y
 } ubo;
 
 layout(push_constant) uniform Push {
@@ -28,10 +26,20 @@ layout(push_constant) uniform Push {
   mat4 normalMatrix;
 } push;
 
+// Unit length is restored after the normal matrix is applied
+vec3 octahedralNormal(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return n;
+}
+
 void main() {
+  vec3 localNormal = OCTAHEDRAL_NORMALS ? octahedralNormal(normal.xy) : normal;
   vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
   gl_Position = ubo.projection * ubo.view * positionWorld;
-  fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+  fragNormalWorld = normalize(mat3(push.normalMatrix) * localNormal);
   fragPosWorld = positionWorld.xyz;
   fragColor = color;
 }
@@ -0,0 +1,51 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+// the compact vertex formats store normals octahedral encoded in xy
+layout(constant_id = 0) const bool OCTAHEDRAL_NORMALS = false;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+  mat4 projection;
+  mat4 view;
+  mat4 invView;
+  vec4 ambientLightColor; // w is intensity
+  uvec4 clusterGrid; // cluster counts along x, y and z, w is the light count
+  vec4 clusterDepth; // depth slice = log(view depth) * x + y
+} ubo;
+
+struct ObjectData {
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+};
+
+// one entry per drawn instance, gl_InstanceIndex includes the draw's firstInstance
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+  ObjectData objects[];
+} objectBuffer;
+
+// Unit length is restored after the normal matrix is applied
+vec3 octahedralNormal(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return n;
+}
+
+void main() {
+  ObjectData object = objectBuffer.objects[gl_InstanceIndex];
+  vec3 localNormal = OCTAHEDRAL_NORMALS ? octahedralNormal(normal.xy) : normal;
+  vec4 positionWorld = object.modelMatrix * vec4(position, 1.0);
+  gl_Position = ubo.projection * ubo.view * positionWorld;
+  fragNormalWorld = normalize(mat3(object.normalMatrix) * localNormal);
+  fragPosWorld = positionWorld.xyz;
+  fragColor = color;
+}
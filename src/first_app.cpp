@@ -3,6 +3,10 @@
 #include "keyboard_movement_controller.hpp"
 #include "lve_buffer.hpp"
 #include "lve_camera.hpp"
+#include "lve_depth_pyramid.hpp"
+#include "lve_frame_allocator.hpp"
+#include "lve_light_clusters.hpp"
+#include "lve_pipeline_registry.hpp"
 #include "systems/point_light_system.hpp"
 #include "systems/simple_render_system.hpp"
 
@@ -16,128 +20,292 @@
 #include <array>
 #include <cassert>
 #include <chrono>
+#include <fstream>
 #include <stdexcept>
 
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
 namespace lve {
 
 FirstApp::FirstApp() {
   globalPool =
-      LveDescriptorPool::Builder(lveDevice)
-          .setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
-          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+      LveDescriptorAllocator::Builder(lveDevice)
+          .setInitialSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolRatio(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f)
+          .addPoolRatio(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.f)
           .build();
+  if (lveDevice.supportsBindless()) {
+    bindlessTable = std::make_unique<LveBindlessTable>(lveDevice);
+  }
+  textureStreamer =
+      std::make_unique<LveTextureStreamer>(lveDevice, threadPool, bindlessTable.get());
   loadGameObjects();
 }
 
 FirstApp::~FirstApp() {}
 
 void FirstApp::run() {
-  std::vector<std::unique_ptr<LveBuffer>> uboBuffers(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
-  for (int i = 0; i < uboBuffers.size(); i++) {
-    uboBuffers[i] = std::make_unique<LveBuffer>(
-        lveDevice,
-        sizeof(GlobalUbo),
-        1,
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    uboBuffers[i]->map();
-  }
+  // the global ubo and any other per frame uniform data are bump allocated from here
+  LveFrameAllocator frameAllocator{lveDevice};
 
   auto globalSetLayout =
       LveDescriptorSetLayout::Builder(lveDevice)
-          .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+          .addBinding(
+              1,
+              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+              VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
           .build();
 
+  LveLightClusters lightClusters{lveDevice};
   std::vector<VkDescriptorSet> globalDescriptorSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
   for (int i = 0; i < globalDescriptorSets.size(); i++) {
-    auto bufferInfo = uboBuffers[i]->descriptorInfo();
+    auto bufferInfo = frameAllocator.descriptorInfo(i, sizeof(GlobalUbo));
+    auto lightsInfo = lightClusters.lightsInfo(i);
+    auto clustersInfo = lightClusters.clustersInfo(i);
+    auto lightIndicesInfo = lightClusters.lightIndicesInfo(i);
     LveDescriptorWriter(*globalSetLayout, *globalPool)
         .writeBuffer(0, &bufferInfo)
+        .writeBuffer(1, &lightsInfo)
+        .writeBuffer(2, &clustersInfo)
+        .writeBuffer(3, &lightIndicesInfo)
         .build(globalDescriptorSets[i]);
   }
 
+  SimpleRenderSystem::Shading shading{};
+  shading.vertexFormat = VERTEX_FORMAT;
   SimpleRenderSystem simpleRenderSystem{
       lveDevice,
       lveRenderer.getSwapChainRenderPass(),
-      globalSetLayout->getDescriptorSetLayout()};
+      globalSetLayout->getDescriptorSetLayout(),
+      shading};
   PointLightSystem pointLightSystem{
       lveDevice,
       lveRenderer.getSwapChainRenderPass(),
       globalSetLayout->getDescriptorSetLayout()};
   LveCamera camera{};
 
+  // previous frame's depth, for occlusion culling in the GPU culled mode
+  LveDepthPyramid depthPyramid{lveDevice, lveRenderer.getSwapChainExtent()};
+  simpleRenderSystem.setDepthPyramid(&depthPyramid);
+  // everything requested while creating the systems, compiled at once
+  lveDevice.pipelineRegistry().compilePending(&threadPool);
+
   auto viewerObject = LveGameObject::createGameObject();
-  viewerObject.transform.translation.z = -2.5f;
+  viewerObject.transform.setTranslation({0.f, 0.f, -2.5f});
   KeyboardMovementController cameraController{};
 
   auto currentTime = std::chrono::high_resolution_clock::now();
-  while (!lveWindow.shouldClose()) {
+  uint32_t swapChainGeneration = lveRenderer.getSwapChainGeneration();
+  float frameTime = 0.f;
+  auto sampleInput = [&]() {
     glfwPollEvents();
 
     auto newTime = std::chrono::high_resolution_clock::now();
-    float frameTime =
+    frameTime =
         std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
     currentTime = newTime;
 
     cameraController.moveInPlaneXZ(lveWindow.getGLFWwindow(), frameTime, viewerObject);
-    camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+    camera.setViewYXZ(
+        viewerObject.transform.getTranslation(),
+        viewerObject.transform.getRotation());
 
     float aspect = lveRenderer.getAspectRatio();
     camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 100.f);
+  };
 
-    if (auto commandBuffer = lveRenderer.beginFrame()) {
+  while (!lveWindow.shouldClose()) {
+    // in low latency mode beginFrame does all the waiting, and input is only sampled after it,
+    // right before recording
+    bool lowLatency = lveRenderer.getSwapChainSettings().lowLatency;
+    if (!lowLatency) {
+      sampleInput();
+    }
+
+    modelLoader.update();
+
+    auto commandBuffer = lveRenderer.beginFrame();
+    if (lowLatency) {
+      sampleInput();
+    }
+    if (commandBuffer) {
       int frameIndex = lveRenderer.getFrameIndex();
+      frameAllocator.beginFrame(frameIndex);
+      if (bindlessTable) {
+        bindlessTable->beginFrame();
+      }
+      textureStreamer->update();
       FrameInfo frameInfo{
           frameIndex,
           frameTime,
           commandBuffer,
           camera,
           globalDescriptorSets[frameIndex],
-          gameObjects};
+          0,
+          scene};
+      frameInfo.frameAllocator = &frameAllocator;
+      frameInfo.profiler = &lveRenderer.getGpuProfiler();
 
       // update
       GlobalUbo ubo{};
       ubo.projection = camera.getProjection();
       ubo.view = camera.getView();
       ubo.inverseView = camera.getInverseView();
-      pointLightSystem.update(frameInfo, ubo);
-      uboBuffers[frameIndex]->writeToBuffer(&ubo);
-      uboBuffers[frameIndex]->flush();
+      // lights are gathered at their world positions, so only once the transforms propagated
+      pointLightSystem.animate(frameInfo);
+      scene.updateTransforms(&threadPool);
+      pointLightSystem.update(frameInfo, ubo, lightClusters);
+      frameInfo.globalUboOffset = frameAllocator.pushUniform(ubo);
+
+      // the graph's cached framebuffers reference the old swap chain's views
+      if (swapChainGeneration != lveRenderer.getSwapChainGeneration()) {
+        renderGraph.resetFramebuffers();
+        swapChainGeneration = lveRenderer.getSwapChainGeneration();
+      }
+      depthPyramid.resize(lveRenderer.getSwapChainExtent());
+      bool gpuCulled = simpleRenderSystem.getMode() == SimpleRenderSystem::Mode::GpuCulled;
+
+      VkExtent2D extent = lveRenderer.getSwapChainExtent();
+      renderGraph.reset(extent);
+      LveRenderGraph::ImportedImage colorImage{
+          lveRenderer.getCurrentImage(),
+          lveRenderer.getCurrentImageView(),
+          lveRenderer.getSwapChainImageFormat(),
+          extent};
+      // the submit waits for the image to be acquired at this stage
+      colorImage.initialStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      colorImage.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+      auto color = renderGraph.importImage("swap chain", colorImage);
+
+      LveRenderGraph::ImportedImage depthImage{
+          lveRenderer.getCurrentDepthImage(),
+          lveRenderer.getCurrentDepthImageView(),
+          lveRenderer.getSwapChainDepthFormat(),
+          extent};
+      // earlier frames depth tested against and sampled this image
+      depthImage.initialStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+      auto depth = renderGraph.importImage("depth", depthImage);
+
+      // the pyramid carries over to the next frame's culling, its build already made its writes
+      // visible to compute shaders
+      LveRenderGraph::ImageHandle pyramid{};
+      if (gpuCulled) {
+        LveRenderGraph::ImportedImage pyramidImage{
+            depthPyramid.getImage(),
+            VK_NULL_HANDLE,
+            VK_FORMAT_R32_SFLOAT,
+            depthPyramid.getExtent()};
+        pyramidImage.initialLayout = VK_IMAGE_LAYOUT_GENERAL;
+        pyramidImage.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
+        pyramid = renderGraph.importImage("depth pyramid", pyramidImage);
+      }
+
+      // cull
+      renderGraph.addPass(
+          "cull",
+          [&](LveRenderGraph::PassBuilder &pass) {
+            // writes the indirect draw buffers
+            pass.setSideEffects();
+            if (gpuCulled) {
+              pass.readStorage(pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            }
+          },
+          [&](const LveRenderGraph::PassContext &) {
+            simpleRenderSystem.cullGameObjects(frameInfo);
+          });
 
       // render
-      lveRenderer.beginSwapChainRenderPass(commandBuffer);
-      simpleRenderSystem.renderGameObjects(frameInfo);
-      pointLightSystem.render(frameInfo);
-      lveRenderer.endSwapChainRenderPass(commandBuffer);
+      renderGraph.addPass(
+          "main",
+          [&](LveRenderGraph::PassBuilder &pass) {
+            pass.writeColor(color, {{0.01f, 0.01f, 0.01f, 1.0f}});
+            pass.writeDepth(depth, {1.0f, 0});
+            if (recordInParallel) {
+              pass.useSecondaryCommandBuffers();
+            }
+          },
+          [&](const LveRenderGraph::PassContext &context) {
+            if (recordInParallel) {
+              parallelRecorder.beginFrame(
+                  frameIndex,
+                  context.renderPass,
+                  context.framebuffer,
+                  context.extent);
+              frameInfo.recorder = &parallelRecorder;
+            }
+            simpleRenderSystem.renderGameObjects(frameInfo);
+            pointLightSystem.render(frameInfo);
+            if (frameInfo.recorder != nullptr) {
+              parallelRecorder.execute(context.commandBuffer);
+            }
+          });
+
+      // reduce this frame's depth for the next frame's occlusion culling
+      if (gpuCulled) {
+        renderGraph.addPass(
+            "depth pyramid",
+            [&](LveRenderGraph::PassBuilder &pass) {
+              pass.readSampled(depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+              pass.writeStorage(pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            },
+            [&](const LveRenderGraph::PassContext &context) {
+              depthPyramid.build(
+                  context.commandBuffer,
+                  frameIndex,
+                  lveRenderer.getCurrentDepthImageView(),
+                  camera.getProjection() * camera.getView());
+            });
+      }
+
+      renderGraph.compile();
+      renderGraph.execute(commandBuffer, frameInfo.profiler);
+      frameAllocator.flush();
       lveRenderer.endFrame();
     }
   }
 
   vkDeviceWaitIdle(lveDevice.device());
+
+  if (writeGpuTrace) {
+    std::ofstream trace{ENGINE_DIR + std::string{GPU_TRACE_FILE}};
+    lveRenderer.getGpuProfiler().writeChromeTrace(trace);
+  }
+}
+
+void FirstApp::loadModelAsync(LveEntity entity, const std::string &filepath) {
+  modelLoader.loadAsync(filepath, [this, entity](std::shared_ptr<LveModel> model) {
+    if (scene.isAlive(entity)) {
+      scene.models.add(entity, std::move(model));
+    }
+  });
 }
 
 void FirstApp::loadGameObjects() {
-  std::shared_ptr<LveModel> lveModel =
-      LveModel::createModelFromFile(lveDevice, "models/flat_vase.obj");
-  auto flatVase = LveGameObject::createGameObject();
-  flatVase.model = lveModel;
-  flatVase.transform.translation = {-.5f, .5f, 0.f};
-  flatVase.transform.scale = {3.f, 1.5f, 3.f};
-  gameObjects.emplace(flatVase.getId(), std::move(flatVase));
-
-  lveModel = LveModel::createModelFromFile(lveDevice, "models/smooth_vase.obj");
-  auto smoothVase = LveGameObject::createGameObject();
-  smoothVase.model = lveModel;
-  smoothVase.transform.translation = {.5f, .5f, 0.f};
-  smoothVase.transform.scale = {3.f, 1.5f, 3.f};
-  gameObjects.emplace(smoothVase.getId(), std::move(smoothVase));
-
-  lveModel = LveModel::createModelFromFile(lveDevice, "models/quad.obj");
-  auto floor = LveGameObject::createGameObject();
-  floor.model = lveModel;
-  floor.transform.translation = {0.f, .5f, 0.f};
-  floor.transform.scale = {3.f, 1.f, 3.f};
-  gameObjects.emplace(floor.getId(), std::move(floor));
+  // models stream in over the first frames, objects are simply skipped until theirs is ready
+  auto flatVase = scene.createEntity();
+  auto &flatVaseTransform = scene.transforms.add(flatVase);
+  flatVaseTransform.setTranslation({-.5f, .5f, 0.f});
+  flatVaseTransform.setScale({3.f, 1.5f, 3.f});
+  loadModelAsync(flatVase, "models/flat_vase.obj");
+
+  auto smoothVase = scene.createEntity();
+  auto &smoothVaseTransform = scene.transforms.add(smoothVase);
+  smoothVaseTransform.setTranslation({.5f, .5f, 0.f});
+  smoothVaseTransform.setScale({3.f, 1.5f, 3.f});
+  loadModelAsync(smoothVase, "models/smooth_vase.obj");
+
+  auto floor = scene.createEntity();
+  auto &floorTransform = scene.transforms.add(floor);
+  floorTransform.setTranslation({0.f, .5f, 0.f});
+  floorTransform.setScale({3.f, 1.f, 3.f});
+  loadModelAsync(floor, "models/quad.obj");
 
   std::vector<glm::vec3> lightColors{
       {1.f, .1f, .1f},
@@ -149,14 +317,13 @@ void FirstApp::loadGameObjects() {
   };
 
   for (int i = 0; i < lightColors.size(); i++) {
-    auto pointLight = LveGameObject::makePointLight(0.2f);
-    pointLight.color = lightColors[i];
+    auto pointLight = scene.createPointLight(0.2f, 0.1f, lightColors[i]);
     auto rotateLight = glm::rotate(
         glm::mat4(1.f),
         (i * glm::two_pi<float>()) / lightColors.size(),
         {0.f, -1.f, 0.f});
-    pointLight.transform.translation = glm::vec3(rotateLight * glm::vec4(-1.f, -1.f, -1.f, 1.f));
-    gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+    scene.transforms.get(pointLight).setTranslation(
+        glm::vec3(rotateLight * glm::vec4(-1.f, -1.f, -1.f, 1.f)));
   }
 }
 
@@ -1,13 +1,21 @@
 #pragma once
 
+#include "lve_bindless_table.hpp"
 #include "lve_descriptors.hpp"
 #include "lve_device.hpp"
 #include "lve_game_object.hpp"
+#include "lve_model_loader.hpp"
+#include "lve_parallel_recorder.hpp"
+#include "lve_render_graph.hpp"
 #include "lve_renderer.hpp"
+#include "lve_scene.hpp"
+#include "lve_texture_streamer.hpp"
+#include "lve_thread_pool.hpp"
 #include "lve_window.hpp"
 
 // std
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace lve {
@@ -15,6 +23,15 @@ class FirstApp {
  public:
   static constexpr int WIDTH = 800;
   static constexpr int HEIGHT = 600;
+  // vertex layout models are uploaded in and the render system's pipelines read
+  static constexpr LveModel::VertexFormat VERTEX_FORMAT = LveModel::VertexFormat::Quantized;
+  // input to photon latency matters more here than frame rate
+  static constexpr LveSwapChain::Settings SWAP_CHAIN_SETTINGS{
+      VK_PRESENT_MODE_MAILBOX_KHR,
+      2,
+      true};
+  // relative to ENGINE_DIR
+  static constexpr const char *GPU_TRACE_FILE = "gpu_trace.json";
 
   FirstApp();
   ~FirstApp();
@@ -26,13 +43,26 @@ class FirstApp {
 
  private:
   void loadGameObjects();
+  void loadModelAsync(LveEntity entity, const std::string &filepath);
 
   LveWindow lveWindow{WIDTH, HEIGHT, "Vulkan Tutorial"};
   LveDevice lveDevice{lveWindow};
-  LveRenderer lveRenderer{lveWindow, lveDevice};
+  LveRenderer lveRenderer{lveWindow, lveDevice, SWAP_CHAIN_SETTINGS};
+  LveThreadPool threadPool{};
+  LveModelLoader modelLoader{lveDevice, threadPool, VERTEX_FORMAT};
+  LveParallelRecorder parallelRecorder{lveDevice, threadPool};
+  // passes of a frame and the images they share, recompiled only when their structure changes
+  LveRenderGraph renderGraph{lveDevice};
+  // record the main render pass into secondary buffers spread over the thread pool
+  bool recordInParallel = true;
+  // save the GPU profiler's last frames to GPU_TRACE_FILE on exit, for chrome://tracing
+  bool writeGpuTrace = false;
 
   // note: order of declarations matters
-  std::unique_ptr<LveDescriptorPool> globalPool{};
-  LveGameObject::Map gameObjects;
+  std::unique_ptr<LveDescriptorAllocator> globalPool{};
+  // only created when the device supports descriptor indexing
+  std::unique_ptr<LveBindlessTable> bindlessTable{};
+  std::unique_ptr<LveTextureStreamer> textureStreamer{};
+  LveScene scene;
 };
 }  // namespace lve
@@ -13,15 +13,17 @@ void KeyboardMovementController::moveInPlaneXZ(
   if (glfwGetKey(window, keys.lookUp) == GLFW_PRESS) rotate.x += 1.f;
   if (glfwGetKey(window, keys.lookDown) == GLFW_PRESS) rotate.x -= 1.f;
 
+  glm::vec3 rotation = gameObject.transform.getRotation();
   if (glm::dot(rotate, rotate) > std::numeric_limits<float>::epsilon()) {
-    gameObject.transform.rotation += lookSpeed * dt * glm::normalize(rotate);
+    rotation += lookSpeed * dt * glm::normalize(rotate);
   }
 
   // limit pitch values between about +/- 85ish degrees
-  gameObject.transform.rotation.x = glm::clamp(gameObject.transform.rotation.x, -1.5f, 1.5f);
-  gameObject.transform.rotation.y = glm::mod(gameObject.transform.rotation.y, glm::two_pi<float>());
+  rotation.x = glm::clamp(rotation.x, -1.5f, 1.5f);
+  rotation.y = glm::mod(rotation.y, glm::two_pi<float>());
+  gameObject.transform.setRotation(rotation);
 
-  float yaw = gameObject.transform.rotation.y;
+  float yaw = rotation.y;
   const glm::vec3 forwardDir{sin(yaw), 0.f, cos(yaw)};
   const glm::vec3 rightDir{forwardDir.z, 0.f, -forwardDir.x};
   const glm::vec3 upDir{0.f, -1.f, 0.f};
@@ -35,7 +37,8 @@ void KeyboardMovementController::moveInPlaneXZ(
   if (glfwGetKey(window, keys.moveDown) == GLFW_PRESS) moveDir -= upDir;
 
   if (glm::dot(moveDir, moveDir) > std::numeric_limits<float>::epsilon()) {
-    gameObject.transform.translation += moveSpeed * dt * glm::normalize(moveDir);
+    gameObject.transform.setTranslation(
+        gameObject.transform.getTranslation() + moveSpeed * dt * glm::normalize(moveDir));
   }
 }
 }  // namespace lve
\ No newline at end of file
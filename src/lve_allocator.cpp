@@ -0,0 +1,286 @@
+#include "lve_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return alignment > 1 ? (value + alignment - 1) & ~(alignment - 1) : value;
+}
+
+}  // namespace
+
+// *************** Range Allocator *********************
+
+LveRangeAllocator::LveRangeAllocator(VkDeviceSize size) : size{size} {
+  freeRanges.emplace(0, size);
+}
+
+VkDeviceSize LveRangeAllocator::allocate(VkDeviceSize allocSize, VkDeviceSize alignment) {
+  // first fit: take the lowest free range that still holds the request once aligned
+  for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+    VkDeviceSize rangeOffset = it->first;
+    VkDeviceSize rangeSize = it->second;
+    VkDeviceSize alignedOffset = alignUp(rangeOffset, alignment);
+    VkDeviceSize padding = alignedOffset - rangeOffset;
+    if (padding + allocSize > rangeSize) {
+      continue;
+    }
+
+    freeRanges.erase(it);
+    if (padding > 0) {
+      freeRanges.emplace(rangeOffset, padding);
+    }
+    VkDeviceSize tail = rangeSize - padding - allocSize;
+    if (tail > 0) {
+      freeRanges.emplace(alignedOffset + allocSize, tail);
+    }
+
+    inUse += allocSize;
+    return alignedOffset;
+  }
+  return INVALID_OFFSET;
+}
+
+void LveRangeAllocator::free(VkDeviceSize offset, VkDeviceSize rangeSize) {
+  inUse -= rangeSize;
+
+  // coalesce with the following free range
+  auto next = freeRanges.lower_bound(offset);
+  if (next != freeRanges.end() && next->first == offset + rangeSize) {
+    rangeSize += next->second;
+    next = freeRanges.erase(next);
+  }
+
+  // coalesce with the preceding free range
+  if (next != freeRanges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += rangeSize;
+      return;
+    }
+  }
+
+  freeRanges.emplace(offset, rangeSize);
+}
+
+VkDeviceSize LveRangeAllocator::getLargestFreeRange() const {
+  VkDeviceSize largest = 0;
+  for (auto &kv : freeRanges) {
+    largest = std::max(largest, kv.second);
+  }
+  return largest;
+}
+
+// *************** Memory Block *********************
+
+LveMemoryBlock::LveMemoryBlock(
+    VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize size, bool hostVisible)
+    : device{device}, memoryTypeIndex{memoryTypeIndex}, ranges{size} {
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate memory block!");
+  }
+
+  if (hostVisible && vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+    vkFreeMemory(device, memory, nullptr);
+    throw std::runtime_error("failed to map memory block!");
+  }
+}
+
+LveMemoryBlock::~LveMemoryBlock() {
+  if (mapped) {
+    vkUnmapMemory(device, memory);
+  }
+  vkFreeMemory(device, memory, nullptr);
+}
+
+bool LveMemoryBlock::allocate(
+    VkDeviceSize allocSize, VkDeviceSize alignment, LveAllocation &allocation) {
+  VkDeviceSize offset = ranges.allocate(allocSize, alignment);
+  if (offset == LveRangeAllocator::INVALID_OFFSET) {
+    return false;
+  }
+
+  allocation.memory = memory;
+  allocation.offset = offset;
+  allocation.size = allocSize;
+  allocation.memoryTypeIndex = memoryTypeIndex;
+  allocation.mapped = mapped ? static_cast<char *>(mapped) + offset : nullptr;
+  allocation.block = this;
+  return true;
+}
+
+void LveMemoryBlock::free(const LveAllocation &allocation) {
+  assert(allocation.block == this && "Allocation does not belong to this block");
+  ranges.free(allocation.offset, allocation.size);
+}
+
+// *************** Allocator *********************
+
+float LveAllocator::Stats::fragmentation() const {
+  VkDeviceSize freeBytes = bytesReserved - bytesInUse;
+  if (freeBytes == 0 || blockCount == 0) {
+    return 0.f;
+  }
+  return 1.f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+}
+
+LveAllocator::LveAllocator(
+    VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize)
+    : device{device}, blockSize{blockSize} {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+  pools.resize(2 * memoryProperties.memoryTypeCount);
+}
+
+LveAllocator::~LveAllocator() {
+  assert(allocationCount == 0 && "Device memory leaked: allocations still alive at shutdown");
+}
+
+uint32_t LveAllocator::findMemoryType(
+    uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool LveAllocator::isHostVisible(uint32_t memoryTypeIndex) const {
+  return memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+}
+
+LveAllocation LveAllocator::allocate(
+    const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear) {
+  uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+
+  std::lock_guard<std::mutex> lock{mutex};
+
+  // anything bigger than half a block would mostly waste the rest of it
+  if (requirements.size > blockSize / 2) {
+    return allocateDedicated(requirements.size, memoryTypeIndex);
+  }
+
+  LveAllocation allocation{};
+  Pool &pool = pools[2 * memoryTypeIndex + (linear ? 0 : 1)];
+  for (auto &block : pool.blocks) {
+    if (block->allocate(requirements.size, requirements.alignment, allocation)) {
+      allocationCount++;
+      return allocation;
+    }
+  }
+
+  pool.blocks.push_back(std::make_unique<LveMemoryBlock>(
+      device,
+      memoryTypeIndex,
+      blockSize,
+      isHostVisible(memoryTypeIndex)));
+  if (!pool.blocks.back()->allocate(requirements.size, requirements.alignment, allocation)) {
+    throw std::runtime_error("failed to sub-allocate from a fresh memory block!");
+  }
+  allocationCount++;
+  return allocation;
+}
+
+LveAllocation LveAllocator::allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex) {
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+  LveAllocation allocation{};
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate dedicated memory!");
+  }
+  if (isHostVisible(memoryTypeIndex) &&
+      vkMapMemory(device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped) !=
+          VK_SUCCESS) {
+    vkFreeMemory(device, allocation.memory, nullptr);
+    throw std::runtime_error("failed to map dedicated memory!");
+  }
+  allocation.size = size;
+  allocation.memoryTypeIndex = memoryTypeIndex;
+
+  allocationCount++;
+  dedicatedAllocationCount++;
+  dedicatedBytes += size;
+  return allocation;
+}
+
+void LveAllocator::free(LveAllocation &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock{mutex};
+  allocationCount--;
+
+  if (allocation.block == nullptr) {
+    if (allocation.mapped) {
+      vkUnmapMemory(device, allocation.memory);
+    }
+    vkFreeMemory(device, allocation.memory, nullptr);
+    dedicatedAllocationCount--;
+    dedicatedBytes -= allocation.size;
+    allocation = LveAllocation{};
+    return;
+  }
+
+  LveMemoryBlock *block = allocation.block;
+  block->free(allocation);
+  allocation = LveAllocation{};
+
+  // keep one empty block per pool around so alloc/free churn doesn't thrash vkAllocateMemory
+  if (block->isEmpty()) {
+    for (auto &pool : pools) {
+      auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(), [block](auto &b) {
+        return b.get() == block;
+      });
+      if (it == pool.blocks.end()) {
+        continue;
+      }
+      bool hasOtherEmpty = std::any_of(pool.blocks.begin(), pool.blocks.end(), [block](auto &b) {
+        return b.get() != block && b->isEmpty();
+      });
+      if (hasOtherEmpty) {
+        pool.blocks.erase(it);
+      }
+      break;
+    }
+  }
+}
+
+LveAllocator::Stats LveAllocator::getStats() const {
+  std::lock_guard<std::mutex> lock{mutex};
+
+  Stats stats{};
+  stats.allocationCount = allocationCount;
+  stats.dedicatedAllocationCount = dedicatedAllocationCount;
+  stats.bytesReserved = dedicatedBytes;
+  stats.bytesInUse = dedicatedBytes;
+  for (auto &pool : pools) {
+    for (auto &block : pool.blocks) {
+      stats.blockCount++;
+      stats.bytesReserved += block->getSize();
+      stats.bytesInUse += block->getBytesInUse();
+      stats.largestFreeRange = std::max(stats.largestFreeRange, block->getLargestFreeRange());
+      stats.freeRangeCount += static_cast<uint32_t>(block->getFreeRangeCount());
+    }
+  }
+  return stats;
+}
+
+}  // namespace lve
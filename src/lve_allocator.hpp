@@ -0,0 +1,135 @@
+#pragma once
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lve {
+
+class LveMemoryBlock;
+
+// First-fit allocator over an abstract [0, size) range, in whatever unit the caller uses. Free
+// ranges are kept ordered by offset and coalesced on free.
+class LveRangeAllocator {
+ public:
+  static constexpr VkDeviceSize INVALID_OFFSET = ~VkDeviceSize{0};
+
+  explicit LveRangeAllocator(VkDeviceSize size);
+
+  // alignment must be a power of two. Returns INVALID_OFFSET if no free range fits.
+  VkDeviceSize allocate(VkDeviceSize size, VkDeviceSize alignment = 1);
+  void free(VkDeviceSize offset, VkDeviceSize size);
+
+  VkDeviceSize getSize() const { return size; }
+  VkDeviceSize getBytesInUse() const { return inUse; }
+  VkDeviceSize getLargestFreeRange() const;
+  size_t getFreeRangeCount() const { return freeRanges.size(); }
+
+ private:
+  VkDeviceSize size;
+  VkDeviceSize inUse = 0;
+
+  // offset -> size of every unused range
+  std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+};
+
+// A sub-range of a VkDeviceMemory block handed out by LveAllocator. Host visible memory is
+// persistently mapped, in which case mapped points at the first byte of this allocation.
+struct LveAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void *mapped = nullptr;
+  uint32_t memoryTypeIndex = 0;
+
+  // owning block, or nullptr for dedicated allocations
+  LveMemoryBlock *block = nullptr;
+};
+
+class LveMemoryBlock {
+ public:
+  LveMemoryBlock(
+      VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize size, bool hostVisible);
+  ~LveMemoryBlock();
+
+  LveMemoryBlock(const LveMemoryBlock &) = delete;
+  LveMemoryBlock &operator=(const LveMemoryBlock &) = delete;
+
+  bool allocate(VkDeviceSize size, VkDeviceSize alignment, LveAllocation &allocation);
+  void free(const LveAllocation &allocation);
+
+  bool isEmpty() const { return ranges.getBytesInUse() == 0; }
+  VkDeviceSize getSize() const { return ranges.getSize(); }
+  VkDeviceSize getBytesInUse() const { return ranges.getBytesInUse(); }
+  VkDeviceSize getLargestFreeRange() const { return ranges.getLargestFreeRange(); }
+  size_t getFreeRangeCount() const { return ranges.getFreeRangeCount(); }
+
+ private:
+  VkDevice device;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  void *mapped = nullptr;
+  uint32_t memoryTypeIndex;
+  LveRangeAllocator ranges;
+};
+
+class LveAllocator {
+ public:
+  static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+  struct Stats {
+    uint32_t blockCount = 0;
+    uint32_t dedicatedAllocationCount = 0;
+    uint32_t allocationCount = 0;
+    VkDeviceSize bytesReserved = 0;  // device memory owned by blocks and dedicated allocations
+    VkDeviceSize bytesInUse = 0;     // bytes handed out to resources
+    VkDeviceSize largestFreeRange = 0;
+    uint32_t freeRangeCount = 0;
+
+    // 0 when all free block memory is one contiguous range, approaching 1 as it splinters
+    float fragmentation() const;
+  };
+
+  LveAllocator(
+      VkDevice device,
+      VkPhysicalDevice physicalDevice,
+      VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+  ~LveAllocator();
+
+  LveAllocator(const LveAllocator &) = delete;
+  LveAllocator &operator=(const LveAllocator &) = delete;
+
+  // linear is true for buffers and linear images, false for optimally tiled images. The two are
+  // kept in separate blocks so neighbouring resources never violate bufferImageGranularity.
+  LveAllocation allocate(
+      const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear);
+  void free(LveAllocation &allocation);
+
+  uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+  Stats getStats() const;
+
+ private:
+  struct Pool {
+    std::vector<std::unique_ptr<LveMemoryBlock>> blocks;
+  };
+
+  LveAllocation allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex);
+  bool isHostVisible(uint32_t memoryTypeIndex) const;
+
+  VkDevice device;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  VkDeviceSize blockSize;
+
+  // pools[2 * memoryTypeIndex + (linear ? 0 : 1)]
+  std::vector<Pool> pools;
+  uint32_t allocationCount = 0;
+  uint32_t dedicatedAllocationCount = 0;
+  VkDeviceSize dedicatedBytes = 0;
+  mutable std::mutex mutex;
+};
+
+}  // namespace lve
@@ -0,0 +1,146 @@
+#include "lve_bindless_table.hpp"
+
+#include "lve_deletion_queue.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+uint32_t LveBindlessTable::Slots::acquire() {
+  if (!free.empty()) {
+    uint32_t index = free.back();
+    free.pop_back();
+    return index;
+  }
+  if (next == capacity) {
+    throw std::runtime_error("failed to add bindless descriptor, table is full!");
+  }
+  return next++;
+}
+
+void LveBindlessTable::Slots::release(uint32_t index, uint64_t frame) {
+  assert(index < next && "Bindless slot was never added");
+  retired.push_back({index, frame});
+}
+
+void LveBindlessTable::Slots::recycle(LveDeletionQueue &deletionQueue) {
+  // released in frame order
+  auto firstInFlight = std::find_if(
+      retired.begin(),
+      retired.end(),
+      [&deletionQueue](const std::pair<uint32_t, uint64_t> &slot) {
+        return !deletionQueue.isFrameComplete(slot.second);
+      });
+  for (auto it = retired.begin(); it != firstInFlight; it++) {
+    free.push_back(it->first);
+  }
+  retired.erase(retired.begin(), firstInFlight);
+}
+
+LveBindlessTable::LveBindlessTable(LveDevice &device) : lveDevice{device} {
+  assert(lveDevice.supportsBindless() && "Bindless descriptors are not supported");
+
+  // combined image samplers count against both the sampler and the sampled image limits
+  const auto &limits = lveDevice.descriptorIndexingProperties();
+  uint32_t resources = limits.maxPerStageUpdateAfterBindResources / 2;
+  images.capacity = std::min(
+      {MAX_IMAGES,
+       resources,
+       limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+       limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+       limits.maxDescriptorSetUpdateAfterBindSampledImages,
+       limits.maxDescriptorSetUpdateAfterBindSamplers});
+  buffers.capacity = std::min(
+      {MAX_BUFFERS,
+       resources,
+       limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+       limits.maxDescriptorSetUpdateAfterBindStorageBuffers});
+
+  VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+                                          VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+  setLayout =
+      LveDescriptorSetLayout::Builder(lveDevice)
+          .addBinding(
+              IMAGE_BINDING,
+              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+              VK_SHADER_STAGE_ALL,
+              images.capacity,
+              bindingFlags)
+          .addBinding(
+              BUFFER_BINDING,
+              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+              VK_SHADER_STAGE_ALL,
+              buffers.capacity,
+              bindingFlags)
+          .setLayoutFlags(VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT)
+          .build();
+  descriptorPool =
+      LveDescriptorPool::Builder(lveDevice)
+          .setMaxSets(1)
+          .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, images.capacity)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffers.capacity)
+          .build();
+  if (!descriptorPool->allocateDescriptor(setLayout->getDescriptorSetLayout(), descriptorSet)) {
+    throw std::runtime_error("failed to allocate bindless descriptor set!");
+  }
+}
+
+uint32_t LveBindlessTable::addImage(const VkDescriptorImageInfo &imageInfo) {
+  uint32_t index = images.acquire();
+  write(IMAGE_BINDING, index, &imageInfo, nullptr);
+  return index;
+}
+
+uint32_t LveBindlessTable::addBuffer(const VkDescriptorBufferInfo &bufferInfo) {
+  uint32_t index = buffers.acquire();
+  write(BUFFER_BINDING, index, nullptr, &bufferInfo);
+  return index;
+}
+
+void LveBindlessTable::updateImage(uint32_t index, const VkDescriptorImageInfo &imageInfo) {
+  assert(index < images.next && "Bindless slot was never added");
+  write(IMAGE_BINDING, index, &imageInfo, nullptr);
+}
+
+void LveBindlessTable::updateBuffer(uint32_t index, const VkDescriptorBufferInfo &bufferInfo) {
+  assert(index < buffers.next && "Bindless slot was never added");
+  write(BUFFER_BINDING, index, nullptr, &bufferInfo);
+}
+
+void LveBindlessTable::removeImage(uint32_t index) {
+  images.release(index, lveDevice.deletionQueue().currentFrame());
+}
+
+void LveBindlessTable::removeBuffer(uint32_t index) {
+  buffers.release(index, lveDevice.deletionQueue().currentFrame());
+}
+
+void LveBindlessTable::beginFrame() {
+  images.recycle(lveDevice.deletionQueue());
+  buffers.recycle(lveDevice.deletionQueue());
+}
+
+void LveBindlessTable::write(
+    uint32_t binding,
+    uint32_t index,
+    const VkDescriptorImageInfo *imageInfo,
+    const VkDescriptorBufferInfo *bufferInfo) {
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = descriptorSet;
+  write.dstBinding = binding;
+  write.dstArrayElement = index;
+  write.descriptorCount = 1;
+  write.descriptorType = imageInfo != nullptr ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                              : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pImageInfo = imageInfo;
+  write.pBufferInfo = bufferInfo;
+  vkUpdateDescriptorSets(lveDevice.device(), 1, &write, 0, nullptr);
+}
+
+}  // namespace lve
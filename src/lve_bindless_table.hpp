@@ -0,0 +1,80 @@
+#pragma once
+
+#include "lve_descriptors.hpp"
+#include "lve_device.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+// A single descriptor set holding every sampled image and storage buffer, shaders pick one by
+// index so switching materials costs an index rather than a descriptor set bind:
+//  binding 0: sampler2D textures[] (combined image samplers)
+//  binding 1: storage buffers
+// Shaders declare the arrays unsized and wrap indices that vary within a draw in nonuniformEXT
+// (GL_EXT_nonuniform_qualifier). Both bindings are update after bind and partially bound, so
+// slots can be written while the set is bound and unused slots never need a valid descriptor.
+// A removed slot is only handed out again once the device's deletion queue saw every frame that
+// may still read it complete. Needs LveDevice::supportsBindless.
+class LveBindlessTable {
+ public:
+  static constexpr uint32_t IMAGE_BINDING = 0;
+  static constexpr uint32_t BUFFER_BINDING = 1;
+  // upper bounds, lowered to the device's update after bind limits
+  static constexpr uint32_t MAX_IMAGES = 16384;
+  static constexpr uint32_t MAX_BUFFERS = 16384;
+
+  explicit LveBindlessTable(LveDevice &device);
+
+  LveBindlessTable(const LveBindlessTable &) = delete;
+  LveBindlessTable &operator=(const LveBindlessTable &) = delete;
+
+  // Return the index shaders use, throw once the table is full
+  uint32_t addImage(const VkDescriptorImageInfo &imageInfo);
+  uint32_t addBuffer(const VkDescriptorBufferInfo &bufferInfo);
+  // Rewrite a slot in place, frames in flight must no longer read it
+  void updateImage(uint32_t index, const VkDescriptorImageInfo &imageInfo);
+  void updateBuffer(uint32_t index, const VkDescriptorBufferInfo &bufferInfo);
+  void removeImage(uint32_t index);
+  void removeBuffer(uint32_t index);
+
+  // Call once per frame, makes slots removed in completed frames available again
+  void beginFrame();
+
+  VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+  VkDescriptorSetLayout getSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+  uint32_t getImageCapacity() const { return images.capacity; }
+  uint32_t getBufferCapacity() const { return buffers.capacity; }
+
+ private:
+  struct Slots {
+    uint32_t capacity = 0;
+    uint32_t next = 0;  // slots from here on were never used
+    std::vector<uint32_t> free;
+    // slot and the frame it was removed in
+    std::vector<std::pair<uint32_t, uint64_t>> retired;
+
+    uint32_t acquire();
+    void release(uint32_t index, uint64_t frame);
+    void recycle(LveDeletionQueue &deletionQueue);
+  };
+
+  void write(
+      uint32_t binding,
+      uint32_t index,
+      const VkDescriptorImageInfo *imageInfo,
+      const VkDescriptorBufferInfo *bufferInfo);
+
+  LveDevice &lveDevice;
+  std::unique_ptr<LveDescriptorSetLayout> setLayout;
+  std::unique_ptr<LveDescriptorPool> descriptorPool;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  Slots images;
+  Slots buffers;
+};
+
+}  // namespace lve
@@ -8,6 +8,7 @@
 #include "lve_buffer.hpp"
 
 // std
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
@@ -49,12 +50,45 @@ LveBuffer::LveBuffer(
 LveBuffer::~LveBuffer() {
   unmap();
   vkDestroyBuffer(lveDevice.device(), buffer, nullptr);
-  vkFreeMemory(lveDevice.device(), memory, nullptr);
+  lveDevice.freeMemory(memory);
+}
+
+/**
+ * Builds the memory range covering [offset, offset + size) of this buffer within its (possibly
+ * shared) device memory block, widened to the device's nonCoherentAtomSize but never past the end
+ * of the memory object
+ *
+ * @param size Size of the range. Pass VK_WHOLE_SIZE for the remainder of the buffer
+ * @param offset Byte offset from beginning of the buffer
+ *
+ * @return VkMappedMemoryRange suitable for flush / invalidate calls
+ */
+VkMappedMemoryRange LveBuffer::getMappedRange(VkDeviceSize size, VkDeviceSize offset) const {
+  VkDeviceSize atomSize = lveDevice.properties.limits.nonCoherentAtomSize;
+  if (size == VK_WHOLE_SIZE) {
+    size = bufferSize - offset;
+  }
+  VkDeviceSize begin = memory.offset + offset;
+  VkDeviceSize end = begin + size;
+  begin = begin / atomSize * atomSize;
+  // a dedicated allocation ends with the buffer, rounding up could run past it
+  VkDeviceSize memorySize = memory.block != nullptr ? memory.block->getSize() : memory.size;
+  end = std::min((end + atomSize - 1) / atomSize * atomSize, memorySize);
+
+  VkMappedMemoryRange mappedRange = {};
+  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  mappedRange.memory = memory.memory;
+  mappedRange.offset = begin;
+  mappedRange.size = end - begin;
+  return mappedRange;
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
  *
+ * @note Host visible memory is persistently mapped by the allocator, so this only hands out a
+ * pointer into the existing mapping
+ *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
  * @param offset (Optional) Byte offset from beginning
@@ -62,24 +96,31 @@ LveBuffer::~LveBuffer() {
  * @return VkResult of the buffer mapping call
  */
 VkResult LveBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-  assert(buffer && memory && "Called map on buffer before create");
-  return vkMapMemory(lveDevice.device(), memory, offset, size, 0, &mapped);
+  assert(buffer && memory.memory && "Called map on buffer before create");
+  if (size == VK_WHOLE_SIZE) {
+    size = bufferSize - offset;
+  }
+  assert(offset + size <= bufferSize && "Mapped range exceeds the buffer");
+  if (!memory.mapped) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
+  }
+  mapped = static_cast<char *>(memory.mapped) + offset;
+  mappedSize = size;
+  return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The underlying block stays mapped until it is released by the allocator
  */
 void LveBuffer::unmap() {
-  if (mapped) {
-    vkUnmapMemory(lveDevice.device(), memory);
-    mapped = nullptr;
-  }
+  mapped = nullptr;
+  mappedSize = 0;
 }
 
 /**
- * Copies the specified data to the mapped buffer. Default value writes whole buffer range
+ * Copies the specified data to the mapped buffer. Default value writes whole mapped range
  *
  * @param data Pointer to the data to copy
  * @param size (Optional) Size of the data to copy. Pass VK_WHOLE_SIZE to flush the complete buffer
@@ -91,8 +132,9 @@ void LveBuffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset
   assert(mapped && "Cannot copy to unmapped buffer");
 
   if (size == VK_WHOLE_SIZE) {
-    memcpy(mapped, data, bufferSize);
+    memcpy(mapped, data, mappedSize);
   } else {
+    assert(offset + size <= mappedSize && "Write exceeds the mapped range");
     char *memOffset = (char *)mapped;
     memOffset += offset;
     memcpy(memOffset, data, size);
@@ -111,11 +153,7 @@ void LveBuffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset
  * @return VkResult of the flush call
  */
 VkResult LveBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
+  VkMappedMemoryRange mappedRange = getMappedRange(size, offset);
   return vkFlushMappedMemoryRanges(lveDevice.device(), 1, &mappedRange);
 }
 
@@ -131,11 +169,7 @@ VkResult LveBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult LveBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
+  VkMappedMemoryRange mappedRange = getMappedRange(size, offset);
   return vkInvalidateMappedMemoryRanges(lveDevice.device(), 1, &mappedRange);
 }
 
@@ -40,13 +40,17 @@ class LveBuffer {
   VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
   VkDeviceSize getBufferSize() const { return bufferSize; }
 
- private:
+  // instanceSize rounded up to a multiple of minOffsetAlignment, which must be a power of two
   static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
 
+ private:
+  VkMappedMemoryRange getMappedRange(VkDeviceSize size, VkDeviceSize offset) const;
+
   LveDevice& lveDevice;
   void* mapped = nullptr;
+  VkDeviceSize mappedSize = 0;
   VkBuffer buffer = VK_NULL_HANDLE;
-  VkDeviceMemory memory = VK_NULL_HANDLE;
+  LveAllocation memory{};
 
   VkDeviceSize bufferSize;
   uint32_t instanceCount;
@@ -0,0 +1,110 @@
+#pragma once
+
+// std
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+// Generational entity handle. The index is reused once an entity is destroyed, the generation
+// tells a stale handle apart from the entity now living at that index.
+struct LveEntity {
+  static constexpr uint32_t INVALID_INDEX = ~0u;
+
+  uint32_t index = INVALID_INDEX;
+  uint32_t generation = 0;
+
+  bool isValid() const { return index != INVALID_INDEX; }
+  bool operator==(const LveEntity &other) const {
+    return index == other.index && generation == other.generation;
+  }
+  bool operator!=(const LveEntity &other) const { return !(*this == other); }
+};
+
+// Sparse set of components: the components and their owning entities are kept packed in two
+// parallel dense arrays, iterated directly, while a sparse array indexed by entity index maps
+// back into them. Removal swaps the last element into the hole, so element order is not stable
+// and pointers / references are only valid until the pool is next modified.
+template <typename T>
+class LveComponentPool {
+ public:
+  template <typename... Args>
+  T &add(LveEntity entity, Args &&...args) {
+    assert(entity.isValid() && "Cannot add a component to an invalid entity");
+    if (T *existing = tryGet(entity)) {
+      *existing = T{std::forward<Args>(args)...};
+      return *existing;
+    }
+
+    if (entity.index >= sparse.size()) {
+      sparse.resize(entity.index + 1, NOT_PRESENT);
+    }
+    sparse[entity.index] = static_cast<uint32_t>(components.size());
+    entities.push_back(entity);
+    components.push_back(T{std::forward<Args>(args)...});
+    return components.back();
+  }
+
+  void remove(LveEntity entity) {
+    if (!has(entity)) return;
+    uint32_t denseIndex = sparse[entity.index];
+    uint32_t last = static_cast<uint32_t>(components.size() - 1);
+    if (denseIndex != last) {
+      components[denseIndex] = std::move(components[last]);
+      entities[denseIndex] = entities[last];
+      sparse[entities[denseIndex].index] = denseIndex;
+    }
+    components.pop_back();
+    entities.pop_back();
+    sparse[entity.index] = NOT_PRESENT;
+  }
+
+  bool has(LveEntity entity) const {
+    return entity.index < sparse.size() && sparse[entity.index] != NOT_PRESENT &&
+           entities[sparse[entity.index]].generation == entity.generation;
+  }
+
+  T *tryGet(LveEntity entity) { return has(entity) ? &components[sparse[entity.index]] : nullptr; }
+  const T *tryGet(LveEntity entity) const {
+    return has(entity) ? &components[sparse[entity.index]] : nullptr;
+  }
+  T &get(LveEntity entity) {
+    assert(has(entity) && "Entity does not have this component");
+    return components[sparse[entity.index]];
+  }
+  const T &get(LveEntity entity) const {
+    assert(has(entity) && "Entity does not have this component");
+    return components[sparse[entity.index]];
+  }
+
+  void clear() {
+    sparse.clear();
+    entities.clear();
+    components.clear();
+  }
+
+  // dense storage, element i belongs to getEntity(i)
+  size_t size() const { return components.size(); }
+  bool empty() const { return components.empty(); }
+  T *data() { return components.data(); }
+  const T *data() const { return components.data(); }
+  LveEntity getEntity(size_t denseIndex) const { return entities[denseIndex]; }
+  const std::vector<LveEntity> &getEntities() const { return entities; }
+
+  typename std::vector<T>::iterator begin() { return components.begin(); }
+  typename std::vector<T>::iterator end() { return components.end(); }
+  typename std::vector<T>::const_iterator begin() const { return components.begin(); }
+  typename std::vector<T>::const_iterator end() const { return components.end(); }
+
+ private:
+  static constexpr uint32_t NOT_PRESENT = ~0u;
+
+  std::vector<uint32_t> sparse;
+  std::vector<LveEntity> entities;
+  std::vector<T> components;
+};
+
+}  // namespace lve
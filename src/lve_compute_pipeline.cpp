@@ -0,0 +1,57 @@
+#include "lve_compute_pipeline.hpp"
+
+#include "lve_pipeline.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+namespace lve {
+
+LveComputePipeline::LveComputePipeline(
+    LveDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+    : lveDevice{device} {
+  compShaderModule =
+      LvePipeline::createShaderModule(lveDevice, LvePipeline::readFile(compFilepath));
+  createComputePipeline(compShaderModule, pipelineLayout);
+}
+
+void LveComputePipeline::createComputePipeline(
+    VkShaderModule compModule, VkPipelineLayout pipelineLayout) {
+  assert(
+      pipelineLayout != VK_NULL_HANDLE &&
+      "Cannot create compute pipeline: no pipelineLayout provided");
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = compModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineInfo.basePipelineIndex = -1;
+
+  if (vkCreateComputePipelines(
+          lveDevice.device(),
+          lveDevice.pipelineCache(),
+          1,
+          &pipelineInfo,
+          nullptr,
+          &computePipeline) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline");
+  }
+}
+
+LveComputePipeline::~LveComputePipeline() {
+  vkDestroyShaderModule(lveDevice.device(), compShaderModule, nullptr);
+  vkDestroyPipeline(lveDevice.device(), computePipeline, nullptr);
+}
+
+void LveComputePipeline::bind(VkCommandBuffer commandBuffer) {
+  assert(isReady() && "Cannot bind a pipeline the registry has not compiled yet");
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+}
+
+}  // namespace lve
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+// std
+#include <string>
+
+namespace lve {
+
+class LveComputePipeline {
+ public:
+  LveComputePipeline(
+      LveDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+  ~LveComputePipeline();
+
+  LveComputePipeline(const LveComputePipeline&) = delete;
+  LveComputePipeline& operator=(const LveComputePipeline&) = delete;
+
+  void bind(VkCommandBuffer commandBuffer);
+  // False for a pipeline requested from LvePipelineRegistry until it was compiled
+  bool isReady() const { return computePipeline != VK_NULL_HANDLE; }
+
+  // Number of workgroups needed to cover invocationCount with groups of groupSize
+  static uint32_t groupCount(uint32_t invocationCount, uint32_t groupSize) {
+    return (invocationCount + groupSize - 1) / groupSize;
+  }
+
+ private:
+  friend class LvePipelineRegistry;
+
+  // created later by the registry, from a shader module the registry owns
+  explicit LveComputePipeline(LveDevice& device) : lveDevice{device} {}
+
+  void createComputePipeline(VkShaderModule compModule, VkPipelineLayout pipelineLayout);
+
+  LveDevice& lveDevice;
+  VkPipeline computePipeline = VK_NULL_HANDLE;
+  VkShaderModule compShaderModule = VK_NULL_HANDLE;
+};
+}  // namespace lve
@@ -0,0 +1,51 @@
+#include "lve_deletion_queue.hpp"
+
+// std
+#include <utility>
+
+namespace lve {
+
+bool LveDeletionQueue::isFrameComplete(uint64_t frame) {
+  if (frame >= frameCount) {
+    return false;
+  }
+  retireCompletedFrames();
+  return frame < firstFrame;
+}
+
+void LveDeletionQueue::retireCompletedFrames() {
+  while (!frameValues.empty() && timeline.isComplete(frameValues.front())) {
+    frameValues.pop_front();
+    firstFrame++;
+  }
+}
+
+void LveDeletionQueue::push(std::function<void()> destroy) {
+  entries.push_back({frameCount, std::move(destroy)});
+}
+
+void LveDeletionQueue::endFrame(uint64_t timelineValue) {
+  frameValues.push_back(timelineValue);
+  frameCount++;
+}
+
+void LveDeletionQueue::collect() {
+  // also with nothing queued, or frameValues would grow by one value every frame
+  retireCompletedFrames();
+  while (!entries.empty() && isFrameComplete(entries.front().frame)) {
+    // moved out first, a destroy may push more
+    auto destroy = std::move(entries.front().destroy);
+    entries.pop_front();
+    destroy();
+  }
+}
+
+void LveDeletionQueue::flush() {
+  while (!entries.empty()) {
+    auto destroy = std::move(entries.front().destroy);
+    entries.pop_front();
+    destroy();
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "lve_timeline.hpp"
+
+// std
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace lve {
+
+// Destroys objects once the GPU is done with the frames that may use them. LveRenderer numbers
+// the frames and ends each with the graphics timeline value its submission signals. Objects
+// pushed while a frame is recorded, or between two frames, are destroyed once the frame
+// completed, so nothing needs to count frames in flight.
+//
+// Used from the render thread only.
+class LveDeletionQueue {
+ public:
+  explicit LveDeletionQueue(LveTimeline &timeline) : timeline{timeline} {}
+  // Runs everything still queued, the device must be idle
+  ~LveDeletionQueue() { flush(); }
+
+  LveDeletionQueue(const LveDeletionQueue &) = delete;
+  LveDeletionQueue &operator=(const LveDeletionQueue &) = delete;
+
+  // The frame being recorded, or the next one between frames
+  uint64_t currentFrame() const { return frameCount; }
+  bool isFrameComplete(uint64_t frame);
+
+  void push(std::function<void()> destroy);
+  // Ends currentFrame, its submission signals timelineValue
+  void endFrame(uint64_t timelineValue);
+  // Runs what belongs to completed frames
+  void collect();
+  // Runs everything, the device must be idle
+  void flush();
+
+ private:
+  struct Entry {
+    uint64_t frame;
+    std::function<void()> destroy;
+  };
+
+  // drops the values of frames seen complete, advancing firstFrame
+  void retireCompletedFrames();
+
+  LveTimeline &timeline;
+  uint64_t frameCount = 0;
+  // timeline values of the frames from firstFrame on that were not yet seen complete
+  uint64_t firstFrame = 0;
+  std::deque<uint64_t> frameValues;
+  std::deque<Entry> entries;
+};
+
+}  // namespace lve
@@ -0,0 +1,310 @@
+#include "lve_depth_pyramid.hpp"
+
+#include "lve_deletion_queue.hpp"
+#include "lve_pipeline_registry.hpp"
+#include "lve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+
+constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+
+struct ReducePushConstants {
+  int32_t srcWidth;
+  int32_t srcHeight;
+  int32_t dstWidth;
+  int32_t dstHeight;
+};
+
+}  // namespace
+
+LveDepthPyramid::LveDepthPyramid(LveDevice &device, VkExtent2D depthExtent) : lveDevice{device} {
+  createSampler();
+  createPipeline();
+  createResources(depthExtent);
+}
+
+LveDepthPyramid::~LveDepthPyramid() {
+  retireResources();
+  reducePipeline.reset();
+  vkDestroyPipelineLayout(lveDevice.device(), reducePipelineLayout, nullptr);
+  vkDestroySampler(lveDevice.device(), sampler, nullptr);
+}
+
+void LveDepthPyramid::createSampler() {
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.minLod = 0.f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  if (vkCreateSampler(lveDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create depth pyramid sampler!");
+  }
+}
+
+void LveDepthPyramid::createPipeline() {
+  reduceSetLayout =
+      LveDescriptorSetLayout::Builder(lveDevice)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+          .build();
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(ReducePushConstants);
+
+  VkDescriptorSetLayout setLayout = reduceSetLayout->getDescriptorSetLayout();
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &setLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(
+          lveDevice.device(),
+          &pipelineLayoutInfo,
+          nullptr,
+          &reducePipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+
+  reducePipeline = lveDevice.pipelineRegistry().requestCompute(
+      "shaders/depth_reduce.comp.spv", reducePipelineLayout);
+}
+
+void LveDepthPyramid::createResources(VkExtent2D extent) {
+  depthExtent = extent;
+  valid = false;
+
+  // mip 0 is half the depth resolution, odd edges fold into the last texel of each level
+  mipExtents.clear();
+  VkExtent2D mipExtent{std::max(extent.width / 2, 1u), std::max(extent.height / 2, 1u)};
+  mipExtents.push_back(mipExtent);
+  while (mipExtent.width > 1 || mipExtent.height > 1) {
+    mipExtent = {std::max(mipExtent.width / 2, 1u), std::max(mipExtent.height / 2, 1u)};
+    mipExtents.push_back(mipExtent);
+  }
+  uint32_t mipCount = getMipCount();
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = mipExtents[0].width;
+  imageInfo.extent.height = mipExtents[0].height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = mipCount;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = VK_FORMAT_R32_SFLOAT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  lveDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = VK_FORMAT_R32_SFLOAT;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = mipCount;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+  if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &fullView) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create depth pyramid view!");
+  }
+
+  mipViews.resize(mipCount);
+  for (uint32_t i = 0; i < mipCount; i++) {
+    viewInfo.subresourceRange.baseMipLevel = i;
+    viewInfo.subresourceRange.levelCount = 1;
+    if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &mipViews[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create depth pyramid mip view!");
+    }
+  }
+
+  // the pyramid stays in GENERAL for its whole life, sampled and stored alike
+  VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1};
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      1,
+      &barrier);
+  lveDevice.endSingleTimeCommands(commandBuffer);
+
+  uint32_t setCount = LveSwapChain::MAX_FRAMES_IN_FLIGHT + mipCount - 1;
+  descriptorPool = LveDescriptorPool::Builder(lveDevice)
+                       .setMaxSets(setCount)
+                       .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount)
+                       .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount)
+                       .build();
+
+  // mip 0 sets get their depth attachment written every build, which vary per swap chain image
+  depthSets.assign(LveSwapChain::MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+  for (auto &set : depthSets) {
+    if (!descriptorPool->allocateDescriptor(reduceSetLayout->getDescriptorSetLayout(), set)) {
+      throw std::runtime_error("failed to allocate depth pyramid descriptor set!");
+    }
+  }
+
+  mipSets.resize(mipCount - 1);
+  for (uint32_t i = 0; i + 1 < mipCount; i++) {
+    VkDescriptorImageInfo srcInfo{sampler, mipViews[i], VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorImageInfo dstInfo{VK_NULL_HANDLE, mipViews[i + 1], VK_IMAGE_LAYOUT_GENERAL};
+    if (!LveDescriptorWriter(*reduceSetLayout, *descriptorPool)
+             .writeImage(0, &srcInfo)
+             .writeImage(1, &dstInfo)
+             .build(mipSets[i])) {
+      throw std::runtime_error("failed to allocate depth pyramid descriptor set!");
+    }
+  }
+}
+
+void LveDepthPyramid::retireResources() {
+  // frames in flight may still use the pyramid, std::function needs the pool copyable
+  LveDevice &device = lveDevice;
+  std::shared_ptr<LveDescriptorPool> pool = std::move(descriptorPool);
+  device.deletionQueue().push([&device,
+                               image = image,
+                               memory = imageMemory,
+                               fullView = fullView,
+                               mipViews = std::move(mipViews),
+                               pool]() mutable {
+    pool.reset();
+    for (VkImageView view : mipViews) {
+      vkDestroyImageView(device.device(), view, nullptr);
+    }
+    vkDestroyImageView(device.device(), fullView, nullptr);
+    vkDestroyImage(device.device(), image, nullptr);
+    device.freeMemory(memory);
+  });
+  depthSets.clear();
+  mipSets.clear();
+  mipViews.clear();
+  imageMemory = {};
+  fullView = VK_NULL_HANDLE;
+  image = VK_NULL_HANDLE;
+}
+
+void LveDepthPyramid::resize(VkExtent2D extent) {
+  if (extent.width == depthExtent.width && extent.height == depthExtent.height) {
+    return;
+  }
+  retireResources();
+  createResources(extent);
+}
+
+VkDescriptorImageInfo LveDepthPyramid::descriptorInfo() const {
+  return VkDescriptorImageInfo{sampler, fullView, VK_IMAGE_LAYOUT_GENERAL};
+}
+
+void LveDepthPyramid::build(
+    VkCommandBuffer commandBuffer,
+    int frameIndex,
+    VkImageView depthImageView,
+    const glm::mat4 &viewProjection) {
+  // this frame slot's previous build has completed, so its mip 0 set is free to rewrite
+  VkDescriptorImageInfo depthInfo{
+      sampler,
+      depthImageView,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  VkDescriptorImageInfo mip0Info{VK_NULL_HANDLE, mipViews[0], VK_IMAGE_LAYOUT_GENERAL};
+  LveDescriptorWriter(*reduceSetLayout, *descriptorPool)
+      .writeImage(0, &depthInfo)
+      .writeImage(1, &mip0Info)
+      .overwrite(depthSets[frameIndex]);
+
+  reducePipeline->bind(commandBuffer);
+
+  VkImageMemoryBarrier mipBarrier{};
+  mipBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  mipBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  mipBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  mipBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  mipBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  mipBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  mipBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  mipBarrier.image = image;
+
+  VkExtent2D srcExtent = depthExtent;
+  for (uint32_t i = 0; i < getMipCount(); i++) {
+    VkDescriptorSet set = i == 0 ? depthSets[frameIndex] : mipSets[i - 1];
+    vkCmdBindDescriptorSets(
+        commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        reducePipelineLayout,
+        0,
+        1,
+        &set,
+        0,
+        nullptr);
+
+    VkExtent2D dstExtent = mipExtents[i];
+    ReducePushConstants push{
+        static_cast<int32_t>(srcExtent.width),
+        static_cast<int32_t>(srcExtent.height),
+        static_cast<int32_t>(dstExtent.width),
+        static_cast<int32_t>(dstExtent.height)};
+    vkCmdPushConstants(
+        commandBuffer,
+        reducePipelineLayout,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0,
+        sizeof(ReducePushConstants),
+        &push);
+    vkCmdDispatch(
+        commandBuffer,
+        LveComputePipeline::groupCount(dstExtent.width, REDUCE_GROUP_SIZE),
+        LveComputePipeline::groupCount(dstExtent.height, REDUCE_GROUP_SIZE),
+        1);
+
+    mipBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1};
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &mipBarrier);
+    srcExtent = dstExtent;
+  }
+
+  this->viewProjection = viewProjection;
+  valid = true;
+}
+
+}  // namespace lve
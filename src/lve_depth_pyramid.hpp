@@ -0,0 +1,82 @@
+#pragma once
+
+#include "lve_compute_pipeline.hpp"
+#include "lve_descriptors.hpp"
+#include "lve_device.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Hierarchical depth (Hi-Z) pyramid: a R32 mip chain where every texel holds the farthest depth
+// of the texels it covers in the level below. Built from a frame's depth attachment once it is
+// rendered, so the next frame can reject objects hidden behind what was drawn.
+class LveDepthPyramid {
+ public:
+  LveDepthPyramid(LveDevice &device, VkExtent2D depthExtent);
+  ~LveDepthPyramid();
+
+  LveDepthPyramid(const LveDepthPyramid &) = delete;
+  LveDepthPyramid &operator=(const LveDepthPyramid &) = delete;
+
+  // Recreates the pyramid when the depth extent changed. Call at the start of a frame before
+  // anything records a use of the pyramid. The previous pyramid goes to the device's deletion
+  // queue, so frames in flight can keep using it.
+  void resize(VkExtent2D depthExtent);
+
+  // Reduces the depth attachment into the pyramid. The caller synchronizes both images, eg as a
+  // render graph pass: the depth must be in SHADER_READ_ONLY_OPTIMAL with its writes visible to
+  // compute, and earlier reads of the pyramid must be done. viewProjection is what the depth was
+  // rendered with, later tests project into the pyramid with it.
+  void build(
+      VkCommandBuffer commandBuffer,
+      int frameIndex,
+      VkImageView depthImageView,
+      const glm::mat4 &viewProjection);
+
+  // False until build has been recorded since construction or the last resize
+  bool isValid() const { return valid; }
+
+  // Whole mip chain for sampling in compute shaders, in GENERAL layout
+  VkDescriptorImageInfo descriptorInfo() const;
+  VkImage getImage() const { return image; }
+  VkExtent2D getExtent() const { return mipExtents[0]; }
+  uint32_t getMipCount() const { return static_cast<uint32_t>(mipExtents.size()); }
+  const glm::mat4 &getViewProjection() const { return viewProjection; }
+
+ private:
+  void createSampler();
+  void createPipeline();
+  void createResources(VkExtent2D depthExtent);
+  void retireResources();
+
+  LveDevice &lveDevice;
+  VkExtent2D depthExtent{};
+
+  VkSampler sampler = VK_NULL_HANDLE;
+  std::unique_ptr<LveDescriptorSetLayout> reduceSetLayout;
+  VkPipelineLayout reducePipelineLayout = VK_NULL_HANDLE;
+  std::shared_ptr<LveComputePipeline> reducePipeline;
+
+  // recreated with the extent
+  VkImage image = VK_NULL_HANDLE;
+  LveAllocation imageMemory{};
+  VkImageView fullView = VK_NULL_HANDLE;
+  std::vector<VkImageView> mipViews;
+  std::vector<VkExtent2D> mipExtents;
+  std::unique_ptr<LveDescriptorPool> descriptorPool;
+  std::vector<VkDescriptorSet> depthSets;  // depth attachment -> mip 0, one per frame in flight
+  std::vector<VkDescriptorSet> mipSets;    // mip i -> mip i + 1
+
+  glm::mat4 viewProjection{1.f};
+  bool valid = false;
+};
+
+}  // namespace lve
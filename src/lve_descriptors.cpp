@@ -1,7 +1,9 @@
 #include "lve_descriptors.hpp"
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <stdexcept>
 
 namespace lve {
@@ -12,7 +14,8 @@ LveDescriptorSetLayout::Builder &LveDescriptorSetLayout::Builder::addBinding(
     uint32_t binding,
     VkDescriptorType descriptorType,
     VkShaderStageFlags stageFlags,
-    uint32_t count) {
+    uint32_t count,
+    VkDescriptorBindingFlags flags) {
   assert(bindings.count(binding) == 0 && "Binding already in use");
   VkDescriptorSetLayoutBinding layoutBinding{};
   layoutBinding.binding = binding;
@@ -20,28 +23,53 @@ LveDescriptorSetLayout::Builder &LveDescriptorSetLayout::Builder::addBinding(
   layoutBinding.descriptorCount = count;
   layoutBinding.stageFlags = stageFlags;
   bindings[binding] = layoutBinding;
+  if (flags != 0) {
+    bindingFlags[binding] = flags;
+  }
+  return *this;
+}
+
+LveDescriptorSetLayout::Builder &LveDescriptorSetLayout::Builder::setLayoutFlags(
+    VkDescriptorSetLayoutCreateFlags flags) {
+  layoutFlags = flags;
   return *this;
 }
 
 std::unique_ptr<LveDescriptorSetLayout> LveDescriptorSetLayout::Builder::build() const {
-  return std::make_unique<LveDescriptorSetLayout>(lveDevice, bindings);
+  return std::make_unique<LveDescriptorSetLayout>(lveDevice, bindings, bindingFlags, layoutFlags);
 }
 
 // *************** Descriptor Set Layout *********************
 
 LveDescriptorSetLayout::LveDescriptorSetLayout(
-    LveDevice &lveDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+    LveDevice &lveDevice,
+    std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+    const std::unordered_map<uint32_t, VkDescriptorBindingFlags> &bindingFlags,
+    VkDescriptorSetLayoutCreateFlags layoutFlags)
     : lveDevice{lveDevice}, bindings{bindings} {
   std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+  std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
   for (auto kv : bindings) {
     setLayoutBindings.push_back(kv.second);
+    auto flags = bindingFlags.find(kv.first);
+    setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
   }
 
   VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
   descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptorSetLayoutInfo.flags = layoutFlags;
   descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
   descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
+  // binding flags come from VK_EXT_descriptor_indexing, only chained when used
+  VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+  bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+  bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+  if (!bindingFlags.empty()) {
+    descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+  }
+
   if (vkCreateDescriptorSetLayout(
           lveDevice.device(),
           &descriptorSetLayoutInfo,
@@ -110,8 +138,7 @@ bool LveDescriptorPool::allocateDescriptor(
   allocInfo.pSetLayouts = &descriptorSetLayout;
   allocInfo.descriptorSetCount = 1;
 
-  // Might want to create a "DescriptorPoolManager" class that handles this case, and builds
-  // a new pool whenever an old pool fills up. But this is beyond our current scope
+  // fails once the pool is full, LveDescriptorAllocator moves on to a new pool instead
   if (vkAllocateDescriptorSets(lveDevice.device(), &allocInfo, &descriptor) != VK_SUCCESS) {
     return false;
   }
@@ -130,10 +157,116 @@ void LveDescriptorPool::resetPool() {
   vkResetDescriptorPool(lveDevice.device(), descriptorPool, 0);
 }
 
+// *************** Descriptor Allocator Builder *********************
+
+LveDescriptorAllocator::Builder &LveDescriptorAllocator::Builder::addPoolRatio(
+    VkDescriptorType descriptorType, float countPerSet) {
+  poolRatios.push_back({descriptorType, countPerSet});
+  return *this;
+}
+
+LveDescriptorAllocator::Builder &LveDescriptorAllocator::Builder::setPoolFlags(
+    VkDescriptorPoolCreateFlags flags) {
+  poolFlags = flags;
+  return *this;
+}
+
+LveDescriptorAllocator::Builder &LveDescriptorAllocator::Builder::setInitialSets(uint32_t count) {
+  initialSets = count;
+  return *this;
+}
+
+std::unique_ptr<LveDescriptorAllocator> LveDescriptorAllocator::Builder::build() const {
+  return std::make_unique<LveDescriptorAllocator>(lveDevice, initialSets, poolFlags, poolRatios);
+}
+
+// *************** Descriptor Allocator *********************
+
+LveDescriptorAllocator::LveDescriptorAllocator(
+    LveDevice &lveDevice,
+    uint32_t initialSets,
+    VkDescriptorPoolCreateFlags poolFlags,
+    const std::vector<std::pair<VkDescriptorType, float>> &poolRatios)
+    : lveDevice{lveDevice},
+      poolFlags{poolFlags},
+      poolRatios{poolRatios},
+      setsPerPool{std::max(initialSets, 1u)} {}
+
+LveDescriptorAllocator::~LveDescriptorAllocator() {
+  for (VkDescriptorPool pool : usedPools) {
+    vkDestroyDescriptorPool(lveDevice.device(), pool, nullptr);
+  }
+  for (VkDescriptorPool pool : freePools) {
+    vkDestroyDescriptorPool(lveDevice.device(), pool, nullptr);
+  }
+}
+
+VkDescriptorPool LveDescriptorAllocator::nextPool() {
+  if (!freePools.empty()) {
+    currentPool = freePools.back();
+    freePools.pop_back();
+    usedPools.push_back(currentPool);
+    return currentPool;
+  }
+
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for (auto &ratio : poolRatios) {
+    uint32_t count = static_cast<uint32_t>(std::ceil(ratio.second * setsPerPool));
+    poolSizes.push_back({ratio.first, std::max(count, 1u)});
+  }
+
+  VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+  descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  descriptorPoolInfo.pPoolSizes = poolSizes.data();
+  descriptorPoolInfo.maxSets = setsPerPool;
+  descriptorPoolInfo.flags = poolFlags;
+
+  if (vkCreateDescriptorPool(lveDevice.device(), &descriptorPoolInfo, nullptr, &currentPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor pool!");
+  }
+  setsPerPool = std::min(setsPerPool * 2, MAX_SETS_PER_POOL);
+  usedPools.push_back(currentPool);
+  return currentPool;
+}
+
+VkDescriptorSet LveDescriptorAllocator::allocate(const VkDescriptorSetLayout descriptorSetLayout) {
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = currentPool != VK_NULL_HANDLE ? currentPool : nextPool();
+  allocInfo.pSetLayouts = &descriptorSetLayout;
+  allocInfo.descriptorSetCount = 1;
+
+  VkDescriptorSet descriptor;
+  VkResult result = vkAllocateDescriptorSets(lveDevice.device(), &allocInfo, &descriptor);
+  if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+    allocInfo.descriptorPool = nextPool();
+    result = vkAllocateDescriptorSets(lveDevice.device(), &allocInfo, &descriptor);
+  }
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate descriptor set!");
+  }
+  return descriptor;
+}
+
+void LveDescriptorAllocator::reset() {
+  for (VkDescriptorPool pool : usedPools) {
+    vkResetDescriptorPool(lveDevice.device(), pool, 0);
+    freePools.push_back(pool);
+  }
+  usedPools.clear();
+  currentPool = VK_NULL_HANDLE;
+}
+
 // *************** Descriptor Writer *********************
 
 LveDescriptorWriter::LveDescriptorWriter(LveDescriptorSetLayout &setLayout, LveDescriptorPool &pool)
-    : setLayout{setLayout}, pool{pool} {}
+    : setLayout{setLayout}, pool{&pool} {}
+
+LveDescriptorWriter::LveDescriptorWriter(
+    LveDescriptorSetLayout &setLayout, LveDescriptorAllocator &allocator)
+    : setLayout{setLayout}, allocator{&allocator} {}
 
 LveDescriptorWriter &LveDescriptorWriter::writeBuffer(
     uint32_t binding, VkDescriptorBufferInfo *bufferInfo) {
@@ -178,8 +311,9 @@ LveDescriptorWriter &LveDescriptorWriter::writeImage(
 }
 
 bool LveDescriptorWriter::build(VkDescriptorSet &set) {
-  bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
-  if (!success) {
+  if (allocator != nullptr) {
+    set = allocator->allocate(setLayout.getDescriptorSetLayout());
+  } else if (!pool->allocateDescriptor(setLayout.getDescriptorSetLayout(), set)) {
     return false;
   }
   overwrite(set);
@@ -190,7 +324,7 @@ void LveDescriptorWriter::overwrite(VkDescriptorSet &set) {
   for (auto &write : writes) {
     write.dstSet = set;
   }
-  vkUpdateDescriptorSets(pool.lveDevice.device(), writes.size(), writes.data(), 0, nullptr);
+  vkUpdateDescriptorSets(setLayout.lveDevice.device(), writes.size(), writes.data(), 0, nullptr);
 }
 
 }  // namespace lve
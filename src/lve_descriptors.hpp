@@ -19,16 +19,23 @@ class LveDescriptorSetLayout {
         uint32_t binding,
         VkDescriptorType descriptorType,
         VkShaderStageFlags stageFlags,
-        uint32_t count = 1);
+        uint32_t count = 1,
+        VkDescriptorBindingFlags bindingFlags = 0);
+    Builder &setLayoutFlags(VkDescriptorSetLayoutCreateFlags flags);
     std::unique_ptr<LveDescriptorSetLayout> build() const;
 
    private:
     LveDevice &lveDevice;
     std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+    std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
+    VkDescriptorSetLayoutCreateFlags layoutFlags = 0;
   };
 
   LveDescriptorSetLayout(
-      LveDevice &lveDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+      LveDevice &lveDevice,
+      std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+      const std::unordered_map<uint32_t, VkDescriptorBindingFlags> &bindingFlags = {},
+      VkDescriptorSetLayoutCreateFlags layoutFlags = 0);
   ~LveDescriptorSetLayout();
   LveDescriptorSetLayout(const LveDescriptorSetLayout &) = delete;
   LveDescriptorSetLayout &operator=(const LveDescriptorSetLayout &) = delete;
@@ -84,9 +91,66 @@ class LveDescriptorPool {
   friend class LveDescriptorWriter;
 };
 
+// Never runs out: sets are allocated from a chain of pools, a new one (each twice the size of
+// the last, up to MAX_SETS_PER_POOL) taking over once the current one is full or fragmented.
+// reset() frees every set at once and keeps the pools for reuse, so an allocator per frame in
+// flight, reset once the frame's previous submission completed, recycles its pools every frame.
+class LveDescriptorAllocator {
+ public:
+  static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+  class Builder {
+   public:
+    Builder(LveDevice &lveDevice) : lveDevice{lveDevice} {}
+
+    // descriptors of the type each pool holds per set
+    Builder &addPoolRatio(VkDescriptorType descriptorType, float countPerSet);
+    Builder &setPoolFlags(VkDescriptorPoolCreateFlags flags);
+    // sets the first pool holds
+    Builder &setInitialSets(uint32_t count);
+    std::unique_ptr<LveDescriptorAllocator> build() const;
+
+   private:
+    LveDevice &lveDevice;
+    std::vector<std::pair<VkDescriptorType, float>> poolRatios{};
+    uint32_t initialSets = 16;
+    VkDescriptorPoolCreateFlags poolFlags = 0;
+  };
+
+  LveDescriptorAllocator(
+      LveDevice &lveDevice,
+      uint32_t initialSets,
+      VkDescriptorPoolCreateFlags poolFlags,
+      const std::vector<std::pair<VkDescriptorType, float>> &poolRatios);
+  ~LveDescriptorAllocator();
+  LveDescriptorAllocator(const LveDescriptorAllocator &) = delete;
+  LveDescriptorAllocator &operator=(const LveDescriptorAllocator &) = delete;
+
+  VkDescriptorSet allocate(const VkDescriptorSetLayout descriptorSetLayout);
+  // Frees every set allocated so far, none may still be in use
+  void reset();
+
+  uint32_t getPoolCount() const {
+    return static_cast<uint32_t>(usedPools.size() + freePools.size());
+  }
+
+ private:
+  VkDescriptorPool nextPool();
+
+  LveDevice &lveDevice;
+  VkDescriptorPoolCreateFlags poolFlags;
+  std::vector<std::pair<VkDescriptorType, float>> poolRatios;
+  uint32_t setsPerPool;
+  VkDescriptorPool currentPool = VK_NULL_HANDLE;
+  // usedPools holds currentPool and every pool filled before it
+  std::vector<VkDescriptorPool> usedPools;
+  std::vector<VkDescriptorPool> freePools;
+};
+
 class LveDescriptorWriter {
  public:
   LveDescriptorWriter(LveDescriptorSetLayout &setLayout, LveDescriptorPool &pool);
+  LveDescriptorWriter(LveDescriptorSetLayout &setLayout, LveDescriptorAllocator &allocator);
 
   LveDescriptorWriter &writeBuffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo);
   LveDescriptorWriter &writeImage(uint32_t binding, VkDescriptorImageInfo *imageInfo);
@@ -96,7 +160,9 @@ class LveDescriptorWriter {
 
  private:
   LveDescriptorSetLayout &setLayout;
-  LveDescriptorPool &pool;
+  // exactly one is set
+  LveDescriptorPool *pool = nullptr;
+  LveDescriptorAllocator *allocator = nullptr;
   std::vector<VkWriteDescriptorSet> writes;
 };
 
@@ -1,11 +1,26 @@
 #include "lve_device.hpp"
 
+#include "lve_deletion_queue.hpp"
+#include "lve_geometry_pool.hpp"
+#include "lve_pipeline_registry.hpp"
+#include "lve_timeline.hpp"
+#include "lve_upload_manager.hpp"
+
 // std headers
+#include <algorithm>
+#include <cassert>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <unordered_set>
 
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
 namespace lve {
 
 // local callback functions
@@ -47,24 +62,52 @@ void DestroyDebugUtilsMessengerEXT(
 }
 
 // class member functions
-LveDevice::LveDevice(LveWindow &window) : window{window} {
+LveDevice::LveDevice(LveWindow &window) : window{&window} {
   createInstance();
   setupDebugMessenger();
   createSurface();
   pickPhysicalDevice();
   createLogicalDevice();
+  createTimelines();
+  createAllocator();
+  createPipelineCache();
+  createPipelineRegistry();
+  createCommandPool();
+  createUploadManager();
+}
+
+LveDevice::LveDevice() {
+  createInstance();
+  setupDebugMessenger();
+  pickPhysicalDevice();
+  createLogicalDevice();
+  createTimelines();
+  createAllocator();
+  createPipelineCache();
+  createPipelineRegistry();
   createCommandPool();
+  createUploadManager();
 }
 
 LveDevice::~LveDevice() {
+  deletionQueue_.reset();
+  geometryPools.clear();
+  uploadManager_.reset();
+  pipelineRegistry_.reset();
   vkDestroyCommandPool(device_, commandPool, nullptr);
+  graphicsTimeline_.reset();
+  savePipelineCache();
+  vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
+  allocator.reset();
   vkDestroyDevice(device_, nullptr);
 
   if (enableValidationLayers) {
     DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
   }
 
-  vkDestroySurfaceKHR(instance, surface_, nullptr);
+  if (surface_ != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(instance, surface_, nullptr);
+  }
   vkDestroyInstance(instance, nullptr);
 }
 
@@ -86,6 +129,19 @@ void LveDevice::createInstance() {
   createInfo.pApplicationInfo = &appInfo;
 
   auto extensions = getRequiredExtensions();
+  // optional, needed to query the features of newer device extensions
+  uint32_t availableCount = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, nullptr);
+  std::vector<VkExtensionProperties> available(availableCount);
+  vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, available.data());
+  for (const auto &extension : available) {
+    if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) ==
+        0) {
+      extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+      hasProperties2 = true;
+      break;
+    }
+  }
   createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
   createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -114,7 +170,7 @@ void LveDevice::pickPhysicalDevice() {
   if (deviceCount == 0) {
     throw std::runtime_error("failed to find GPUs with Vulkan support!");
   }
-  std::cout << "Device count: " << deviceCount << std::endl;
+  log() << "Device count: " << deviceCount << std::endl;
   std::vector<VkPhysicalDevice> devices(deviceCount);
   vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
@@ -130,14 +186,17 @@ void LveDevice::pickPhysicalDevice() {
   }
 
   vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-  std::cout << "physical device: " << properties.deviceName << std::endl;
+  log() << "physical device: " << properties.deviceName << std::endl;
 }
 
 void LveDevice::createLogicalDevice() {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  std::set<uint32_t> uniqueQueueFamilies = {
+      indices.graphicsFamily,
+      indices.presentFamily,
+      indices.transferFamily};
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -149,8 +208,39 @@ void LveDevice::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
-  VkPhysicalDeviceFeatures deviceFeatures = {};
-  deviceFeatures.samplerAnisotropy = VK_TRUE;
+  std::vector<const char *> extensions = getEnabledDeviceExtensions();
+
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+  enabledFeatures_ = {};
+  enabledFeatures_.samplerAnisotropy = VK_TRUE;
+  // optional, used by the indirect rendering path when present
+  enabledFeatures_.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  enabledFeatures_.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+  // optional, block compressed textures can only be streamed when present
+  enabledFeatures_.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  // optional, LveGpuProfiler only collects pipeline statistics when present
+  enabledFeatures_.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+  queryDescriptorIndexing();
+  queryPresentWait();
+  queryTimelineSemaphores();
+
+  // feature structs of the extensions in use, chained onto the create info
+  void *featureChain = nullptr;
+  if (supportsBindless_) {
+    descriptorIndexingFeatures_.pNext = featureChain;
+    featureChain = &descriptorIndexingFeatures_;
+  }
+  if (supportsPresentWait_) {
+    presentIdFeatures_.pNext = featureChain;
+    presentWaitFeatures_.pNext = &presentIdFeatures_;
+    featureChain = &presentWaitFeatures_;
+  }
+  if (supportsTimelineSemaphores_) {
+    timelineSemaphoreFeatures_.pNext = featureChain;
+    featureChain = &timelineSemaphoreFeatures_;
+  }
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -158,9 +248,10 @@ void LveDevice::createLogicalDevice() {
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-  createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.pEnabledFeatures = &enabledFeatures_;
+  createInfo.pNext = featureChain;
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -177,6 +268,292 @@ void LveDevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+  timestampValidBits_ = families[indices.graphicsFamily].timestampValidBits;
+
+  loadDeviceFunctions();
+}
+
+std::vector<const char *> LveDevice::getEnabledDeviceExtensions() {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      physicalDevice,
+      nullptr,
+      &extensionCount,
+      availableExtensions.data());
+
+  auto isAvailable = [&availableExtensions](const char *name) {
+    for (const auto &extension : availableExtensions) {
+      if (strcmp(name, extension.extensionName) == 0) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  std::vector<const char *> extensions;
+  if (!isHeadless()) {
+    extensions = deviceExtensions;
+  }
+  for (const char *optional : optionalDeviceExtensions) {
+    // presenting extensions depend on VK_KHR_swapchain
+    bool presenting = strcmp(optional, VK_KHR_PRESENT_ID_EXTENSION_NAME) == 0 ||
+                      strcmp(optional, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) == 0;
+    if (isAvailable(optional) && !(presenting && isHeadless())) {
+      extensions.push_back(optional);
+    }
+  }
+  // depends on maintenance3, and its features can only be queried through properties2
+  if (!hasProperties2 || !isAvailable(VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+    extensions.erase(
+        std::remove_if(
+            extensions.begin(),
+            extensions.end(),
+            [](const char *name) {
+              return strcmp(name, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+            }),
+        extensions.end());
+  }
+
+  enabledExtensions.assign(extensions.begin(), extensions.end());
+  return extensions;
+}
+
+bool LveDevice::isExtensionEnabled(const char *extensionName) const {
+  for (const auto &extension : enabledExtensions) {
+    if (extension == extensionName) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void LveDevice::loadDeviceFunctions() {
+  if (isExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+    cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+        vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+  }
+  if (supportsPresentWait_) {
+    waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+        vkGetDeviceProcAddr(device_, "vkWaitForPresentKHR"));
+    supportsPresentWait_ = waitForPresent != nullptr;
+  }
+  if (supportsTimelineSemaphores_) {
+    waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphores>(
+        vkGetDeviceProcAddr(device_, "vkWaitSemaphoresKHR"));
+    getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(
+        vkGetDeviceProcAddr(device_, "vkGetSemaphoreCounterValueKHR"));
+    supportsTimelineSemaphores_ = waitSemaphores != nullptr && getSemaphoreCounterValue != nullptr;
+  }
+  if (enableValidationLayers) {
+    cmdBeginDebugUtilsLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(
+        vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT"));
+    cmdEndDebugUtilsLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(
+        vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT"));
+    if (cmdBeginDebugUtilsLabel == nullptr || cmdEndDebugUtilsLabel == nullptr) {
+      cmdBeginDebugUtilsLabel = nullptr;
+      cmdEndDebugUtilsLabel = nullptr;
+    }
+  }
+}
+
+void LveDevice::queryDescriptorIndexing() {
+  descriptorIndexingFeatures_ = {};
+  descriptorIndexingFeatures_.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  descriptorIndexingProperties_ = {};
+  descriptorIndexingProperties_.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+  supportsBindless_ = false;
+  if (!isExtensionEnabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+    return;
+  }
+
+  auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+      vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+  auto getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+      vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+  if (getFeatures2 == nullptr || getProperties2 == nullptr) {
+    return;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeatures supported{};
+  supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features2.pNext = &supported;
+  getFeatures2(physicalDevice, &features2);
+
+  VkPhysicalDeviceProperties2 properties2{};
+  properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties2.pNext = &descriptorIndexingProperties_;
+  getProperties2(physicalDevice, &properties2);
+  descriptorIndexingProperties_.pNext = nullptr;
+
+  supportsBindless_ = supported.runtimeDescriptorArray &&
+                      supported.descriptorBindingPartiallyBound &&
+                      supported.descriptorBindingUpdateUnusedWhilePending &&
+                      supported.descriptorBindingSampledImageUpdateAfterBind &&
+                      supported.descriptorBindingStorageBufferUpdateAfterBind &&
+                      supported.shaderSampledImageArrayNonUniformIndexing &&
+                      supported.shaderStorageBufferArrayNonUniformIndexing;
+  if (supportsBindless_) {
+    // only what the bindless table uses
+    descriptorIndexingFeatures_.runtimeDescriptorArray = VK_TRUE;
+    descriptorIndexingFeatures_.descriptorBindingPartiallyBound = VK_TRUE;
+    descriptorIndexingFeatures_.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    descriptorIndexingFeatures_.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    descriptorIndexingFeatures_.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    descriptorIndexingFeatures_.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    descriptorIndexingFeatures_.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+  }
+}
+
+void LveDevice::queryPresentWait() {
+  presentIdFeatures_ = {};
+  presentIdFeatures_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  presentWaitFeatures_ = {};
+  presentWaitFeatures_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  supportsPresentWait_ = false;
+  if (!hasProperties2 || !isExtensionEnabled(VK_KHR_PRESENT_ID_EXTENSION_NAME) ||
+      !isExtensionEnabled(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+    return;
+  }
+
+  auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+      vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+  if (getFeatures2 == nullptr) {
+    return;
+  }
+
+  VkPhysicalDevicePresentIdFeaturesKHR presentId{};
+  presentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWait{};
+  presentWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  presentWait.pNext = &presentId;
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features2.pNext = &presentWait;
+  getFeatures2(physicalDevice, &features2);
+
+  supportsPresentWait_ = presentId.presentId && presentWait.presentWait;
+  presentIdFeatures_.presentId = supportsPresentWait_;
+  presentWaitFeatures_.presentWait = supportsPresentWait_;
+}
+
+void LveDevice::queryTimelineSemaphores() {
+  timelineSemaphoreFeatures_ = {};
+  timelineSemaphoreFeatures_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+  supportsTimelineSemaphores_ = false;
+  if (!hasProperties2 || !isExtensionEnabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+    return;
+  }
+
+  auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+      vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+  if (getFeatures2 == nullptr) {
+    return;
+  }
+
+  VkPhysicalDeviceTimelineSemaphoreFeatures supported{};
+  supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features2.pNext = &supported;
+  getFeatures2(physicalDevice, &features2);
+
+  supportsTimelineSemaphores_ = supported.timelineSemaphore;
+  timelineSemaphoreFeatures_.timelineSemaphore = supportsTimelineSemaphores_;
+}
+
+void LveDevice::createTimelines() {
+  graphicsTimeline_ = std::make_unique<LveTimeline>(*this, graphicsQueue_);
+  deletionQueue_ = std::make_unique<LveDeletionQueue>(*graphicsTimeline_);
+}
+
+void LveDevice::createAllocator() {
+  allocator = std::make_unique<LveAllocator>(device_, physicalDevice);
+}
+
+void LveDevice::createPipelineCache() {
+  // drivers are meant to reject foreign data but some crash on it, so only hand over a cache
+  // whose header matches this device and driver: header size and version, vendor and device id,
+  // then the cache UUID
+  std::string cachePath = ENGINE_DIR + std::string{PIPELINE_CACHE_FILE};
+  std::vector<char> data;
+  std::ifstream file{cachePath, std::ios::ate | std::ios::binary};
+  if (file.is_open()) {
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    if (!file) {
+      data.clear();
+    }
+  }
+
+  constexpr size_t HEADER_SIZE = 16 + VK_UUID_SIZE;
+  if (data.size() >= HEADER_SIZE) {
+    uint32_t header[4];
+    memcpy(header, data.data(), sizeof(header));
+    bool matches = header[0] >= HEADER_SIZE && header[0] <= data.size() &&
+                   header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                   header[2] == properties.vendorID && header[3] == properties.deviceID &&
+                   memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    if (!matches) {
+      log() << "pipeline cache is from another device or driver, rebuilding it" << std::endl;
+      data.clear();
+    }
+  } else {
+    data.clear();
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+    // the data passed validation but the driver still refused it
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = nullptr;
+    if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create pipeline cache!");
+    }
+  }
+}
+
+void LveDevice::savePipelineCache() {
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, nullptr) != VK_SUCCESS || size == 0) {
+    return;
+  }
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, data.data()) != VK_SUCCESS) {
+    return;
+  }
+
+  // write to a temporary first so a crash never leaves a truncated cache behind. Failing to save
+  // only costs the next start its head start.
+  std::string cachePath = ENGINE_DIR + std::string{PIPELINE_CACHE_FILE};
+  std::string tempPath = cachePath + ".tmp";
+  {
+    std::ofstream out{tempPath, std::ios::binary | std::ios::trunc};
+    out.write(data.data(), static_cast<std::streamsize>(size));
+    if (!out) {
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(tempPath, cachePath, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+  }
 }
 
 void LveDevice::createCommandPool() {
@@ -185,23 +562,47 @@ void LveDevice::createCommandPool() {
   VkCommandPoolCreateInfo poolInfo = {};
   poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
-  poolInfo.flags =
-      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
   if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = commandPool;
+  allocInfo.commandBufferCount = 1;
+  if (vkAllocateCommandBuffers(device_, &allocInfo, &singleTimeCommandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate single time command buffer!");
+  }
+}
+
+LveGeometryPool &LveDevice::geometryPool(uint32_t vertexStride) {
+  auto &pool = geometryPools[vertexStride];
+  if (!pool) {
+    pool = std::make_unique<LveGeometryPool>(*this, vertexStride);
+  }
+  return *pool;
+}
+
+void LveDevice::createPipelineRegistry() {
+  pipelineRegistry_ = std::make_unique<LvePipelineRegistry>(*this);
+}
+
+void LveDevice::createUploadManager() {
+  uploadManager_ = std::make_unique<LveUploadManager>(*this);
 }
 
-void LveDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+void LveDevice::createSurface() { window->createWindowSurface(instance, &surface_); }
 
 bool LveDevice::isDeviceSuitable(VkPhysicalDevice device) {
   QueueFamilyIndices indices = findQueueFamilies(device);
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  bool swapChainAdequate = isHeadless();
+  if (extensionsSupported && !isHeadless()) {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
     swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
   }
@@ -260,11 +661,14 @@ bool LveDevice::checkValidationLayerSupport() {
 }
 
 std::vector<const char *> LveDevice::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  std::vector<const char *> extensions;
+  // glfw is not even initialized without a window
+  if (!isHeadless()) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -279,17 +683,17 @@ void LveDevice::hasGflwRequiredInstanceExtensions() {
   std::vector<VkExtensionProperties> extensions(extensionCount);
   vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
 
-  std::cout << "available extensions:" << std::endl;
+  log() << "available extensions:" << std::endl;
   std::unordered_set<std::string> available;
   for (const auto &extension : extensions) {
-    std::cout << "\t" << extension.extensionName << std::endl;
+    log() << "\t" << extension.extensionName << std::endl;
     available.insert(extension.extensionName);
   }
 
-  std::cout << "required extensions:" << std::endl;
+  log() << "required extensions:" << std::endl;
   auto requiredExtensions = getRequiredExtensions();
   for (const auto &required : requiredExtensions) {
-    std::cout << "\t" << required << std::endl;
+    log() << "\t" << required << std::endl;
     if (available.find(required) == available.end()) {
       throw std::runtime_error("Missing required glfw extension");
     }
@@ -307,7 +711,10 @@ bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
       &extensionCount,
       availableExtensions.data());
 
-  std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+  std::set<std::string> requiredExtensions;
+  if (!isHeadless()) {
+    requiredExtensions.insert(deviceExtensions.begin(), deviceExtensions.end());
+  }
 
   for (const auto &extension : availableExtensions) {
     requiredExtensions.erase(extension.extensionName);
@@ -331,8 +738,12 @@ QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
       indices.graphicsFamily = i;
       indices.graphicsFamilyHasValue = true;
     }
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+    // nothing is presented, the present queue is just the graphics queue
+    VkBool32 presentSupport = isHeadless() && indices.graphicsFamilyHasValue &&
+                              indices.graphicsFamily == static_cast<uint32_t>(i);
+    if (!isHeadless()) {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+    }
     if (queueFamily.queueCount > 0 && presentSupport) {
       indices.presentFamily = i;
       indices.presentFamilyHasValue = true;
@@ -344,6 +755,27 @@ QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
     i++;
   }
 
+  // prefer a transfer-only family (usually backed by DMA engines), then any non-graphics family
+  // with transfer support, and finally fall back to sharing the graphics queue
+  int bestScore = -1;
+  for (uint32_t family = 0; family < queueFamilyCount; family++) {
+    VkQueueFlags flags = queueFamilies[family].queueFlags;
+    if (queueFamilies[family].queueCount == 0 || !(flags & VK_QUEUE_TRANSFER_BIT) ||
+        (flags & VK_QUEUE_GRAPHICS_BIT)) {
+      continue;
+    }
+    int score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+    if (score > bestScore) {
+      bestScore = score;
+      indices.transferFamily = family;
+      indices.transferFamilyHasValue = true;
+    }
+  }
+  if (!indices.transferFamilyHasValue && indices.graphicsFamilyHasValue) {
+    indices.transferFamily = indices.graphicsFamily;
+    indices.transferFamilyHasValue = true;
+  }
+
   return indices;
 }
 
@@ -389,17 +821,14 @@ VkFormat LveDevice::findSupportedFormat(
   throw std::runtime_error("failed to find supported format!");
 }
 
-uint32_t LveDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-    if ((typeFilter & (1 << i)) &&
-        (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-      return i;
-    }
-  }
+VkFormatProperties LveDevice::getFormatProperties(VkFormat format) {
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+  return props;
+}
 
-  throw std::runtime_error("failed to find suitable memory type!");
+uint32_t LveDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+  return allocator->findMemoryType(typeFilter, properties);
 }
 
 void LveDevice::createBuffer(
@@ -407,7 +836,7 @@ void LveDevice::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
+    LveAllocation &bufferMemory) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
@@ -421,37 +850,28 @@ void LveDevice::createBuffer(
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  bufferMemory = allocator->allocate(memRequirements, properties, true);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+  if (vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to bind buffer memory!");
   }
-
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
 }
 
 VkCommandBuffer LveDevice::beginSingleTimeCommands() {
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = commandPool;
-  allocInfo.commandBufferCount = 1;
-
-  VkCommandBuffer commandBuffer;
-  vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
+  singleTimeMutex.lock();
 
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
   beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-  vkBeginCommandBuffer(commandBuffer, &beginInfo);
-  return commandBuffer;
+  vkBeginCommandBuffer(singleTimeCommandBuffer, &beginInfo);
+  return singleTimeCommandBuffer;
 }
 
 void LveDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+  assert(commandBuffer == singleTimeCommandBuffer && "Not a single time command buffer");
+  std::lock_guard<std::mutex> singleTimeLock{singleTimeMutex, std::adopt_lock};
   vkEndCommandBuffer(commandBuffer);
 
   VkSubmitInfo submitInfo{};
@@ -459,10 +879,9 @@ void LveDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
 
-  vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue_);
-
-  vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+  // waits for this submission and the ones before it, not for frames queued after it
+  graphicsTimeline_->wait(graphicsTimeline_->submit(submitInfo));
+  vkResetCommandPool(device_, commandPool, 0);
 }
 
 void LveDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
@@ -508,7 +927,7 @@ void LveDevice::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory) {
+    LveAllocation &imageMemory) {
   if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
@@ -516,16 +935,12 @@ void LveDevice::createImageWithInfo(
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
-  }
+  imageMemory = allocator->allocate(
+      memRequirements,
+      properties,
+      imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+  if (vkBindImageMemory(device_, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS) {
     throw std::runtime_error("failed to bind image memory!");
   }
 }
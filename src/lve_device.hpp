@@ -1,13 +1,24 @@
 #pragma once
 
+#include "lve_allocator.hpp"
 #include "lve_window.hpp"
 
 // std lib headers
+#include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace lve {
 
+class LveDeletionQueue;
+class LveGeometryPool;
+class LvePipelineRegistry;
+class LveTimeline;
+class LveUploadManager;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -17,8 +28,10 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  uint32_t transferFamily;  // dedicated transfer family if one exists, else graphicsFamily
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool transferFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -31,6 +44,8 @@ class LveDevice {
 #endif
 
   LveDevice(LveWindow &window);
+  // Headless: no surface, swap chain or present capable queue, eg for offscreen rendering
+  LveDevice();
   ~LveDevice();
 
   // Not copyable or movable
@@ -39,17 +54,37 @@ class LveDevice {
   LveDevice(LveDevice &&) = delete;
   LveDevice &operator=(LveDevice &&) = delete;
 
-  VkCommandPool getCommandPool() { return commandPool; }
   VkDevice device() { return device_; }
+  bool isHeadless() const { return window == nullptr; }
+  // VK_NULL_HANDLE when headless
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
+  // the graphics queue when headless
   VkQueue presentQueue() { return presentQueue_; }
-
+  VkQueue transferQueue() { return transferQueue_; }
+  // Queues must be externally synchronized and graphics, present and transfer may all be the
+  // same VkQueue, so every vkQueueSubmit / vkQueuePresentKHR happens under this lock
+  std::mutex &queueMutex() { return queueMutex_; }
+  // Values signaled by graphics queue submissions. Work on the transfer queue completes through
+  // the graphics queue, see LveUploadManager, so this is the only timeline.
+  LveTimeline &graphicsTimeline() { return *graphicsTimeline_; }
+  // Objects frames in flight may still use, destroyed once the frames completed
+  LveDeletionQueue &deletionQueue() { return *deletionQueue_; }
+  LveUploadManager &uploadManager() { return *uploadManager_; }
+  // Shared by every pipeline, persisted across runs in PIPELINE_CACHE_FILE
+  VkPipelineCache pipelineCache() { return pipelineCache_; }
+  // Pipelines and shader modules shared between systems
+  LvePipelineRegistry &pipelineRegistry() { return *pipelineRegistry_; }
+  // Shared vertex / index buffers for meshes whose vertices are vertexStride bytes
+  LveGeometryPool &geometryPool(uint32_t vertexStride);
+
+  // Not for headless devices
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
   QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
   VkFormat findSupportedFormat(
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+  VkFormatProperties getFormatProperties(VkFormat format);
 
   // Buffer Helper Functions
   void createBuffer(
@@ -57,7 +92,9 @@ class LveDevice {
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      LveAllocation &bufferMemory);
+  // Blocking one off graphics queue work, callable from any thread. Calls are serialized: the
+  // single command buffer stays locked from begin until end has waited for it.
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -68,10 +105,51 @@ class LveDevice {
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      LveAllocation &imageMemory);
+
+  // Memory for optimal tiling images bound by hand, eg so several can share it
+  LveAllocation allocateMemory(
+      const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties) {
+    return allocator->allocate(requirements, properties, false);
+  }
+  // Returns memory obtained from createBuffer / createImageWithInfo / allocateMemory
+  void freeMemory(LveAllocation &allocation) { allocator->free(allocation); }
+  LveAllocator::Stats getMemoryStats() const { return allocator->getStats(); }
+
+  // Features / optional extensions actually enabled on the logical device
+  const VkPhysicalDeviceFeatures &enabledFeatures() const { return enabledFeatures_; }
+  bool isExtensionEnabled(const char *extensionName) const;
+  // Update after bind, partially bound arrays of sampled images and storage buffers indexed
+  // non uniformly, what LveBindlessTable needs. Requires VK_EXT_descriptor_indexing.
+  bool supportsBindless() const { return supportsBindless_; }
+  const VkPhysicalDeviceDescriptorIndexingProperties &descriptorIndexingProperties() const {
+    return descriptorIndexingProperties_;
+  }
+
+  // Timeline semaphores through VK_KHR_timeline_semaphore, LveTimeline falls back to fences
+  bool supportsTimelineSemaphores() const { return supportsTimelineSemaphores_; }
+  // Presents can carry an id and be waited on until they reached the screen, through
+  // VK_KHR_present_id and VK_KHR_present_wait
+  bool supportsPresentWait() const { return supportsPresentWait_; }
+  // Bits of the graphics queue's timestamps that are valid, 0 when it cannot write any
+  uint32_t timestampValidBits() const { return timestampValidBits_; }
+
+  // nullptr unless VK_KHR_draw_indirect_count is enabled
+  PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+  // nullptr unless supportsPresentWait
+  PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+  // nullptr unless supportsTimelineSemaphores
+  PFN_vkWaitSemaphores waitSemaphores = nullptr;
+  PFN_vkGetSemaphoreCounterValue getSemaphoreCounterValue = nullptr;
+  // nullptr unless validation layers, and with them VK_EXT_debug_utils, are enabled
+  PFN_vkCmdBeginDebugUtilsLabelEXT cmdBeginDebugUtilsLabel = nullptr;
+  PFN_vkCmdEndDebugUtilsLabelEXT cmdEndDebugUtilsLabel = nullptr;
 
   VkPhysicalDeviceProperties properties;
 
+  // relative to ENGINE_DIR
+  static constexpr const char *PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+
  private:
   void createInstance();
   void setupDebugMessenger();
@@ -79,6 +157,11 @@ class LveDevice {
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void createAllocator();
+  void createPipelineCache();
+  void savePipelineCache();
+  void createPipelineRegistry();
+  void createUploadManager();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
@@ -88,21 +171,64 @@ class LveDevice {
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  std::vector<const char *> getEnabledDeviceExtensions();
+  void loadDeviceFunctions();
+  void queryDescriptorIndexing();
+  void queryPresentWait();
+  void queryTimelineSemaphores();
+  void createTimelines();
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+  // Diagnostics go to stderr when headless, keeping stdout free for the tool's own output
+  std::ostream &log() { return isHeadless() ? std::cerr : std::cout; }
 
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-  LveWindow &window;
+  LveWindow *window = nullptr;
+
+  // single time commands, reset in bulk after each use
   VkCommandPool commandPool;
+  VkCommandBuffer singleTimeCommandBuffer;
+  std::mutex singleTimeMutex;
+  std::mutex queueMutex_;
+  std::unique_ptr<LveAllocator> allocator;
+  VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+  std::unique_ptr<LvePipelineRegistry> pipelineRegistry_;
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
+  std::unique_ptr<LveUploadManager> uploadManager_;
+  std::unique_ptr<LveTimeline> graphicsTimeline_;
+  std::unique_ptr<LveDeletionQueue> deletionQueue_;
+  std::unordered_map<uint32_t, std::unique_ptr<LveGeometryPool>> geometryPools;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
+  // required unless headless
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  // enabled when available, features depending on them check isExtensionEnabled
+  const std::vector<const char *> optionalDeviceExtensions = {
+      VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+      VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+      VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+      VK_KHR_PRESENT_ID_EXTENSION_NAME,
+      VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+      VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME};
+  std::vector<std::string> enabledExtensions;
+  VkPhysicalDeviceFeatures enabledFeatures_{};
+  // VK_KHR_get_physical_device_properties2 is enabled on the instance
+  bool hasProperties2 = false;
+  bool supportsBindless_ = false;
+  VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures_{};
+  VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties_{};
+  bool supportsPresentWait_ = false;
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures_{};
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures_{};
+  bool supportsTimelineSemaphores_ = false;
+  VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures_{};
+  uint32_t timestampValidBits_ = 0;
 };
 
 }  // namespace lve
@@ -0,0 +1,51 @@
+#include "lve_frame_allocator.hpp"
+
+#include "lve_swap_chain.hpp"
+
+// std
+#include <stdexcept>
+
+namespace lve {
+
+LveFrameAllocator::LveFrameAllocator(LveDevice &device, VkDeviceSize frameCapacity)
+    : lveDevice{device}, frameCapacity{frameCapacity} {
+  frames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (auto &frame : frames) {
+    frame = std::make_unique<LveBuffer>(
+        lveDevice,
+        frameCapacity,
+        1,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    frame->map();
+  }
+}
+
+void LveFrameAllocator::beginFrame(int frameIndex) {
+  this->frameIndex = frameIndex;
+  head.store(0, std::memory_order_relaxed);
+}
+
+LveFrameAllocator::Allocation LveFrameAllocator::allocate(
+    VkDeviceSize size, VkDeviceSize alignment) {
+  VkDeviceSize begin;
+  VkDeviceSize current = head.load(std::memory_order_relaxed);
+  do {
+    begin = LveBuffer::getAlignment(current, alignment);
+    if (begin + size > frameCapacity) {
+      throw std::runtime_error("failed to allocate frame memory, frame capacity exceeded!");
+    }
+  } while (!head.compare_exchange_weak(current, begin + size, std::memory_order_relaxed));
+
+  auto *mapped = static_cast<char *>(frames[frameIndex]->getMappedMemory());
+  return {mapped + begin, static_cast<uint32_t>(begin)};
+}
+
+void LveFrameAllocator::flush() {
+  VkDeviceSize used = head.load(std::memory_order_relaxed);
+  if (used > 0) {
+    frames[frameIndex]->flush(used, 0);
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Per frame scratch memory for uniform and storage data. Each frame in flight owns one
+// persistently mapped host visible buffer that is bump allocated front to back and reset
+// wholesale at the start of the frame, once its previous submission has finished. Data is bound
+// through VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC / STORAGE_BUFFER_DYNAMIC descriptors pointing
+// at the frame's buffer, the allocation's offset being the dynamic offset, so any amount of per
+// draw data needs neither new descriptor sets nor per allocation flushes. Allocating is thread
+// safe.
+class LveFrameAllocator {
+ public:
+  static constexpr VkDeviceSize DEFAULT_FRAME_CAPACITY = 1024 * 1024;
+
+  struct Allocation {
+    void *data;
+    // from the start of the frame's buffer, the dynamic offset to bind it with
+    uint32_t offset;
+  };
+
+  LveFrameAllocator(LveDevice &device, VkDeviceSize frameCapacity = DEFAULT_FRAME_CAPACITY);
+
+  LveFrameAllocator(const LveFrameAllocator &) = delete;
+  LveFrameAllocator &operator=(const LveFrameAllocator &) = delete;
+
+  // Must come after LveRenderer::beginFrame, which waits for the frame's previous submission
+  void beginFrame(int frameIndex);
+
+  Allocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+  Allocation allocateUniform(VkDeviceSize size) {
+    return allocate(size, lveDevice.properties.limits.minUniformBufferOffsetAlignment);
+  }
+  Allocation allocateStorage(VkDeviceSize size) {
+    return allocate(size, lveDevice.properties.limits.minStorageBufferOffsetAlignment);
+  }
+
+  // Copies value into a new uniform allocation and returns its dynamic offset
+  template <typename T>
+  uint32_t pushUniform(const T &value) {
+    Allocation allocation = allocateUniform(sizeof(T));
+    std::memcpy(allocation.data, &value, sizeof(T));
+    return allocation.offset;
+  }
+
+  // Flushes everything allocated this frame in one range, call once before submitting
+  void flush();
+
+  // For the dynamic descriptors, range being the size of the data bound at each offset
+  VkDescriptorBufferInfo descriptorInfo(int frameIndex, VkDeviceSize range) {
+    return frames[frameIndex]->descriptorInfo(range, 0);
+  }
+
+  VkDeviceSize getFrameCapacity() const { return frameCapacity; }
+  // bytes allocated in the current frame
+  VkDeviceSize getUsed() const { return head.load(std::memory_order_relaxed); }
+
+ private:
+  LveDevice &lveDevice;
+  VkDeviceSize frameCapacity;
+  std::vector<std::unique_ptr<LveBuffer>> frames;
+  int frameIndex = 0;
+  std::atomic<VkDeviceSize> head{0};
+};
+
+}  // namespace lve
@@ -1,18 +1,23 @@
 #pragma once
 
 #include "lve_camera.hpp"
-#include "lve_game_object.hpp"
+#include "lve_parallel_recorder.hpp"
+#include "lve_scene.hpp"
 
 // lib
 #include <vulkan/vulkan.h>
 
 namespace lve {
 
-#define MAX_LIGHTS 10
+class LveFrameAllocator;
+class LveGpuProfiler;
 
+// std430 layout of the lights buffer, see LveLightClusters
 struct PointLight {
-  glm::vec4 position{};  // ignore w
+  glm::vec4 position{};  // w is range
   glm::vec4 color{};     // w is intensity
+  float radius = 0.f;    // of the billboard PointLightSystem draws
+  float padding[3]{};
 };
 
 struct GlobalUbo {
@@ -20,8 +25,9 @@ struct GlobalUbo {
   glm::mat4 view{1.f};
   glm::mat4 inverseView{1.f};
   glm::vec4 ambientLightColor{1.f, 1.f, 1.f, .02f};  // w is intensity
-  PointLight pointLights[MAX_LIGHTS];
-  int numLights;
+  // set by LveLightClusters::build, the lights themselves are in storage buffers
+  glm::uvec4 clusterGrid{};  // cluster counts along x, y and z, w is the light count
+  glm::vec4 clusterDepth{};  // depth slice = log(view depth) * x + y
 };
 
 struct FrameInfo {
@@ -30,6 +36,15 @@ struct FrameInfo {
   VkCommandBuffer commandBuffer;
   LveCamera &camera;
   VkDescriptorSet globalDescriptorSet;
-  LveGameObject::Map &gameObjects;
+  // dynamic offset of the GlobalUbo in globalDescriptorSet
+  uint32_t globalUboOffset;
+  LveScene &scene;
+  // set while the render pass takes secondary command buffers, systems then record through it
+  // instead of into commandBuffer
+  LveParallelRecorder *recorder = nullptr;
+  // this frame's scratch uniform / storage memory
+  LveFrameAllocator *frameAllocator = nullptr;
+  // systems time their work with an LveGpuProfiler::Scope when set
+  LveGpuProfiler *profiler = nullptr;
 };
 }  // namespace lve
@@ -0,0 +1,58 @@
+#include "lve_frustum.hpp"
+
+namespace lve {
+
+LveFrustum::LveFrustum(const glm::mat4 &viewProjection) {
+  // Gribb / Hartmann plane extraction, glm matrices are column major so gather rows first
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++) {
+    rows[i] = glm::vec4{
+        viewProjection[0][i],
+        viewProjection[1][i],
+        viewProjection[2][i],
+        viewProjection[3][i]};
+  }
+
+  planes[Left] = rows[3] + rows[0];
+  planes[Right] = rows[3] - rows[0];
+  planes[Bottom] = rows[3] + rows[1];
+  planes[Top] = rows[3] - rows[1];
+  planes[Near] = rows[2];  // depth range is [0, 1]
+  planes[Far] = rows[3] - rows[2];
+
+  for (auto &plane : planes) {
+    plane /= glm::length(glm::vec3{plane});
+  }
+}
+
+bool LveFrustum::isVisible(const LveBoundingSphere &sphere) const {
+  for (const auto &plane : planes) {
+    if (glm::dot(glm::vec3{plane}, sphere.center) + plane.w < -sphere.radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LveFrustum::cullSpheres(
+    const float *centerX,
+    const float *centerY,
+    const float *centerZ,
+    const float *radius,
+    uint32_t count,
+    uint8_t *visible) const {
+  for (uint32_t i = 0; i < count; i++) {
+    visible[i] = 1;
+  }
+
+  // planes outside, spheres inside: each inner loop is branch free over contiguous arrays
+  for (const auto &plane : planes) {
+    const float a = plane.x, b = plane.y, c = plane.z, d = plane.w;
+    for (uint32_t i = 0; i < count; i++) {
+      float distance = a * centerX[i] + b * centerY[i] + c * centerZ[i] + d;
+      visible[i] &= static_cast<uint8_t>(distance >= -radius[i]);
+    }
+  }
+}
+
+}  // namespace lve
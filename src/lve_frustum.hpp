@@ -0,0 +1,55 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+
+namespace lve {
+
+struct LveBoundingBox {
+  glm::vec3 min{0.f};
+  glm::vec3 max{0.f};
+
+  glm::vec3 center() const { return (min + max) * .5f; }
+  glm::vec3 extent() const { return (max - min) * .5f; }
+};
+
+struct LveBoundingSphere {
+  glm::vec3 center{0.f};
+  float radius = 0.f;
+};
+
+// The six clip planes of a view projection matrix, normals pointing inwards and normalized so
+// plane distances are in world units.
+class LveFrustum {
+ public:
+  enum Plane { Left = 0, Right, Bottom, Top, Near, Far, PLANE_COUNT };
+
+  LveFrustum() = default;
+  explicit LveFrustum(const glm::mat4 &viewProjection);
+
+  bool isVisible(const LveBoundingSphere &sphere) const;
+
+  // Batch test over spheres in structure of arrays layout, sets visible[i] to 1 when sphere i
+  // intersects the frustum and 0 otherwise. Written as straight loops over plain arrays so the
+  // compiler can vectorize them.
+  void cullSpheres(
+      const float *centerX,
+      const float *centerY,
+      const float *centerZ,
+      const float *radius,
+      uint32_t count,
+      uint8_t *visible) const;
+
+  const glm::vec4 &getPlane(Plane plane) const { return planes[plane]; }
+
+ private:
+  std::array<glm::vec4, PLANE_COUNT> planes{};
+};
+
+}  // namespace lve
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lve_model.hpp"
+#include "lve_transform.hpp"
 
 // libs
 #include <glm/gtc/matrix_transform.hpp>
@@ -11,19 +12,6 @@
 
 namespace lve {
 
-struct TransformComponent {
-  glm::vec3 translation{};
-  glm::vec3 scale{1.f, 1.f, 1.f};
-  glm::vec3 rotation{};
-
-  // Matrix corrsponds to Translate * Ry * Rx * Rz * Scale
-  // Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
-  // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
-  glm::mat4 mat4();
-
-  glm::mat3 normalMatrix();
-};
-
 struct PointLightComponent {
   float lightIntensity = 1.0f;
 };
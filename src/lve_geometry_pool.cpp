@@ -0,0 +1,91 @@
+#include "lve_geometry_pool.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+LveGeometryPool::LveGeometryPool(LveDevice &device, uint32_t vertexStride)
+    : lveDevice{device}, vertexStride{vertexStride} {}
+
+LveGeometryAllocation LveGeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount) {
+  LveGeometryAllocation allocation{};
+  for (auto &chunk : chunks) {
+    if (tryAllocate(*chunk, vertexCount, indexCount, allocation)) {
+      allocation.chunk = static_cast<uint32_t>(&chunk - chunks.data());
+      return allocation;
+    }
+  }
+
+  // meshes bigger than a regular chunk get a chunk sized exactly for them
+  createChunk(
+      std::max(vertexCount, VERTICES_PER_CHUNK),
+      std::max(indexCount, INDICES_PER_CHUNK));
+  if (!tryAllocate(*chunks.back(), vertexCount, indexCount, allocation)) {
+    throw std::runtime_error("failed to allocate geometry from a fresh chunk!");
+  }
+  allocation.chunk = static_cast<uint32_t>(chunks.size() - 1);
+  return allocation;
+}
+
+bool LveGeometryPool::tryAllocate(
+    Chunk &chunk, uint32_t vertexCount, uint32_t indexCount, LveGeometryAllocation &out) {
+  VkDeviceSize firstVertex = chunk.vertexRanges.allocate(vertexCount);
+  if (firstVertex == LveRangeAllocator::INVALID_OFFSET) {
+    return false;
+  }
+
+  VkDeviceSize firstIndex = 0;
+  if (indexCount > 0) {
+    firstIndex = chunk.indexRanges.allocate(indexCount);
+    if (firstIndex == LveRangeAllocator::INVALID_OFFSET) {
+      chunk.vertexRanges.free(firstVertex, vertexCount);
+      return false;
+    }
+  }
+
+  out.firstVertex = static_cast<uint32_t>(firstVertex);
+  out.vertexCount = vertexCount;
+  out.firstIndex = static_cast<uint32_t>(firstIndex);
+  out.indexCount = indexCount;
+  return true;
+}
+
+void LveGeometryPool::free(const LveGeometryAllocation &allocation) {
+  assert(allocation.chunk < chunks.size() && "Geometry allocation from another pool");
+  Chunk &chunk = *chunks[allocation.chunk];
+  if (allocation.vertexCount > 0) {
+    chunk.vertexRanges.free(allocation.firstVertex, allocation.vertexCount);
+  }
+  if (allocation.indexCount > 0) {
+    chunk.indexRanges.free(allocation.firstIndex, allocation.indexCount);
+  }
+}
+
+void LveGeometryPool::createChunk(uint32_t vertexCapacity, uint32_t indexCapacity) {
+  auto chunk = std::make_unique<Chunk>(vertexCapacity, indexCapacity);
+  chunk->vertices = std::make_unique<LveBuffer>(
+      lveDevice,
+      vertexStride,
+      vertexCapacity,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  chunk->indices = std::make_unique<LveBuffer>(
+      lveDevice,
+      sizeof(uint32_t),
+      indexCapacity,
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  chunks.push_back(std::move(chunk));
+}
+
+void LveGeometryPool::bind(VkCommandBuffer commandBuffer, uint32_t chunk) {
+  VkBuffer buffers[] = {getVertexBuffer(chunk)};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, getIndexBuffer(chunk), 0, VK_INDEX_TYPE_UINT32);
+}
+
+}  // namespace lve
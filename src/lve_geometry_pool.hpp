@@ -0,0 +1,66 @@
+#pragma once
+
+#include "lve_allocator.hpp"
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// A mesh's range within an LveGeometryPool. Offsets are in vertices / indices, so they can be
+// passed to vkCmdDrawIndexed as vertexOffset / firstIndex unchanged.
+struct LveGeometryAllocation {
+  uint32_t chunk = 0;
+  uint32_t firstVertex = 0;
+  uint32_t vertexCount = 0;
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+};
+
+// Large shared device local vertex and index buffers that meshes are sub-allocated from, so a
+// whole scene can be drawn with one vertex / index buffer bind per chunk.
+class LveGeometryPool {
+ public:
+  static constexpr uint32_t VERTICES_PER_CHUNK = 1 << 20;
+  static constexpr uint32_t INDICES_PER_CHUNK = 1 << 22;
+
+  LveGeometryPool(LveDevice &device, uint32_t vertexStride);
+
+  LveGeometryPool(const LveGeometryPool &) = delete;
+  LveGeometryPool &operator=(const LveGeometryPool &) = delete;
+
+  LveGeometryAllocation allocate(uint32_t vertexCount, uint32_t indexCount);
+  void free(const LveGeometryAllocation &allocation);
+
+  void bind(VkCommandBuffer commandBuffer, uint32_t chunk);
+
+  uint32_t getVertexStride() const { return vertexStride; }
+  uint32_t getChunkCount() const { return static_cast<uint32_t>(chunks.size()); }
+  VkBuffer getVertexBuffer(uint32_t chunk) const { return chunks[chunk]->vertices->getBuffer(); }
+  VkBuffer getIndexBuffer(uint32_t chunk) const { return chunks[chunk]->indices->getBuffer(); }
+
+ private:
+  struct Chunk {
+    std::unique_ptr<LveBuffer> vertices;
+    std::unique_ptr<LveBuffer> indices;
+    LveRangeAllocator vertexRanges;
+    LveRangeAllocator indexRanges;
+
+    Chunk(uint32_t vertexCapacity, uint32_t indexCapacity)
+        : vertexRanges{vertexCapacity}, indexRanges{indexCapacity} {}
+  };
+
+  bool tryAllocate(
+      Chunk &chunk, uint32_t vertexCount, uint32_t indexCount, LveGeometryAllocation &out);
+  void createChunk(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+  LveDevice &lveDevice;
+  uint32_t vertexStride;
+  std::vector<std::unique_ptr<Chunk>> chunks;
+};
+
+}  // namespace lve
@@ -0,0 +1,354 @@
+#include "lve_gpu_profiler.hpp"
+
+#include "lve_frame_info.hpp"
+#include "lve_parallel_recorder.hpp"
+#include "lve_swap_chain.hpp"
+
+// std
+#include <cassert>
+#include <iomanip>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+
+void writeJsonString(std::ostream &out, const std::string &value) {
+  out << '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << ' ';
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+}  // namespace
+
+LveGpuProfiler::Scope::Scope(
+    LveGpuProfiler *profiler,
+    VkCommandBuffer commandBuffer,
+    const std::string &name,
+    bool statistics) {
+  begin(profiler, commandBuffer, name, statistics);
+}
+
+LveGpuProfiler::Scope::Scope(const FrameInfo &frameInfo, const std::string &name) {
+  if (frameInfo.recorder == nullptr) {
+    begin(frameInfo.profiler, frameInfo.commandBuffer, name, true);
+    return;
+  }
+  if (frameInfo.profiler == nullptr) {
+    return;
+  }
+
+  // timestamps may be written inside a render pass, but labels and statistics can't span
+  // secondary buffers
+  profiler = frameInfo.profiler;
+  recorder = frameInfo.recorder;
+  index = profiler->openScope(name, false);
+  if (index != INVALID_SCOPE) {
+    recorder->record([this](VkCommandBuffer secondary) {
+      profiler->writeTimestamp(secondary, index, false);
+    });
+  }
+}
+
+void LveGpuProfiler::Scope::begin(
+    LveGpuProfiler *profiler,
+    VkCommandBuffer commandBuffer,
+    const std::string &name,
+    bool statistics) {
+  if (profiler == nullptr) {
+    return;
+  }
+  this->profiler = profiler;
+  this->commandBuffer = commandBuffer;
+
+  LveDevice &device = profiler->lveDevice;
+  if (device.cmdBeginDebugUtilsLabel != nullptr) {
+    VkDebugUtilsLabelEXT labelInfo{};
+    labelInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    labelInfo.pLabelName = name.c_str();
+    device.cmdBeginDebugUtilsLabel(commandBuffer, &labelInfo);
+    label = true;
+  }
+
+  index = profiler->openScope(name, statistics);
+  if (index == INVALID_SCOPE) {
+    return;
+  }
+  profiler->writeTimestamp(commandBuffer, index, false);
+  const FrameSlot &slot = profiler->slots[profiler->currentSlot];
+  this->statistics = slot.scopes[index].statisticsQuery != INVALID_SCOPE;
+  if (this->statistics) {
+    profiler->beginStatistics(commandBuffer, index);
+  }
+}
+
+LveGpuProfiler::Scope::~Scope() {
+  if (profiler == nullptr) {
+    return;
+  }
+  if (index != INVALID_SCOPE) {
+    if (recorder != nullptr) {
+      recorder->record([this](VkCommandBuffer secondary) {
+        profiler->writeTimestamp(secondary, index, true);
+      });
+    } else {
+      if (statistics) {
+        profiler->endStatistics(commandBuffer, index);
+      }
+      profiler->writeTimestamp(commandBuffer, index, true);
+    }
+    profiler->closeScope(index);
+  }
+  if (label) {
+    profiler->lveDevice.cmdEndDebugUtilsLabel(commandBuffer);
+  }
+}
+
+LveGpuProfiler::LveGpuProfiler(LveDevice &device) : lveDevice{device} {
+  slots.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  uint32_t validBits = lveDevice.timestampValidBits();
+  if (validBits == 0) {
+    return;
+  }
+  timestampMask = validBits >= 64 ? ~uint64_t{0} : (uint64_t{1} << validBits) - 1;
+  nanosecondsPerTick = lveDevice.properties.limits.timestampPeriod;
+
+  VkQueryPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = static_cast<uint32_t>(slots.size()) * TIMESTAMPS_PER_FRAME;
+  if (vkCreateQueryPool(lveDevice.device(), &poolInfo, nullptr, &timestampPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create timestamp query pool!");
+  }
+
+  if (!lveDevice.enabledFeatures().pipelineStatisticsQuery) {
+    return;
+  }
+  poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+  poolInfo.queryCount = static_cast<uint32_t>(slots.size()) * MAX_SCOPES;
+  poolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+                                VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+  if (vkCreateQueryPool(lveDevice.device(), &poolInfo, nullptr, &statisticsPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline statistics query pool!");
+  }
+}
+
+LveGpuProfiler::~LveGpuProfiler() {
+  if (statisticsPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(lveDevice.device(), statisticsPool, nullptr);
+  }
+  if (timestampPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(lveDevice.device(), timestampPool, nullptr);
+  }
+}
+
+void LveGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex) {
+  recording = false;
+  if (!isSupported()) {
+    return;
+  }
+  currentSlot = static_cast<uint32_t>(frameIndex);
+  FrameSlot &slot = slots[currentSlot];
+  if (slot.pending) {
+    readBack(slot, currentSlot);
+  }
+  if (!enabled) {
+    return;
+  }
+
+  vkCmdResetQueryPool(
+      commandBuffer,
+      timestampPool,
+      currentSlot * TIMESTAMPS_PER_FRAME,
+      TIMESTAMPS_PER_FRAME);
+  if (statisticsPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, statisticsPool, currentSlot * MAX_SCOPES, MAX_SCOPES);
+  }
+  slot.frame = frameCount++;
+  slot.scopes.clear();
+  slot.statisticsCount = 0;
+  openDepth = 0;
+  statisticsActive = false;
+  recording = true;
+
+  vkCmdWriteTimestamp(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      timestampPool,
+      currentSlot * TIMESTAMPS_PER_FRAME);
+}
+
+void LveGpuProfiler::endFrame(VkCommandBuffer commandBuffer) {
+  if (!recording) {
+    return;
+  }
+  assert(openDepth == 0 && "Profiler scope still open at the end of the frame");
+  vkCmdWriteTimestamp(
+      commandBuffer,
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      timestampPool,
+      currentSlot * TIMESTAMPS_PER_FRAME + 1);
+  slots[currentSlot].pending = true;
+  recording = false;
+}
+
+uint32_t LveGpuProfiler::openScope(const std::string &name, bool statistics) {
+  if (!recording) {
+    return INVALID_SCOPE;
+  }
+  FrameSlot &slot = slots[currentSlot];
+  if (slot.scopes.size() == MAX_SCOPES) {
+    return INVALID_SCOPE;
+  }
+
+  uint32_t statisticsQuery = INVALID_SCOPE;
+  if (statistics && statisticsPool != VK_NULL_HANDLE && !statisticsActive) {
+    statisticsQuery = slot.statisticsCount++;
+    statisticsActive = true;
+  }
+  slot.scopes.push_back({name, openDepth++, statisticsQuery});
+  return static_cast<uint32_t>(slot.scopes.size() - 1);
+}
+
+void LveGpuProfiler::closeScope(uint32_t scope) {
+  assert(openDepth > 0 && "Closing a profiler scope that was never opened");
+  openDepth--;
+  if (slots[currentSlot].scopes[scope].statisticsQuery != INVALID_SCOPE) {
+    statisticsActive = false;
+  }
+}
+
+uint32_t LveGpuProfiler::timestampQuery(uint32_t scope, bool end) const {
+  return currentSlot * TIMESTAMPS_PER_FRAME + 2 + 2 * scope + (end ? 1 : 0);
+}
+
+void LveGpuProfiler::writeTimestamp(VkCommandBuffer commandBuffer, uint32_t scope, bool end) {
+  vkCmdWriteTimestamp(
+      commandBuffer,
+      end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      timestampPool,
+      timestampQuery(scope, end));
+}
+
+void LveGpuProfiler::beginStatistics(VkCommandBuffer commandBuffer, uint32_t scope) {
+  uint32_t query = slots[currentSlot].scopes[scope].statisticsQuery;
+  vkCmdBeginQuery(commandBuffer, statisticsPool, currentSlot * MAX_SCOPES + query, 0);
+}
+
+void LveGpuProfiler::endStatistics(VkCommandBuffer commandBuffer, uint32_t scope) {
+  uint32_t query = slots[currentSlot].scopes[scope].statisticsQuery;
+  vkCmdEndQuery(commandBuffer, statisticsPool, currentSlot * MAX_SCOPES + query);
+}
+
+void LveGpuProfiler::readBack(FrameSlot &slot, uint32_t slotIndex) {
+  slot.pending = false;
+
+  // the slot's submission completed, so every query it wrote is available without waiting
+  uint32_t timestampCount = 2 + 2 * static_cast<uint32_t>(slot.scopes.size());
+  timestampScratch.resize(timestampCount);
+  if (vkGetQueryPoolResults(
+          lveDevice.device(),
+          timestampPool,
+          slotIndex * TIMESTAMPS_PER_FRAME,
+          timestampCount,
+          timestampScratch.size() * sizeof(uint64_t),
+          timestampScratch.data(),
+          sizeof(uint64_t),
+          VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+    return;
+  }
+
+  bool hasStatistics = slot.statisticsCount > 0;
+  if (hasStatistics) {
+    statisticsScratch.resize(slot.statisticsCount * STATISTICS_PER_QUERY);
+    hasStatistics = vkGetQueryPoolResults(
+                        lveDevice.device(),
+                        statisticsPool,
+                        slotIndex * MAX_SCOPES,
+                        slot.statisticsCount,
+                        statisticsScratch.size() * sizeof(uint64_t),
+                        statisticsScratch.data(),
+                        STATISTICS_PER_QUERY * sizeof(uint64_t),
+                        VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+  }
+
+  // differences of masked ticks, so a counter wrapping within the frame still comes out right
+  auto elapsedMs = [this](uint64_t from, uint64_t to) {
+    return static_cast<double>((to - from) & timestampMask) * nanosecondsPerTick * 1e-6;
+  };
+  uint64_t frameBegin = timestampScratch[0];
+  FrameResult result{};
+  result.frame = slot.frame;
+  result.beginMs = static_cast<double>(frameBegin & timestampMask) * nanosecondsPerTick * 1e-6;
+  result.durationMs = elapsedMs(frameBegin, timestampScratch[1]);
+  result.scopes.reserve(slot.scopes.size());
+  for (size_t i = 0; i < slot.scopes.size(); i++) {
+    const PendingScope &pending = slot.scopes[i];
+    ScopeResult scope{};
+    scope.name = pending.name;
+    scope.depth = pending.depth;
+    scope.beginMs = elapsedMs(frameBegin, timestampScratch[2 + 2 * i]);
+    scope.durationMs = elapsedMs(timestampScratch[2 + 2 * i], timestampScratch[3 + 2 * i]);
+    if (hasStatistics && pending.statisticsQuery != INVALID_SCOPE) {
+      const uint64_t *values = &statisticsScratch[pending.statisticsQuery * STATISTICS_PER_QUERY];
+      scope.hasStatistics = true;
+      scope.vertexInvocations = values[0];
+      scope.fragmentInvocations = values[1];
+      scope.computeInvocations = values[2];
+    }
+    result.scopes.push_back(std::move(scope));
+  }
+
+  history.push_back(std::move(result));
+  if (history.size() > HISTORY_FRAMES) {
+    history.pop_front();
+  }
+}
+
+void LveGpuProfiler::writeChromeTrace(std::ostream &out) const {
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3);
+
+  // complete events in microseconds, nested by their times. GPU timestamps start anywhere, so
+  // they are made relative to the oldest frame.
+  double originMs = history.empty() ? 0. : history.front().beginMs;
+  bool first = true;
+  auto beginEvent = [&](const std::string &name, double beginMs, double durationMs) {
+    out << (first ? "\n" : ",\n") << R"({"name":)";
+    writeJsonString(out, name);
+    out << R"(,"ph":"X","pid":0,"tid":0,"ts":)" << (beginMs - originMs) * 1000.
+        << R"(,"dur":)" << durationMs * 1000.;
+    first = false;
+  };
+
+  out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+  for (const FrameResult &frame : history) {
+    beginEvent("frame " + std::to_string(frame.frame), frame.beginMs, frame.durationMs);
+    out << "}";
+    for (const ScopeResult &scope : frame.scopes) {
+      beginEvent(scope.name, frame.beginMs + scope.beginMs, scope.durationMs);
+      if (scope.hasStatistics) {
+        out << R"(,"args":{"vertexInvocations":)" << scope.vertexInvocations
+            << R"(,"fragmentInvocations":)" << scope.fragmentInvocations
+            << R"(,"computeInvocations":)" << scope.computeInvocations << "}";
+      }
+      out << "}";
+    }
+  }
+  out << "\n]}\n";
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+}  // namespace lve
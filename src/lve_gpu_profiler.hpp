@@ -0,0 +1,156 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+// std
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+struct FrameInfo;
+class LveParallelRecorder;
+
+// GPU time of every frame and of the scopes recorded into it, from timestamp queries written
+// around them. LveRenderer begins and ends the profiler's frames, systems and render graph passes
+// open Scopes around their work. A frame is read back when its frame slot is reused, the slot's
+// previous submission has completed by then, so results arrive framesInFlight frames late without
+// the CPU ever waiting on a query.
+//
+// Scopes that record into a primary command buffer and are not nested in another such scope also
+// collect pipeline statistics, when the device supports them, and show up as debug utils labels in
+// tools like RenderDoc when validation layers are enabled. Used from the render thread only.
+class LveGpuProfiler {
+ public:
+  static constexpr uint32_t MAX_SCOPES = 64;  // per frame, later scopes are not timed
+  static constexpr uint32_t HISTORY_FRAMES = 240;
+  static constexpr uint32_t INVALID_SCOPE = ~0u;
+
+  struct ScopeResult {
+    std::string name;
+    uint32_t depth;  // number of scopes it is nested in
+    double beginMs;  // from the start of the frame
+    double durationMs;
+    bool hasStatistics;
+    uint64_t vertexInvocations;
+    uint64_t fragmentInvocations;
+    uint64_t computeInvocations;
+  };
+
+  struct FrameResult {
+    uint64_t frame;  // frames the profiler began before this one
+    double beginMs;  // on the GPU's clock, only meaningful relative to other frames
+    double durationMs;
+    std::vector<ScopeResult> scopes;  // in the order they were opened
+  };
+
+  // Times the commands recorded during its lifetime, does nothing when profiler is nullptr
+  class Scope {
+   public:
+    Scope(
+        LveGpuProfiler *profiler,
+        VkCommandBuffer commandBuffer,
+        const std::string &name,
+        bool statistics = true);
+    // Around a render system's work: its commands go into frameInfo.recorder's secondary buffers
+    // when it is set, the scope then records its timestamps into secondary buffers of its own
+    Scope(const FrameInfo &frameInfo, const std::string &name);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+   private:
+    void begin(
+        LveGpuProfiler *profiler,
+        VkCommandBuffer commandBuffer,
+        const std::string &name,
+        bool statistics);
+
+    LveGpuProfiler *profiler = nullptr;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    LveParallelRecorder *recorder = nullptr;
+    uint32_t index = INVALID_SCOPE;
+    bool statistics = false;
+    bool label = false;
+  };
+
+  explicit LveGpuProfiler(LveDevice &device);
+  // The device must be idle
+  ~LveGpuProfiler();
+
+  LveGpuProfiler(const LveGpuProfiler &) = delete;
+  LveGpuProfiler &operator=(const LveGpuProfiler &) = delete;
+
+  // False when the graphics queue cannot write timestamps
+  bool isSupported() const { return timestampPool != VK_NULL_HANDLE; }
+  bool supportsStatistics() const { return statisticsPool != VK_NULL_HANDLE; }
+  // Takes effect with the next frame
+  void setEnabled(bool enabled) { this->enabled = enabled; }
+  bool isEnabled() const { return enabled; }
+
+  // Call right after commandBuffer was begun, once frameIndex's previous submission completed.
+  // Reads that submission's results back and resets its queries.
+  void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+  // Call right before commandBuffer is ended
+  void endFrame(VkCommandBuffer commandBuffer);
+
+  // Oldest first, at most HISTORY_FRAMES
+  const std::deque<FrameResult> &getHistory() const { return history; }
+  // Every frame in the history as complete events of the Chrome trace event format, for
+  // chrome://tracing or https://ui.perfetto.dev
+  void writeChromeTrace(std::ostream &out) const;
+
+ private:
+  struct PendingScope {
+    std::string name;
+    uint32_t depth;
+    uint32_t statisticsQuery;  // INVALID_SCOPE without statistics
+  };
+
+  // queries of one frame slot
+  struct FrameSlot {
+    uint64_t frame = 0;
+    bool pending = false;
+    std::vector<PendingScope> scopes;
+    uint32_t statisticsCount = 0;
+  };
+
+  // frame begin and end, then begin and end of every scope
+  static constexpr uint32_t TIMESTAMPS_PER_FRAME = 2 + 2 * MAX_SCOPES;
+  // vertex, fragment and compute shader invocations
+  static constexpr uint32_t STATISTICS_PER_QUERY = 3;
+
+  uint32_t openScope(const std::string &name, bool statistics);
+  void closeScope(uint32_t scope);
+  void writeTimestamp(VkCommandBuffer commandBuffer, uint32_t scope, bool end);
+  void beginStatistics(VkCommandBuffer commandBuffer, uint32_t scope);
+  void endStatistics(VkCommandBuffer commandBuffer, uint32_t scope);
+  uint32_t timestampQuery(uint32_t scope, bool end) const;
+  void readBack(FrameSlot &slot, uint32_t slotIndex);
+
+  LveDevice &lveDevice;
+  VkQueryPool timestampPool = VK_NULL_HANDLE;
+  VkQueryPool statisticsPool = VK_NULL_HANDLE;
+  double nanosecondsPerTick = 1.;
+  uint64_t timestampMask = 0;
+
+  bool enabled = true;
+  // whether the frame being recorded is profiled
+  bool recording = false;
+  uint32_t currentSlot = 0;
+  uint32_t openDepth = 0;
+  // pipeline statistics queries can't nest
+  bool statisticsActive = false;
+  uint64_t frameCount = 0;
+  std::vector<FrameSlot> slots;
+  std::deque<FrameResult> history;
+
+  std::vector<uint64_t> timestampScratch;
+  std::vector<uint64_t> statisticsScratch;
+};
+
+}  // namespace lve
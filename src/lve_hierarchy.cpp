@@ -0,0 +1,207 @@
+#include "lve_hierarchy.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <thread>
+
+namespace lve {
+
+uint32_t LveHierarchy::findNode(LveEntity entity) const {
+  if (!entity.isValid() || entity.index >= nodeOf.size()) {
+    return INVALID_NODE;
+  }
+  uint32_t node = nodeOf[entity.index];
+  return node != INVALID_NODE && nodes[node].entity == entity ? node : INVALID_NODE;
+}
+
+LveEntity LveHierarchy::getParent(LveEntity entity) const {
+  uint32_t node = findNode(entity);
+  return node != INVALID_NODE ? nodes[node].parent : LveEntity{};
+}
+
+uint32_t LveHierarchy::getChildCount(LveEntity entity) const {
+  uint32_t node = findNode(entity);
+  if (node == INVALID_NODE) {
+    return 0;
+  }
+  uint32_t count = 0;
+  uint32_t end = node + nodes[node].subtreeSize;
+  for (uint32_t child = node + 1; child < end; child += nodes[child].subtreeSize) {
+    count++;
+  }
+  return count;
+}
+
+uint32_t LveHierarchy::addRoot(LveEntity entity) {
+  assert(transforms.has(entity) && "Hierarchy nodes need a transform");
+  transforms.get(entity).inHierarchy = true;
+
+  Node node{};
+  node.entity = entity;
+  nodes.push_back(node);
+  reindex();
+  return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void LveHierarchy::setParent(LveEntity child, LveEntity parent) {
+  assert(child != parent && "An entity cannot be its own parent");
+  uint32_t childNode = findNode(child);
+  if (getParent(child) == parent) {
+    return;
+  }
+
+  uint32_t parentNode = findNode(parent);
+  if (childNode != INVALID_NODE && parentNode != INVALID_NODE && parentNode > childNode &&
+      parentNode < childNode + nodes[childNode].subtreeSize) {
+    assert(false && "Cannot parent an entity to one of its own descendants");
+    return;
+  }
+
+  if (childNode == INVALID_NODE) {
+    childNode = addRoot(child);
+  }
+  if (parent.isValid() && parentNode == INVALID_NODE) {
+    addRoot(parent);
+  }
+
+  // cut the child's subtree out of its old place
+  uint32_t size = nodes[childNode].subtreeSize;
+  for (uint32_t a = nodes[childNode].parentNode; a != INVALID_NODE; a = nodes[a].parentNode) {
+    nodes[a].subtreeSize -= size;
+  }
+  std::vector<Node> subtree{nodes.begin() + childNode, nodes.begin() + childNode + size};
+  nodes.erase(nodes.begin() + childNode, nodes.begin() + childNode + size);
+  subtree.front().parent = parent;
+  subtree.front().moved = true;
+  reindex();
+
+  // and append it to the end of the new parent's subtree, or as a new root
+  size_t insertAt = nodes.size();
+  if (parent.isValid()) {
+    parentNode = findNode(parent);
+    insertAt = parentNode + nodes[parentNode].subtreeSize;
+    for (uint32_t a = parentNode; a != INVALID_NODE; a = nodes[a].parentNode) {
+      nodes[a].subtreeSize += size;
+    }
+  }
+  nodes.insert(nodes.begin() + insertAt, subtree.begin(), subtree.end());
+  reindex();
+  pruneTrivialRoots();
+}
+
+void LveHierarchy::remove(LveEntity entity) {
+  uint32_t node = findNode(entity);
+  while (node != INVALID_NODE && nodes[node].subtreeSize > 1) {
+    setParent(nodes[node + 1].entity, LveEntity{});
+    node = findNode(entity);
+  }
+  if (node != INVALID_NODE) {
+    setParent(entity, LveEntity{});
+  }
+}
+
+void LveHierarchy::pruneTrivialRoots() {
+  auto trivial = [](const Node &node) {
+    return !node.parent.isValid() && node.subtreeSize == 1;
+  };
+  if (std::none_of(nodes.begin(), nodes.end(), trivial)) {
+    return;
+  }
+  for (const Node &node : nodes) {
+    if (trivial(node)) {
+      if (TransformComponent *transform = transforms.tryGet(node.entity)) {
+        transform->inHierarchy = false;
+      }
+    }
+  }
+  nodes.erase(std::remove_if(nodes.begin(), nodes.end(), trivial), nodes.end());
+  reindex();
+}
+
+void LveHierarchy::reindex() {
+  std::fill(nodeOf.begin(), nodeOf.end(), INVALID_NODE);
+  roots.clear();
+  for (uint32_t i = 0; i < nodes.size(); i++) {
+    if (nodes[i].entity.index >= nodeOf.size()) {
+      nodeOf.resize(nodes[i].entity.index + 1, INVALID_NODE);
+    }
+    nodeOf[nodes[i].entity.index] = i;
+  }
+  for (uint32_t i = 0; i < nodes.size(); i++) {
+    nodes[i].parentNode = findNode(nodes[i].parent);
+    if (nodes[i].parentNode == INVALID_NODE) {
+      roots.push_back(i);
+    }
+  }
+  changed.resize(nodes.size());
+}
+
+void LveHierarchy::propagateRange(uint32_t begin, uint32_t end) {
+  for (uint32_t i = begin; i < end; i++) {
+    Node &node = nodes[i];
+    TransformComponent &transform = transforms.get(node.entity);
+    bool parentChanged = node.parentNode != INVALID_NODE && changed[node.parentNode];
+    changed[i] = node.moved || transform.moved || parentChanged;
+    if (!changed[i]) {
+      continue;
+    }
+    node.moved = false;
+    transform.moved = false;
+
+    if (node.parentNode == INVALID_NODE) {
+      transform.world = transform.mat4();
+      transform.worldNormal = transform.normalMatrix();
+    } else {
+      const TransformComponent &parentTransform = transforms.get(nodes[node.parentNode].entity);
+      transform.world = parentTransform.world * transform.mat4();
+      transform.worldNormal = parentTransform.worldNormal * transform.normalMatrix();
+    }
+  }
+}
+
+void LveHierarchy::propagate(LveThreadPool *threadPool) {
+  uint32_t nodeCount = static_cast<uint32_t>(nodes.size());
+  if (threadPool == nullptr || nodeCount < PARALLEL_NODE_THRESHOLD || roots.size() < 2) {
+    propagateRange(0, nodeCount);
+    return;
+  }
+
+  // consecutive root subtrees are grouped into ranges of roughly equal node count, claimed by
+  // the workers and the calling thread alike. Jobs still queued behind other work once every
+  // range is taken find nothing left and return, so the frame never waits on them.
+  struct Work {
+    std::vector<uint32_t> rangeStarts;
+    std::atomic<uint32_t> next{0};
+    std::atomic<uint32_t> done{0};
+  };
+  auto work = std::make_shared<Work>();
+  uint32_t workerCount = threadPool->getThreadCount() + 1;
+  uint32_t nodesPerRange = std::max(1u, nodeCount / (workerCount * 4));
+  for (uint32_t root : roots) {
+    if (work->rangeStarts.empty() || root - work->rangeStarts.back() >= nodesPerRange) {
+      work->rangeStarts.push_back(root);
+    }
+  }
+  work->rangeStarts.push_back(nodeCount);
+  uint32_t rangeCount = static_cast<uint32_t>(work->rangeStarts.size() - 1);
+
+  auto process = [this, work, rangeCount]() {
+    uint32_t range;
+    while ((range = work->next.fetch_add(1)) < rangeCount) {
+      propagateRange(work->rangeStarts[range], work->rangeStarts[range + 1]);
+      work->done.fetch_add(1, std::memory_order_release);
+    }
+  };
+  for (uint32_t i = 1; i < std::min(workerCount, rangeCount); i++) {
+    threadPool->submit(process);
+  }
+  process();
+  while (work->done.load(std::memory_order_acquire) < rangeCount) {
+    std::this_thread::yield();
+  }
+}
+
+}  // namespace lve
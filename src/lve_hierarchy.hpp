@@ -0,0 +1,71 @@
+#pragma once
+
+#include "lve_component_pool.hpp"
+#include "lve_thread_pool.hpp"
+#include "lve_transform.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// Parent / child relations between entities with a TransformComponent. Nodes are kept in pre
+// order, so every parent precedes its children and each subtree is one contiguous range: world
+// matrices propagate in a single linear pass, and separate root subtrees can be processed by
+// different threads. Only nodes whose local transform or some ancestor changed are recomputed.
+// Entities without parent and children are not stored at all. Reparenting moves the subtree
+// inside the node array and is linear in the node count, structural changes are expected to be
+// rare compared to transform changes.
+class LveHierarchy {
+ public:
+  explicit LveHierarchy(LveComponentPool<TransformComponent> &transforms)
+      : transforms{transforms} {}
+
+  LveHierarchy(const LveHierarchy &) = delete;
+  LveHierarchy &operator=(const LveHierarchy &) = delete;
+
+  // Attaches child and its subtree below parent, the child's transform becomes relative to it.
+  // An invalid parent detaches the child back to world space.
+  void setParent(LveEntity child, LveEntity parent);
+  LveEntity getParent(LveEntity entity) const;
+  uint32_t getChildCount(LveEntity entity) const;
+  bool contains(LveEntity entity) const { return findNode(entity) != INVALID_NODE; }
+  size_t size() const { return nodes.size(); }
+
+  // Detaches the entity from its parent and turns its children into roots
+  void remove(LveEntity entity);
+
+  // Recomputes the world matrices of changed subtrees, splitting root subtrees across the
+  // thread pool when there are enough nodes to be worth it
+  void propagate(LveThreadPool *threadPool = nullptr);
+
+ private:
+  static constexpr uint32_t INVALID_NODE = ~0u;
+  static constexpr size_t PARALLEL_NODE_THRESHOLD = 4096;
+
+  struct Node {
+    LveEntity entity;
+    LveEntity parent;
+    uint32_t parentNode = INVALID_NODE;
+    // this node plus all of its descendants
+    uint32_t subtreeSize = 1;
+    // reparented since the last propagation
+    bool moved = true;
+  };
+
+  uint32_t findNode(LveEntity entity) const;
+  uint32_t addRoot(LveEntity entity);
+  void pruneTrivialRoots();
+  // rebuilds nodeOf, parentNode and roots after nodes were moved around
+  void reindex();
+  void propagateRange(uint32_t begin, uint32_t end);
+
+  LveComponentPool<TransformComponent> &transforms;
+  std::vector<Node> nodes;
+  std::vector<uint32_t> nodeOf;  // node index by entity index
+  std::vector<uint32_t> roots;
+  std::vector<uint8_t> changed;  // node world matrix changed during the current propagation
+};
+
+}  // namespace lve
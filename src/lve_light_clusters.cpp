@@ -0,0 +1,183 @@
+#include "lve_light_clusters.hpp"
+
+#include "lve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace lve {
+
+static_assert(sizeof(PointLight) == 48, "PointLight must match the shaders' std430 array stride");
+
+namespace {
+
+// Smallest and largest value / z over z in [z0, z1], z0 > 0
+float minOverDepth(float value, float z0, float z1) { return value / (value < 0.f ? z0 : z1); }
+float maxOverDepth(float value, float z0, float z1) { return value / (value > 0.f ? z0 : z1); }
+
+// Range of tiles covered by [minNdc, maxNdc], false when it lies off screen
+bool tileRange(float minNdc, float maxNdc, uint32_t tileCount, uint32_t &first, uint32_t &last) {
+  if (maxNdc < -1.f || minNdc > 1.f) {
+    return false;
+  }
+  auto tileOf = [tileCount](float ndc) {
+    float tile = (std::clamp(ndc, -1.f, 1.f) * .5f + .5f) * static_cast<float>(tileCount);
+    return std::min(static_cast<uint32_t>(tile), tileCount - 1);
+  };
+  first = tileOf(minNdc);
+  last = tileOf(maxNdc);
+  return true;
+}
+
+}  // namespace
+
+LveLightClusters::LveLightClusters(LveDevice &device) : lveDevice{device} {
+  frames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (auto &frame : frames) {
+    frame.lights = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(PointLight),
+        MAX_LIGHTS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    frame.clusters = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(glm::uvec2),
+        CLUSTER_COUNT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    frame.lightIndices = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(uint32_t),
+        MAX_LIGHT_INDICES,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    frame.lights->map();
+    frame.clusters->map();
+    frame.lightIndices->map();
+  }
+  lights.reserve(MAX_LIGHTS);
+  clusterCounts.resize(CLUSTER_COUNT);
+  clusterCursors.resize(CLUSTER_COUNT);
+}
+
+void LveLightClusters::addLight(const PointLight &light) {
+  if (lights.size() >= MAX_LIGHTS) {
+    droppedLights++;
+    return;
+  }
+  lights.push_back(light);
+}
+
+uint32_t LveLightClusters::sliceOf(float viewDepth) const {
+  float slice = std::floor(std::log(viewDepth) * sliceScale + sliceBias);
+  return static_cast<uint32_t>(std::clamp(slice, 0.f, static_cast<float>(CLUSTER_Z - 1)));
+}
+
+void LveLightClusters::binLight(
+    uint32_t lightIndex, const glm::mat4 &projection, const glm::vec3 &center, float range) {
+  float zMin = std::max(center.z - range, nearPlane);
+  float zMax = std::min(center.z + range, farPlane);
+  if (zMin > zMax) {
+    return;
+  }
+
+  uint32_t lastSlice = sliceOf(zMax);
+  for (uint32_t slice = sliceOf(zMin); slice <= lastSlice; slice++) {
+    // part of the sphere's depth range inside this slice
+    float z0 = std::max(zMin, std::exp((static_cast<float>(slice) - sliceBias) / sliceScale));
+    float z1 = std::min(zMax, std::exp((static_cast<float>(slice + 1) - sliceBias) / sliceScale));
+    z1 = std::max(z0, z1);
+
+    // the sphere's bounding box within [z0, z1] projected, which covers the sphere
+    uint32_t firstX, lastX, firstY, lastY;
+    if (!tileRange(
+            projection[0][0] * minOverDepth(center.x - range, z0, z1),
+            projection[0][0] * maxOverDepth(center.x + range, z0, z1),
+            CLUSTER_X,
+            firstX,
+            lastX) ||
+        !tileRange(
+            projection[1][1] * minOverDepth(center.y - range, z0, z1),
+            projection[1][1] * maxOverDepth(center.y + range, z0, z1),
+            CLUSTER_Y,
+            firstY,
+            lastY)) {
+      continue;
+    }
+
+    for (uint32_t y = firstY; y <= lastY; y++) {
+      for (uint32_t x = firstX; x <= lastX; x++) {
+        assignments.push_back({(slice * CLUSTER_Y + y) * CLUSTER_X + x, lightIndex});
+      }
+    }
+  }
+}
+
+void LveLightClusters::build(int frameIndex, const LveCamera &camera, GlobalUbo &ubo) {
+  const glm::mat4 &projection = camera.getProjection();
+  assert(projection[2][3] == 1.f && "Light clusters need a perspective projection");
+  nearPlane = -projection[3][2] / projection[2][2];
+  farPlane = projection[3][2] / (1.f - projection[2][2]);
+  float logDepthRange = std::log(farPlane / nearPlane);
+  sliceScale = static_cast<float>(CLUSTER_Z) / logDepthRange;
+  sliceBias = -static_cast<float>(CLUSTER_Z) * std::log(nearPlane) / logDepthRange;
+
+  assignments.clear();
+  const glm::mat4 &view = camera.getView();
+  for (uint32_t i = 0; i < lights.size(); i++) {
+    glm::vec3 center{view * glm::vec4{glm::vec3{lights[i].position}, 1.f}};
+    binLight(i, projection, center, lights[i].position.w);
+  }
+
+  // counting sort by cluster, lights stay in submission order within a cluster
+  std::fill(clusterCounts.begin(), clusterCounts.end(), 0);
+  for (auto &assignment : assignments) {
+    uint32_t &count = clusterCounts[assignment.cluster];
+    count = std::min(count + 1, MAX_LIGHTS_PER_CLUSTER);
+  }
+
+  FrameBuffers &frame = frames[frameIndex];
+  auto *clusterData = static_cast<glm::uvec2 *>(frame.clusters->getMappedMemory());
+  uint32_t offset = 0;
+  for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+    uint32_t count = std::min(clusterCounts[cluster], MAX_LIGHT_INDICES - offset);
+    clusterData[cluster] = {offset, count};
+    clusterCursors[cluster] = offset;
+    clusterCounts[cluster] = offset + count;  // now the cluster's end
+    offset += count;
+  }
+
+  auto *indexData = static_cast<uint32_t *>(frame.lightIndices->getMappedMemory());
+  stats.droppedIndices = 0;
+  for (auto &assignment : assignments) {
+    uint32_t &cursor = clusterCursors[assignment.cluster];
+    if (cursor < clusterCounts[assignment.cluster]) {
+      indexData[cursor++] = assignment.light;
+    } else {
+      stats.droppedIndices++;
+    }
+  }
+
+  // addLight keeps lights within the buffer, the copy is clamped regardless
+  size_t lightCount = std::min<size_t>(lights.size(), MAX_LIGHTS);
+  if (lightCount > 0) {
+    std::memcpy(frame.lights->getMappedMemory(), lights.data(), lightCount * sizeof(PointLight));
+  }
+  frame.lights->flush();
+  frame.clusters->flush();
+  frame.lightIndices->flush();
+
+  ubo.clusterGrid = {CLUSTER_X, CLUSTER_Y, CLUSTER_Z, static_cast<uint32_t>(lightCount)};
+  ubo.clusterDepth = {sliceScale, sliceBias, 0.f, 0.f};
+  stats.lights = static_cast<uint32_t>(lightCount);
+  stats.lightIndices = offset;
+  stats.droppedLights = droppedLights;
+  lights.clear();
+  droppedLights = 0;
+}
+
+}  // namespace lve
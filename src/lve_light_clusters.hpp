@@ -0,0 +1,111 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_camera.hpp"
+#include "lve_device.hpp"
+#include "lve_frame_info.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Clustered forward lighting. The view frustum is split into CLUSTER_X x CLUSTER_Y screen tiles
+// and CLUSTER_Z exponentially spaced depth slices. Every frame the point lights are binned on
+// the CPU into the clusters their range touches, and the fragment shader only loops over the
+// lights of its own cluster, so shading cost follows the local light density rather than the
+// total light count.
+//
+// Per frame in flight there are three host visible storage buffers, bound in the global set:
+//  1: PointLight lights[MAX_LIGHTS], also read by the light billboards' vertex shader
+//  2: uvec2 clusters[CLUSTER_COUNT], offset and count into the index list
+//  3: uint lightIndices[MAX_LIGHT_INDICES]
+class LveLightClusters {
+ public:
+  static constexpr uint32_t CLUSTER_X = 16;
+  static constexpr uint32_t CLUSTER_Y = 9;
+  static constexpr uint32_t CLUSTER_Z = 24;
+  static constexpr uint32_t CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+  // lights queued past this are dropped
+  static constexpr uint32_t MAX_LIGHTS = 1024;
+  // lights past these budgets are left out of the clusters that overflow
+  static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 64;
+  static constexpr uint32_t MAX_LIGHT_INDICES = CLUSTER_COUNT * 32;
+
+  struct Stats {
+    uint32_t lights = 0;
+    uint32_t lightIndices = 0;
+    // light / cluster pairs that did not fit a budget
+    uint32_t droppedIndices = 0;
+    // lights queued beyond MAX_LIGHTS
+    uint32_t droppedLights = 0;
+  };
+
+  explicit LveLightClusters(LveDevice &device);
+
+  LveLightClusters(const LveLightClusters &) = delete;
+  LveLightClusters &operator=(const LveLightClusters &) = delete;
+
+  // Distance at which a light of the given intensity falls below the shading cutoff, the
+  // shaders fade it to zero there
+  static float lightRange(float intensity) { return glm::sqrt(intensity / LIGHT_CUTOFF); }
+
+  // Queues a light for the next build, light.position.w is its range. Ignored once MAX_LIGHTS
+  // are queued.
+  void addLight(const PointLight &light);
+  // Bins the queued lights into the frame's buffers and sets the cluster fields of ubo. The
+  // frame's previous submission must have been waited on. Needs a perspective projection.
+  void build(int frameIndex, const LveCamera &camera, GlobalUbo &ubo);
+
+  VkDescriptorBufferInfo lightsInfo(int frameIndex) {
+    return frames[frameIndex].lights->descriptorInfo();
+  }
+  VkDescriptorBufferInfo clustersInfo(int frameIndex) {
+    return frames[frameIndex].clusters->descriptorInfo();
+  }
+  VkDescriptorBufferInfo lightIndicesInfo(int frameIndex) {
+    return frames[frameIndex].lightIndices->descriptorInfo();
+  }
+
+  const Stats &getStats() const { return stats; }
+
+ private:
+  // irradiance below which a light is not shaded, see lightRange
+  static constexpr float LIGHT_CUTOFF = 1.f / 256.f;
+
+  struct FrameBuffers {
+    std::unique_ptr<LveBuffer> lights;
+    std::unique_ptr<LveBuffer> clusters;
+    std::unique_ptr<LveBuffer> lightIndices;
+  };
+
+  struct Assignment {
+    uint32_t cluster;
+    uint32_t light;
+  };
+
+  // appends the clusters the light's range touches, center in view space
+  void binLight(
+      uint32_t lightIndex, const glm::mat4 &projection, const glm::vec3 &center, float range);
+  uint32_t sliceOf(float viewDepth) const;
+
+  LveDevice &lveDevice;
+  std::vector<FrameBuffers> frames;
+  std::vector<PointLight> lights;
+  uint32_t droppedLights = 0;
+
+  // current build's slice mapping, slice = log(depth) * sliceScale + sliceBias
+  float nearPlane = 0.f;
+  float farPlane = 0.f;
+  float sliceScale = 0.f;
+  float sliceBias = 0.f;
+
+  std::vector<Assignment> assignments;
+  std::vector<uint32_t> clusterCounts;
+  std::vector<uint32_t> clusterCursors;
+  Stats stats;
+};
+
+}  // namespace lve
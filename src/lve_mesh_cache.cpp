@@ -0,0 +1,223 @@
+#include "lve_mesh_cache.hpp"
+
+// std
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lve {
+
+static_assert(sizeof(LveMeshHeader) == 32, "LveMeshHeader layout is part of the file format");
+static_assert(sizeof(LveModel::Lod) == 12, "LveModel::Lod layout is part of the file format");
+
+// *************** Mapped File *********************
+
+std::unique_ptr<LveMappedFile> LveMappedFile::open(const std::string &filepath) {
+  std::unique_ptr<LveMappedFile> file{new LveMappedFile()};
+
+#ifdef _WIN32
+  HANDLE handle = CreateFileA(
+      filepath.c_str(),
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      nullptr,
+      OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+      nullptr);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return nullptr;
+  }
+  file->fileHandle = handle;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+    return nullptr;
+  }
+  file->size_ = static_cast<size_t>(fileSize.QuadPart);
+
+  file->mappingHandle = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (file->mappingHandle == nullptr) {
+    return nullptr;
+  }
+  file->data_ = MapViewOfFile(file->mappingHandle, FILE_MAP_READ, 0, 0, 0);
+  if (file->data_ == nullptr) {
+    return nullptr;
+  }
+#else
+  file->fd = ::open(filepath.c_str(), O_RDONLY);
+  if (file->fd < 0) {
+    return nullptr;
+  }
+
+  struct stat info;
+  if (fstat(file->fd, &info) != 0 || info.st_size == 0) {
+    return nullptr;
+  }
+  file->size_ = static_cast<size_t>(info.st_size);
+
+  void *mapping = mmap(nullptr, file->size_, PROT_READ, MAP_PRIVATE, file->fd, 0);
+  if (mapping == MAP_FAILED) {
+    return nullptr;
+  }
+  file->data_ = mapping;
+#endif
+
+  return file;
+}
+
+LveMappedFile::~LveMappedFile() {
+#ifdef _WIN32
+  if (data_) UnmapViewOfFile(data_);
+  if (mappingHandle) CloseHandle(mappingHandle);
+  if (fileHandle) CloseHandle(fileHandle);
+#else
+  if (data_) munmap(const_cast<void *>(data_), size_);
+  if (fd >= 0) close(fd);
+#endif
+}
+
+// *************** Mesh Cache *********************
+
+constexpr char LveMeshCache::MAGIC[4];
+
+std::string LveMeshCache::getCachePath(const std::string &objPath) {
+  return std::filesystem::path{objPath}.replace_extension(".lvemesh").string();
+}
+
+bool LveMeshCache::isFresh(const std::string &cachePath, const std::string &sourcePath) {
+  std::error_code error;
+  auto cacheTime = std::filesystem::last_write_time(cachePath, error);
+  if (error) {
+    return false;
+  }
+  auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+  // a shipped cache without its source is still usable
+  return error || cacheTime >= sourceTime;
+}
+
+bool LveMeshCache::write(
+    const std::string &cachePath,
+    const LveModel::Vertex *vertices,
+    uint32_t vertexCount,
+    const uint32_t *indices,
+    uint32_t indexCount,
+    const LveModel::Lod *lods,
+    uint32_t lodCount) {
+  LveMeshHeader header{};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.vertexStride = sizeof(LveModel::Vertex);
+  header.vertexCount = vertexCount;
+  header.indexCount = indexCount;
+  header.lodCount = lodCount;
+
+  // write to a temporary first so a crash never leaves a truncated cache behind
+  std::string tempPath = cachePath + ".tmp";
+  {
+    std::ofstream out{tempPath, std::ios::binary | std::ios::trunc};
+    if (!out) {
+      return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(
+        reinterpret_cast<const char *>(vertices),
+        static_cast<std::streamsize>(sizeof(LveModel::Vertex) * vertexCount));
+    out.write(
+        reinterpret_cast<const char *>(indices),
+        static_cast<std::streamsize>(sizeof(uint32_t) * indexCount));
+    out.write(
+        reinterpret_cast<const char *>(lods),
+        static_cast<std::streamsize>(sizeof(LveModel::Lod) * lodCount));
+    if (!out) {
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, cachePath, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<LveMeshCache> LveMeshCache::open(const std::string &cachePath) {
+  auto file = LveMappedFile::open(cachePath);
+  if (!file || file->size() < sizeof(LveMeshHeader)) {
+    return nullptr;
+  }
+
+  auto header = static_cast<const LveMeshHeader *>(file->data());
+  if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION ||
+      header->vertexStride != sizeof(LveModel::Vertex)) {
+    return nullptr;
+  }
+
+  size_t expectedSize = sizeof(LveMeshHeader) +
+                        sizeof(LveModel::Vertex) * static_cast<size_t>(header->vertexCount) +
+                        sizeof(uint32_t) * static_cast<size_t>(header->indexCount) +
+                        sizeof(LveModel::Lod) * static_cast<size_t>(header->lodCount);
+  if (file->size() != expectedSize) {
+    return nullptr;
+  }
+
+  // a corrupt lod table would have draws read past the model's indices
+  auto lods = reinterpret_cast<const LveModel::Lod *>(
+      static_cast<const char *>(file->data()) + expectedSize -
+      sizeof(LveModel::Lod) * header->lodCount);
+  for (uint32_t i = 0; i < header->lodCount; i++) {
+    if (lods[i].firstIndex > header->indexCount ||
+        lods[i].indexCount > header->indexCount - lods[i].firstIndex) {
+      return nullptr;
+    }
+  }
+
+  return std::unique_ptr<LveMeshCache>{new LveMeshCache(std::move(file))};
+}
+
+std::unique_ptr<LveMeshCache> LveMeshCache::loadOrConvert(
+    const std::string &objPath, LveModel::Builder &fallback) {
+  std::string cachePath = getCachePath(objPath);
+  if (isFresh(cachePath, objPath)) {
+    if (auto cache = open(cachePath)) {
+      return cache;
+    }
+  }
+
+  fallback.loadModel(objPath);
+  fallback.optimize();
+  write(
+      cachePath,
+      fallback.vertices.data(),
+      static_cast<uint32_t>(fallback.vertices.size()),
+      fallback.indices.data(),
+      static_cast<uint32_t>(fallback.indices.size()),
+      fallback.lods.data(),
+      static_cast<uint32_t>(fallback.lods.size()));
+  return nullptr;
+}
+
+LveMeshCache::LveMeshCache(std::unique_ptr<LveMappedFile> mappedFile)
+    : file{std::move(mappedFile)} {
+  auto bytes = static_cast<const char *>(file->data());
+  header = reinterpret_cast<const LveMeshHeader *>(bytes);
+  vertices = reinterpret_cast<const LveModel::Vertex *>(bytes + sizeof(LveMeshHeader));
+  indices = reinterpret_cast<const uint32_t *>(
+      bytes + sizeof(LveMeshHeader) + sizeof(LveModel::Vertex) * header->vertexCount);
+  lods = reinterpret_cast<const LveModel::Lod *>(indices + header->indexCount);
+}
+
+}  // namespace lve
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "lve_model.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace lve {
+
+// Read-only memory mapping of a whole file
+class LveMappedFile {
+ public:
+  // Returns nullptr if the file can't be opened or mapped
+  static std::unique_ptr<LveMappedFile> open(const std::string &filepath);
+  ~LveMappedFile();
+
+  LveMappedFile(const LveMappedFile &) = delete;
+  LveMappedFile &operator=(const LveMappedFile &) = delete;
+
+  const void *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  LveMappedFile() = default;
+
+  const void *data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void *fileHandle = nullptr;
+  void *mappingHandle = nullptr;
+#else
+  int fd = -1;
+#endif
+};
+
+// On disk layout of a .lvemesh file: the header, then vertexCount tightly packed vertices, then
+// indexCount uint32_t indices, then lodCount LveModel::Lod ranges of those indices. All fields
+// are little endian.
+struct LveMeshHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t vertexStride;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t lodCount;
+  uint32_t reserved[2];
+};
+
+// A memory mapped .lvemesh file. Vertex and index pointers point straight into the mapping.
+class LveMeshCache {
+ public:
+  static constexpr char MAGIC[4] = {'L', 'V', 'E', 'M'};
+  // 2: optimized triangle and vertex order, lod table
+  static constexpr uint32_t VERSION = 2;
+
+  // models/foo.obj -> models/foo.lvemesh
+  static std::string getCachePath(const std::string &objPath);
+
+  // True if cachePath exists and is at least as new as sourcePath
+  static bool isFresh(const std::string &cachePath, const std::string &sourcePath);
+
+  // Returns false if the file could not be written
+  static bool write(
+      const std::string &cachePath,
+      const LveModel::Vertex *vertices,
+      uint32_t vertexCount,
+      const uint32_t *indices,
+      uint32_t indexCount,
+      const LveModel::Lod *lods,
+      uint32_t lodCount);
+
+  // Returns nullptr if the file is missing, truncated or was written by an incompatible version
+  static std::unique_ptr<LveMeshCache> open(const std::string &cachePath);
+
+  // Maps the up to date cache for objPath. Otherwise parses and optimizes the OBJ into fallback,
+  // writes a cache for next time and returns nullptr.
+  static std::unique_ptr<LveMeshCache> loadOrConvert(
+      const std::string &objPath, LveModel::Builder &fallback);
+
+  const LveModel::Vertex *getVertices() const { return vertices; }
+  uint32_t getVertexCount() const { return header->vertexCount; }
+  const uint32_t *getIndices() const { return indices; }
+  uint32_t getIndexCount() const { return header->indexCount; }
+  const LveModel::Lod *getLods() const { return lods; }
+  uint32_t getLodCount() const { return header->lodCount; }
+
+ private:
+  explicit LveMeshCache(std::unique_ptr<LveMappedFile> file);
+
+  std::unique_ptr<LveMappedFile> file;
+  const LveMeshHeader *header = nullptr;
+  const LveModel::Vertex *vertices = nullptr;
+  const uint32_t *indices = nullptr;
+  const LveModel::Lod *lods = nullptr;
+};
+
+}  // namespace lve
@@ -0,0 +1,596 @@
+#include "lve_mesh_optimizer.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace lve {
+
+namespace {
+
+constexpr uint32_t INVALID = ~0u;
+
+// FIFO post transform cache, a vertex stays cached for CACHE_SIZE misses after its own
+class FifoCache {
+ public:
+  explicit FifoCache(uint32_t vertexCount) : stamps(vertexCount, 0) {}
+
+  // True on a miss
+  bool access(uint32_t vertex) {
+    if (stamps[vertex] != 0 && time - stamps[vertex] < LveMeshOptimizer::CACHE_SIZE) {
+      return false;
+    }
+    stamps[vertex] = ++time;
+    return true;
+  }
+
+  void flush() { time += LveMeshOptimizer::CACHE_SIZE; }
+
+ private:
+  std::vector<uint32_t> stamps;
+  uint32_t time = 0;
+};
+
+// Triangles using each vertex, triangles[offsets[v]] to triangles[offsets[v + 1]]
+void buildAdjacency(
+    const uint32_t *indices,
+    size_t indexCount,
+    uint32_t vertexCount,
+    std::vector<uint32_t> &offsets,
+    std::vector<uint32_t> &triangles) {
+  offsets.assign(vertexCount + 1, 0);
+  for (size_t i = 0; i < indexCount; i++) {
+    offsets[indices[i] + 1]++;
+  }
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    offsets[v + 1] += offsets[v];
+  }
+  triangles.resize(indexCount);
+  std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < indexCount; i++) {
+    triangles[next[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+}
+
+// Area weighted squared distances to a set of planes: p^T A p + 2 b.p + c, over the total weight
+struct Quadric {
+  double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+  double b0 = 0, b1 = 0, b2 = 0;
+  double c = 0;
+  double weight = 0;
+
+  void addPlane(const glm::vec3 &n, float d, float area) {
+    a00 += area * n.x * n.x;
+    a01 += area * n.x * n.y;
+    a02 += area * n.x * n.z;
+    a11 += area * n.y * n.y;
+    a12 += area * n.y * n.z;
+    a22 += area * n.z * n.z;
+    b0 += area * n.x * d;
+    b1 += area * n.y * d;
+    b2 += area * n.z * d;
+    c += area * d * d;
+    weight += area;
+  }
+
+  void add(const Quadric &other) {
+    a00 += other.a00;
+    a01 += other.a01;
+    a02 += other.a02;
+    a11 += other.a11;
+    a12 += other.a12;
+    a22 += other.a22;
+    b0 += other.b0;
+    b1 += other.b1;
+    b2 += other.b2;
+    c += other.c;
+    weight += other.weight;
+  }
+
+  // Weighted sum of squared distances from p
+  double evaluate(const glm::vec3 &p) const {
+    double x = p.x, y = p.y, z = p.z;
+    double result = a00 * x * x + a11 * y * y + a22 * z * z +
+                    2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                    2 * (b0 * x + b1 * y + b2 * z) + c;
+    return std::max(result, 0.0);
+  }
+};
+
+// Half edge collapses of one vertex onto a neighbour, vertices never move so every lod can
+// share the original vertex buffer
+class Simplifier {
+ public:
+  Simplifier(const std::vector<LveModel::Vertex> &vertices, const uint32_t *indices, size_t count)
+      : vertices{vertices},
+        vertexCount{static_cast<uint32_t>(vertices.size())},
+        indices(indices, indices + count) {
+    lockBorders();
+    lockSharedPositions();
+    computeQuadrics();
+  }
+
+  std::vector<uint32_t> run(size_t targetIndexCount, float &error) {
+    double worstCost = 0.0;
+    std::vector<uint8_t> touched(vertexCount);
+
+    while (indices.size() > targetIndexCount) {
+      buildAdjacency(indices.data(), indices.size(), vertexCount, offsets, adjacency);
+      gatherCollapses();
+      if (collapses.empty()) {
+        break;
+      }
+      std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+        return a.cost < b.cost;
+      });
+
+      // cheapest first, at most one collapse per neighbourhood so the checks made while
+      // gathering stay valid
+      size_t removable = (indices.size() - targetIndexCount) / 3;
+      size_t removed = 0;
+      std::fill(touched.begin(), touched.end(), 0);
+      for (const Collapse &collapse : collapses) {
+        if (removed >= removable) {
+          break;
+        }
+        if (touched[collapse.from] || touched[collapse.to]) {
+          continue;
+        }
+        for (uint32_t i = offsets[collapse.from]; i < offsets[collapse.from + 1]; i++) {
+          uint32_t *corners = &indices[3 * adjacency[i]];
+          bool degenerate = false;
+          for (int k = 0; k < 3; k++) {
+            touched[corners[k]] = 1;
+            degenerate = degenerate || corners[k] == collapse.to;
+          }
+          for (int k = 0; k < 3; k++) {
+            if (corners[k] == collapse.from) corners[k] = collapse.to;
+          }
+          if (degenerate) removed++;
+        }
+        quadrics[collapse.to].add(quadrics[collapse.from]);
+        worstCost = std::max(worstCost, collapse.cost);
+      }
+
+      // drop the triangles that collapsed onto an edge
+      size_t kept = 0;
+      for (size_t i = 0; i < indices.size(); i += 3) {
+        uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a == b || b == c || a == c) continue;
+        indices[kept++] = a;
+        indices[kept++] = b;
+        indices[kept++] = c;
+      }
+      indices.resize(kept);
+    }
+
+    error = static_cast<float>(std::sqrt(worstCost));
+    return std::move(indices);
+  }
+
+ private:
+  struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;  // mean squared distance of the merged quadric at the target
+  };
+
+  const glm::vec3 &position(uint32_t vertex) const { return vertices[vertex].position; }
+
+  // Patch borders, including the seams where vertices were split by their attributes, and
+  // edges shared by more than two triangles must keep their exact shape
+  void lockBorders() {
+    locked.assign(vertexCount, 0);
+    std::unordered_map<uint64_t, uint32_t> edges;
+    edges.reserve(indices.size());
+    auto key = [](uint32_t a, uint32_t b) { return (static_cast<uint64_t>(a) << 32) | b; };
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      for (int k = 0; k < 3; k++) {
+        edges[key(indices[i + k], indices[i + (k + 1) % 3])]++;
+      }
+    }
+    for (const auto &edge : edges) {
+      uint32_t a = static_cast<uint32_t>(edge.first >> 32);
+      uint32_t b = static_cast<uint32_t>(edge.first);
+      if (edge.second > 1 || edges.find(key(b, a)) == edges.end()) {
+        locked[a] = locked[b] = 1;
+      }
+    }
+  }
+
+  // Vertices sharing a position belong to separate patches that merely touch there. A hash
+  // collision only locks a vertex too many.
+  void lockSharedPositions() {
+    std::unordered_map<uint64_t, uint32_t> positions;
+    positions.reserve(vertexCount);
+    std::vector<uint64_t> keys(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      uint32_t bits[3];
+      std::memcpy(bits, &vertices[v].position, sizeof(bits));
+      uint64_t h = bits[0];
+      h = h * 0x9E3779B97F4A7C15ull ^ bits[1];
+      h = h * 0x9E3779B97F4A7C15ull ^ bits[2];
+      keys[v] = h;
+      positions[h]++;
+    }
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      if (positions[keys[v]] > 1) locked[v] = 1;
+    }
+  }
+
+  void computeQuadrics() {
+    quadrics.assign(vertexCount, Quadric{});
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      const glm::vec3 &p0 = position(indices[i]);
+      glm::vec3 n = glm::cross(position(indices[i + 1]) - p0, position(indices[i + 2]) - p0);
+      float length = glm::length(n);
+      if (length == 0.f) continue;
+      n /= length;
+      float d = -glm::dot(n, p0);
+      for (int k = 0; k < 3; k++) {
+        quadrics[indices[i + k]].addPlane(n, d, length * .5f);
+      }
+    }
+  }
+
+  // The cheapest valid collapse of every unlocked vertex still in use
+  void gatherCollapses() {
+    collapses.clear();
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      if (locked[v] || offsets[v] == offsets[v + 1]) continue;
+
+      Collapse best{v, INVALID, 0.0};
+      for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++) {
+        const uint32_t *corners = &indices[3 * adjacency[i]];
+        for (int k = 0; k < 3; k++) {
+          uint32_t u = corners[k];
+          if (u == v || u == best.to) continue;
+          double weight = quadrics[v].weight + quadrics[u].weight;
+          double cost = (quadrics[v].evaluate(position(u)) + quadrics[u].evaluate(position(u))) /
+                        std::max(weight, 1e-20);
+          if (best.to != INVALID && cost >= best.cost) continue;
+          if (flips(v, u) || !keepsManifold(v, u)) continue;
+          best.to = u;
+          best.cost = cost;
+        }
+      }
+      if (best.to != INVALID) {
+        collapses.push_back(best);
+      }
+    }
+  }
+
+  // True if moving v onto u turns any remaining triangle around v by more than ~75 degrees
+  bool flips(uint32_t v, uint32_t u) const {
+    for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++) {
+      const uint32_t *corners = &indices[3 * adjacency[i]];
+      if (corners[0] == u || corners[1] == u || corners[2] == u) continue;
+      int k = corners[0] == v ? 0 : corners[1] == v ? 1 : 2;
+      const glm::vec3 &x = position(corners[(k + 1) % 3]);
+      const glm::vec3 &y = position(corners[(k + 2) % 3]);
+      glm::vec3 before = glm::cross(x - position(v), y - position(v));
+      glm::vec3 after = glm::cross(x - position(u), y - position(u));
+      if (glm::dot(before, after) <= .25f * glm::length(before) * glm::length(after)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Link condition: v and u may only share the neighbours opposite their shared edge, otherwise
+  // the collapse pinches the surface into non-manifold edges
+  bool keepsManifold(uint32_t v, uint32_t u) {
+    ring.clear();
+    uint32_t sharedTriangles = 0;
+    for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++) {
+      const uint32_t *corners = &indices[3 * adjacency[i]];
+      bool shared = false;
+      for (int k = 0; k < 3; k++) {
+        uint32_t x = corners[k];
+        shared = shared || x == u;
+        if (x != v && x != u && std::find(ring.begin(), ring.end(), x) == ring.end()) {
+          ring.push_back(x);
+        }
+      }
+      if (shared) sharedTriangles++;
+    }
+
+    uint32_t common = 0;
+    for (uint32_t x : ring) {
+      for (uint32_t i = offsets[u]; i < offsets[u + 1]; i++) {
+        const uint32_t *corners = &indices[3 * adjacency[i]];
+        if (corners[0] == x || corners[1] == x || corners[2] == x) {
+          common++;
+          break;
+        }
+      }
+    }
+    return common == sharedTriangles;
+  }
+
+  const std::vector<LveModel::Vertex> &vertices;
+  uint32_t vertexCount;
+  std::vector<uint32_t> indices;
+  std::vector<uint8_t> locked;
+  std::vector<Quadric> quadrics;
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> adjacency;
+  std::vector<Collapse> collapses;
+  std::vector<uint32_t> ring;
+};
+
+}  // namespace
+
+void LveMeshOptimizer::optimize(LveModel::Builder &builder) {
+  if (builder.indices.size() < 3 || builder.indices.size() % 3 != 0) {
+    return;
+  }
+  uint32_t vertexCount = static_cast<uint32_t>(builder.vertices.size());
+
+  std::vector<std::vector<uint32_t>> lodIndices;
+  std::vector<float> lodErrors{0.f};
+  lodIndices.push_back(std::move(builder.indices));
+  while (lodIndices.size() < MAX_LODS) {
+    const std::vector<uint32_t> &base = lodIndices.front();
+    const std::vector<uint32_t> &previous = lodIndices.back();
+    size_t targetTriangles = static_cast<size_t>(previous.size() / 3 * LOD_REDUCTION);
+    if (targetTriangles < MIN_LOD_TRIANGLES) {
+      break;
+    }
+
+    // from the full mesh every time, so errors are measured against the original surface
+    float error;
+    std::vector<uint32_t> lod =
+        simplify(builder.vertices, base.data(), base.size(), targetTriangles * 3, error);
+    // stuck on locked vertices, coarser targets would not get any further
+    if (lod.size() * 10 > previous.size() * 9) {
+      break;
+    }
+    lodErrors.push_back(std::max(error, lodErrors.back()));
+    lodIndices.push_back(std::move(lod));
+  }
+
+  builder.indices.clear();
+  builder.lods.clear();
+  std::vector<uint32_t> clusters;
+  for (size_t i = 0; i < lodIndices.size(); i++) {
+    std::vector<uint32_t> &lod = lodIndices[i];
+    optimizeVertexCache(lod.data(), lod.size(), vertexCount, clusters);
+    optimizeOverdraw(lod.data(), lod.size(), builder.vertices.data(), vertexCount, clusters);
+
+    builder.lods.push_back(
+        {static_cast<uint32_t>(builder.indices.size()),
+         static_cast<uint32_t>(lod.size()),
+         lodErrors[i]});
+    builder.indices.insert(builder.indices.end(), lod.begin(), lod.end());
+  }
+
+  // lod 0 is drawn up close, where fetch locality matters most, and it comes first
+  optimizeVertexFetch(builder.vertices, builder.indices);
+}
+
+void LveMeshOptimizer::optimizeVertexCache(
+    uint32_t *indices, size_t indexCount, uint32_t vertexCount, std::vector<uint32_t> &clusters) {
+  clusters.assign(1, 0);
+  if (indexCount == 0) {
+    return;
+  }
+
+  // Tipsify (Sander et al. 2007): fan around one vertex at a time, moving on to the candidate
+  // that will still be cached when its remaining triangles are emitted
+  std::vector<uint32_t> offsets, adjacency;
+  buildAdjacency(indices, indexCount, vertexCount, offsets, adjacency);
+  std::vector<uint32_t> live(vertexCount);
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    live[v] = offsets[v + 1] - offsets[v];
+  }
+
+  std::vector<uint32_t> cacheTime(vertexCount, 0);
+  std::vector<uint8_t> emitted(indexCount / 3, 0);
+  std::vector<uint32_t> deadEnd;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> output;
+  output.reserve(indexCount);
+  deadEnd.reserve(indexCount);
+
+  uint32_t time = CACHE_SIZE + 1;
+  uint32_t cursor = 0;
+  uint32_t fanning = indices[0];
+  while (fanning != INVALID) {
+    candidates.clear();
+    for (uint32_t i = offsets[fanning]; i < offsets[fanning + 1]; i++) {
+      uint32_t triangle = adjacency[i];
+      if (emitted[triangle]) continue;
+      emitted[triangle] = 1;
+      for (int k = 0; k < 3; k++) {
+        uint32_t v = indices[3 * triangle + k];
+        output.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - cacheTime[v] > CACHE_SIZE) {
+          cacheTime[v] = time++;
+        }
+      }
+    }
+
+    uint32_t next = INVALID;
+    int64_t bestPriority = -1;
+    for (uint32_t v : candidates) {
+      if (live[v] == 0) continue;
+      int64_t priority = 0;
+      if (time - cacheTime[v] + 2 * live[v] <= CACHE_SIZE) {
+        priority = time - cacheTime[v];
+      }
+      if (priority > bestPriority) {
+        bestPriority = priority;
+        next = v;
+      }
+    }
+
+    if (next == INVALID) {
+      // dead end: the most recently used vertex with triangles left, else the next in order
+      while (!deadEnd.empty() && next == INVALID) {
+        uint32_t v = deadEnd.back();
+        deadEnd.pop_back();
+        if (live[v] > 0) next = v;
+      }
+      while (next == INVALID && cursor < vertexCount) {
+        if (live[cursor] > 0) next = cursor;
+        cursor++;
+      }
+      if (next != INVALID && output.size() > clusters.back()) {
+        clusters.push_back(static_cast<uint32_t>(output.size()));
+      }
+    }
+    fanning = next;
+  }
+
+  assert(output.size() == indexCount && "Every triangle must be emitted exactly once");
+  std::copy(output.begin(), output.end(), indices);
+}
+
+void LveMeshOptimizer::optimizeOverdraw(
+    uint32_t *indices,
+    size_t indexCount,
+    const LveModel::Vertex *vertices,
+    uint32_t vertexCount,
+    const std::vector<uint32_t> &clusters) {
+  if (indexCount < 3) {
+    return;
+  }
+
+  // split where the miss rate so far is close to the whole mesh's, each piece then starts cold
+  // as it will once the pieces are reordered (Sander et al. 2007)
+  float meshRatio = averageCacheMissRatio(indices, indexCount, vertexCount);
+  std::vector<uint32_t> starts;
+  FifoCache cache{vertexCount};
+  for (size_t c = 0; c < clusters.size(); c++) {
+    size_t end = c + 1 < clusters.size() ? clusters[c + 1] : indexCount;
+    size_t start = clusters[c];
+    starts.push_back(static_cast<uint32_t>(start));
+    cache.flush();
+    uint32_t misses = 0;
+    for (size_t i = clusters[c]; i < end; i += 3) {
+      misses += cache.access(indices[i]) + cache.access(indices[i + 1]) +
+                cache.access(indices[i + 2]);
+      size_t triangles = (i + 3 - start) / 3;
+      if (i + 3 < end && misses <= meshRatio * OVERDRAW_THRESHOLD * triangles) {
+        start = i + 3;
+        starts.push_back(static_cast<uint32_t>(start));
+        cache.flush();
+        misses = 0;
+      }
+    }
+  }
+
+  // view independent occlusion order: clusters whose area weighted normal points away from the
+  // mesh centroid sit on the outside and are drawn first
+  auto triangleNormal = [&](size_t i) {
+    const glm::vec3 &p0 = vertices[indices[i]].position;
+    return glm::cross(
+        vertices[indices[i + 1]].position - p0,
+        vertices[indices[i + 2]].position - p0);
+  };
+  auto triangleCentroid = [&](size_t i) {
+    return (vertices[indices[i]].position + vertices[indices[i + 1]].position +
+            vertices[indices[i + 2]].position) /
+           3.f;
+  };
+
+  glm::vec3 meshCentroid{0.f};
+  float meshArea = 0.f;
+  for (size_t i = 0; i < indexCount; i += 3) {
+    float area = glm::length(triangleNormal(i));
+    meshCentroid += triangleCentroid(i) * area;
+    meshArea += area;
+  }
+  if (meshArea > 0.f) meshCentroid /= meshArea;
+
+  struct Cluster {
+    uint32_t start;
+    uint32_t end;
+    float sortKey;
+  };
+  std::vector<Cluster> sorted;
+  sorted.reserve(starts.size());
+  for (size_t c = 0; c < starts.size(); c++) {
+    uint32_t end = c + 1 < starts.size() ? starts[c + 1] : static_cast<uint32_t>(indexCount);
+    glm::vec3 centroid{0.f};
+    glm::vec3 normal{0.f};
+    float area = 0.f;
+    for (size_t i = starts[c]; i < end; i += 3) {
+      glm::vec3 n = triangleNormal(i);
+      float triangleArea = glm::length(n);
+      centroid += triangleCentroid(i) * triangleArea;
+      normal += n;
+      area += triangleArea;
+    }
+    float normalLength = glm::length(normal);
+    float sortKey = 0.f;
+    if (area > 0.f && normalLength > 0.f) {
+      sortKey = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+    }
+    sorted.push_back({starts[c], end, sortKey});
+  }
+  std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster &a, const Cluster &b) {
+    return a.sortKey > b.sortKey;
+  });
+
+  std::vector<uint32_t> reordered;
+  reordered.reserve(indexCount);
+  for (const Cluster &cluster : sorted) {
+    reordered.insert(reordered.end(), indices + cluster.start, indices + cluster.end);
+  }
+  std::copy(reordered.begin(), reordered.end(), indices);
+}
+
+void LveMeshOptimizer::optimizeVertexFetch(
+    std::vector<LveModel::Vertex> &vertices, std::vector<uint32_t> &indices) {
+  std::vector<uint32_t> remap(vertices.size(), INVALID);
+  uint32_t next = 0;
+  for (uint32_t &index : indices) {
+    if (remap[index] == INVALID) {
+      remap[index] = next++;
+    }
+    index = remap[index];
+  }
+
+  std::vector<LveModel::Vertex> reordered(next);
+  for (size_t v = 0; v < vertices.size(); v++) {
+    if (remap[v] != INVALID) {
+      reordered[remap[v]] = vertices[v];
+    }
+  }
+  vertices = std::move(reordered);
+}
+
+std::vector<uint32_t> LveMeshOptimizer::simplify(
+    const std::vector<LveModel::Vertex> &vertices,
+    const uint32_t *indices,
+    size_t indexCount,
+    size_t targetIndexCount,
+    float &error) {
+  assert(indexCount % 3 == 0 && "Simplification needs a triangle list");
+  Simplifier simplifier{vertices, indices, indexCount};
+  return simplifier.run(targetIndexCount, error);
+}
+
+float LveMeshOptimizer::averageCacheMissRatio(
+    const uint32_t *indices, size_t indexCount, uint32_t vertexCount) {
+  if (indexCount < 3) {
+    return 0.f;
+  }
+  FifoCache cache{vertexCount};
+  uint32_t misses = 0;
+  for (size_t i = 0; i < indexCount; i++) {
+    misses += cache.access(indices[i]);
+  }
+  return static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+}
+
+}  // namespace lve
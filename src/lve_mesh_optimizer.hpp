@@ -0,0 +1,71 @@
+#pragma once
+
+#include "lve_model.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// Import time mesh processing, run on a Builder before its mesh cache is written so the cost is
+// only paid once per source file.
+//
+// optimize() builds a lod chain by edge collapse simplification, orders each lod's triangles for
+// the post transform vertex cache (Tipsify) and then for overdraw by sorting clusters of them
+// outwards facing first, and finally orders the vertices by first use so fetches stay local.
+class LveMeshOptimizer {
+ public:
+  // post transform cache size the triangle order is tuned for, small enough for every GPU
+  static constexpr uint32_t CACHE_SIZE = 16;
+  static constexpr uint32_t MAX_LODS = 8;
+  // every lod aims for this fraction of the previous lod's triangles
+  static constexpr float LOD_REDUCTION = .5f;
+  // lods stop once they would have fewer triangles than this
+  static constexpr size_t MIN_LOD_TRIANGLES = 32;
+  // clusters may be split while their cache miss rate is within this factor of the whole mesh's
+  static constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+  // Replaces builder's indices with its lods, most detailed first, and sets builder.lods.
+  // Vertices are reordered and unreferenced ones dropped.
+  static void optimize(LveModel::Builder &builder);
+
+  // Reorders the triangles of indices in place. clusters receives the first index of every run
+  // of triangles that starts with a cold cache, the first being 0.
+  static void optimizeVertexCache(
+      uint32_t *indices,
+      size_t indexCount,
+      uint32_t vertexCount,
+      std::vector<uint32_t> &clusters);
+
+  // Splits the clusters from optimizeVertexCache further where that costs little cache reuse,
+  // then sorts them so the ones facing away from the mesh center are drawn first and occlude
+  // the rest, whatever the viewing direction
+  static void optimizeOverdraw(
+      uint32_t *indices,
+      size_t indexCount,
+      const LveModel::Vertex *vertices,
+      uint32_t vertexCount,
+      const std::vector<uint32_t> &clusters);
+
+  // Renumbers vertices in order of first use by indices, dropping unreferenced ones
+  static void optimizeVertexFetch(
+      std::vector<LveModel::Vertex> &vertices, std::vector<uint32_t> &indices);
+
+  // Collapses edges of the triangles in indices until at most targetIndexCount indices are left,
+  // or no collapse remains that keeps borders, attribute seams and triangle orientation intact.
+  // error receives the largest surface deviation caused, in the units of the positions.
+  static std::vector<uint32_t> simplify(
+      const std::vector<LveModel::Vertex> &vertices,
+      const uint32_t *indices,
+      size_t indexCount,
+      size_t targetIndexCount,
+      float &error);
+
+  // Average vertex shader invocations per triangle with a FIFO cache of CACHE_SIZE
+  static float averageCacheMissRatio(
+      const uint32_t *indices, size_t indexCount, uint32_t vertexCount);
+};
+
+}  // namespace lve
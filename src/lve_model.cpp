@@ -1,146 +1,462 @@
 #include "lve_model.hpp"
 
-#include "lve_utils.hpp"
+#include "lve_mesh_cache.hpp"
+#include "lve_mesh_optimizer.hpp"
+#include "lve_upload_manager.hpp"
 
 // libs
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include <glm/gtc/packing.hpp>
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
-#include <unordered_map>
+#include <thread>
 
 #ifndef ENGINE_DIR
 #define ENGINE_DIR "../"
 #endif
 
-namespace std {
-template <>
-struct hash<lve::LveModel::Vertex> {
-  size_t operator()(lve::LveModel::Vertex const &vertex) const {
-    size_t seed = 0;
-    lve::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-    return seed;
+namespace lve {
+
+namespace {
+
+// GPU layouts of VertexFormat::Compact and VertexFormat::Quantized
+struct CompactVertex {
+  glm::vec3 position;
+  uint32_t color;   // R8G8B8A8_UNORM
+  uint32_t normal;  // R16G16_SNORM, octahedral
+  uint32_t uv;      // R16G16_SFLOAT
+};
+
+struct QuantizedVertex {
+  uint16_t position[4];  // R16G16B16A16_UNORM, w unused
+  uint32_t color;
+  uint32_t normal;
+  uint32_t uv;
+};
+
+static_assert(sizeof(CompactVertex) == 24, "CompactVertex must be tightly packed");
+static_assert(sizeof(QuantizedVertex) == 20, "QuantizedVertex must be tightly packed");
+
+// Projects a normal onto the octahedron and unfolds the lower half over the upper one, decoded
+// by octahedralNormal() in the vertex shaders. Missing (zero) normals come out as +z.
+glm::vec2 encodeOctahedral(const glm::vec3 &normal) {
+  float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+  if (l1 == 0.f) {
+    return glm::vec2{0.f};
+  }
+  glm::vec2 e = glm::vec2{normal} / l1;
+  if (normal.z < 0.f) {
+    e = (1.f - glm::abs(glm::vec2{e.y, e.x})) *
+        glm::vec2{e.x >= 0.f ? 1.f : -1.f, e.y >= 0.f ? 1.f : -1.f};
+  }
+  return e;
+}
+
+template <typename T>
+void encodeAttributes(const LveModel::Vertex &vertex, T &out) {
+  out.color = glm::packUnorm4x8(glm::vec4{vertex.color, 1.f});
+  out.normal = glm::packSnorm2x16(encodeOctahedral(vertex.normal));
+  out.uv = glm::packHalf2x16(vertex.uv);
+}
+
+// Open addressing table from an OBJ (position, normal, texcoord) index triple to the vertex it
+// produced. Every attribute of a Vertex is a function of that triple, so comparing three ints
+// replaces hashing and comparing the full 44 byte vertex.
+class VertexIndexTable {
+ public:
+  explicit VertexIndexTable(size_t expectedKeys) {
+    size_t capacity = 16;
+    while (capacity < expectedKeys * 2) {
+      capacity <<= 1;
+    }
+    slots.resize(capacity);
   }
+
+  // Returns the vertex index stored for key, inserting nextIndex if key is new
+  uint32_t findOrInsert(const tinyobj::index_t &key, uint32_t nextIndex, bool &inserted) {
+    if ((count + 1) * 2 > slots.size()) {
+      grow();
+    }
+
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+      Slot &slot = slots[i];
+      if (slot.value == EMPTY) {
+        slot.key = key;
+        slot.value = nextIndex;
+        count++;
+        inserted = true;
+        return nextIndex;
+      }
+      if (slot.key.vertex_index == key.vertex_index && slot.key.normal_index == key.normal_index &&
+          slot.key.texcoord_index == key.texcoord_index) {
+        inserted = false;
+        return slot.value;
+      }
+    }
+  }
+
+ private:
+  static constexpr uint32_t EMPTY = ~0u;
+
+  struct Slot {
+    tinyobj::index_t key;
+    uint32_t value = EMPTY;
+  };
+
+  static size_t hash(const tinyobj::index_t &key) {
+    uint64_t h = static_cast<uint32_t>(key.vertex_index);
+    h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(key.normal_index);
+    h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(key.texcoord_index);
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return static_cast<size_t>(h);
+  }
+
+  void grow() {
+    std::vector<Slot> old = std::move(slots);
+    slots.assign(old.size() * 2, Slot{});
+    size_t mask = slots.size() - 1;
+    for (const Slot &slot : old) {
+      if (slot.value == EMPTY) continue;
+      size_t i = hash(slot.key) & mask;
+      while (slots[i].value != EMPTY) {
+        i = (i + 1) & mask;
+      }
+      slots[i] = slot;
+    }
+  }
+
+  std::vector<Slot> slots;
+  size_t count = 0;
 };
-}  // namespace std
 
-namespace lve {
+LveModel::Vertex makeVertex(const tinyobj::attrib_t &attrib, const tinyobj::index_t &index) {
+  LveModel::Vertex vertex{};
+
+  if (index.vertex_index >= 0) {
+    vertex.position = {
+        attrib.vertices[3 * index.vertex_index + 0],
+        attrib.vertices[3 * index.vertex_index + 1],
+        attrib.vertices[3 * index.vertex_index + 2],
+    };
+
+    vertex.color = {
+        attrib.colors[3 * index.vertex_index + 0],
+        attrib.colors[3 * index.vertex_index + 1],
+        attrib.colors[3 * index.vertex_index + 2],
+    };
+  }
+
+  if (index.normal_index >= 0) {
+    vertex.normal = {
+        attrib.normals[3 * index.normal_index + 0],
+        attrib.normals[3 * index.normal_index + 1],
+        attrib.normals[3 * index.normal_index + 2],
+    };
+  }
 
-LveModel::LveModel(LveDevice &device, const LveModel::Builder &builder) : lveDevice{device} {
-  createVertexBuffers(builder.vertices);
-  createIndexBuffers(builder.indices);
+  if (index.texcoord_index >= 0) {
+    vertex.uv = {
+        attrib.texcoords[2 * index.texcoord_index + 0],
+        attrib.texcoords[2 * index.texcoord_index + 1],
+    };
+  }
+
+  return vertex;
 }
 
-LveModel::~LveModel() {}
+// Dedups shapes [first, last) into vertices / indices, with indices relative to vertices
+void dedupShapes(
+    const tinyobj::attrib_t &attrib,
+    const std::vector<tinyobj::shape_t> &shapes,
+    size_t first,
+    size_t last,
+    std::vector<LveModel::Vertex> &vertices,
+    std::vector<uint32_t> &indices) {
+  size_t indexCount = 0;
+  for (size_t s = first; s < last; s++) {
+    indexCount += shapes[s].mesh.indices.size();
+  }
 
-std::unique_ptr<LveModel> LveModel::createModelFromFile(
-    LveDevice &device, const std::string &filepath) {
-  Builder builder{};
-  builder.loadModel(ENGINE_DIR + filepath);
-  return std::make_unique<LveModel>(device, builder);
+  // triangle meshes reference each unique vertex from several faces, so sizing for one unique
+  // vertex per two indices almost never has to grow
+  VertexIndexTable table{indexCount / 2};
+  indices.reserve(indices.size() + indexCount);
+
+  for (size_t s = first; s < last; s++) {
+    for (const auto &index : shapes[s].mesh.indices) {
+      bool inserted;
+      uint32_t vertexIndex =
+          table.findOrInsert(index, static_cast<uint32_t>(vertices.size()), inserted);
+      if (inserted) {
+        vertices.push_back(makeVertex(attrib, index));
+      }
+      indices.push_back(vertexIndex);
+    }
+  }
 }
 
-void LveModel::createVertexBuffers(const std::vector<Vertex> &vertices) {
-  vertexCount = static_cast<uint32_t>(vertices.size());
-  assert(vertexCount >= 3 && "Vertex count must be at least 3");
-  VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-  uint32_t vertexSize = sizeof(vertices[0]);
-
-  LveBuffer stagingBuffer{
-      lveDevice,
-      vertexSize,
-      vertexCount,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-  };
+}  // namespace
+
+
+glm::mat4 LveModel::Quantization::apply(const glm::mat4 &modelMatrix) const {
+  glm::mat4 result = modelMatrix;
+  result[0] *= scale;
+  result[1] *= scale;
+  result[2] *= scale;
+  result[3] = modelMatrix * glm::vec4{offset, 1.f};
+  return result;
+}
+
+LveBoundingSphere LveModel::Quantization::toStored(const LveBoundingSphere &sphere) const {
+  return {(sphere.center - offset) / scale, sphere.radius / scale};
+}
 
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *)vertices.data());
+LveModel::LveModel(LveDevice &device, const LveModel::Builder &builder, VertexFormat format)
+    : LveModel(
+          device,
+          builder.vertices.data(),
+          static_cast<uint32_t>(builder.vertices.size()),
+          builder.indices.data(),
+          static_cast<uint32_t>(builder.indices.size()),
+          builder.lods.data(),
+          static_cast<uint32_t>(builder.lods.size()),
+          format) {}
+
+LveModel::LveModel(
+    LveDevice &device,
+    const Vertex *vertices,
+    uint32_t vertexCount,
+    const uint32_t *indices,
+    uint32_t indexCount,
+    const Lod *lods,
+    uint32_t lodCount,
+    VertexFormat format)
+    : lveDevice{device},
+      vertexFormat{format},
+      geometryPool{device.geometryPool(getVertexStride(format))} {
+  assert(vertexCount >= 3 && "Vertex count must be at least 3");
+  if (lodCount > 0) {
+    this->lods.assign(lods, lods + lodCount);
+  } else {
+    this->lods.push_back({0, indexCount, 0.f});
+  }
+  for (const Lod &lod : this->lods) {
+    assert(lod.firstIndex + lod.indexCount <= indexCount && "Lod out of the model's indices");
+  }
+  computeBounds(vertices, vertexCount);
+  geometry = geometryPool.allocate(vertexCount, indexCount);
+  uploadVertices(vertices);
+  uploadIndices(indices);
+}
 
-  vertexBuffer = std::make_unique<LveBuffer>(
-      lveDevice,
-      vertexSize,
-      vertexCount,
-      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+LveModel::~LveModel() { geometryPool.free(geometry); }
 
-  lveDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+std::unique_ptr<LveModel> LveModel::createModelFromFile(
+    LveDevice &device, const std::string &filepath, VertexFormat format) {
+  Builder builder{};
+  if (auto cache = LveMeshCache::loadOrConvert(ENGINE_DIR + filepath, builder)) {
+    return std::make_unique<LveModel>(
+        device,
+        cache->getVertices(),
+        cache->getVertexCount(),
+        cache->getIndices(),
+        cache->getIndexCount(),
+        cache->getLods(),
+        cache->getLodCount(),
+        format);
+  }
+  return std::make_unique<LveModel>(device, builder, format);
 }
 
-void LveModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
-  indexCount = static_cast<uint32_t>(indices.size());
-  hasIndexBuffer = indexCount > 0;
+void LveModel::computeBounds(const Vertex *vertices, uint32_t vertexCount) {
+  boundingBox.min = boundingBox.max = vertices[0].position;
+  for (uint32_t i = 1; i < vertexCount; i++) {
+    boundingBox.min = glm::min(boundingBox.min, vertices[i].position);
+    boundingBox.max = glm::max(boundingBox.max, vertices[i].position);
+  }
 
-  if (!hasIndexBuffer) {
-    return;
+  // centered on the box, but sized by the farthest vertex rather than the box corner
+  boundingSphere.center = boundingBox.center();
+  float radiusSquared = 0.f;
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    glm::vec3 offset = vertices[i].position - boundingSphere.center;
+    radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+  }
+  boundingSphere.radius = std::sqrt(radiusSquared);
+
+  if (vertexFormat == VertexFormat::Quantized) {
+    // the largest extent spans the full unorm16 range, flat meshes keep a scale of 1
+    glm::vec3 extent = boundingBox.max - boundingBox.min;
+    float largest = std::max(extent.x, std::max(extent.y, extent.z));
+    quantization.offset = boundingBox.min;
+    quantization.scale = largest > 0.f ? largest : 1.f;
+  }
+}
+
+const void *LveModel::encodeVertices(const Vertex *vertices, std::vector<uint8_t> &encoded) const {
+  if (vertexFormat == VertexFormat::Full) {
+    return vertices;
   }
 
-  VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-  uint32_t indexSize = sizeof(indices[0]);
+  encoded.resize(static_cast<size_t>(getVertexStride(vertexFormat)) * geometry.vertexCount);
+  if (vertexFormat == VertexFormat::Compact) {
+    auto *out = reinterpret_cast<CompactVertex *>(encoded.data());
+    for (uint32_t i = 0; i < geometry.vertexCount; i++) {
+      out[i].position = vertices[i].position;
+      encodeAttributes(vertices[i], out[i]);
+    }
+  } else {
+    auto *out = reinterpret_cast<QuantizedVertex *>(encoded.data());
+    for (uint32_t i = 0; i < geometry.vertexCount; i++) {
+      glm::vec3 stored = glm::clamp(
+          (vertices[i].position - quantization.offset) / quantization.scale,
+          glm::vec3{0.f},
+          glm::vec3{1.f});
+      for (int c = 0; c < 3; c++) {
+        out[i].position[c] = static_cast<uint16_t>(std::round(stored[c] * 65535.f));
+      }
+      out[i].position[3] = 0;
+      encodeAttributes(vertices[i], out[i]);
+    }
+  }
+  return encoded.data();
+}
 
-  LveBuffer stagingBuffer{
-      lveDevice,
-      indexSize,
-      indexCount,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-  };
+void LveModel::uploadVertices(const Vertex *vertices) {
+  // the upload manager copies into staging right away, so encoded only has to live until then
+  std::vector<uint8_t> encoded;
+  VkDeviceSize stride = getVertexStride(vertexFormat);
+  lveDevice.uploadManager().uploadBuffer(
+      encodeVertices(vertices, encoded),
+      stride * geometry.vertexCount,
+      geometryPool.getVertexBuffer(geometry.chunk),
+      stride * geometry.firstVertex,
+      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+}
 
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *)indices.data());
+void LveModel::uploadIndices(const uint32_t *indices) {
+  if (geometry.indexCount == 0) {
+    return;
+  }
 
-  indexBuffer = std::make_unique<LveBuffer>(
-      lveDevice,
-      indexSize,
-      indexCount,
-      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  lveDevice.uploadManager().uploadBuffer(
+      indices,
+      sizeof(uint32_t) * geometry.indexCount,
+      geometryPool.getIndexBuffer(geometry.chunk),
+      sizeof(uint32_t) * geometry.firstIndex,
+      VK_ACCESS_INDEX_READ_BIT,
+      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+}
 
-  lveDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+uint32_t LveModel::selectLod(float errorScale) const {
+  uint32_t lod = 0;
+  while (lod + 1 < lods.size() && lods[lod + 1].error * errorScale <= 1.f) {
+    lod++;
+  }
+  return lod;
 }
 
-void LveModel::draw(VkCommandBuffer commandBuffer) {
-  if (hasIndexBuffer) {
-    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+void LveModel::draw(
+    VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod) {
+  if (geometry.indexCount > 0) {
+    vkCmdDrawIndexed(
+        commandBuffer,
+        lods[lod].indexCount,
+        instanceCount,
+        geometry.firstIndex + lods[lod].firstIndex,
+        static_cast<int32_t>(geometry.firstVertex),
+        firstInstance);
   } else {
-    vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+    vkCmdDraw(
+        commandBuffer,
+        geometry.vertexCount,
+        instanceCount,
+        geometry.firstVertex,
+        firstInstance);
   }
 }
 
 void LveModel::bind(VkCommandBuffer commandBuffer) {
-  VkBuffer buffers[] = {vertexBuffer->getBuffer()};
-  VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+  geometryPool.bind(commandBuffer, geometry.chunk);
+}
+
+std::vector<VkVertexInputBindingDescription> LveModel::Vertex::getBindingDescriptions() {
+  return LveModel::getBindingDescriptions(VertexFormat::Full);
+}
+
+std::vector<VkVertexInputAttributeDescription> LveModel::Vertex::getAttributeDescriptions() {
+  return LveModel::getAttributeDescriptions(VertexFormat::Full);
+}
 
-  if (hasIndexBuffer) {
-    vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+uint32_t LveModel::getVertexStride(VertexFormat format) {
+  switch (format) {
+    case VertexFormat::Compact:
+      return sizeof(CompactVertex);
+    case VertexFormat::Quantized:
+      return sizeof(QuantizedVertex);
+    default:
+      return sizeof(Vertex);
   }
 }
 
-std::vector<VkVertexInputBindingDescription> LveModel::Vertex::getBindingDescriptions() {
+std::vector<VkVertexInputBindingDescription> LveModel::getBindingDescriptions(
+    VertexFormat format) {
   std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
   bindingDescriptions[0].binding = 0;
-  bindingDescriptions[0].stride = sizeof(Vertex);
+  bindingDescriptions[0].stride = getVertexStride(format);
   bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
   return bindingDescriptions;
 }
 
-std::vector<VkVertexInputAttributeDescription> LveModel::Vertex::getAttributeDescriptions() {
+std::vector<VkVertexInputAttributeDescription> LveModel::getAttributeDescriptions(
+    VertexFormat format) {
   std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 
-  attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
-  attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
-  attributeDescriptions.push_back({2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
-  attributeDescriptions.push_back({3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)});
+  // shader inputs stay vec3 / vec2, missing components read as 0 and extra ones are dropped
+  switch (format) {
+    case VertexFormat::Full:
+      attributeDescriptions.push_back(
+          {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
+      attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
+      attributeDescriptions.push_back(
+          {2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
+      attributeDescriptions.push_back({3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)});
+      break;
+    case VertexFormat::Compact:
+      attributeDescriptions.push_back(
+          {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(CompactVertex, position)});
+      attributeDescriptions.push_back(
+          {1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(CompactVertex, color)});
+      attributeDescriptions.push_back(
+          {2, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, normal)});
+      attributeDescriptions.push_back(
+          {3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, uv)});
+      break;
+    case VertexFormat::Quantized:
+      attributeDescriptions.push_back(
+          {0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(QuantizedVertex, position)});
+      attributeDescriptions.push_back(
+          {1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(QuantizedVertex, color)});
+      attributeDescriptions.push_back(
+          {2, 0, VK_FORMAT_R16G16_SNORM, offsetof(QuantizedVertex, normal)});
+      attributeDescriptions.push_back(
+          {3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(QuantizedVertex, uv)});
+      break;
+  }
 
   return attributeDescriptions;
 }
 
-void LveModel::Builder::loadModel(const std::string &filepath) {
+void LveModel::Builder::loadModel(const std::string &filepath, uint32_t threadCount) {
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
@@ -150,48 +466,76 @@ void LveModel::Builder::loadModel(const std::string &filepath) {
     throw std::runtime_error(warn + err);
   }
 
+  buildFromObj(attrib, shapes, threadCount);
+}
+
+void LveModel::Builder::optimize() { LveMeshOptimizer::optimize(*this); }
+
+void LveModel::Builder::buildFromObj(
+    const tinyobj::attrib_t &attrib,
+    const std::vector<tinyobj::shape_t> &shapes,
+    uint32_t threadCount) {
   vertices.clear();
   indices.clear();
+  lods.clear();
 
-  std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+  size_t totalIndices = 0;
   for (const auto &shape : shapes) {
-    for (const auto &index : shape.mesh.indices) {
-      Vertex vertex{};
-
-      if (index.vertex_index >= 0) {
-        vertex.position = {
-            attrib.vertices[3 * index.vertex_index + 0],
-            attrib.vertices[3 * index.vertex_index + 1],
-            attrib.vertices[3 * index.vertex_index + 2],
-        };
-
-        vertex.color = {
-            attrib.colors[3 * index.vertex_index + 0],
-            attrib.colors[3 * index.vertex_index + 1],
-            attrib.colors[3 * index.vertex_index + 2],
-        };
-      }
+    totalIndices += shape.mesh.indices.size();
+  }
 
-      if (index.normal_index >= 0) {
-        vertex.normal = {
-            attrib.normals[3 * index.normal_index + 0],
-            attrib.normals[3 * index.normal_index + 1],
-            attrib.normals[3 * index.normal_index + 2],
-        };
-      }
+  // small meshes aren't worth a thread, and one shape can't be split
+  static constexpr size_t MIN_INDICES_PER_THREAD = 1 << 16;
+  threadCount = static_cast<uint32_t>(std::min<size_t>(
+      {std::max(threadCount, 1u), shapes.size(), totalIndices / MIN_INDICES_PER_THREAD}));
 
-      if (index.texcoord_index >= 0) {
-        vertex.uv = {
-            attrib.texcoords[2 * index.texcoord_index + 0],
-            attrib.texcoords[2 * index.texcoord_index + 1],
-        };
-      }
+  if (threadCount <= 1) {
+    dedupShapes(attrib, shapes, 0, shapes.size(), vertices, indices);
+    return;
+  }
 
-      if (uniqueVertices.count(vertex) == 0) {
-        uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-        vertices.push_back(vertex);
-      }
-      indices.push_back(uniqueVertices[vertex]);
+  // split shapes into contiguous ranges of roughly equal index count. Vertices shared between
+  // shapes in different ranges are duplicated, which is rare for OBJ exports.
+  std::vector<size_t> rangeStarts{0};
+  size_t target = totalIndices / threadCount;
+  size_t accumulated = 0;
+  for (size_t s = 0; s < shapes.size() && rangeStarts.size() < threadCount; s++) {
+    accumulated += shapes[s].mesh.indices.size();
+    if (accumulated >= target * rangeStarts.size() && s + 1 < shapes.size()) {
+      rangeStarts.push_back(s + 1);
+    }
+  }
+  rangeStarts.push_back(shapes.size());
+
+  size_t rangeCount = rangeStarts.size() - 1;
+  std::vector<std::vector<Vertex>> rangeVertices(rangeCount);
+  std::vector<std::vector<uint32_t>> rangeIndices(rangeCount);
+  std::vector<std::thread> workers;
+  for (size_t r = 1; r < rangeCount; r++) {
+    workers.emplace_back([&, r]() {
+      dedupShapes(
+          attrib,
+          shapes,
+          rangeStarts[r],
+          rangeStarts[r + 1],
+          rangeVertices[r],
+          rangeIndices[r]);
+    });
+  }
+  dedupShapes(attrib, shapes, rangeStarts[0], rangeStarts[1], rangeVertices[0], rangeIndices[0]);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  // merge in shape order so the output doesn't depend on scheduling
+  vertices = std::move(rangeVertices[0]);
+  indices = std::move(rangeIndices[0]);
+  for (size_t r = 1; r < rangeCount; r++) {
+    uint32_t base = static_cast<uint32_t>(vertices.size());
+    vertices.insert(vertices.end(), rangeVertices[r].begin(), rangeVertices[r].end());
+    indices.reserve(indices.size() + rangeIndices[r].size());
+    for (uint32_t index : rangeIndices[r]) {
+      indices.push_back(base + index);
     }
   }
 }
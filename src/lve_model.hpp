@@ -1,7 +1,8 @@
 #pragma once
 
-#include "lve_buffer.hpp"
 #include "lve_device.hpp"
+#include "lve_frustum.hpp"
+#include "lve_geometry_pool.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -9,18 +10,48 @@
 #include <glm/glm.hpp>
 
 // std
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
+namespace tinyobj {
+struct attrib_t;
+struct shape_t;
+}  // namespace tinyobj
+
 namespace lve {
 class LveModel {
  public:
+  // Layout of a model's vertices in its geometry pool. Vertex stays the layout models are built
+  // and cached in, the compact layouts are encoded from it at upload time and trade precision
+  // for vertex fetch bandwidth: octahedral R16G16_SNORM normals, half float uvs and
+  // R8G8B8A8_UNORM colors.
+  enum class VertexFormat {
+    Full,       // 44 bytes, Vertex as is
+    Compact,    // 24 bytes, R32G32B32_SFLOAT positions
+    Quantized,  // 20 bytes, R16G16B16A16_UNORM positions within the bounds, see Quantization
+  };
+
+  // Quantized positions are stored as (position - offset) / scale. The scale is uniform, so
+  // folding the dequantization into the model matrix keeps bounding sphere tests exact.
+  struct Quantization {
+    glm::vec3 offset{0.f};
+    float scale = 1.f;
+
+    // modelMatrix * translate(offset) * scale(scale), takes stored positions to world space
+    glm::mat4 apply(const glm::mat4 &modelMatrix) const;
+    // A local space sphere in the space of the stored positions
+    LveBoundingSphere toStored(const LveBoundingSphere &sphere) const;
+  };
+
   struct Vertex {
     glm::vec3 position{};
     glm::vec3 color{};
     glm::vec3 normal{};
     glm::vec2 uv{};
 
+    // Descriptions of the Full format
     static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
     static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
 
@@ -30,36 +61,107 @@ class LveModel {
     }
   };
 
+  // A level of detail, a range of the model's indices. Every lod shares the model's vertices, so
+  // switching lods costs nothing but the draw's index range.
+  struct Lod {
+    uint32_t firstIndex = 0;  // relative to the model's first index
+    uint32_t indexCount = 0;
+    // how far the simplified surface strays from the full one, in local space units
+    float error = 0.f;
+  };
+
   struct Builder {
     std::vector<Vertex> vertices{};
     std::vector<uint32_t> indices{};
-
-    void loadModel(const std::string &filepath);
+    // most detailed first, empty for a single lod made of all indices
+    std::vector<Lod> lods{};
+
+    // threadCount > 1 dedups groups of shapes in parallel for large multi-shape meshes
+    void loadModel(const std::string &filepath, uint32_t threadCount = 1);
+    // Builds lods and reorders triangles and vertices for the GPU, see LveMeshOptimizer
+    void optimize();
+    void buildFromObj(
+        const tinyobj::attrib_t &attrib,
+        const std::vector<tinyobj::shape_t> &shapes,
+        uint32_t threadCount = 1);
   };
 
-  LveModel(LveDevice &device, const LveModel::Builder &builder);
+  // Vertex input state for pipelines drawing models of the given format. Locations match
+  // Vertex's members in every format, shaders only have to decode octahedral normals.
+  static uint32_t getVertexStride(VertexFormat format);
+  static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(VertexFormat format);
+  static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(
+      VertexFormat format);
+
+  // Buffer copies are queued on the device's upload manager. The model may only be drawn once
+  // the batch they are submitted with has completed.
+  LveModel(
+      LveDevice &device,
+      const LveModel::Builder &builder,
+      VertexFormat format = VertexFormat::Full);
+  // Uploads directly from caller owned memory, eg a mapped mesh cache. The data only has to stay
+  // valid for the duration of the call.
+  LveModel(
+      LveDevice &device,
+      const Vertex *vertices,
+      uint32_t vertexCount,
+      const uint32_t *indices,
+      uint32_t indexCount,
+      const Lod *lods = nullptr,
+      uint32_t lodCount = 0,
+      VertexFormat format = VertexFormat::Full);
   ~LveModel();
 
   LveModel(const LveModel &) = delete;
   LveModel &operator=(const LveModel &) = delete;
 
+  // Loads from the binary .lvemesh cache next to filepath when it is up to date, otherwise parses
+  // the OBJ and writes the cache for next time
   static std::unique_ptr<LveModel> createModelFromFile(
-      LveDevice &device, const std::string &filepath);
+      LveDevice &device,
+      const std::string &filepath,
+      VertexFormat format = VertexFormat::Full);
 
+  // Binds the geometry pool chunk holding this model. Models sharing a chunk only need it bound
+  // once, see getGeometry().chunk.
   void bind(VkCommandBuffer commandBuffer);
-  void draw(VkCommandBuffer commandBuffer);
+  void draw(
+      VkCommandBuffer commandBuffer,
+      uint32_t instanceCount = 1,
+      uint32_t firstInstance = 0,
+      uint32_t lod = 0);
 
- private:
-  void createVertexBuffers(const std::vector<Vertex> &vertices);
-  void createIndexBuffers(const std::vector<uint32_t> &indices);
+  const LveGeometryAllocation &getGeometry() const { return geometry; }
+  LveGeometryPool &getGeometryPool() const { return geometryPool; }
 
-  LveDevice &lveDevice;
+  // Local space bounds, computed once from the vertex positions at load time
+  const LveBoundingBox &getBoundingBox() const { return boundingBox; }
+  const LveBoundingSphere &getBoundingSphere() const { return boundingSphere; }
+
+  // At least one, the first being the full mesh
+  const std::vector<Lod> &getLods() const { return lods; }
+  // Coarsest lod whose error times errorScale stays within 1. errorScale turns local space
+  // units into fractions of the allowed on screen error at the object's distance.
+  uint32_t selectLod(float errorScale) const;
 
-  std::unique_ptr<LveBuffer> vertexBuffer;
-  uint32_t vertexCount;
+  VertexFormat getVertexFormat() const { return vertexFormat; }
+  // Identity unless the format is Quantized
+  const Quantization &getQuantization() const { return quantization; }
 
-  bool hasIndexBuffer = false;
-  std::unique_ptr<LveBuffer> indexBuffer;
-  uint32_t indexCount;
+ private:
+  void computeBounds(const Vertex *vertices, uint32_t vertexCount);
+  void uploadVertices(const Vertex *vertices);
+  // Returns the geometry's vertices in vertexFormat, vertices itself for Full
+  const void *encodeVertices(const Vertex *vertices, std::vector<uint8_t> &encoded) const;
+  void uploadIndices(const uint32_t *indices);
+
+  LveDevice &lveDevice;
+  VertexFormat vertexFormat;
+  LveGeometryPool &geometryPool;
+  LveGeometryAllocation geometry{};
+  LveBoundingBox boundingBox{};
+  LveBoundingSphere boundingSphere{};
+  Quantization quantization{};
+  std::vector<Lod> lods;
 };
 }  // namespace lve
@@ -0,0 +1,113 @@
+#include "lve_model_loader.hpp"
+
+// std
+#include <chrono>
+#include <exception>
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace lve {
+
+LveModelLoader::LveModelLoader(
+    LveDevice &device, LveThreadPool &threadPool, LveModel::VertexFormat vertexFormat)
+    : lveDevice{device}, threadPool{threadPool}, vertexFormat{vertexFormat} {}
+
+LveModelLoader::~LveModelLoader() {
+  // workers may still reference jobs through their futures, let them finish first
+  for (auto &job : parsing) {
+    job->parsed.wait();
+  }
+}
+
+LveModelLoader::Handle LveModelLoader::loadAsync(const std::string &filepath, Callback onLoaded) {
+  auto job = std::make_unique<Job>();
+  job->callback = std::move(onLoaded);
+  job->parsed = threadPool.submit([path = ENGINE_DIR + filepath]() {
+    ParsedMesh mesh{};
+    mesh.builder = std::make_unique<LveModel::Builder>();
+    mesh.cache = LveMeshCache::loadOrConvert(path, *mesh.builder);
+    if (mesh.cache) {
+      mesh.builder.reset();
+    }
+    return mesh;
+  });
+
+  Handle handle = job->promise.get_future().share();
+  parsing.push_back(std::move(job));
+  return handle;
+}
+
+void LveModelLoader::update() {
+  auto &uploads = lveDevice.uploadManager();
+
+  // create buffers for everything that finished parsing and send them out as one batch
+  std::vector<Job *> created;
+  for (auto it = parsing.begin(); it != parsing.end();) {
+    Job &job = **it;
+    if (job.parsed.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      ++it;
+      continue;
+    }
+
+    try {
+      ParsedMesh mesh = job.parsed.get();
+      if (mesh.cache) {
+        job.model = std::make_shared<LveModel>(
+            lveDevice,
+            mesh.cache->getVertices(),
+            mesh.cache->getVertexCount(),
+            mesh.cache->getIndices(),
+            mesh.cache->getIndexCount(),
+            mesh.cache->getLods(),
+            mesh.cache->getLodCount(),
+            vertexFormat);
+      } else {
+        job.model = std::make_shared<LveModel>(lveDevice, *mesh.builder, vertexFormat);
+      }
+      created.push_back(&job);
+      uploading.push_back(std::move(*it));
+    } catch (...) {
+      job.promise.set_exception(std::current_exception());
+    }
+    it = parsing.erase(it);
+  }
+
+  if (!created.empty()) {
+    LveUploadManager::Ticket ticket = uploads.submit();
+    for (Job *job : created) {
+      job->ticket = ticket;
+    }
+  }
+
+  for (auto it = uploading.begin(); it != uploading.end();) {
+    Job &job = **it;
+    if (!uploads.isComplete(job.ticket)) {
+      ++it;
+      continue;
+    }
+
+    job.promise.set_value(job.model);
+    if (job.callback) {
+      job.callback(job.model);
+    }
+    it = uploading.erase(it);
+  }
+}
+
+void LveModelLoader::waitIdle() {
+  auto &uploads = lveDevice.uploadManager();
+  while (!isIdle()) {
+    for (auto &job : parsing) {
+      job->parsed.wait();
+    }
+    update();
+    for (auto &job : uploading) {
+      uploads.wait(job->ticket);
+    }
+    update();
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_mesh_cache.hpp"
+#include "lve_model.hpp"
+#include "lve_thread_pool.hpp"
+#include "lve_upload_manager.hpp"
+
+// std
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+// Maps mesh caches, or parses and dedups OBJ files, on a thread pool. GPU buffers are created on
+// the thread calling update(), and a load only completes once its upload batch has finished.
+class LveModelLoader {
+ public:
+  using Handle = std::shared_future<std::shared_ptr<LveModel>>;
+  using Callback = std::function<void(std::shared_ptr<LveModel>)>;
+
+  // Every model is created in vertexFormat
+  LveModelLoader(
+      LveDevice &device,
+      LveThreadPool &threadPool,
+      LveModel::VertexFormat vertexFormat = LveModel::VertexFormat::Full);
+  ~LveModelLoader();
+
+  LveModelLoader(const LveModelLoader &) = delete;
+  LveModelLoader &operator=(const LveModelLoader &) = delete;
+
+  // filepath is relative to ENGINE_DIR, as for LveModel::createModelFromFile. onLoaded runs
+  // inside update() once the model is ready to draw; parse errors are reported through the handle.
+  Handle loadAsync(const std::string &filepath, Callback onLoaded = nullptr);
+
+  // Call once per frame from the thread that owns the device
+  void update();
+
+  // Blocks until every outstanding load has completed
+  void waitIdle();
+
+  bool isIdle() const { return parsing.empty() && uploading.empty(); }
+  size_t getPendingCount() const { return parsing.size() + uploading.size(); }
+
+ private:
+  // exactly one of cache / builder is set
+  struct ParsedMesh {
+    std::unique_ptr<LveMeshCache> cache;
+    std::unique_ptr<LveModel::Builder> builder;
+  };
+
+  struct Job {
+    std::future<ParsedMesh> parsed;
+    std::promise<std::shared_ptr<LveModel>> promise;
+    Callback callback;
+    std::shared_ptr<LveModel> model;
+    LveUploadManager::Ticket ticket = 0;
+  };
+
+  LveDevice &lveDevice;
+  LveThreadPool &threadPool;
+  LveModel::VertexFormat vertexFormat;
+
+  std::vector<std::unique_ptr<Job>> parsing;
+  std::vector<std::unique_ptr<Job>> uploading;
+};
+
+}  // namespace lve
@@ -0,0 +1,178 @@
+#include "lve_parallel_recorder.hpp"
+
+#include "lve_swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace lve {
+
+LveParallelRecorder::LveParallelRecorder(LveDevice &device, LveThreadPool &threadPool)
+    : lveDevice{device}, threadPool{threadPool}, threadCount{threadPool.getThreadCount() + 1} {
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = lveDevice.findPhysicalQueueFamilies().graphicsFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  pools.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT * threadCount);
+  for (auto &pool : pools) {
+    if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &pool.commandPool) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create secondary command pool!");
+    }
+  }
+}
+
+LveParallelRecorder::~LveParallelRecorder() {
+  // destroying a pool frees its command buffers
+  for (auto &pool : pools) {
+    vkDestroyCommandPool(lveDevice.device(), pool.commandPool, nullptr);
+  }
+}
+
+void LveParallelRecorder::beginFrame(
+    int frameIndex, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent) {
+  this->frameIndex = frameIndex;
+  this->extent = extent;
+  for (uint32_t slot = 0; slot < threadCount; slot++) {
+    SlotPool &pool = pools[frameIndex * threadCount + slot];
+    if (pool.used > 0) {
+      vkResetCommandPool(lveDevice.device(), pool.commandPool, 0);
+      pool.used = 0;
+    }
+  }
+
+  inheritance = VkCommandBufferInheritanceInfo{};
+  inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance.renderPass = renderPass;
+  inheritance.subpass = 0;
+  inheritance.framebuffer = framebuffer;
+  recorded.clear();
+}
+
+VkCommandBuffer LveParallelRecorder::beginSecondary(uint32_t slot) {
+  SlotPool &pool = pools[frameIndex * threadCount + slot];
+  if (pool.used == pool.commandBuffers.size()) {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandPool = pool.commandPool;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate secondary command buffer!");
+    }
+    pool.commandBuffers.push_back(commandBuffer);
+  }
+  VkCommandBuffer commandBuffer = pool.commandBuffers[pool.used++];
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = &inheritance;
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording secondary command buffer!");
+  }
+
+  // dynamic state is not inherited from the primary buffer
+  VkViewport viewport{};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(extent.width);
+  viewport.height = static_cast<float>(extent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  VkRect2D scissor{{0, 0}, extent};
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+  return commandBuffer;
+}
+
+void LveParallelRecorder::endSecondary(VkCommandBuffer commandBuffer) {
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record secondary command buffer!");
+  }
+}
+
+void LveParallelRecorder::record(const std::function<void(VkCommandBuffer)> &recordFn) {
+  VkCommandBuffer commandBuffer = beginSecondary(0);
+  recordFn(commandBuffer);
+  endSecondary(commandBuffer);
+  recorded.push_back(commandBuffer);
+}
+
+void LveParallelRecorder::recordParallel(
+    uint32_t count, uint32_t minRangeSize, const RangeRecorder &recordRange) {
+  if (count == 0) {
+    return;
+  }
+  uint32_t rangeSize =
+      std::max(std::max(minRangeSize, 1u), (count + threadCount - 1) / threadCount);
+  uint32_t rangeCount = (count + rangeSize - 1) / rangeSize;
+  if (rangeCount == 1) {
+    record([&](VkCommandBuffer commandBuffer) { recordRange(commandBuffer, 0, count); });
+    return;
+  }
+
+  // ranges are claimed by the calling thread and the workers alike, each recording with its own
+  // slot's pool. Jobs still queued behind other work once every range is taken find nothing
+  // left and return, so the frame never waits on them.
+  struct Work {
+    std::vector<VkCommandBuffer> rangeBuffers;
+    std::atomic<uint32_t> next{0};
+    std::atomic<uint32_t> done{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+  };
+  auto work = std::make_shared<Work>();
+  work->rangeBuffers.resize(rangeCount);
+
+  auto process = [this, work, rangeCount, rangeSize, count, &recordRange](uint32_t slot) {
+    uint32_t range;
+    while ((range = work->next.fetch_add(1)) < rangeCount) {
+      try {
+        uint32_t begin = range * rangeSize;
+        VkCommandBuffer commandBuffer = beginSecondary(slot);
+        recordRange(commandBuffer, begin, std::min(begin + rangeSize, count));
+        endSecondary(commandBuffer);
+        work->rangeBuffers[range] = commandBuffer;
+      } catch (...) {
+        std::lock_guard<std::mutex> lock{work->errorMutex};
+        work->error = std::current_exception();
+      }
+      work->done.fetch_add(1, std::memory_order_release);
+    }
+  };
+  for (uint32_t slot = 1; slot < std::min(threadCount, rangeCount); slot++) {
+    threadPool.submit([process, slot]() { process(slot); });
+  }
+  process(0);
+  while (work->done.load(std::memory_order_acquire) < rangeCount) {
+    std::this_thread::yield();
+  }
+
+  if (work->error) {
+    std::rethrow_exception(work->error);
+  }
+  recorded.insert(recorded.end(), work->rangeBuffers.begin(), work->rangeBuffers.end());
+}
+
+void LveParallelRecorder::execute(VkCommandBuffer primaryCommandBuffer) {
+  if (recorded.empty()) {
+    return;
+  }
+  vkCmdExecuteCommands(
+      primaryCommandBuffer,
+      static_cast<uint32_t>(recorded.size()),
+      recorded.data());
+}
+
+}  // namespace lve
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_thread_pool.hpp"
+
+// std
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace lve {
+
+// Records the contents of a render pass into secondary command buffers, optionally spread over
+// the thread pool, for the primary buffer to run with a single vkCmdExecuteCommands. Every
+// recording thread has its own command pool per frame in flight, all of a frame's pools are
+// reset together once that frame's previous submission completed.
+class LveParallelRecorder {
+ public:
+  using RangeRecorder = std::function<void(VkCommandBuffer, uint32_t begin, uint32_t end)>;
+
+  LveParallelRecorder(LveDevice &device, LveThreadPool &threadPool);
+  ~LveParallelRecorder();
+
+  LveParallelRecorder(const LveParallelRecorder &) = delete;
+  LveParallelRecorder &operator=(const LveParallelRecorder &) = delete;
+
+  // Must come after LveRenderer::beginFrame, which waits for the frame's previous submission,
+  // and before the render pass is begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+  void beginFrame(
+      int frameIndex, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+
+  // Records into one secondary buffer on the calling thread
+  void record(const std::function<void(VkCommandBuffer)> &recordFn);
+
+  // Splits [0, count) into contiguous ranges of at least minRangeSize and records each into its
+  // own secondary buffer on whichever thread claims it. recordRange is called concurrently, so it
+  // must only read shared state. The ranges execute in order.
+  void recordParallel(uint32_t count, uint32_t minRangeSize, const RangeRecorder &recordRange);
+
+  // Executes everything recorded since beginFrame in recording order
+  void execute(VkCommandBuffer primaryCommandBuffer);
+
+  uint32_t getThreadCount() const { return threadCount; }
+
+ private:
+  struct SlotPool {
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> commandBuffers;
+    uint32_t used = 0;
+  };
+
+  // next unused secondary buffer of the given thread slot, begun for the current render pass
+  VkCommandBuffer beginSecondary(uint32_t slot);
+  void endSecondary(VkCommandBuffer commandBuffer);
+
+  LveDevice &lveDevice;
+  LveThreadPool &threadPool;
+  uint32_t threadCount;
+
+  // MAX_FRAMES_IN_FLIGHT x threadCount, slot 0 belongs to the calling thread
+  std::vector<SlotPool> pools;
+  int frameIndex = 0;
+  VkCommandBufferInheritanceInfo inheritance{};
+  VkExtent2D extent{};
+  std::vector<VkCommandBuffer> recorded;
+};
+
+}  // namespace lve
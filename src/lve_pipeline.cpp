@@ -20,7 +20,9 @@ LvePipeline::LvePipeline(
     const std::string& fragFilepath,
     const PipelineConfigInfo& configInfo)
     : lveDevice{device} {
-  createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+  vertShaderModule = createShaderModule(lveDevice, readFile(vertFilepath));
+  fragShaderModule = createShaderModule(lveDevice, readFile(fragFilepath));
+  createGraphicsPipeline(vertShaderModule, fragShaderModule, configInfo);
 }
 
 LvePipeline::~LvePipeline() {
@@ -48,9 +50,7 @@ std::vector<char> LvePipeline::readFile(const std::string& filepath) {
 }
 
 void LvePipeline::createGraphicsPipeline(
-    const std::string& vertFilepath,
-    const std::string& fragFilepath,
-    const PipelineConfigInfo& configInfo) {
+    VkShaderModule vertModule, VkShaderModule fragModule, const PipelineConfigInfo& configInfo) {
   assert(
       configInfo.pipelineLayout != VK_NULL_HANDLE &&
       "Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
@@ -58,27 +58,26 @@ void LvePipeline::createGraphicsPipeline(
       configInfo.renderPass != VK_NULL_HANDLE &&
       "Cannot create graphics pipeline: no renderPass provided in configInfo");
 
-  auto vertCode = readFile(vertFilepath);
-  auto fragCode = readFile(fragFilepath);
-
-  createShaderModule(vertCode, &vertShaderModule);
-  createShaderModule(fragCode, &fragShaderModule);
+  VkSpecializationInfo vertSpecialization = configInfo.vertSpecialization.getInfo();
+  VkSpecializationInfo fragSpecialization = configInfo.fragSpecialization.getInfo();
 
   VkPipelineShaderStageCreateInfo shaderStages[2];
   shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-  shaderStages[0].module = vertShaderModule;
+  shaderStages[0].module = vertModule;
   shaderStages[0].pName = "main";
   shaderStages[0].flags = 0;
   shaderStages[0].pNext = nullptr;
-  shaderStages[0].pSpecializationInfo = nullptr;
+  shaderStages[0].pSpecializationInfo =
+      configInfo.vertSpecialization.empty() ? nullptr : &vertSpecialization;
   shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  shaderStages[1].module = fragShaderModule;
+  shaderStages[1].module = fragModule;
   shaderStages[1].pName = "main";
   shaderStages[1].flags = 0;
   shaderStages[1].pNext = nullptr;
-  shaderStages[1].pSpecializationInfo = nullptr;
+  shaderStages[1].pSpecializationInfo =
+      configInfo.fragSpecialization.empty() ? nullptr : &fragSpecialization;
 
   auto& bindingDescriptions = configInfo.bindingDescriptions;
   auto& attributeDescriptions = configInfo.attributeDescriptions;
@@ -112,7 +111,7 @@ void LvePipeline::createGraphicsPipeline(
 
   if (vkCreateGraphicsPipelines(
           lveDevice.device(),
-          VK_NULL_HANDLE,
+          lveDevice.pipelineCache(),
           1,
           &pipelineInfo,
           nullptr,
@@ -121,18 +120,21 @@ void LvePipeline::createGraphicsPipeline(
   }
 }
 
-void LvePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
+VkShaderModule LvePipeline::createShaderModule(LveDevice& device, const std::vector<char>& code) {
   VkShaderModuleCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
   createInfo.codeSize = code.size();
   createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
-  if (vkCreateShaderModule(lveDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device.device(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
     throw std::runtime_error("failed to create shader module");
   }
+  return shaderModule;
 }
 
 void LvePipeline::bind(VkCommandBuffer commandBuffer) {
+  assert(isReady() && "Cannot bind a pipeline the registry has not compiled yet");
   vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 }
 
@@ -3,11 +3,54 @@
 #include "lve_device.hpp"
 
 // std
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace lve {
 
+// Values for one shader stage's specialization constants. Owns its data, so configs holding it
+// can be copied around without dangling pointers.
+class LveSpecialization {
+ public:
+  template <typename T>
+  LveSpecialization &set(uint32_t constantId, const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value, "specialization data must be plain");
+    VkSpecializationMapEntry entry{};
+    entry.constantID = constantId;
+    entry.offset = static_cast<uint32_t>(data.size());
+    entry.size = sizeof(T);
+    entries.push_back(entry);
+    data.resize(data.size() + sizeof(T));
+    std::memcpy(data.data() + entry.offset, &value, sizeof(T));
+    return *this;
+  }
+  // GLSL bool constants are 32 bit
+  LveSpecialization &set(uint32_t constantId, bool value) {
+    return set(constantId, static_cast<VkBool32>(value ? VK_TRUE : VK_FALSE));
+  }
+
+  bool empty() const { return entries.empty(); }
+  const std::vector<VkSpecializationMapEntry> &getEntries() const { return entries; }
+  const std::vector<uint8_t> &getData() const { return data; }
+
+  // Points into this object, valid until it is modified
+  VkSpecializationInfo getInfo() const {
+    VkSpecializationInfo info{};
+    info.mapEntryCount = static_cast<uint32_t>(entries.size());
+    info.pMapEntries = entries.data();
+    info.dataSize = data.size();
+    info.pData = data.data();
+    return info;
+  }
+
+ private:
+  std::vector<VkSpecializationMapEntry> entries;
+  std::vector<uint8_t> data;
+};
+
 struct PipelineConfigInfo {
   PipelineConfigInfo(const PipelineConfigInfo&) = delete;
   PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
@@ -26,6 +69,9 @@ struct PipelineConfigInfo {
   VkPipelineLayout pipelineLayout = nullptr;
   VkRenderPass renderPass = nullptr;
   uint32_t subpass = 0;
+  // constants the shaders are compiled with, empty keeps the shaders' defaults
+  LveSpecialization vertSpecialization{};
+  LveSpecialization fragSpecialization{};
 };
 
 class LvePipeline {
@@ -41,22 +87,28 @@ class LvePipeline {
   LvePipeline& operator=(const LvePipeline&) = delete;
 
   void bind(VkCommandBuffer commandBuffer);
+  // False for a pipeline requested from LvePipelineRegistry until it was compiled
+  bool isReady() const { return graphicsPipeline != VK_NULL_HANDLE; }
 
   static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
- private:
+  // Reads a file relative to ENGINE_DIR, eg a compiled shader
   static std::vector<char> readFile(const std::string& filepath);
 
-  void createGraphicsPipeline(
-      const std::string& vertFilepath,
-      const std::string& fragFilepath,
-      const PipelineConfigInfo& configInfo);
+  static VkShaderModule createShaderModule(LveDevice& device, const std::vector<char>& code);
 
-  void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+ private:
+  friend class LvePipelineRegistry;
+
+  // created later by the registry, from shader modules the registry owns
+  explicit LvePipeline(LveDevice& device) : lveDevice{device} {}
+
+  void createGraphicsPipeline(
+      VkShaderModule vertModule, VkShaderModule fragModule, const PipelineConfigInfo& configInfo);
 
   LveDevice& lveDevice;
-  VkPipeline graphicsPipeline;
-  VkShaderModule vertShaderModule;
-  VkShaderModule fragShaderModule;
+  VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+  VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+  VkShaderModule fragShaderModule = VK_NULL_HANDLE;
 };
 }  // namespace lve
@@ -0,0 +1,309 @@
+#include "lve_pipeline_registry.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace lve {
+
+namespace {
+
+// Packs the fields of the pipeline state into a string, field by field so padding and pointers
+// never take part in the comparison
+class KeyWriter {
+ public:
+  template <typename T>
+  void add(const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value, "only plain values can be keyed");
+    key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+  void add(const std::string &text) {
+    add(static_cast<uint64_t>(text.size()));
+    key.append(text);
+  }
+  void addSpecialization(const LveSpecialization &specialization) {
+    add(specialization.getEntries().size());
+    for (auto &entry : specialization.getEntries()) {
+      add(entry.constantID);
+      add(entry.offset);
+      add(entry.size);
+    }
+    add(specialization.getData().size());
+    key.append(
+        reinterpret_cast<const char *>(specialization.getData().data()),
+        specialization.getData().size());
+  }
+  void addStencil(const VkStencilOpState &op) {
+    add(op.failOp);
+    add(op.passOp);
+    add(op.depthFailOp);
+    add(op.compareOp);
+    add(op.compareMask);
+    add(op.writeMask);
+    add(op.reference);
+  }
+
+  std::string key;
+};
+
+std::string graphicsKey(
+    const std::string &vertFilepath,
+    const std::string &fragFilepath,
+    const PipelineConfigInfo &configInfo) {
+  KeyWriter writer;
+  writer.add(vertFilepath);
+  writer.add(fragFilepath);
+
+  writer.add(configInfo.bindingDescriptions.size());
+  for (auto &binding : configInfo.bindingDescriptions) {
+    writer.add(binding.binding);
+    writer.add(binding.stride);
+    writer.add(binding.inputRate);
+  }
+  writer.add(configInfo.attributeDescriptions.size());
+  for (auto &attribute : configInfo.attributeDescriptions) {
+    writer.add(attribute.location);
+    writer.add(attribute.binding);
+    writer.add(attribute.format);
+    writer.add(attribute.offset);
+  }
+
+  writer.add(configInfo.viewportInfo.viewportCount);
+  writer.add(configInfo.viewportInfo.scissorCount);
+  writer.add(configInfo.inputAssemblyInfo.topology);
+  writer.add(configInfo.inputAssemblyInfo.primitiveRestartEnable);
+
+  auto &raster = configInfo.rasterizationInfo;
+  writer.add(raster.depthClampEnable);
+  writer.add(raster.rasterizerDiscardEnable);
+  writer.add(raster.polygonMode);
+  writer.add(raster.cullMode);
+  writer.add(raster.frontFace);
+  writer.add(raster.depthBiasEnable);
+  writer.add(raster.depthBiasConstantFactor);
+  writer.add(raster.depthBiasClamp);
+  writer.add(raster.depthBiasSlopeFactor);
+  writer.add(raster.lineWidth);
+
+  auto &multisample = configInfo.multisampleInfo;
+  writer.add(multisample.rasterizationSamples);
+  writer.add(multisample.sampleShadingEnable);
+  writer.add(multisample.minSampleShading);
+  writer.add(multisample.alphaToCoverageEnable);
+  writer.add(multisample.alphaToOneEnable);
+
+  auto &blend = configInfo.colorBlendInfo;
+  writer.add(blend.logicOpEnable);
+  writer.add(blend.logicOp);
+  writer.add(blend.attachmentCount);
+  for (uint32_t i = 0; i < blend.attachmentCount; i++) {
+    auto &attachment = blend.pAttachments[i];
+    writer.add(attachment.blendEnable);
+    writer.add(attachment.srcColorBlendFactor);
+    writer.add(attachment.dstColorBlendFactor);
+    writer.add(attachment.colorBlendOp);
+    writer.add(attachment.srcAlphaBlendFactor);
+    writer.add(attachment.dstAlphaBlendFactor);
+    writer.add(attachment.alphaBlendOp);
+    writer.add(attachment.colorWriteMask);
+  }
+  for (float constant : blend.blendConstants) {
+    writer.add(constant);
+  }
+
+  auto &depthStencil = configInfo.depthStencilInfo;
+  writer.add(depthStencil.depthTestEnable);
+  writer.add(depthStencil.depthWriteEnable);
+  writer.add(depthStencil.depthCompareOp);
+  writer.add(depthStencil.depthBoundsTestEnable);
+  writer.add(depthStencil.stencilTestEnable);
+  writer.addStencil(depthStencil.front);
+  writer.addStencil(depthStencil.back);
+  writer.add(depthStencil.minDepthBounds);
+  writer.add(depthStencil.maxDepthBounds);
+
+  auto &dynamicState = configInfo.dynamicStateInfo;
+  writer.add(dynamicState.dynamicStateCount);
+  for (uint32_t i = 0; i < dynamicState.dynamicStateCount; i++) {
+    writer.add(dynamicState.pDynamicStates[i]);
+  }
+
+  writer.add(configInfo.pipelineLayout);
+  writer.add(configInfo.renderPass);
+  writer.add(configInfo.subpass);
+  writer.addSpecialization(configInfo.vertSpecialization);
+  writer.addSpecialization(configInfo.fragSpecialization);
+  return std::move(writer.key);
+}
+
+}  // namespace
+
+LvePipelineRegistry::~LvePipelineRegistry() {
+  for (auto &kv : shaderModules) {
+    vkDestroyShaderModule(lveDevice.device(), kv.second, nullptr);
+  }
+}
+
+VkShaderModule LvePipelineRegistry::getShaderModule(const std::string &filepath) {
+  auto it = shaderModules.find(filepath);
+  if (it != shaderModules.end()) {
+    return it->second;
+  }
+  VkShaderModule shaderModule =
+      LvePipeline::createShaderModule(lveDevice, LvePipeline::readFile(filepath));
+  shaderModules.emplace(filepath, shaderModule);
+  stats.shaderModules++;
+  return shaderModule;
+}
+
+std::shared_ptr<LvePipeline> LvePipelineRegistry::requestGraphics(
+    const std::string &vertFilepath,
+    const std::string &fragFilepath,
+    const PipelineConfigInfo &configInfo) {
+  // state the copy below does not carry over
+  assert(
+      configInfo.viewportInfo.pViewports == nullptr &&
+      configInfo.viewportInfo.pScissors == nullptr &&
+      "Registry pipelines must use dynamic viewport and scissor");
+  assert(
+      configInfo.multisampleInfo.pSampleMask == nullptr &&
+      "Registry pipelines cannot use a sample mask");
+
+  std::string key = graphicsKey(vertFilepath, fragFilepath, configInfo);
+  auto &entry = graphicsPipelines[key];
+  if (auto existing = entry.lock()) {
+    stats.pipelinesShared++;
+    return existing;
+  }
+
+  std::shared_ptr<LvePipeline> pipeline{new LvePipeline(lveDevice)};
+  entry = pipeline;
+
+  Pending request{};
+  request.graphics = pipeline;
+  request.firstModule = getShaderModule(vertFilepath);
+  request.secondModule = getShaderModule(fragFilepath);
+  request.config.reset(new PipelineConfigInfo{});
+  PipelineConfigInfo &config = *request.config;
+  config.bindingDescriptions = configInfo.bindingDescriptions;
+  config.attributeDescriptions = configInfo.attributeDescriptions;
+  config.viewportInfo = configInfo.viewportInfo;
+  config.inputAssemblyInfo = configInfo.inputAssemblyInfo;
+  config.rasterizationInfo = configInfo.rasterizationInfo;
+  config.multisampleInfo = configInfo.multisampleInfo;
+  config.colorBlendAttachment = configInfo.colorBlendAttachment;
+  config.colorBlendInfo = configInfo.colorBlendInfo;
+  config.depthStencilInfo = configInfo.depthStencilInfo;
+  config.dynamicStateInfo = configInfo.dynamicStateInfo;
+  config.pipelineLayout = configInfo.pipelineLayout;
+  config.renderPass = configInfo.renderPass;
+  config.subpass = configInfo.subpass;
+  config.vertSpecialization = configInfo.vertSpecialization;
+  config.fragSpecialization = configInfo.fragSpecialization;
+
+  request.blendAttachments.assign(
+      configInfo.colorBlendInfo.pAttachments,
+      configInfo.colorBlendInfo.pAttachments + configInfo.colorBlendInfo.attachmentCount);
+  config.colorBlendInfo.pAttachments = request.blendAttachments.data();
+  config.dynamicStateEnables.assign(
+      configInfo.dynamicStateInfo.pDynamicStates,
+      configInfo.dynamicStateInfo.pDynamicStates + configInfo.dynamicStateInfo.dynamicStateCount);
+  config.dynamicStateInfo.pDynamicStates = config.dynamicStateEnables.data();
+
+  pending.push_back(std::move(request));
+  return pipeline;
+}
+
+std::shared_ptr<LveComputePipeline> LvePipelineRegistry::requestCompute(
+    const std::string &compFilepath, VkPipelineLayout pipelineLayout) {
+  KeyWriter writer;
+  writer.add(compFilepath);
+  writer.add(pipelineLayout);
+  auto &entry = computePipelines[writer.key];
+  if (auto existing = entry.lock()) {
+    stats.pipelinesShared++;
+    return existing;
+  }
+
+  std::shared_ptr<LveComputePipeline> pipeline{new LveComputePipeline(lveDevice)};
+  entry = pipeline;
+
+  Pending request{};
+  request.compute = pipeline;
+  request.firstModule = getShaderModule(compFilepath);
+  request.computeLayout = pipelineLayout;
+  pending.push_back(std::move(request));
+  return pipeline;
+}
+
+void LvePipelineRegistry::compile(Pending &request) {
+  if (auto pipeline = request.graphics.lock()) {
+    pipeline->createGraphicsPipeline(request.firstModule, request.secondModule, *request.config);
+  } else if (auto pipeline = request.compute.lock()) {
+    pipeline->createComputePipeline(request.firstModule, request.computeLayout);
+  }
+}
+
+void LvePipelineRegistry::compilePending(LveThreadPool *threadPool) {
+  // drop requests whose users are already gone
+  pending.erase(
+      std::remove_if(
+          pending.begin(),
+          pending.end(),
+          [](const Pending &request) {
+            return request.graphics.expired() && request.compute.expired();
+          }),
+      pending.end());
+  if (pending.empty()) {
+    return;
+  }
+
+  struct Work {
+    std::vector<Pending> requests;
+    std::atomic<uint32_t> next{0};
+    std::atomic<uint32_t> done{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+  };
+  auto work = std::make_shared<Work>();
+  work->requests = std::move(pending);
+  pending.clear();
+  uint32_t count = static_cast<uint32_t>(work->requests.size());
+
+  // the pipeline cache is internally synchronized, so pipelines are claimed one at a time by the
+  // calling thread and the workers alike. Jobs that only start once everything was claimed
+  // return without touching the registry.
+  auto process = [work, count]() {
+    uint32_t index;
+    while ((index = work->next.fetch_add(1)) < count) {
+      try {
+        compile(work->requests[index]);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock{work->errorMutex};
+        work->error = std::current_exception();
+      }
+      work->done.fetch_add(1, std::memory_order_release);
+    }
+  };
+  uint32_t helpers = threadPool != nullptr ? std::min(threadPool->getThreadCount(), count - 1) : 0;
+  for (uint32_t i = 0; i < helpers; i++) {
+    threadPool->submit(process);
+  }
+  process();
+  while (work->done.load(std::memory_order_acquire) < count) {
+    std::this_thread::yield();
+  }
+
+  if (work->error) {
+    std::rethrow_exception(work->error);
+  }
+  stats.pipelinesCreated += count;
+}
+
+}  // namespace lve
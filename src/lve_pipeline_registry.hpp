@@ -0,0 +1,79 @@
+#pragma once
+
+#include "lve_compute_pipeline.hpp"
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_thread_pool.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+// Hands out pipelines shared between everyone requesting the same shaders and state. A graphics
+// pipeline is keyed by its shader paths and every field of its PipelineConfigInfo, including
+// layout, render pass and subpass, a compute pipeline by its shader path and layout. The registry
+// only keeps weak references, a pipeline is destroyed with its last user. Shader modules are
+// loaded once per path and owned by the registry for its lifetime.
+//
+// Requested pipelines are created later, all at once by compilePending, so that load time
+// compiles can be spread over the thread pool; until then isReady is false. Requests must come
+// from a single thread.
+class LvePipelineRegistry {
+ public:
+  struct Stats {
+    uint32_t pipelinesCreated = 0;
+    // requests answered with a pipeline that already existed or was already pending
+    uint32_t pipelinesShared = 0;
+    uint32_t shaderModules = 0;
+  };
+
+  explicit LvePipelineRegistry(LveDevice &device) : lveDevice{device} {}
+  ~LvePipelineRegistry();
+
+  LvePipelineRegistry(const LvePipelineRegistry &) = delete;
+  LvePipelineRegistry &operator=(const LvePipelineRegistry &) = delete;
+
+  // configInfo is copied, it does not have to outlive the call
+  std::shared_ptr<LvePipeline> requestGraphics(
+      const std::string &vertFilepath,
+      const std::string &fragFilepath,
+      const PipelineConfigInfo &configInfo);
+  std::shared_ptr<LveComputePipeline> requestCompute(
+      const std::string &compFilepath, VkPipelineLayout pipelineLayout);
+
+  // Creates every pipeline requested since the last call whose users still hold it, on the
+  // calling thread and the pool's workers. Returns once all of them exist.
+  void compilePending(LveThreadPool *threadPool = nullptr);
+  bool hasPending() const { return !pending.empty(); }
+
+  const Stats &getStats() const { return stats; }
+
+ private:
+  struct Pending {
+    std::weak_ptr<LvePipeline> graphics;
+    std::weak_ptr<LveComputePipeline> compute;
+    VkShaderModule firstModule = VK_NULL_HANDLE;   // vertex or compute
+    VkShaderModule secondModule = VK_NULL_HANDLE;  // fragment
+    // deep copy of the requested state, its pointers refer to the copy's own storage
+    std::unique_ptr<PipelineConfigInfo> config;
+    std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+    VkPipelineLayout computeLayout = VK_NULL_HANDLE;
+  };
+
+  VkShaderModule getShaderModule(const std::string &filepath);
+  static void compile(Pending &pending);
+
+  LveDevice &lveDevice;
+  std::unordered_map<std::string, VkShaderModule> shaderModules;
+  std::unordered_map<std::string, std::weak_ptr<LvePipeline>> graphicsPipelines;
+  std::unordered_map<std::string, std::weak_ptr<LveComputePipeline>> computePipelines;
+  std::vector<Pending> pending;
+  Stats stats;
+};
+
+}  // namespace lve
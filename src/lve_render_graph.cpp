@@ -0,0 +1,820 @@
+#include "lve_render_graph.hpp"
+
+#include "lve_deletion_queue.hpp"
+#include "lve_gpu_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+
+constexpr VkAccessFlags WRITE_ACCESS =
+    VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT |
+    VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+constexpr VkPipelineStageFlags DEPTH_TEST_STAGES =
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+bool hasDepth(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool hasStencil(VkFormat format) {
+  return format == VK_FORMAT_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT ||
+         format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+// transitions on combined formats must name both aspects in Vulkan 1.0
+VkImageAspectFlags barrierAspect(VkFormat format) {
+  VkImageAspectFlags aspect = (hasDepth(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : 0) |
+                              (hasStencil(format) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+  return aspect != 0 ? aspect : VkImageAspectFlags{VK_IMAGE_ASPECT_COLOR_BIT};
+}
+
+// views of depth formats only see depth, so they can be both attached and sampled
+VkImageAspectFlags viewAspect(VkFormat format) {
+  if (hasDepth(format)) return VK_IMAGE_ASPECT_DEPTH_BIT;
+  return hasStencil(format) ? VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+}
+
+VkImageUsageFlags usageFor(const LveImageAccess &access) {
+  VkImageUsageFlags usage = 0;
+  switch (access.layout) {
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+      usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+      usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+      usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+      usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+      break;
+    default:
+      break;
+  }
+  if (access.access & (VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)) {
+    usage |= access.layout == VK_IMAGE_LAYOUT_GENERAL ? VK_IMAGE_USAGE_STORAGE_BIT
+                                                      : VK_IMAGE_USAGE_SAMPLED_BIT;
+  }
+  if (access.access & VK_ACCESS_INPUT_ATTACHMENT_READ_BIT) {
+    usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+  }
+  return usage;
+}
+
+uint64_t packExtent(VkExtent2D extent) {
+  return static_cast<uint64_t>(extent.width) << 32 | extent.height;
+}
+
+}  // namespace
+
+void LveRenderGraph::PassBuilder::writeColor(ImageHandle image) {
+  addAccess(
+      image,
+      {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+       VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT},
+      true,
+      Attachment::Color);
+}
+
+void LveRenderGraph::PassBuilder::writeColor(
+    ImageHandle image, const VkClearColorValue &clearColor) {
+  VkClearValue clearValue{};
+  clearValue.color = clearColor;
+  addAccess(
+      image,
+      {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+       VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT},
+      true,
+      Attachment::Color,
+      &clearValue);
+}
+
+void LveRenderGraph::PassBuilder::writeDepth(ImageHandle image) {
+  addAccess(
+      image,
+      {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+       DEPTH_TEST_STAGES,
+       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT},
+      true,
+      Attachment::Depth);
+}
+
+void LveRenderGraph::PassBuilder::writeDepth(
+    ImageHandle image, const VkClearDepthStencilValue &clearDepth) {
+  VkClearValue clearValue{};
+  clearValue.depthStencil = clearDepth;
+  addAccess(
+      image,
+      {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+       DEPTH_TEST_STAGES,
+       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT},
+      true,
+      Attachment::Depth,
+      &clearValue);
+}
+
+void LveRenderGraph::PassBuilder::readDepth(ImageHandle image) {
+  addAccess(
+      image,
+      {VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+       DEPTH_TEST_STAGES,
+       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT},
+      false,
+      Attachment::Depth);
+}
+
+void LveRenderGraph::PassBuilder::readSampled(ImageHandle image, VkPipelineStageFlags stages) {
+  addAccess(
+      image,
+      {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, stages, VK_ACCESS_SHADER_READ_BIT},
+      false);
+}
+
+void LveRenderGraph::PassBuilder::readStorage(ImageHandle image, VkPipelineStageFlags stages) {
+  addAccess(image, {VK_IMAGE_LAYOUT_GENERAL, stages, VK_ACCESS_SHADER_READ_BIT}, false);
+}
+
+void LveRenderGraph::PassBuilder::writeStorage(ImageHandle image, VkPipelineStageFlags stages) {
+  addAccess(
+      image,
+      {VK_IMAGE_LAYOUT_GENERAL, stages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT},
+      true);
+}
+
+void LveRenderGraph::PassBuilder::read(ImageHandle image, const LveImageAccess &access) {
+  addAccess(image, access, false);
+}
+
+void LveRenderGraph::PassBuilder::write(ImageHandle image, const LveImageAccess &access) {
+  addAccess(image, access, true);
+}
+
+void LveRenderGraph::PassBuilder::setSideEffects() { graph.passes[passIndex].sideEffects = true; }
+
+void LveRenderGraph::PassBuilder::useSecondaryCommandBuffers() {
+  graph.passes[passIndex].secondary = true;
+}
+
+void LveRenderGraph::PassBuilder::addAccess(
+    ImageHandle image,
+    const LveImageAccess &access,
+    bool write,
+    Attachment attachment,
+    const VkClearValue *clearValue) {
+  assert(image.isValid() && image.index < graph.resources.size() && "Unknown graph image");
+  Pass &pass = graph.passes[passIndex];
+  assert(
+      std::none_of(
+          pass.accesses.begin(),
+          pass.accesses.end(),
+          [&](const Access &other) { return other.image == image.index; }) &&
+      "A pass can only access an image once");
+  assert(
+      (attachment != Attachment::Depth ||
+       std::none_of(
+           pass.accesses.begin(),
+           pass.accesses.end(),
+           [](const Access &other) { return other.attachment == Attachment::Depth; })) &&
+      "A pass can only have one depth attachment");
+
+  Access entry{};
+  entry.image = image.index;
+  entry.usage = access;
+  entry.write = write;
+  entry.clear = clearValue != nullptr;
+  entry.attachment = attachment;
+  if (clearValue != nullptr) {
+    entry.clearValue = *clearValue;
+  }
+  pass.accesses.push_back(entry);
+}
+
+LveRenderGraph::LveRenderGraph(LveDevice &device) : lveDevice{device} {}
+
+LveRenderGraph::~LveRenderGraph() { releaseCompilation(); }
+
+void LveRenderGraph::reset(VkExtent2D frameExtent) {
+  this->frameExtent = frameExtent;
+  resources.clear();
+  passes.clear();
+  declarationKey.clear();
+  appendKey(packExtent(frameExtent));
+}
+
+LveRenderGraph::ImageHandle LveRenderGraph::importImage(
+    const std::string &name, const ImportedImage &image) {
+  resources.push_back({name, true, image});
+  appendKey(1);
+  appendKey(std::hash<std::string>{}(name));
+  appendKey(image.format);
+  appendKey(packExtent(image.extent));
+  appendKey(static_cast<uint64_t>(image.initialLayout) << 32 | image.finalLayout);
+  appendKey(static_cast<uint64_t>(image.initialStages) << 32 | image.initialAccess);
+  appendKey(static_cast<uint64_t>(image.finalStages) << 32 | image.finalAccess);
+  return {static_cast<uint32_t>(resources.size() - 1)};
+}
+
+LveRenderGraph::ImageHandle LveRenderGraph::createImage(
+    const std::string &name, const ImageDesc &desc) {
+  ImportedImage image{};
+  image.format = desc.format;
+  image.extent = desc.extent.width != 0 && desc.extent.height != 0 ? desc.extent : frameExtent;
+  resources.push_back({name, false, image});
+  appendKey(2);
+  appendKey(std::hash<std::string>{}(name));
+  appendKey(image.format);
+  appendKey(packExtent(image.extent));
+  return {static_cast<uint32_t>(resources.size() - 1)};
+}
+
+void LveRenderGraph::addPass(const std::string &name, const SetupFn &setup, ExecuteFn execute) {
+  uint32_t passIndex = static_cast<uint32_t>(passes.size());
+  passes.emplace_back();
+  passes.back().name = name;
+  PassBuilder builder{*this, passIndex};
+  setup(builder);
+
+  Pass &pass = passes[passIndex];
+  pass.execute = std::move(execute);
+  appendKey(3);
+  appendKey(std::hash<std::string>{}(name));
+  appendKey(static_cast<uint64_t>(pass.sideEffects) << 1 | pass.secondary);
+  for (const Access &access : pass.accesses) {
+    appendKey(
+        static_cast<uint64_t>(access.image) << 32 | static_cast<uint64_t>(access.attachment) << 2 |
+        static_cast<uint64_t>(access.write) << 1 | access.clear);
+    appendKey(static_cast<uint64_t>(access.usage.layout) << 32 | access.usage.access);
+    appendKey(access.usage.stages);
+  }
+}
+
+void LveRenderGraph::compile() {
+  if (compiled && declarationKey == compiledKey) {
+    return;
+  }
+  if (compiled) {
+    releaseCompilation();
+  }
+
+  std::vector<uint32_t> kept;
+  cullPasses(kept);
+  for (uint32_t pass : kept) {
+    CompiledPass compiledPass{};
+    compiledPass.pass = pass;
+    plan.push_back(std::move(compiledPass));
+  }
+  createTransientImages(kept);
+  planBarriers();
+
+  compiledKey = declarationKey;
+  compiled = true;
+  stats.compileCount++;
+  stats.executedPasses = static_cast<uint32_t>(kept.size());
+  stats.culledPasses = static_cast<uint32_t>(passes.size() - kept.size());
+}
+
+void LveRenderGraph::cullPasses(std::vector<uint32_t> &kept) const {
+  // walking backwards, an image is needed when a later kept pass or the graph's output reads
+  // its current contents. Writes that don't clear may keep parts of what was there and count as
+  // reads too.
+  std::vector<bool> needed(resources.size());
+  for (size_t i = 0; i < resources.size(); i++) {
+    const Resource &resource = resources[i];
+    needed[i] = resource.imported && resource.image.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+  }
+
+  for (uint32_t p = static_cast<uint32_t>(passes.size()); p-- > 0;) {
+    const Pass &pass = passes[p];
+    bool keep = pass.sideEffects ||
+                std::any_of(pass.accesses.begin(), pass.accesses.end(), [&](const Access &access) {
+                  return access.write && needed[access.image];
+                });
+    if (!keep) {
+      continue;
+    }
+    kept.push_back(p);
+    for (const Access &access : pass.accesses) {
+      needed[access.image] = !access.clear;
+    }
+  }
+  std::reverse(kept.begin(), kept.end());
+}
+
+void LveRenderGraph::createTransientImages(const std::vector<uint32_t> &kept) {
+  size_t resourceCount = resources.size();
+  std::vector<uint32_t> firstUse(resourceCount, ~0u);
+  std::vector<uint32_t> lastUse(resourceCount, 0);
+  std::vector<VkImageUsageFlags> usage(resourceCount, 0);
+  // stages and writes a later user of the same memory has to wait for
+  std::vector<VkPipelineStageFlags> endStages(resourceCount, 0);
+  std::vector<VkAccessFlags> endWrites(resourceCount, 0);
+  for (uint32_t i = 0; i < kept.size(); i++) {
+    for (const Access &access : passes[kept[i]].accesses) {
+      uint32_t r = access.image;
+      firstUse[r] = std::min(firstUse[r], i);
+      lastUse[r] = i;
+      usage[r] |= usageFor(access.usage);
+      if (access.write) {
+        endStages[r] = access.usage.stages;
+        endWrites[r] = access.usage.access & WRITE_ACCESS;
+      } else {
+        endStages[r] |= access.usage.stages;
+      }
+    }
+  }
+
+  transientImages.assign(resourceCount, TransientImage{});
+  initialStates.resize(resourceCount);
+  std::vector<uint32_t> order;
+  for (uint32_t r = 0; r < resourceCount; r++) {
+    const ImportedImage &image = resources[r].image;
+    if (resources[r].imported) {
+      initialStates[r] =
+          {image.initialLayout, image.initialStages, image.initialAccess, 0, 0};
+    } else if (firstUse[r] != ~0u) {
+      const std::vector<Access> &accesses = passes[kept[firstUse[r]]].accesses;
+      assert(
+          std::any_of(
+              accesses.begin(),
+              accesses.end(),
+              [r](const Access &access) { return access.image == r && access.write; }) &&
+          "Transient images must be written before they are read");
+      (void)accesses;
+      order.push_back(r);
+    }
+  }
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return firstUse[a] < firstUse[b];
+  });
+
+  // greedy interval assignment: each image goes into the compatible block whose previous user
+  // is done with it and that has to grow the least, or a new block
+  struct Block {
+    VkMemoryRequirements requirements;
+    uint32_t lastUse;
+    std::vector<uint32_t> users;
+  };
+  std::vector<Block> blocks;
+  std::vector<uint32_t> blockOf(resourceCount, 0);
+  for (uint32_t r : order) {
+    const ImportedImage &desc = resources[r].image;
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = desc.extent.width;
+    imageInfo.extent.height = desc.extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = desc.format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage[r];
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateImage(lveDevice.device(), &imageInfo, nullptr, &transientImages[r].image) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create render graph image!");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(lveDevice.device(), transientImages[r].image, &requirements);
+
+    uint32_t best = static_cast<uint32_t>(blocks.size());
+    VkDeviceSize bestGrowth = 0;
+    for (uint32_t b = 0; b < blocks.size(); b++) {
+      const Block &block = blocks[b];
+      if (block.lastUse >= firstUse[r] ||
+          (block.requirements.memoryTypeBits & requirements.memoryTypeBits) == 0) {
+        continue;
+      }
+      VkDeviceSize growth = requirements.size > block.requirements.size
+                                ? requirements.size - block.requirements.size
+                                : 0;
+      if (best == blocks.size() || growth < bestGrowth ||
+          (growth == bestGrowth && block.requirements.size < blocks[best].requirements.size)) {
+        best = b;
+        bestGrowth = growth;
+      }
+    }
+    if (best == blocks.size()) {
+      blocks.push_back({requirements, lastUse[r], {}});
+    }
+    Block &block = blocks[best];
+    block.requirements.size = std::max(block.requirements.size, requirements.size);
+    block.requirements.alignment = std::max(block.requirements.alignment, requirements.alignment);
+    block.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+    block.lastUse = lastUse[r];
+    block.users.push_back(r);
+    blockOf[r] = best;
+  }
+
+  stats.transientImages = static_cast<uint32_t>(order.size());
+  stats.transientMemoryBlocks = static_cast<uint32_t>(blocks.size());
+  stats.transientBytes = 0;
+  for (const Block &block : blocks) {
+    transientMemory.push_back(
+        lveDevice.allocateMemory(block.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+    const LveAllocation &memory = transientMemory.back();
+    stats.transientBytes += block.requirements.size;
+
+    for (size_t u = 0; u < block.users.size(); u++) {
+      uint32_t r = block.users[u];
+      if (vkBindImageMemory(
+              lveDevice.device(),
+              transientImages[r].image,
+              memory.memory,
+              memory.offset) != VK_SUCCESS) {
+        throw std::runtime_error("failed to bind render graph image memory!");
+      }
+
+      VkImageViewCreateInfo viewInfo{};
+      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      viewInfo.image = transientImages[r].image;
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      viewInfo.format = resources[r].image.format;
+      viewInfo.subresourceRange = {viewAspect(resources[r].image.format), 0, 1, 0, 1};
+      if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &transientImages[r].view) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph image view!");
+      }
+
+      // contents never survive, but the memory's previous user has to be done with it: the image
+      // before it in this frame, or for the first one the block's last user of the frame before
+      uint32_t previous = block.users[(u + block.users.size() - 1) % block.users.size()];
+      initialStates[r] =
+          {VK_IMAGE_LAYOUT_UNDEFINED, endStages[previous], endWrites[previous], 0, 0};
+    }
+  }
+}
+
+void LveRenderGraph::planBarriers() {
+  size_t resourceCount = resources.size();
+  std::vector<ImageState> states = initialStates;
+  std::vector<uint32_t> lastUse(resourceCount, 0);
+  for (uint32_t i = 0; i < plan.size(); i++) {
+    for (const Access &access : passes[plan[i].pass].accesses) {
+      lastUse[access.image] = i;
+    }
+  }
+
+  auto addBarrier = [](BarrierBatch &batch,
+                       uint32_t image,
+                       const ImageState &state,
+                       VkPipelineStageFlags srcStages,
+                       const LveImageAccess &usage) {
+    batch.barriers.push_back(
+        {image, state.layout, usage.layout, state.writeAccess, usage.access});
+    batch.srcStages |= srcStages;
+    batch.dstStages |= usage.stages;
+  };
+
+  for (uint32_t i = 0; i < plan.size(); i++) {
+    CompiledPass &compiledPass = plan[i];
+    const Pass &pass = passes[compiledPass.pass];
+    std::vector<VkAttachmentDescription> descriptions;
+    uint32_t depthAttachment = ~0u;
+    VkAttachmentDescription depthDescription{};
+
+    for (uint32_t a = 0; a < pass.accesses.size(); a++) {
+      const Access &access = pass.accesses[a];
+      ImageState &state = states[access.image];
+      const LveImageAccess &usage = access.usage;
+      bool transition = state.layout != usage.layout;
+      bool contentsDefined = state.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+
+      // layout transitions and writes wait for earlier reads and writes, reads only for the
+      // last write unless it was already made visible to them
+      VkPipelineStageFlags srcStages =
+          transition || access.write ? state.writeStages | state.readStages : state.writeStages;
+      bool visible = (usage.stages & ~state.readStages) == 0 &&
+                     (usage.access & ~state.readAccess) == 0;
+      if (transition || (srcStages != 0 && (access.write || !visible))) {
+        addBarrier(compiledPass.barriers, access.image, state, srcStages, usage);
+      }
+
+      if (access.write) {
+        state = {usage.layout, usage.stages, usage.access & WRITE_ACCESS, 0, 0};
+      } else if (transition) {
+        state = {usage.layout, usage.stages, 0, usage.stages, usage.access};
+      } else {
+        state.readStages |= usage.stages;
+        state.readAccess |= usage.access;
+      }
+
+      if (access.attachment == PassBuilder::Attachment::None) {
+        continue;
+      }
+      const Resource &resource = resources[access.image];
+      bool output = resource.imported && resource.image.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+      VkAttachmentDescription description{};
+      description.format = resource.image.format;
+      description.samples = VK_SAMPLE_COUNT_1_BIT;
+      description.loadOp = access.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                           : contentsDefined || !access.write ? VK_ATTACHMENT_LOAD_OP_LOAD
+                                                              : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      description.storeOp = output || lastUse[access.image] > i ? VK_ATTACHMENT_STORE_OP_STORE
+                                                                : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      // the barriers above already moved the image into the layout the pass uses
+      description.initialLayout = usage.layout;
+      description.finalLayout = usage.layout;
+
+      // colors in declaration order, the depth attachment last
+      if (access.attachment == PassBuilder::Attachment::Depth) {
+        depthAttachment = a;
+        depthDescription = description;
+      } else {
+        compiledPass.attachments.push_back(a);
+        descriptions.push_back(description);
+      }
+    }
+    if (depthAttachment != ~0u) {
+      compiledPass.attachments.push_back(depthAttachment);
+      descriptions.push_back(depthDescription);
+    }
+
+    if (!descriptions.empty()) {
+      uint32_t firstImage = pass.accesses[compiledPass.attachments[0]].image;
+      compiledPass.extent = resources[firstImage].image.extent;
+      for (uint32_t a : compiledPass.attachments) {
+        VkExtent2D extent = resources[pass.accesses[a].image].image.extent;
+        assert(
+            extent.width == compiledPass.extent.width &&
+            extent.height == compiledPass.extent.height &&
+            "All attachments of a pass must have the same extent");
+      }
+      createRenderPass(compiledPass, descriptions);
+    }
+  }
+
+  // hand outputs over in the layout their next user expects
+  for (uint32_t r = 0; r < resourceCount; r++) {
+    const Resource &resource = resources[r];
+    ImageState &state = states[r];
+    if (!resource.imported || resource.image.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+        resource.image.finalLayout == state.layout) {
+      continue;
+    }
+    addBarrier(
+        finalBarriers,
+        r,
+        state,
+        state.writeStages | state.readStages,
+        {resource.image.finalLayout, resource.image.finalStages, resource.image.finalAccess});
+  }
+}
+
+void LveRenderGraph::createRenderPass(
+    CompiledPass &compiled, const std::vector<VkAttachmentDescription> &descriptions) {
+  const Pass &pass = passes[compiled.pass];
+  std::vector<VkAttachmentReference> colorReferences;
+  VkAttachmentReference depthReference{};
+  bool hasDepthAttachment = false;
+  for (uint32_t i = 0; i < compiled.attachments.size(); i++) {
+    VkAttachmentReference reference{i, descriptions[i].initialLayout};
+    if (pass.accesses[compiled.attachments[i]].attachment == PassBuilder::Attachment::Depth) {
+      depthReference = reference;
+      hasDepthAttachment = true;
+    } else {
+      colorReferences.push_back(reference);
+    }
+  }
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+  subpass.pColorAttachments = colorReferences.data();
+  subpass.pDepthStencilAttachment = hasDepthAttachment ? &depthReference : nullptr;
+
+  // no subpass dependencies, the graph's barriers before and after the pass order it
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+  renderPassInfo.pAttachments = descriptions.data();
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+
+  if (vkCreateRenderPass(lveDevice.device(), &renderPassInfo, nullptr, &compiled.renderPass) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create render graph render pass!");
+  }
+}
+
+void LveRenderGraph::releaseCompilation() {
+  // the last frames in flight may still use the images, render passes and framebuffers
+  resetFramebuffers();
+  std::vector<VkRenderPass> renderPasses;
+  for (CompiledPass &compiledPass : plan) {
+    if (compiledPass.renderPass != VK_NULL_HANDLE) {
+      renderPasses.push_back(compiledPass.renderPass);
+    }
+  }
+  LveDevice &device = lveDevice;
+  device.deletionQueue().push(
+      [&device, renderPasses, images = transientImages, memory = transientMemory]() mutable {
+        for (VkRenderPass renderPass : renderPasses) {
+          vkDestroyRenderPass(device.device(), renderPass, nullptr);
+        }
+        for (TransientImage &image : images) {
+          vkDestroyImageView(device.device(), image.view, nullptr);
+          vkDestroyImage(device.device(), image.image, nullptr);
+        }
+        for (LveAllocation &allocation : memory) {
+          device.freeMemory(allocation);
+        }
+      });
+  plan.clear();
+  finalBarriers = BarrierBatch{};
+  transientImages.clear();
+  transientMemory.clear();
+  compiledKey.clear();
+  compiled = false;
+}
+
+VkImage LveRenderGraph::getImage(ImageHandle image) const {
+  assert(image.isValid() && image.index < resources.size() && "Unknown graph image");
+  if (resources[image.index].imported) {
+    return resources[image.index].image.image;
+  }
+  return image.index < transientImages.size() ? transientImages[image.index].image
+                                              : VK_NULL_HANDLE;
+}
+
+VkImageView LveRenderGraph::getImageView(ImageHandle image) const {
+  assert(image.isValid() && image.index < resources.size() && "Unknown graph image");
+  if (resources[image.index].imported) {
+    return resources[image.index].image.view;
+  }
+  return image.index < transientImages.size() ? transientImages[image.index].view
+                                              : VK_NULL_HANDLE;
+}
+
+void LveRenderGraph::resetFramebuffers() {
+  std::vector<VkFramebuffer> framebuffers;
+  for (CompiledPass &compiledPass : plan) {
+    for (Framebuffer &framebuffer : compiledPass.framebuffers) {
+      framebuffers.push_back(framebuffer.framebuffer);
+    }
+    compiledPass.framebuffers.clear();
+  }
+  if (framebuffers.empty()) {
+    return;
+  }
+  LveDevice &device = lveDevice;
+  device.deletionQueue().push([&device, framebuffers]() {
+    for (VkFramebuffer framebuffer : framebuffers) {
+      vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
+    }
+  });
+}
+
+VkFramebuffer LveRenderGraph::getFramebuffer(CompiledPass &compiled) {
+  // imported views change from frame to frame, eg one per swap chain image
+  const Pass &pass = passes[compiled.pass];
+  std::vector<VkImageView> views;
+  views.reserve(compiled.attachments.size());
+  for (uint32_t a : compiled.attachments) {
+    views.push_back(getImageView({pass.accesses[a].image}));
+  }
+  for (const Framebuffer &framebuffer : compiled.framebuffers) {
+    if (framebuffer.views == views) {
+      return framebuffer.framebuffer;
+    }
+  }
+
+  VkFramebufferCreateInfo framebufferInfo{};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = compiled.renderPass;
+  framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+  framebufferInfo.pAttachments = views.data();
+  framebufferInfo.width = compiled.extent.width;
+  framebufferInfo.height = compiled.extent.height;
+  framebufferInfo.layers = 1;
+
+  VkFramebuffer framebuffer;
+  if (vkCreateFramebuffer(lveDevice.device(), &framebufferInfo, nullptr, &framebuffer) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create render graph framebuffer!");
+  }
+  compiled.framebuffers.push_back({std::move(views), framebuffer});
+  return framebuffer;
+}
+
+void LveRenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch &batch) {
+  if (batch.barriers.empty()) {
+    return;
+  }
+  barrierScratch.clear();
+  for (const BarrierTemplate &barrierTemplate : batch.barriers) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = barrierTemplate.srcAccess;
+    barrier.dstAccessMask = barrierTemplate.dstAccess;
+    barrier.oldLayout = barrierTemplate.oldLayout;
+    barrier.newLayout = barrierTemplate.newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = getImage({barrierTemplate.image});
+    barrier.subresourceRange = {
+        barrierAspect(resources[barrierTemplate.image].image.format),
+        0,
+        VK_REMAINING_MIP_LEVELS,
+        0,
+        VK_REMAINING_ARRAY_LAYERS};
+    barrierScratch.push_back(barrier);
+  }
+  // a batch that only transitions images nothing used before has nothing to wait for
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      batch.srcStages != 0 ? batch.srcStages
+                           : VkPipelineStageFlags{VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT},
+      batch.dstStages,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      static_cast<uint32_t>(barrierScratch.size()),
+      barrierScratch.data());
+  stats.barriers += static_cast<uint32_t>(barrierScratch.size());
+}
+
+void LveRenderGraph::execute(VkCommandBuffer commandBuffer, LveGpuProfiler *profiler) {
+  assert(compiled && declarationKey == compiledKey && "Compile the graph before executing it");
+  stats.barriers = 0;
+  for (CompiledPass &compiledPass : plan) {
+    recordBarriers(commandBuffer, compiledPass.barriers);
+    const Pass &pass = passes[compiledPass.pass];
+    // statistics queries can't stay active across secondary command buffers
+    LveGpuProfiler::Scope scope{profiler, commandBuffer, pass.name, !pass.secondary};
+    PassContext context{commandBuffer, compiledPass.renderPass, VK_NULL_HANDLE, frameExtent};
+    if (compiledPass.renderPass == VK_NULL_HANDLE) {
+      pass.execute(context);
+      continue;
+    }
+    context.framebuffer = getFramebuffer(compiledPass);
+    context.extent = compiledPass.extent;
+
+    clearScratch.assign(compiledPass.attachments.size(), VkClearValue{});
+    for (size_t i = 0; i < compiledPass.attachments.size(); i++) {
+      clearScratch[i] = pass.accesses[compiledPass.attachments[i]].clearValue;
+    }
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = compiledPass.renderPass;
+    renderPassInfo.framebuffer = context.framebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = compiledPass.extent;
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearScratch.size());
+    renderPassInfo.pClearValues = clearScratch.data();
+    vkCmdBeginRenderPass(
+        commandBuffer,
+        &renderPassInfo,
+        pass.secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                       : VK_SUBPASS_CONTENTS_INLINE);
+
+    if (!pass.secondary) {
+      VkViewport viewport{};
+      viewport.x = 0.0f;
+      viewport.y = 0.0f;
+      viewport.width = static_cast<float>(compiledPass.extent.width);
+      viewport.height = static_cast<float>(compiledPass.extent.height);
+      viewport.minDepth = 0.0f;
+      viewport.maxDepth = 1.0f;
+      VkRect2D scissor{{0, 0}, compiledPass.extent};
+      vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+      vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
+    pass.execute(context);
+    vkCmdEndRenderPass(commandBuffer);
+  }
+  recordBarriers(commandBuffer, finalBarriers);
+}
+
+}  // namespace lve
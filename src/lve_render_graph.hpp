@@ -0,0 +1,254 @@
+#pragma once
+
+#include "lve_device.hpp"
+
+// std
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+class LveGpuProfiler;
+
+// How a pass uses an image: the layout it needs and the stages / accesses touching it
+struct LveImageAccess {
+  VkImageLayout layout;
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+};
+
+// Frame graph over images. Every frame the passes are declared again, in execution order, with
+// the images they read and write; the graph then
+//  - culls passes whose results nothing consumes,
+//  - records the minimal image barriers and layout transitions between the ones left,
+//  - creates render passes and framebuffers for passes writing attachments,
+//  - places transient images whose lifetimes don't overlap in the same memory.
+// Compilation is cached and only redone when the declarations differ from the previous frame's,
+// which leaves the per frame cost at comparing them and recording the barriers. Buffers are not
+// tracked, passes synchronize their own buffer accesses.
+class LveRenderGraph {
+ public:
+  struct ImageHandle {
+    uint32_t index = ~0u;
+    bool isValid() const { return index != ~0u; }
+  };
+
+  struct ImageDesc {
+    VkFormat format;
+    // zero takes the frame extent given to reset
+    VkExtent2D extent{};
+  };
+
+  // An image owned outside the graph, eg a swap chain image. Its state going in and coming out
+  // of the graph describes what happens to it before and after the graph's passes.
+  struct ImportedImage {
+    VkImage image;
+    VkImageView view;
+    VkFormat format;
+    VkExtent2D extent;
+    // UNDEFINED discards the contents on first use
+    VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // earlier work on the image the first use has to wait for
+    VkPipelineStageFlags initialStages = 0;
+    VkAccessFlags initialAccess = 0;
+    // anything but UNDEFINED preserves the contents and makes the image an output of the graph
+    VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags finalStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    VkAccessFlags finalAccess = 0;
+  };
+
+  struct PassContext {
+    VkCommandBuffer commandBuffer;
+    // VK_NULL_HANDLE for passes without attachments, which run outside a render pass
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+    VkExtent2D extent;
+  };
+
+  class PassBuilder {
+   public:
+    // Color attachments are numbered in declaration order, the depth attachment follows them
+    void writeColor(ImageHandle image);
+    void writeColor(ImageHandle image, const VkClearColorValue &clearColor);
+    void writeDepth(ImageHandle image);
+    void writeDepth(ImageHandle image, const VkClearDepthStencilValue &clearDepth);
+    // depth test against the image without writing it
+    void readDepth(ImageHandle image);
+
+    void readSampled(ImageHandle image, VkPipelineStageFlags stages);
+    void readStorage(ImageHandle image, VkPipelineStageFlags stages);
+    void writeStorage(ImageHandle image, VkPipelineStageFlags stages);
+    void read(ImageHandle image, const LveImageAccess &access);
+    void write(ImageHandle image, const LveImageAccess &access);
+
+    // Keeps the pass even when no other pass or output reads what it writes, eg because it
+    // writes buffers the graph does not see
+    void setSideEffects();
+    // Begins the render pass with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, the pass then
+    // only executes secondary buffers, which set their own viewport and scissor
+    void useSecondaryCommandBuffers();
+
+   private:
+    friend class LveRenderGraph;
+
+    enum class Attachment : uint8_t { None, Color, Depth };
+
+    PassBuilder(LveRenderGraph &graph, uint32_t passIndex) : graph{graph}, passIndex{passIndex} {}
+    void addAccess(
+        ImageHandle image,
+        const LveImageAccess &access,
+        bool write,
+        Attachment attachment = Attachment::None,
+        const VkClearValue *clearValue = nullptr);
+
+    LveRenderGraph &graph;
+    uint32_t passIndex;
+  };
+
+  using SetupFn = std::function<void(PassBuilder &)>;
+  using ExecuteFn = std::function<void(const PassContext &)>;
+
+  struct Stats {
+    uint32_t compileCount = 0;
+    uint32_t executedPasses = 0;
+    uint32_t culledPasses = 0;
+    uint32_t barriers = 0;
+    uint32_t transientImages = 0;
+    uint32_t transientMemoryBlocks = 0;
+    VkDeviceSize transientBytes = 0;
+  };
+
+  explicit LveRenderGraph(LveDevice &device);
+  ~LveRenderGraph();
+
+  LveRenderGraph(const LveRenderGraph &) = delete;
+  LveRenderGraph &operator=(const LveRenderGraph &) = delete;
+
+  // Starts declaring a frame
+  void reset(VkExtent2D frameExtent);
+  ImageHandle importImage(const std::string &name, const ImportedImage &image);
+  ImageHandle createImage(const std::string &name, const ImageDesc &desc);
+  // setup runs immediately to declare the pass' images, execute runs from execute if the pass
+  // survives culling
+  void addPass(const std::string &name, const SetupFn &setup, ExecuteFn execute);
+
+  // Reuses the previous compilation when the frame was declared the same way. Otherwise the
+  // previous one goes to the device's deletion queue, which only happens when the declarations
+  // change, eg on resize.
+  void compile();
+  // Times every pass in a scope of profiler when one is given
+  void execute(VkCommandBuffer commandBuffer, LveGpuProfiler *profiler = nullptr);
+
+  // Hands the cached framebuffers to the device's deletion queue, call when imported image views
+  // were recreated without the declarations changing, eg the swap chain at the same extent
+  void resetFramebuffers();
+
+  // Image and view of a resource this frame, for transient ones only valid after compile
+  VkImage getImage(ImageHandle image) const;
+  VkImageView getImageView(ImageHandle image) const;
+  const Stats &getStats() const { return stats; }
+
+ private:
+  struct Access {
+    uint32_t image;
+    LveImageAccess usage;
+    bool write;
+    bool clear;
+    PassBuilder::Attachment attachment;
+    VkClearValue clearValue;
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<Access> accesses;
+    ExecuteFn execute;
+    bool sideEffects = false;
+    bool secondary = false;
+  };
+
+  struct Resource {
+    std::string name;
+    bool imported;
+    ImportedImage image;
+  };
+
+  struct BarrierTemplate {
+    uint32_t image;
+    VkImageLayout oldLayout;
+    VkImageLayout newLayout;
+    VkAccessFlags srcAccess;
+    VkAccessFlags dstAccess;
+  };
+
+  struct BarrierBatch {
+    std::vector<BarrierTemplate> barriers;
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+  };
+
+  struct Framebuffer {
+    std::vector<VkImageView> views;
+    VkFramebuffer framebuffer;
+  };
+
+  struct CompiledPass {
+    uint32_t pass;
+    BarrierBatch barriers;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    // index into the pass' accesses per attachment, colors first, then depth
+    std::vector<uint32_t> attachments;
+    VkExtent2D extent{};
+    std::vector<Framebuffer> framebuffers;
+  };
+
+  struct TransientImage {
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+  };
+
+  // what the graph knows about an image's last accesses while walking the passes
+  struct ImageState {
+    VkImageLayout layout;
+    // stages and writes of the last write or layout transition
+    VkPipelineStageFlags writeStages;
+    VkAccessFlags writeAccess;
+    // stages and accesses the last write was made visible to and that read it since
+    VkPipelineStageFlags readStages;
+    VkAccessFlags readAccess;
+  };
+
+  void appendKey(uint64_t value) { declarationKey.push_back(value); }
+  void cullPasses(std::vector<uint32_t> &kept) const;
+  void createTransientImages(const std::vector<uint32_t> &kept);
+  void planBarriers();
+  void createRenderPass(
+      CompiledPass &compiled, const std::vector<VkAttachmentDescription> &descriptions);
+  VkFramebuffer getFramebuffer(CompiledPass &compiled);
+  void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch &batch);
+  void releaseCompilation();
+
+  LveDevice &lveDevice;
+
+  // declared this frame
+  VkExtent2D frameExtent{};
+  std::vector<Resource> resources;
+  std::vector<Pass> passes;
+  std::vector<uint64_t> declarationKey;
+
+  // cached compilation, valid for compiledKey
+  std::vector<uint64_t> compiledKey;
+  bool compiled = false;
+  std::vector<CompiledPass> plan;
+  BarrierBatch finalBarriers;
+  std::vector<TransientImage> transientImages;  // by resource index
+  std::vector<ImageState> initialStates;        // by resource index
+  std::vector<LveAllocation> transientMemory;
+
+  std::vector<VkImageMemoryBarrier> barrierScratch;
+  std::vector<VkClearValue> clearScratch;
+  Stats stats;
+};
+
+}  // namespace lve
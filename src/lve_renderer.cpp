@@ -1,5 +1,7 @@
 #include "lve_renderer.hpp"
 
+#include "lve_deletion_queue.hpp"
+
 // std
 #include <array>
 #include <cassert>
@@ -7,13 +9,14 @@
 
 namespace lve {
 
-LveRenderer::LveRenderer(LveWindow& window, LveDevice& device)
-    : lveWindow{window}, lveDevice{device} {
+LveRenderer::LveRenderer(
+    LveWindow& window, LveDevice& device, const LveSwapChain::Settings& settings)
+    : lveWindow{window}, lveDevice{device}, gpuProfiler{device}, swapChainSettings{settings} {
   recreateSwapChain();
-  createCommandBuffers();
+  createCommandPools();
 }
 
-LveRenderer::~LveRenderer() { freeCommandBuffers(); }
+LveRenderer::~LveRenderer() { destroyCommandPools(); }
 
 void LveRenderer::recreateSwapChain() {
   auto extent = lveWindow.getExtent();
@@ -21,48 +24,79 @@ void LveRenderer::recreateSwapChain() {
     extent = lveWindow.getExtent();
     glfwWaitEvents();
   }
-  vkDeviceWaitIdle(lveDevice.device());
 
   if (lveSwapChain == nullptr) {
-    lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent);
+    lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, swapChainSettings);
   } else {
     std::shared_ptr<LveSwapChain> oldSwapChain = std::move(lveSwapChain);
-    lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, oldSwapChain);
+    lveSwapChain =
+        std::make_unique<LveSwapChain>(lveDevice, extent, swapChainSettings, oldSwapChain);
 
     if (!oldSwapChain->compareSwapFormats(*lveSwapChain.get())) {
       throw std::runtime_error("Swap chain image(or depth) format has changed!");
     }
+    // destroyed once the frames in flight which rendered to it completed
+    lveDevice.deletionQueue().push([oldSwapChain]() {});
   }
+  swapChainSettingsChanged = false;
+  swapChainGeneration++;
+}
+
+void LveRenderer::setSwapChainSettings(const LveSwapChain::Settings& settings) {
+  assert(
+      settings.framesInFlight >= 1 &&
+      settings.framesInFlight <= LveSwapChain::MAX_FRAMES_IN_FLIGHT &&
+      "frames in flight out of range");
+  swapChainSettings = settings;
+  swapChainSettingsChanged = true;
 }
 
-void LveRenderer::createCommandBuffers() {
+void LveRenderer::createCommandPools() {
+  commandPools.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
   commandBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
 
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = lveDevice.getCommandPool();
-  allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = lveDevice.findPhysicalQueueFamilies().graphicsFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  for (size_t i = 0; i < commandPools.size(); i++) {
+    if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &commandPools[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create frame command pool!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPools[i];
+    allocInfo.commandBufferCount = 1;
 
-  if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, commandBuffers.data()) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate command buffers!");
+    if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffers[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate command buffers!");
+    }
   }
 }
 
-void LveRenderer::freeCommandBuffers() {
-  vkFreeCommandBuffers(
-      lveDevice.device(),
-      lveDevice.getCommandPool(),
-      static_cast<uint32_t>(commandBuffers.size()),
-      commandBuffers.data());
+void LveRenderer::destroyCommandPools() {
+  // destroying a pool frees its command buffers
+  for (VkCommandPool pool : commandPools) {
+    vkDestroyCommandPool(lveDevice.device(), pool, nullptr);
+  }
+  commandPools.clear();
   commandBuffers.clear();
 }
 
 VkCommandBuffer LveRenderer::beginFrame() {
   assert(!isFrameStarted && "Can't call beginFrame while already in progress");
 
+  if (swapChainSettingsChanged) {
+    recreateSwapChain();
+  }
+
   auto result = lveSwapChain->acquireNextImage(&currentImageIndex);
+  lveDevice.deletionQueue().collect();
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     recreateSwapChain();
     return nullptr;
@@ -73,6 +107,11 @@ VkCommandBuffer LveRenderer::beginFrame() {
   }
 
   isFrameStarted = true;
+  // follows the swap chain, which cycles through only as many frames as its settings allow
+  currentFrameIndex = lveSwapChain->getCurrentFrame();
+
+  // acquireNextImage waited for this frame's previous submission, so its pool is free again
+  vkResetCommandPool(lveDevice.device(), commandPools[currentFrameIndex], 0);
 
   auto commandBuffer = getCurrentCommandBuffer();
   VkCommandBufferBeginInfo beginInfo{};
@@ -81,17 +120,20 @@ VkCommandBuffer LveRenderer::beginFrame() {
   if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
     throw std::runtime_error("failed to begin recording command buffer!");
   }
+  gpuProfiler.beginFrame(commandBuffer, currentFrameIndex);
   return commandBuffer;
 }
 
 void LveRenderer::endFrame() {
   assert(isFrameStarted && "Can't call endFrame while frame is not in progress");
   auto commandBuffer = getCurrentCommandBuffer();
+  gpuProfiler.endFrame(commandBuffer);
   if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
     throw std::runtime_error("failed to record command buffer!");
   }
 
   auto result = lveSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+  lveDevice.deletionQueue().endFrame(lveSwapChain->getFrameValue(currentFrameIndex));
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
       lveWindow.wasWindowResized()) {
     lveWindow.resetWindowResizedFlag();
@@ -101,10 +143,10 @@ void LveRenderer::endFrame() {
   }
 
   isFrameStarted = false;
-  currentFrameIndex = (currentFrameIndex + 1) % LveSwapChain::MAX_FRAMES_IN_FLIGHT;
 }
 
-void LveRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+void LveRenderer::beginSwapChainRenderPass(
+    VkCommandBuffer commandBuffer, VkSubpassContents contents) {
   assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
   assert(
       commandBuffer == getCurrentCommandBuffer() &&
@@ -124,7 +166,10 @@ void LveRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
   renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
   renderPassInfo.pClearValues = clearValues.data();
 
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+  if (contents != VK_SUBPASS_CONTENTS_INLINE) {
+    return;
+  }
 
   VkViewport viewport{};
   viewport.x = 0.0f;
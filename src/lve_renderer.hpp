@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lve_device.hpp"
+#include "lve_gpu_profiler.hpp"
 #include "lve_swap_chain.hpp"
 #include "lve_window.hpp"
 
@@ -12,7 +13,8 @@
 namespace lve {
 class LveRenderer {
  public:
-  LveRenderer(LveWindow &window, LveDevice &device);
+  LveRenderer(
+      LveWindow &window, LveDevice &device, const LveSwapChain::Settings &settings = {});
   ~LveRenderer();
 
   LveRenderer(const LveRenderer &) = delete;
@@ -20,8 +22,21 @@ class LveRenderer {
 
   VkRenderPass getSwapChainRenderPass() const { return lveSwapChain->getRenderPass(); }
   float getAspectRatio() const { return lveSwapChain->extentAspectRatio(); }
+  VkExtent2D getSwapChainExtent() const { return lveSwapChain->getSwapChainExtent(); }
+  VkFormat getSwapChainImageFormat() const { return lveSwapChain->getSwapChainImageFormat(); }
+  VkFormat getSwapChainDepthFormat() const { return lveSwapChain->getDepthFormat(); }
+  // Changes whenever the swap chain was recreated and with it its images and views
+  uint32_t getSwapChainGeneration() const { return swapChainGeneration; }
   bool isFrameInProgress() const { return isFrameStarted; }
 
+  const LveSwapChain::Settings &getSwapChainSettings() const { return swapChainSettings; }
+  VkPresentModeKHR getPresentMode() const { return lveSwapChain->getPresentMode(); }
+  // Takes effect by recreating the swap chain when the next frame begins
+  void setSwapChainSettings(const LveSwapChain::Settings &settings);
+
+  // Times every frame, scopes go into the command buffer beginFrame returned
+  LveGpuProfiler &getGpuProfiler() { return gpuProfiler; }
+
   VkCommandBuffer getCurrentCommandBuffer() const {
     assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
     return commandBuffers[currentFrameIndex];
@@ -32,22 +47,56 @@ class LveRenderer {
     return currentFrameIndex;
   }
 
+  // Swap chain image being rendered this frame and its depth attachment
+  VkImage getCurrentImage() const {
+    assert(isFrameStarted && "Cannot get image when frame not in progress");
+    return lveSwapChain->getImage(currentImageIndex);
+  }
+  VkImageView getCurrentImageView() const {
+    assert(isFrameStarted && "Cannot get image view when frame not in progress");
+    return lveSwapChain->getImageView(currentImageIndex);
+  }
+  VkImage getCurrentDepthImage() const {
+    assert(isFrameStarted && "Cannot get depth image when frame not in progress");
+    return lveSwapChain->getDepthImage(currentImageIndex);
+  }
+  VkImageView getCurrentDepthImageView() const {
+    assert(isFrameStarted && "Cannot get depth image view when frame not in progress");
+    return lveSwapChain->getDepthImageView(currentImageIndex);
+  }
+
+  VkFramebuffer getCurrentFrameBuffer() const {
+    assert(isFrameStarted && "Cannot get frame buffer when frame not in progress");
+    return lveSwapChain->getFrameBuffer(currentImageIndex);
+  }
+
   VkCommandBuffer beginFrame();
   void endFrame();
-  void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+  // With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass may only execute secondary
+  // buffers, which then set their own viewport and scissor
+  void beginSwapChainRenderPass(
+      VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
   void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
  private:
-  void createCommandBuffers();
-  void freeCommandBuffers();
+  void createCommandPools();
+  void destroyCommandPools();
+  // Replaces the swap chain without waiting for the device, the old one goes to the device's
+  // deletion queue
   void recreateSwapChain();
 
   LveWindow &lveWindow;
   LveDevice &lveDevice;
+  LveGpuProfiler gpuProfiler;
   std::unique_ptr<LveSwapChain> lveSwapChain;
+  LveSwapChain::Settings swapChainSettings;
+  bool swapChainSettingsChanged{false};
+  // one transient pool per frame in flight, reset in bulk once the frame's submission completed
+  std::vector<VkCommandPool> commandPools;
   std::vector<VkCommandBuffer> commandBuffers;
 
   uint32_t currentImageIndex;
+  uint32_t swapChainGeneration{0};
   int currentFrameIndex{0};
   bool isFrameStarted{false};
 };
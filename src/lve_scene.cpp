@@ -0,0 +1,48 @@
+#include "lve_scene.hpp"
+
+namespace lve {
+
+LveEntity LveScene::createEntity() {
+  if (!freeIndices.empty()) {
+    uint32_t index = freeIndices.back();
+    freeIndices.pop_back();
+    alive[index] = 1;
+    return LveEntity{index, generations[index]};
+  }
+  generations.push_back(0);
+  alive.push_back(1);
+  return LveEntity{static_cast<uint32_t>(generations.size() - 1), 0};
+}
+
+void LveScene::destroyEntity(LveEntity entity) {
+  if (!isAlive(entity)) return;
+  hierarchy.remove(entity);
+  transforms.remove(entity);
+  models.remove(entity);
+  colors.remove(entity);
+  pointLights.remove(entity);
+  generations[entity.index]++;
+  alive[entity.index] = 0;
+  freeIndices.push_back(entity.index);
+}
+
+bool LveScene::isAlive(LveEntity entity) const {
+  return entity.index < generations.size() && alive[entity.index] &&
+         generations[entity.index] == entity.generation;
+}
+
+LveEntity LveScene::createPointLight(float intensity, float radius, glm::vec3 color) {
+  LveEntity entity = createEntity();
+  transforms.add(entity).setScale({radius, 1.f, 1.f});
+  colors.add(entity, color);
+  pointLights.add(entity).lightIntensity = intensity;
+  return entity;
+}
+
+size_t LveScene::updateTransforms(LveThreadPool *threadPool) {
+  size_t rebuilt = transformUpdater.update(transforms.data(), transforms.size());
+  hierarchy.propagate(threadPool);
+  return rebuilt;
+}
+
+}  // namespace lve
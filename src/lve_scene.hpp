@@ -0,0 +1,59 @@
+#pragma once
+
+#include "lve_component_pool.hpp"
+#include "lve_game_object.hpp"
+#include "lve_hierarchy.hpp"
+#include "lve_model.hpp"
+#include "lve_transform.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Entities and their components, each component type stored in its own dense pool. Systems
+// iterate the pool of the component they care about, so entities without it are never visited.
+class LveScene {
+ public:
+  LveScene() = default;
+
+  LveScene(const LveScene &) = delete;
+  LveScene &operator=(const LveScene &) = delete;
+
+  LveEntity createEntity();
+  // Removes the entity and all of its components, its handle becomes stale
+  void destroyEntity(LveEntity entity);
+  bool isAlive(LveEntity entity) const;
+  size_t getEntityCount() const { return generations.size() - freeIndices.size(); }
+
+  // Entity with a transform, color and light, as LveGameObject::makePointLight
+  LveEntity createPointLight(
+      float intensity = 10.f, float radius = 0.1f, glm::vec3 color = glm::vec3(1.f));
+
+  // Attaches child below parent, see LveHierarchy::setParent
+  void setParent(LveEntity child, LveEntity parent) { hierarchy.setParent(child, parent); }
+  LveEntity getParent(LveEntity entity) const { return hierarchy.getParent(entity); }
+
+  // Rebuilds the cached matrices of transforms changed since the last call, then propagates
+  // world matrices through the hierarchy. Returns how many local matrices were rebuilt.
+  size_t updateTransforms(LveThreadPool *threadPool = nullptr);
+
+  LveComponentPool<TransformComponent> transforms;
+  LveComponentPool<std::shared_ptr<LveModel>> models;
+  LveComponentPool<glm::vec3> colors;
+  LveComponentPool<PointLightComponent> pointLights;
+
+  LveHierarchy hierarchy{transforms};
+
+ private:
+  std::vector<uint32_t> generations;
+  std::vector<uint8_t> alive;
+  std::vector<uint32_t> freeIndices;
+  LveTransformUpdater transformUpdater;
+};
+
+}  // namespace lve
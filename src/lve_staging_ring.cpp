@@ -0,0 +1,65 @@
+#include "lve_staging_ring.hpp"
+
+// std
+#include <cassert>
+
+namespace lve {
+
+LveStagingRing::LveStagingRing(LveDevice &device, VkDeviceSize capacity) : capacity{capacity} {
+  buffer = std::make_unique<LveBuffer>(
+      device,
+      capacity,
+      1,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  buffer->map();
+}
+
+bool LveStagingRing::tryAllocate(VkDeviceSize size, VkDeviceSize alignment, Region &region) {
+  assert(size <= capacity && "Staging allocation larger than the ring");
+
+  if (isEmpty()) {
+    head = tail = 0;
+  } else if (head == tail) {
+    return false;  // full
+  }
+
+  VkDeviceSize offset = alignment > 1 ? (head + alignment - 1) & ~(alignment - 1) : head;
+  if (isEmpty() || tail < head) {
+    // free space is [head, capacity) followed by [0, tail)
+    if (offset + size > capacity) {
+      if (!isEmpty() && size > tail) {
+        return false;
+      }
+      offset = 0;
+    }
+  } else if (offset + size > tail) {
+    // free space is [head, tail)
+    return false;
+  }
+
+  head = offset + size;
+  hasUntagged = true;
+
+  region.buffer = buffer->getBuffer();
+  region.offset = offset;
+  region.mapped = static_cast<char *>(buffer->getMappedMemory()) + offset;
+  return true;
+}
+
+void LveStagingRing::tag(uint64_t ticket) {
+  if (!hasUntagged) {
+    return;
+  }
+  pendingRegions.push_back({ticket, head});
+  hasUntagged = false;
+}
+
+void LveStagingRing::release(uint64_t completedTicket) {
+  while (!pendingRegions.empty() && pendingRegions.front().ticket <= completedTicket) {
+    tail = pendingRegions.front().end;
+    pendingRegions.pop_front();
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+
+// std
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+namespace lve {
+
+// A single persistently mapped host visible buffer handed out front to back. Allocations are
+// grouped under the upload ticket they were submitted with and reclaimed in submission order
+// once that ticket completes, so staging never allocates, maps or unmaps memory.
+class LveStagingRing {
+ public:
+  static constexpr VkDeviceSize DEFAULT_CAPACITY = 32 * 1024 * 1024;
+
+  struct Region {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    void *mapped = nullptr;
+  };
+
+  LveStagingRing(LveDevice &device, VkDeviceSize capacity = DEFAULT_CAPACITY);
+
+  LveStagingRing(const LveStagingRing &) = delete;
+  LveStagingRing &operator=(const LveStagingRing &) = delete;
+
+  // Returns false when the ring has no room until earlier tickets are released
+  bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, Region &region);
+
+  // Assigns every allocation made since the last call to ticket
+  void tag(uint64_t ticket);
+
+  // Reclaims all regions tagged with a ticket <= completedTicket
+  void release(uint64_t completedTicket);
+
+  VkDeviceSize getCapacity() const { return capacity; }
+  bool isEmpty() const { return pendingRegions.empty() && !hasUntagged; }
+
+ private:
+  struct TaggedRange {
+    uint64_t ticket;
+    VkDeviceSize end;
+  };
+
+  std::unique_ptr<LveBuffer> buffer;
+  VkDeviceSize capacity;
+  VkDeviceSize head = 0;  // next free byte
+  VkDeviceSize tail = 0;  // oldest byte still in use
+  bool hasUntagged = false;
+  std::deque<TaggedRange> pendingRegions;
+};
+
+}  // namespace lve
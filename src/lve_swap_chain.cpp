@@ -1,7 +1,10 @@
 #include "lve_swap_chain.hpp"
 
+#include "lve_timeline.hpp"
+
 // std
 #include <array>
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -11,19 +14,25 @@
 
 namespace lve {
 
-LveSwapChain::LveSwapChain(LveDevice &deviceRef, VkExtent2D extent)
-    : device{deviceRef}, windowExtent{extent} {
+LveSwapChain::LveSwapChain(LveDevice &deviceRef, VkExtent2D extent, const Settings &settings)
+    : device{deviceRef}, windowExtent{extent}, settings{settings} {
   init();
 }
 
 LveSwapChain::LveSwapChain(
-    LveDevice &deviceRef, VkExtent2D extent, std::shared_ptr<LveSwapChain> previous)
-    : device{deviceRef}, windowExtent{extent}, oldSwapChain{previous} {
+    LveDevice &deviceRef,
+    VkExtent2D extent,
+    const Settings &settings,
+    std::shared_ptr<LveSwapChain> previous)
+    : device{deviceRef}, windowExtent{extent}, settings{settings}, oldSwapChain{previous} {
   init();
   oldSwapChain = nullptr;
 }
 
 void LveSwapChain::init() {
+  assert(
+      settings.framesInFlight >= 1 && settings.framesInFlight <= MAX_FRAMES_IN_FLIGHT &&
+      "frames in flight out of range");
   createSwapChain();
   createImageViews();
   createRenderPass();
@@ -46,7 +55,10 @@ LveSwapChain::~LveSwapChain() {
   for (int i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
     vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+    // unless it was handed on to the next swap chain
+    if (depthImageMemorys[i].memory != VK_NULL_HANDLE) {
+      device.freeMemory(depthImageMemorys[i]);
+    }
   }
 
   for (auto framebuffer : swapChainFramebuffers) {
@@ -55,21 +67,26 @@ LveSwapChain::~LveSwapChain() {
 
   vkDestroyRenderPass(device.device(), renderPass, nullptr);
 
-  // cleanup synchronization objects
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  // cleanup synchronization objects, unless they were handed on to the next swap chain
+  for (size_t i = 0; i < imageAvailableSemaphores.size(); i++) {
     vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-    vkDestroyFence(device.device(), inFlightFences[i], nullptr);
   }
 }
 
 VkResult LveSwapChain::acquireNextImage(uint32_t *imageIndex) {
-  vkWaitForFences(
-      device.device(),
-      1,
-      &inFlightFences[currentFrame],
-      VK_TRUE,
-      std::numeric_limits<uint64_t>::max());
+  LveTimeline &timeline = device.graphicsTimeline();
+  timeline.wait(frameValues[currentFrame]);
+
+  if (settings.lowLatency) {
+    if (presentId > 0) {
+      // bounded so a hidden or occluded window that never presents doesn't stall forever
+      device.waitForPresent(device.device(), swapChain, presentId, PRESENT_WAIT_TIMEOUT);
+    } else if (!device.supportsPresentWait()) {
+      size_t previousFrame = (currentFrame + settings.framesInFlight - 1) % settings.framesInFlight;
+      timeline.wait(frameValues[previousFrame]);
+    }
+  }
 
   VkResult result = vkAcquireNextImageKHR(
       device.device(),
@@ -83,10 +100,9 @@ VkResult LveSwapChain::acquireNextImage(uint32_t *imageIndex) {
 }
 
 VkResult LveSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex) {
-  if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-    vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-  }
-  imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
+  // the image may have been acquired out of order, behind a frame still rendering to it
+  LveTimeline &timeline = device.graphicsTimeline();
+  timeline.wait(imageValues[*imageIndex]);
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -104,11 +120,8 @@ VkResult LveSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, uint
   submitInfo.signalSemaphoreCount = 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
-  vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-  if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to submit draw command buffer!");
-  }
+  frameValues[currentFrame] = timeline.submit(submitInfo);
+  imageValues[*imageIndex] = frameValues[currentFrame];
 
   VkPresentInfoKHR presentInfo = {};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -122,9 +135,22 @@ VkResult LveSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, uint
 
   presentInfo.pImageIndices = imageIndex;
 
+  VkPresentIdKHR presentIdInfo{};
+  uint64_t nextPresentId = presentId + 1;
+  if (device.supportsPresentWait()) {
+    presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    presentIdInfo.swapchainCount = 1;
+    presentIdInfo.pPresentIds = &nextPresentId;
+    presentInfo.pNext = &presentIdInfo;
+  }
+
+  std::lock_guard<std::mutex> queueLock{device.queueMutex()};
   auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+  if (device.supportsPresentWait() && (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)) {
+    presentId = nextPresentId;
+  }
 
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  currentFrame = (currentFrame + 1) % settings.framesInFlight;
 
   return result;
 }
@@ -133,7 +159,7 @@ void LveSwapChain::createSwapChain() {
   SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
   VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-  VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+  presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
   uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -212,11 +238,21 @@ void LveSwapChain::createImageViews() {
 }
 
 void LveSwapChain::createRenderPass() {
+  // the previous swap chain's pass stays valid for the same formats, and with it every pipeline
+  // created against it
+  if (oldSwapChain != nullptr && oldSwapChain->renderPass != VK_NULL_HANDLE &&
+      oldSwapChain->swapChainImageFormat == swapChainImageFormat &&
+      oldSwapChain->swapChainDepthFormat == findDepthFormat()) {
+    renderPass = oldSwapChain->renderPass;
+    oldSwapChain->renderPass = VK_NULL_HANDLE;
+    return;
+  }
+
   VkAttachmentDescription depthAttachment{};
   depthAttachment.format = findDepthFormat();
   depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
   depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -306,7 +342,7 @@ void LveSwapChain::createDepthResources() {
   depthImageMemorys.resize(imageCount());
   depthImageViews.resize(imageCount());
 
-  for (int i = 0; i < depthImages.size(); i++) {
+  for (size_t i = 0; i < depthImages.size(); i++) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -318,16 +354,41 @@ void LveSwapChain::createDepthResources() {
     imageInfo.format = depthFormat;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.flags = 0;
 
-    device.createImageWithInfo(
-        imageInfo,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        depthImages[i],
-        depthImageMemorys[i]);
+    if (vkCreateImage(device.device(), &imageInfo, nullptr, &depthImages[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create image!");
+    }
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device.device(), depthImages[i], &requirements);
+
+    // Take over the previous swap chain's memory for this image when it fits, eg while a window
+    // shrinks. Its image may still be in use by frames in flight, but every frame's first depth
+    // access waits for the earlier frames' depth tests on the queue.
+    LveAllocation *previous = nullptr;
+    if (oldSwapChain != nullptr && i < oldSwapChain->depthImageMemorys.size()) {
+      previous = &oldSwapChain->depthImageMemorys[i];
+    }
+    if (previous != nullptr && previous->memory != VK_NULL_HANDLE &&
+        previous->size >= requirements.size &&
+        (requirements.memoryTypeBits & (1u << previous->memoryTypeIndex)) != 0 &&
+        previous->offset % requirements.alignment == 0) {
+      depthImageMemorys[i] = *previous;
+      *previous = LveAllocation{};
+    } else {
+      depthImageMemorys[i] =
+          device.allocateMemory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    if (vkBindImageMemory(
+            device.device(),
+            depthImages[i],
+            depthImageMemorys[i].memory,
+            depthImageMemorys[i].offset) != VK_SUCCESS) {
+      throw std::runtime_error("failed to bind image memory!");
+    }
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -347,24 +408,32 @@ void LveSwapChain::createDepthResources() {
 }
 
 void LveSwapChain::createSyncObjects() {
+  imageValues.assign(imageCount(), 0);
+
+  // frames in flight keep signaling the previous swap chain's semaphores, so carry them over
+  // with the frames' timeline values instead of waiting for the frames to complete
+  if (oldSwapChain != nullptr && !oldSwapChain->imageAvailableSemaphores.empty()) {
+    imageAvailableSemaphores = std::move(oldSwapChain->imageAvailableSemaphores);
+    renderFinishedSemaphores = std::move(oldSwapChain->renderFinishedSemaphores);
+    frameValues = oldSwapChain->frameValues;
+    oldSwapChain->imageAvailableSemaphores.clear();
+    oldSwapChain->renderFinishedSemaphores.clear();
+    currentFrame = oldSwapChain->currentFrame % settings.framesInFlight;
+    return;
+  }
+
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+  frameValues.assign(MAX_FRAMES_IN_FLIGHT, 0);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  VkFenceCreateInfo fenceInfo = {};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
             VK_SUCCESS ||
         vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-            VK_SUCCESS ||
-        vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+            VK_SUCCESS) {
       throw std::runtime_error("failed to create synchronization objects for a frame!");
     }
   }
@@ -385,19 +454,26 @@ VkSurfaceFormatKHR LveSwapChain::chooseSwapSurfaceFormat(
 VkPresentModeKHR LveSwapChain::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
   for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      std::cout << "Present mode: Mailbox" << std::endl;
+    if (availablePresentMode == settings.presentMode) {
+      switch (availablePresentMode) {
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+          std::cout << "Present mode: Mailbox" << std::endl;
+          break;
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+          std::cout << "Present mode: Immediate" << std::endl;
+          break;
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+          std::cout << "Present mode: Relaxed V-Sync" << std::endl;
+          break;
+        default:
+          std::cout << "Present mode: V-Sync" << std::endl;
+          break;
+      }
       return availablePresentMode;
     }
   }
 
-  // for (const auto &availablePresentMode : availablePresentModes) {
-  //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-  //     std::cout << "Present mode: Immediate" << std::endl;
-  //     return availablePresentMode;
-  //   }
-  // }
-
+  // always supported
   std::cout << "Present mode: V-Sync" << std::endl;
   return VK_PRESENT_MODE_FIFO_KHR;
 }
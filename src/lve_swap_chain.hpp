@@ -14,11 +14,30 @@ namespace lve {
 
 class LveSwapChain {
  public:
-  static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-  LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent);
+  // per frame resources everywhere are sized for this many frames, Settings pick how many of
+  // them are used
+  static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+
+  struct Settings {
+    // used when the surface supports it, FIFO otherwise
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    // frames the CPU may record ahead of the GPU, 1 to MAX_FRAMES_IN_FLIGHT
+    int framesInFlight = 2;
+    // acquireNextImage also waits for the previous frame to reach the screen, or without
+    // present wait support for the GPU to finish it, so input sampled after it is as fresh as
+    // possible when the frame is shown
+    bool lowLatency = false;
+  };
+
+  LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent, const Settings &settings);
+  // Retires previous: takes over its frame semaphores and timeline values, its render pass when
+  // the formats match and its depth memory where it fits. The caller keeps previous alive until
+  // the frames in flight that used it completed.
   LveSwapChain(
-      LveDevice &deviceRef, VkExtent2D windowExtent, std::shared_ptr<LveSwapChain> previous);
+      LveDevice &deviceRef,
+      VkExtent2D windowExtent,
+      const Settings &settings,
+      std::shared_ptr<LveSwapChain> previous);
 
   ~LveSwapChain();
 
@@ -27,7 +46,12 @@ class LveSwapChain {
 
   VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
   VkRenderPass getRenderPass() { return renderPass; }
+  VkImage getImage(int index) { return swapChainImages[index]; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+  // Depth attachments are stored and sampleable, eg for building a depth pyramid
+  VkImage getDepthImage(int index) { return depthImages[index]; }
+  VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+  VkFormat getDepthFormat() { return swapChainDepthFormat; }
   size_t imageCount() { return swapChainImages.size(); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
   VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -38,6 +62,13 @@ class LveSwapChain {
     return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
   }
   VkFormat findDepthFormat();
+  const Settings &getSettings() const { return settings; }
+  // the mode actually in use
+  VkPresentModeKHR getPresentMode() const { return presentMode; }
+  // frame whose sync objects the next acquireNextImage uses
+  int getCurrentFrame() const { return static_cast<int>(currentFrame); }
+  // graphics timeline value signaled once frame's last submission completed
+  uint64_t getFrameValue(int frame) const { return frameValues[frame]; }
 
   VkResult acquireNextImage(uint32_t *imageIndex);
   VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
@@ -48,6 +79,9 @@ class LveSwapChain {
   }
 
  private:
+  // nanoseconds the low latency mode waits at most for the previous present
+  static constexpr uint64_t PRESENT_WAIT_TIMEOUT = 100'000'000;
+
   void init();
   void createSwapChain();
   void createImageViews();
@@ -71,22 +105,27 @@ class LveSwapChain {
   VkRenderPass renderPass;
 
   std::vector<VkImage> depthImages;
-  std::vector<VkDeviceMemory> depthImageMemorys;
+  std::vector<LveAllocation> depthImageMemorys;
   std::vector<VkImageView> depthImageViews;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
 
   LveDevice &device;
   VkExtent2D windowExtent;
+  Settings settings;
+  VkPresentModeKHR presentMode;
 
   VkSwapchainKHR swapChain;
   std::shared_ptr<LveSwapChain> oldSwapChain;
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
-  std::vector<VkFence> inFlightFences;
-  std::vector<VkFence> imagesInFlight;
+  // graphics timeline value of every frame's and every image's last submission
+  std::vector<uint64_t> frameValues;
+  std::vector<uint64_t> imageValues;
   size_t currentFrame = 0;
+  // ids of the presents so far when the device supports present wait, 0 before the first
+  uint64_t presentId = 0;
 };
 
 }  // namespace lve
@@ -0,0 +1,23 @@
+#include "lve_texture.hpp"
+
+namespace lve {
+
+void LveTexture::requestScreenSize(float pixels) {
+  float previous = demand.load(std::memory_order_relaxed);
+  while (previous < pixels &&
+         !demand.compare_exchange_weak(previous, pixels, std::memory_order_relaxed)) {
+  }
+}
+
+VkDescriptorImageInfo LveTexture::descriptorInfo() const {
+  return {
+      sampler,
+      isResident() ? current.view : fallbackView,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+}
+
+uint32_t LveTexture::getBindlessIndex() const {
+  return isResident() ? current.bindlessIndex : fallbackIndex;
+}
+
+}  // namespace lve
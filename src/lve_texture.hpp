@@ -0,0 +1,83 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_texture_file.hpp"
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace lve {
+
+// A streamed 2D texture, created by LveTextureStreamer. Its image only holds the levels from
+// getResidentLevel() down to the smallest mip, and is replaced by a whole new image whenever
+// the streamer raises or lowers residency. Until the first levels are in, descriptors point at
+// the streamer's 1x1 white fallback, so textures can be drawn with right after loading starts.
+class LveTexture {
+ public:
+  static constexpr uint32_t INVALID_INDEX = ~0u;
+
+  LveTexture(const LveTexture &) = delete;
+  LveTexture &operator=(const LveTexture &) = delete;
+
+  // Largest size in pixels the texture covers on screen this frame, the streamer aims for the
+  // level whose texels come closest to one per pixel. Thread safe.
+  void requestScreenSize(float pixels);
+
+  // Descriptors change with residency, so write sets and read the bindless index every frame
+  VkDescriptorImageInfo descriptorInfo() const;
+  // Into the streamer's bindless table images, INVALID_INDEX without a table
+  uint32_t getBindlessIndex() const;
+
+  const std::string &getPath() const { return path; }
+  bool isResident() const { return current.image != VK_NULL_HANDLE; }
+  // False when loading failed, the texture then keeps showing the fallback
+  bool isValid() const { return !failed; }
+  // First level held by the image, getMipCount() while nothing is resident
+  uint32_t getResidentLevel() const { return isResident() ? current.firstLevel : mipCount; }
+  // 0 until the file header has been read
+  uint32_t getMipCount() const { return mipCount; }
+  VkExtent3D getExtent() const { return extent; }
+  VkDeviceSize getResidentBytes() const { return current.memory.size; }
+
+ private:
+  friend class LveTextureStreamer;
+
+  // One image holding levels [firstLevel, mipCount)
+  struct Residency {
+    VkImage image = VK_NULL_HANDLE;
+    LveAllocation memory{};
+    VkImageView view = VK_NULL_HANDLE;
+    uint32_t firstLevel = 0;
+    uint32_t bindlessIndex = INVALID_INDEX;
+  };
+
+  LveTexture(std::string path, VkSampler sampler, VkImageView fallbackView, uint32_t fallbackIndex)
+      : path{std::move(path)},
+        sampler{sampler},
+        fallbackView{fallbackView},
+        fallbackIndex{fallbackIndex} {}
+
+  std::string path;
+  VkSampler sampler;
+  VkImageView fallbackView;
+  uint32_t fallbackIndex;
+
+  // set by the first load's worker, read on the streamer's thread once that load completed
+  std::unique_ptr<LveTextureFile> file;
+  uint32_t mipCount = 0;
+  VkExtent3D extent{};
+  // what the first load brings in and eviction falls back to, see INITIAL_SIZE
+  uint32_t initialLevel = 0;
+
+  Residency current;
+  std::atomic<float> demand{0.f};
+  uint64_t lastRequestedFrame = 0;
+  bool loading = false;
+  bool failed = false;
+};
+
+}  // namespace lve
@@ -0,0 +1,161 @@
+#include "lve_texture_file.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+
+// KTX2 header fields that follow the identifier, all little endian. The supercompression global
+// data offset and length (two uint64_t) that come next are not needed.
+struct Ktx2Header {
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+};
+
+struct Ktx2LevelIndex {
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(Ktx2Header) == 52, "KTX2 header must be tightly packed");
+static_assert(sizeof(Ktx2LevelIndex) == 24, "KTX2 level index must be tightly packed");
+
+// Bytes and texels across of one texel block, false for unsupported formats
+bool blockInfo(VkFormat format, uint32_t &blockBytes, uint32_t &blockTexels) {
+  blockTexels = 1;
+  switch (format) {
+    case VK_FORMAT_R8_UNORM:
+      blockBytes = 1;
+      return true;
+    case VK_FORMAT_R8G8_UNORM:
+      blockBytes = 2;
+      return true;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+      blockBytes = 4;
+      return true;
+    default:
+      break;
+  }
+
+  blockTexels = 4;
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+      blockBytes = 8;
+      return true;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      blockBytes = 16;
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+VkDeviceSize LveTextureFile::levelSize(VkFormat format, VkExtent3D extent) {
+  uint32_t blockBytes, blockTexels;
+  if (!blockInfo(format, blockBytes, blockTexels)) {
+    return 0;
+  }
+  VkDeviceSize blocksX = (extent.width + blockTexels - 1) / blockTexels;
+  VkDeviceSize blocksY = (extent.height + blockTexels - 1) / blockTexels;
+  return blocksX * blocksY * blockBytes;
+}
+
+bool LveTextureFile::isBlockCompressed() const {
+  uint32_t blockBytes, blockTexels;
+  return blockInfo(format, blockBytes, blockTexels) && blockTexels > 1;
+}
+
+LveTextureFile::LveTextureFile(const std::string &filepath) {
+  file = LveMappedFile::open(filepath);
+  if (!file) {
+    throw std::runtime_error("failed to open texture file: " + filepath);
+  }
+  const char *bytes = static_cast<const char *>(file->data());
+  size_t fileSize = file->size();
+
+  Ktx2Header header;
+  if (fileSize < sizeof(IDENTIFIER) + sizeof(header) ||
+      std::memcmp(bytes, IDENTIFIER, sizeof(IDENTIFIER)) != 0) {
+    throw std::runtime_error("texture is not a KTX2 file: " + filepath);
+  }
+  std::memcpy(&header, bytes + sizeof(IDENTIFIER), sizeof(header));
+
+  format = static_cast<VkFormat>(header.vkFormat);
+  if (levelSize(format, {1, 1, 1}) == 0 || header.supercompressionScheme != 0) {
+    throw std::runtime_error("unsupported texture format or supercompression: " + filepath);
+  }
+  if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 ||
+      header.layerCount > 1 || header.faceCount != 1) {
+    throw std::runtime_error("texture is not a single 2D image: " + filepath);
+  }
+
+  VkExtent3D extent{header.pixelWidth, header.pixelHeight, 1};
+  uint32_t fullChain = 1;
+  while ((extent.width >> fullChain) > 0 || (extent.height >> fullChain) > 0) {
+    fullChain++;
+  }
+
+  // a level count of 0 asks for the mips to be generated from the single stored level
+  uint32_t storedLevels = std::max(header.levelCount, 1u);
+  if (storedLevels > fullChain) {
+    throw std::runtime_error("texture has more levels than its extent allows: " + filepath);
+  }
+  mipCount = header.levelCount == 0 ? fullChain : storedLevels;
+
+  size_t indexOffset = sizeof(IDENTIFIER) + sizeof(header) + 2 * sizeof(uint64_t);
+  if (fileSize < indexOffset + storedLevels * sizeof(Ktx2LevelIndex)) {
+    throw std::runtime_error("texture file is truncated: " + filepath);
+  }
+  for (uint32_t level = 0; level < storedLevels; level++) {
+    Ktx2LevelIndex index;
+    std::memcpy(&index, bytes + indexOffset + level * sizeof(index), sizeof(index));
+
+    VkExtent3D levelExtent{
+        std::max(extent.width >> level, 1u),
+        std::max(extent.height >> level, 1u),
+        1};
+    VkDeviceSize expected = levelSize(format, levelExtent);
+    if (index.byteLength < expected || index.byteOffset > fileSize ||
+        fileSize - index.byteOffset < index.byteLength) {
+      throw std::runtime_error("texture file is truncated: " + filepath);
+    }
+    levels.push_back({bytes + index.byteOffset, expected, levelExtent});
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "lve_mesh_cache.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+// A memory mapped KTX2 file holding a single 2D image, uncompressed 8 bit or BCn, without
+// supercompression. Level pointers point straight into the mapping, so only the levels that are
+// actually uploaded are ever read from disk.
+class LveTextureFile {
+ public:
+  static constexpr char IDENTIFIER[12] =
+      {'\xAB', 'K', 'T', 'X', ' ', '2', '0', '\xBB', '\r', '\n', '\x1A', '\n'};
+
+  struct Level {
+    const void *data;
+    VkDeviceSize size;
+    VkExtent3D extent;
+  };
+
+  // Throws if the file is missing, truncated or uses features listed above as unsupported
+  explicit LveTextureFile(const std::string &filepath);
+
+  LveTextureFile(const LveTextureFile &) = delete;
+  LveTextureFile &operator=(const LveTextureFile &) = delete;
+
+  VkFormat getFormat() const { return format; }
+  VkExtent3D getExtent() const { return levels[0].extent; }
+  bool isBlockCompressed() const;
+  // Levels stored in the file, largest first
+  uint32_t getLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+  const Level &getLevel(uint32_t level) const { return levels[level]; }
+  // Levels of the image, more than are stored when the file asks for the rest to be generated
+  uint32_t getMipCount() const { return mipCount; }
+
+  // Bytes of one level with the given extent, 0 for formats this class cannot read
+  static VkDeviceSize levelSize(VkFormat format, VkExtent3D extent);
+
+ private:
+  std::unique_ptr<LveMappedFile> file;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  std::vector<Level> levels;
+  uint32_t mipCount = 0;
+};
+
+}  // namespace lve
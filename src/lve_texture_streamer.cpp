@@ -0,0 +1,471 @@
+#include "lve_texture_streamer.hpp"
+
+#include "lve_deletion_queue.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace lve {
+
+namespace {
+
+// every shader stage that may sample a texture
+constexpr VkPipelineStageFlags TEXTURE_STAGES = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+uint32_t initialLevelOf(const LveTextureFile &file) {
+  // generated mips need the full size level to start from
+  if (file.getLevelCount() < file.getMipCount()) {
+    return 0;
+  }
+  uint32_t level = 0;
+  while (level + 1 < file.getLevelCount()) {
+    VkExtent3D extent = file.getLevel(level).extent;
+    if (std::max(extent.width, extent.height) <= LveTextureStreamer::INITIAL_SIZE) {
+      break;
+    }
+    level++;
+  }
+  return level;
+}
+
+}  // namespace
+
+LveTextureStreamer::LveTextureStreamer(
+    LveDevice &device,
+    LveThreadPool &threadPool,
+    LveBindlessTable *bindlessTable,
+    VkDeviceSize budget)
+    : lveDevice{device}, threadPool{threadPool}, bindlessTable{bindlessTable}, budget{budget} {
+  createSampler();
+  createFallback();
+}
+
+LveTextureStreamer::~LveTextureStreamer() {
+  // workers may still be recording uploads of images, let them finish and flush them out
+  auto &uploads = lveDevice.uploadManager();
+  for (auto &load : loads) {
+    if (!load->submitted) {
+      try {
+        load->residency = load->prepared.get().residency;
+      } catch (...) {
+      }
+    }
+  }
+  uploads.submit();
+  uploads.waitIdle();
+
+  for (auto &load : loads) {
+    destroy(load->residency);
+  }
+  for (auto &kv : textures) {
+    destroy(kv.second->current);
+  }
+  for (auto &entry : retired) {
+    destroy(entry.residency);
+  }
+  destroy(fallback);
+  vkDestroySampler(lveDevice.device(), sampler, nullptr);
+}
+
+void LveTextureStreamer::createSampler() {
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.anisotropyEnable = VK_TRUE;
+  samplerInfo.maxAnisotropy = std::min(16.f, lveDevice.properties.limits.maxSamplerAnisotropy);
+  samplerInfo.minLod = 0.f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  if (vkCreateSampler(lveDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture sampler!");
+  }
+}
+
+void LveTextureStreamer::createFallback() {
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent = {1, 1, 1};
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  lveDevice.createImageWithInfo(
+      imageInfo,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      fallback.image,
+      fallback.memory);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = fallback.image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+  viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &fallback.view) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture image view!");
+  }
+
+  uint32_t white = 0xffffffff;
+  auto &uploads = lveDevice.uploadManager();
+  uploads.uploadImage(fallback.image, 1, {{&white, sizeof(white), {1, 1, 1}}}, TEXTURE_STAGES);
+  uploads.wait(uploads.submit());
+
+  if (bindlessTable != nullptr) {
+    fallback.bindlessIndex =
+        bindlessTable->addImage({sampler, fallback.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+  }
+}
+
+std::shared_ptr<LveTexture> LveTextureStreamer::load(const std::string &filepath) {
+  auto it = textures.find(filepath);
+  if (it != textures.end()) {
+    return it->second;
+  }
+
+  std::shared_ptr<LveTexture> texture{
+      new LveTexture(filepath, sampler, fallback.view, fallback.bindlessIndex)};
+  textures.emplace(filepath, texture);
+  startLoad(texture, LveTexture::INVALID_INDEX);
+  return texture;
+}
+
+void LveTextureStreamer::startLoad(
+    const std::shared_ptr<LveTexture> &texture, uint32_t firstLevel) {
+  auto load = std::make_unique<Load>();
+  load->texture = texture;
+  if (texture->file) {
+    load->reservedBytes = estimateBytes(*texture, firstLevel);
+    load->releasedBytes = texture->getResidentBytes();
+    reservedBytes += load->reservedBytes;
+    releasingBytes += load->releasedBytes;
+  }
+
+  // the file is only opened by the first load and never replaced, so workers may read it
+  const LveTextureFile *file = texture->file.get();
+  load->prepared = threadPool.submit([this, path = texture->getPath(), file, firstLevel]() {
+    return prepare(path, file, firstLevel);
+  });
+  texture->loading = true;
+  loads.push_back(std::move(load));
+}
+
+LveTextureStreamer::Prepared LveTextureStreamer::prepare(
+    const std::string &path, const LveTextureFile *file, uint32_t firstLevel) {
+  Prepared prepared{};
+  if (file == nullptr) {
+    prepared.file = std::make_unique<LveTextureFile>(ENGINE_DIR + path);
+    file = prepared.file.get();
+    firstLevel = initialLevelOf(*file);
+
+    if (file->isBlockCompressed() && !lveDevice.enabledFeatures().textureCompressionBC) {
+      throw std::runtime_error("block compressed textures are not supported: " + path);
+    }
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                        VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    if (file->getLevelCount() < file->getMipCount() &&
+        (lveDevice.getFormatProperties(file->getFormat()).optimalTilingFeatures & blitFeatures) !=
+            blitFeatures) {
+      throw std::runtime_error("texture format does not support mip generation: " + path);
+    }
+  }
+
+  uint32_t mipLevels = file->getMipCount() - firstLevel;
+  bool generateMips = file->getLevelCount() < file->getMipCount();
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent = file->getLevel(firstLevel).extent;
+  imageInfo.mipLevels = mipLevels;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = file->getFormat();
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                    (generateMips ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  LveTexture::Residency &residency = prepared.residency;
+  residency.firstLevel = firstLevel;
+  lveDevice.createImageWithInfo(
+      imageInfo,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      residency.image,
+      residency.memory);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = residency.image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = file->getFormat();
+  viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
+  if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &residency.view) != VK_SUCCESS) {
+    destroy(residency);
+    throw std::runtime_error("failed to create texture image view!");
+  }
+
+  // reading the levels out of the mapping is what pages them in from disk
+  std::vector<LveUploadManager::ImageLevel> levels;
+  for (uint32_t level = firstLevel; level < file->getLevelCount(); level++) {
+    const LveTextureFile::Level &source = file->getLevel(level);
+    levels.push_back({source.data, source.size, source.extent});
+  }
+  lveDevice.uploadManager().uploadImage(residency.image, mipLevels, levels, TEXTURE_STAGES);
+  return prepared;
+}
+
+void LveTextureStreamer::finishLoads() {
+  auto &uploads = lveDevice.uploadManager();
+
+  // send everything workers recorded out as one batch
+  bool anyPrepared = false;
+  for (auto it = loads.begin(); it != loads.end();) {
+    Load &load = **it;
+    if (load.submitted ||
+        load.prepared.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      ++it;
+      continue;
+    }
+
+    LveTexture &texture = *load.texture;
+    try {
+      Prepared prepared = load.prepared.get();
+      load.residency = prepared.residency;
+      if (prepared.file) {
+        texture.mipCount = prepared.file->getMipCount();
+        texture.extent = prepared.file->getExtent();
+        texture.initialLevel = initialLevelOf(*prepared.file);
+        texture.file = std::move(prepared.file);
+      }
+      load.submitted = true;
+      anyPrepared = true;
+      ++it;
+    } catch (const std::exception &e) {
+      std::cerr << "failed to load texture " << texture.getPath() << ": " << e.what()
+                << std::endl;
+      texture.failed = true;
+      texture.loading = false;
+      reservedBytes -= load.reservedBytes;
+      releasingBytes -= load.releasedBytes;
+      it = loads.erase(it);
+    }
+  }
+  if (anyPrepared) {
+    LveUploadManager::Ticket ticket = uploads.submit();
+    for (auto &load : loads) {
+      if (load->submitted && load->ticket == 0) {
+        load->ticket = ticket;
+      }
+    }
+  }
+
+  for (auto it = loads.begin(); it != loads.end();) {
+    Load &load = **it;
+    if (!load.submitted || !uploads.isComplete(load.ticket)) {
+      ++it;
+      continue;
+    }
+
+    LveTexture &texture = *load.texture;
+    if (texture.isResident()) {
+      retire(texture.current);
+    }
+    texture.current = load.residency;
+    if (bindlessTable != nullptr) {
+      texture.current.bindlessIndex = bindlessTable->addImage(texture.descriptorInfo());
+    }
+    texture.loading = false;
+    stats.residentBytes += texture.current.memory.size;
+    reservedBytes -= load.reservedBytes;
+    releasingBytes -= load.releasedBytes;
+    it = loads.erase(it);
+  }
+}
+
+uint32_t LveTextureStreamer::targetLevel(const LveTexture &texture, float screenSize) const {
+  if (screenSize <= 0.f) {
+    return texture.initialLevel;
+  }
+  float size = static_cast<float>(std::max(texture.extent.width, texture.extent.height));
+  float level = std::floor(std::log2(std::max(size / screenSize, 1.f)));
+  return std::min(static_cast<uint32_t>(level), texture.initialLevel);
+}
+
+VkDeviceSize LveTextureStreamer::estimateBytes(
+    const LveTexture &texture, uint32_t firstLevel) const {
+  VkDeviceSize bytes = 0;
+  for (uint32_t level = firstLevel; level < texture.mipCount; level++) {
+    VkExtent3D extent{
+        std::max(texture.extent.width >> level, 1u),
+        std::max(texture.extent.height >> level, 1u),
+        1};
+    bytes += LveTextureFile::levelSize(texture.file->getFormat(), extent);
+  }
+  return bytes;
+}
+
+void LveTextureStreamer::schedule() {
+  struct Raise {
+    std::shared_ptr<LveTexture> texture;
+    uint32_t level;
+    float screenSize;
+  };
+  std::vector<Raise> raises;
+  std::vector<std::shared_ptr<LveTexture>> evictable;
+  for (auto &kv : textures) {
+    LveTexture &texture = *kv.second;
+    float screenSize = texture.demand.exchange(0.f, std::memory_order_relaxed);
+    if (screenSize > 0.f) {
+      texture.lastRequestedFrame = frameCount;
+    }
+    if (texture.loading || texture.failed || !texture.isResident()) {
+      continue;
+    }
+
+    uint32_t level = targetLevel(texture, screenSize);
+    if (level < texture.current.firstLevel) {
+      raises.push_back({kv.second, level, screenSize});
+    } else if (
+        texture.current.firstLevel < texture.initialLevel &&
+        frameCount - texture.lastRequestedFrame > EVICT_AFTER_FRAMES) {
+      evictable.push_back(kv.second);
+    }
+  }
+
+  // most missing detail first, and among equals the largest on screen
+  std::sort(raises.begin(), raises.end(), [](const Raise &a, const Raise &b) {
+    uint32_t missingA = a.texture->current.firstLevel - a.level;
+    uint32_t missingB = b.texture->current.firstLevel - b.level;
+    return missingA != missingB ? missingA > missingB : a.screenSize > b.screenSize;
+  });
+  std::sort(
+      evictable.begin(),
+      evictable.end(),
+      [](const std::shared_ptr<LveTexture> &a, const std::shared_ptr<LveTexture> &b) {
+        return a->lastRequestedFrame < b->lastRequestedFrame;
+      });
+
+  size_t nextEviction = 0;
+  auto projectedBytes = [this]() { return stats.residentBytes + reservedBytes - releasingBytes; };
+  auto evictUntil = [&](VkDeviceSize bytes) {
+    while (projectedBytes() + bytes > budget && nextEviction < evictable.size() &&
+           loads.size() < MAX_LOADS_IN_FLIGHT) {
+      auto &texture = evictable[nextEviction++];
+      startLoad(texture, texture->initialLevel);
+      stats.evictions++;
+    }
+  };
+
+  // eg after the budget was lowered
+  evictUntil(0);
+  for (auto &raise : raises) {
+    if (loads.size() >= MAX_LOADS_IN_FLIGHT) {
+      break;
+    }
+    // what the new image adds, the old one is released once it is swapped in
+    VkDeviceSize bytes = estimateBytes(*raise.texture, raise.level);
+    VkDeviceSize added = bytes - std::min(bytes, raise.texture->getResidentBytes());
+    evictUntil(added);
+    // smaller raises further down may still fit
+    if (projectedBytes() + added <= budget && loads.size() < MAX_LOADS_IN_FLIGHT) {
+      startLoad(raise.texture, raise.level);
+    }
+  }
+}
+
+void LveTextureStreamer::update() {
+  frameCount++;
+
+  // frames that could still read these have all finished
+  auto &deletionQueue = lveDevice.deletionQueue();
+  for (auto it = retired.begin(); it != retired.end();) {
+    if (deletionQueue.isFrameComplete(it->frame)) {
+      destroy(it->residency);
+      it = retired.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // only the streamer still holds these
+  for (auto it = textures.begin(); it != textures.end();) {
+    if (it->second.use_count() == 1 && !it->second->loading) {
+      if (it->second->isResident()) {
+        retire(it->second->current);
+      }
+      it = textures.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  finishLoads();
+  schedule();
+
+  stats.textures = static_cast<uint32_t>(textures.size());
+  stats.loadsInFlight = static_cast<uint32_t>(loads.size());
+}
+
+void LveTextureStreamer::waitIdle() {
+  auto &uploads = lveDevice.uploadManager();
+  while (!loads.empty()) {
+    for (auto &load : loads) {
+      if (!load->submitted) {
+        load->prepared.wait();
+      }
+    }
+    finishLoads();
+    for (auto &load : loads) {
+      if (load->submitted) {
+        uploads.wait(load->ticket);
+      }
+    }
+    finishLoads();
+  }
+  stats.loadsInFlight = 0;
+}
+
+void LveTextureStreamer::retire(LveTexture::Residency &residency) {
+  if (bindlessTable != nullptr && residency.bindlessIndex != LveTexture::INVALID_INDEX) {
+    bindlessTable->removeImage(residency.bindlessIndex);
+  }
+  stats.residentBytes -= residency.memory.size;
+  retired.push_back({residency, lveDevice.deletionQueue().currentFrame()});
+  residency = {};
+}
+
+void LveTextureStreamer::destroy(LveTexture::Residency &residency) {
+  if (residency.view != VK_NULL_HANDLE) {
+    vkDestroyImageView(lveDevice.device(), residency.view, nullptr);
+  }
+  if (residency.image != VK_NULL_HANDLE) {
+    vkDestroyImage(lveDevice.device(), residency.image, nullptr);
+    lveDevice.freeMemory(residency.memory);
+  }
+  residency = {};
+}
+
+}  // namespace lve
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "lve_bindless_table.hpp"
+#include "lve_device.hpp"
+#include "lve_texture.hpp"
+#include "lve_thread_pool.hpp"
+#include "lve_upload_manager.hpp"
+
+// std
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+// Loads KTX2 textures on a thread pool and keeps each one's resident mip levels in line with
+// how large it is drawn on screen, within a VRAM budget.
+//
+// A texture first gets its levels from the largest mip no bigger than INITIAL_SIZE across down,
+// or its whole chain when the file asks for mips to be generated. Every frame update() turns the
+// screen sizes requested since the last frame into target levels and raises the residency of
+// the textures furthest from theirs. When that would exceed the budget, textures not requested
+// for EVICT_AFTER_FRAMES frames drop back to their initial levels first, least recently used
+// first. Changing residency builds a new image on a worker, uploads it through the device's
+// upload manager and swaps it in once the upload completed; the old image is destroyed once no
+// frame in flight can still read it.
+class LveTextureStreamer {
+ public:
+  static constexpr VkDeviceSize DEFAULT_BUDGET = 256 * 1024 * 1024;
+  static constexpr uint32_t INITIAL_SIZE = 64;
+  static constexpr uint32_t MAX_LOADS_IN_FLIGHT = 4;
+  static constexpr uint64_t EVICT_AFTER_FRAMES = 120;
+
+  struct Stats {
+    uint32_t textures = 0;
+    uint32_t loadsInFlight = 0;
+    VkDeviceSize residentBytes = 0;
+    uint64_t evictions = 0;
+  };
+
+  // Textures are added to bindlessTable when one is given
+  LveTextureStreamer(
+      LveDevice &device,
+      LveThreadPool &threadPool,
+      LveBindlessTable *bindlessTable = nullptr,
+      VkDeviceSize budget = DEFAULT_BUDGET);
+  // The device must be idle
+  ~LveTextureStreamer();
+
+  LveTextureStreamer(const LveTextureStreamer &) = delete;
+  LveTextureStreamer &operator=(const LveTextureStreamer &) = delete;
+
+  // filepath is relative to ENGINE_DIR. Textures are shared by path while any handle is alive,
+  // and unloaded once the last one is dropped.
+  std::shared_ptr<LveTexture> load(const std::string &filepath);
+
+  // Call once per frame from the thread that owns the device, after the frame's previous
+  // submission was waited on and before anything reads texture descriptors for the frame
+  void update();
+
+  // Blocks until every outstanding load has been swapped in
+  void waitIdle();
+
+  void setBudget(VkDeviceSize bytes) { budget = bytes; }
+  VkDeviceSize getBudget() const { return budget; }
+  const Stats &getStats() const { return stats; }
+  VkSampler getSampler() const { return sampler; }
+
+ private:
+  struct Prepared {
+    LveTexture::Residency residency;
+    // opened by a texture's first load
+    std::unique_ptr<LveTextureFile> file;
+  };
+
+  struct Load {
+    std::shared_ptr<LveTexture> texture;
+    // the new image, built and recorded for upload on a worker
+    std::future<Prepared> prepared;
+    LveTexture::Residency residency;
+    LveUploadManager::Ticket ticket = 0;
+    bool submitted = false;
+    // estimated size of the new image and size of the one it replaces
+    VkDeviceSize reservedBytes = 0;
+    VkDeviceSize releasedBytes = 0;
+  };
+
+  struct Retired {
+    LveTexture::Residency residency;
+    uint64_t frame;  // of the device's deletion queue
+  };
+
+  void createSampler();
+  void createFallback();
+  // Starts building an image of texture's levels from firstLevel down, INVALID_INDEX for the
+  // first load, which opens the file and starts from the initial level
+  void startLoad(const std::shared_ptr<LveTexture> &texture, uint32_t firstLevel);
+  // runs on a worker, file is nullptr for the first load
+  Prepared prepare(const std::string &path, const LveTextureFile *file, uint32_t firstLevel);
+  void finishLoads();
+  void schedule();
+  // Level whose texels come closest to one per pixel at the requested screen size
+  uint32_t targetLevel(const LveTexture &texture, float screenSize) const;
+  VkDeviceSize estimateBytes(const LveTexture &texture, uint32_t firstLevel) const;
+  void retire(LveTexture::Residency &residency);
+  void destroy(LveTexture::Residency &residency);
+
+  LveDevice &lveDevice;
+  LveThreadPool &threadPool;
+  LveBindlessTable *bindlessTable;
+  VkDeviceSize budget;
+
+  VkSampler sampler = VK_NULL_HANDLE;
+  LveTexture::Residency fallback;
+
+  std::unordered_map<std::string, std::shared_ptr<LveTexture>> textures;
+  std::vector<std::unique_ptr<Load>> loads;
+  std::vector<Retired> retired;
+  // sums over the loads in flight, residency once they all swapped in is
+  // stats.residentBytes + reservedBytes - releasingBytes
+  VkDeviceSize reservedBytes = 0;
+  VkDeviceSize releasingBytes = 0;
+  // update calls so far, for eviction
+  uint64_t frameCount = 0;
+  Stats stats;
+};
+
+}  // namespace lve
@@ -0,0 +1,48 @@
+#include "lve_thread_pool.hpp"
+
+// std
+#include <algorithm>
+
+namespace lve {
+
+LveThreadPool::LveThreadPool(uint32_t threadCount) {
+  if (threadCount == 0) {
+    uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    threadCount = std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1u);
+  }
+
+  workers.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    workers.emplace_back([this]() { workerLoop(); });
+  }
+}
+
+LveThreadPool::~LveThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    stopping = true;
+  }
+  condition.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void LveThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock{mutex};
+      condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+      // drain queued work before exiting so no future is left without a value
+      if (jobs.empty()) {
+        return;
+      }
+      job = std::move(jobs.front());
+      jobs.pop();
+    }
+    job();
+  }
+}
+
+}  // namespace lve
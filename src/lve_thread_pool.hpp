@@ -0,0 +1,50 @@
+#pragma once
+
+// std
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace lve {
+
+class LveThreadPool {
+ public:
+  // threadCount of 0 uses one worker per hardware thread, minus the main thread
+  explicit LveThreadPool(uint32_t threadCount = 0);
+  ~LveThreadPool();
+
+  LveThreadPool(const LveThreadPool &) = delete;
+  LveThreadPool &operator=(const LveThreadPool &) = delete;
+
+  template <typename F>
+  auto submit(F &&job) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+    using Result = std::invoke_result_t<std::decay_t<F>>;
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+    std::future<Result> future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      jobs.emplace([task]() { (*task)(); });
+    }
+    condition.notify_one();
+    return future;
+  }
+
+  uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+ private:
+  void workerLoop();
+
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> jobs;
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping = false;
+};
+
+}  // namespace lve
@@ -0,0 +1,146 @@
+#include "lve_timeline.hpp"
+
+#include "lve_device.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+namespace lve {
+
+LveTimeline::LveTimeline(LveDevice &device, VkQueue queue) : lveDevice{device}, queue{queue} {
+  if (!lveDevice.supportsTimelineSemaphores()) {
+    return;
+  }
+
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+  if (vkCreateSemaphore(lveDevice.device(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create timeline semaphore!");
+  }
+}
+
+LveTimeline::~LveTimeline() {
+  if (semaphore != VK_NULL_HANDLE) {
+    vkDestroySemaphore(lveDevice.device(), semaphore, nullptr);
+  }
+  for (auto &pending : pendingFences) {
+    vkDestroyFence(lveDevice.device(), pending.second, nullptr);
+  }
+  for (VkFence fence : freeFences) {
+    vkDestroyFence(lveDevice.device(), fence, nullptr);
+  }
+}
+
+uint64_t LveTimeline::submit(const VkSubmitInfo &submitInfo) {
+  assert(
+      submitInfo.signalSemaphoreCount <= MAX_SIGNAL_SEMAPHORES &&
+      "Too many signal semaphores for a timeline submission");
+  VkSubmitInfo info = submitInfo;
+
+  // the batch's own signals come first, binary semaphores ignore their value
+  std::array<VkSemaphore, MAX_SIGNAL_SEMAPHORES + 1> signalSemaphores{};
+  std::array<uint64_t, MAX_SIGNAL_SEMAPHORES + 1> signalValues{};
+  std::copy_n(
+      submitInfo.pSignalSemaphores,
+      submitInfo.signalSemaphoreCount,
+      signalSemaphores.begin());
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+
+  std::lock_guard<std::mutex> queueLock{lveDevice.queueMutex()};
+  uint64_t value = lastSubmitted_ + 1;
+
+  VkFence fence = VK_NULL_HANDLE;
+  if (semaphore != VK_NULL_HANDLE) {
+    signalSemaphores[submitInfo.signalSemaphoreCount] = semaphore;
+    signalValues[submitInfo.signalSemaphoreCount] = value;
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.pNext = submitInfo.pNext;
+    timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount + 1;
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+    info.pNext = &timelineInfo;
+    info.signalSemaphoreCount = submitInfo.signalSemaphoreCount + 1;
+    info.pSignalSemaphores = signalSemaphores.data();
+  } else {
+    std::lock_guard<std::mutex> fenceLock{fenceMutex};
+    if (!freeFences.empty()) {
+      fence = freeFences.back();
+      freeFences.pop_back();
+    } else {
+      VkFenceCreateInfo fenceInfo{};
+      fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+      if (vkCreateFence(lveDevice.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline fence!");
+      }
+    }
+    pendingFences.emplace_back(value, fence);
+  }
+
+  if (vkQueueSubmit(queue, 1, &info, fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit to timeline queue!");
+  }
+  lastSubmitted_ = value;
+  return value;
+}
+
+uint64_t LveTimeline::completedValue() {
+  if (semaphore != VK_NULL_HANDLE) {
+    uint64_t value = 0;
+    lveDevice.getSemaphoreCounterValue(lveDevice.device(), semaphore, &value);
+    // only ever grows, concurrent pollers may race to store it
+    uint64_t completed = completed_;
+    while (value > completed && !completed_.compare_exchange_weak(completed, value)) {
+    }
+    return std::max(value, completed);
+  }
+
+  std::lock_guard<std::mutex> fenceLock{fenceMutex};
+  while (!pendingFences.empty() &&
+         vkGetFenceStatus(lveDevice.device(), pendingFences.front().second) == VK_SUCCESS) {
+    vkResetFences(lveDevice.device(), 1, &pendingFences.front().second);
+    freeFences.push_back(pendingFences.front().second);
+    completed_ = pendingFences.front().first;
+    pendingFences.pop_front();
+  }
+  return completed_;
+}
+
+void LveTimeline::wait(uint64_t value) {
+  assert(value <= lastSubmitted_ && "Waiting on a timeline value that was never submitted");
+  if (isComplete(value)) {
+    return;
+  }
+
+  if (semaphore != VK_NULL_HANDLE) {
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &semaphore;
+    waitInfo.pValues = &value;
+    lveDevice.waitSemaphores(lveDevice.device(), &waitInfo, std::numeric_limits<uint64_t>::max());
+    completedValue();
+    return;
+  }
+
+  // fences are recycled under the lock, so it is held while waiting
+  std::lock_guard<std::mutex> fenceLock{fenceMutex};
+  while (!pendingFences.empty() && pendingFences.front().first <= value) {
+    VkFence fence = pendingFences.front().second;
+    vkWaitForFences(lveDevice.device(), 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    vkResetFences(lveDevice.device(), 1, &fence);
+    freeFences.push_back(fence);
+    completed_ = pendingFences.front().first;
+    pendingFences.pop_front();
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,61 @@
+#pragma once
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+class LveDevice;
+
+// Progress of the work submitted to one queue as a single increasing value: every submit()
+// returns the next value, which the timeline reaches once that batch completed. Code tracking GPU
+// work then only keeps a number instead of a fence of its own.
+//
+// Backed by a timeline semaphore when the device supports VK_KHR_timeline_semaphore, otherwise by
+// a recycled fence per batch still executing. All calls are thread safe.
+class LveTimeline {
+ public:
+  // most signal semaphores a batch given to submit may carry itself
+  static constexpr uint32_t MAX_SIGNAL_SEMAPHORES = 4;
+
+  LveTimeline(LveDevice &device, VkQueue queue);
+  // The queue must be idle
+  ~LveTimeline();
+
+  LveTimeline(const LveTimeline &) = delete;
+  LveTimeline &operator=(const LveTimeline &) = delete;
+
+  // Submits the batch under the device's queue lock and returns the value it signals. The
+  // batch must not use a fence, nor wait on timeline semaphores.
+  uint64_t submit(const VkSubmitInfo &submitInfo);
+
+  uint64_t lastSubmitted() const { return lastSubmitted_; }
+  // Highest value whose batch and all before it completed, polls the GPU
+  uint64_t completedValue();
+  bool isComplete(uint64_t value) { return value <= completed_ || completedValue() >= value; }
+  void wait(uint64_t value);
+
+ private:
+  LveDevice &lveDevice;
+  VkQueue queue;
+  VkSemaphore semaphore = VK_NULL_HANDLE;
+
+  std::atomic<uint64_t> lastSubmitted_{0};
+  std::atomic<uint64_t> completed_{0};
+
+  // without timeline semaphores, the fence and value of every batch still executing in
+  // submission order
+  std::mutex fenceMutex;
+  std::deque<std::pair<uint64_t, VkFence>> pendingFences;
+  std::vector<VkFence> freeFences;
+};
+
+}  // namespace lve
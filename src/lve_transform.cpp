@@ -0,0 +1,259 @@
+#include "lve_transform.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LVE_TRANSFORM_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define LVE_TRANSFORM_NEON
+#include <arm_neon.h>
+#endif
+
+namespace lve {
+
+namespace {
+
+// SoA streams, each holding one value per dirty transform
+enum Stream {
+  ROTATION_X,
+  ROTATION_Y,
+  ROTATION_Z,
+  SCALE_X,
+  SCALE_Y,
+  SCALE_Z,
+  // column major 3x3 rotation times scale, one stream per term
+  LOCAL_BASIS,
+  // column major 3x3 rotation times inverse scale, one stream per term
+  NORMAL_BASIS = LOCAL_BASIS + 9,
+  STREAM_COUNT = NORMAL_BASIS + 9,
+};
+
+// Cody-Waite split of pi / 2 and the minimax polynomials for sin / cos on [-pi / 4, pi / 4]
+constexpr float TWO_OVER_PI = 0.636619772367581343f;
+constexpr float PI_OVER_2_HI = 1.5703125f;
+constexpr float PI_OVER_2_MID = 4.837512969970703125e-4f;
+constexpr float PI_OVER_2_LO = 7.54978995489188216e-8f;
+constexpr float SIN_C1 = -1.6666654611e-1f;
+constexpr float SIN_C2 = 8.3321608736e-3f;
+constexpr float SIN_C3 = -1.9515295891e-4f;
+constexpr float COS_C1 = 4.166664568298827e-2f;
+constexpr float COS_C2 = -1.388731625493765e-3f;
+constexpr float COS_C3 = 2.443315711809948e-5f;
+
+#if defined(LVE_TRANSFORM_SSE2)
+
+struct Lanes {
+  static constexpr size_t WIDTH = 4;
+  __m128 v;
+
+  static Lanes load(const float *p) { return {_mm_loadu_ps(p)}; }
+  static Lanes splat(float f) { return {_mm_set1_ps(f)}; }
+  void store(float *p) const { _mm_storeu_ps(p, v); }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Lanes operator/(Lanes a, Lanes b) { return {_mm_div_ps(a.v, b.v)}; }
+inline Lanes operator-(Lanes a) { return {_mm_xor_ps(a.v, _mm_set1_ps(-0.f))}; }
+
+#elif defined(LVE_TRANSFORM_NEON)
+
+struct Lanes {
+  static constexpr size_t WIDTH = 4;
+  float32x4_t v;
+
+  static Lanes load(const float *p) { return {vld1q_f32(p)}; }
+  static Lanes splat(float f) { return {vdupq_n_f32(f)}; }
+  void store(float *p) const { vst1q_f32(p, v); }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return {vaddq_f32(a.v, b.v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return {vsubq_f32(a.v, b.v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return {vmulq_f32(a.v, b.v)}; }
+inline Lanes operator/(Lanes a, Lanes b) { return {vdivq_f32(a.v, b.v)}; }
+inline Lanes operator-(Lanes a) { return {vnegq_f32(a.v)}; }
+
+#else
+
+struct Lanes {
+  static constexpr size_t WIDTH = 1;
+  float v;
+
+  static Lanes load(const float *p) { return {*p}; }
+  static Lanes splat(float f) { return {f}; }
+  void store(float *p) const { *p = v; }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return {a.v + b.v}; }
+inline Lanes operator-(Lanes a, Lanes b) { return {a.v - b.v}; }
+inline Lanes operator*(Lanes a, Lanes b) { return {a.v * b.v}; }
+inline Lanes operator/(Lanes a, Lanes b) { return {a.v / b.v}; }
+inline Lanes operator-(Lanes a) { return {-a.v}; }
+
+#endif
+
+// sin / cos of the reduced angle r in [-pi / 4, pi / 4]
+inline void sinCosPolynomials(Lanes r, Lanes &sinR, Lanes &cosR) {
+  Lanes z = r * r;
+  sinR = r + r * z * (Lanes::splat(SIN_C1) + z * (Lanes::splat(SIN_C2) + z * Lanes::splat(SIN_C3)));
+  cosR = Lanes::splat(1.f) - Lanes::splat(.5f) * z +
+         z * z * (Lanes::splat(COS_C1) + z * (Lanes::splat(COS_C2) + z * Lanes::splat(COS_C3)));
+}
+
+// Reduces x by its nearest multiple q of pi / 2, then picks and negates the polynomials by the
+// quadrant q & 3: sin(x) is sin(r), cos(r), -sin(r), -cos(r) and cos(x) is the next one along
+void sinCos(Lanes x, Lanes &sinX, Lanes &cosX) {
+#if defined(LVE_TRANSFORM_SSE2)
+  __m128i q = _mm_cvtps_epi32(_mm_mul_ps(x.v, _mm_set1_ps(TWO_OVER_PI)));
+  Lanes qf{_mm_cvtepi32_ps(q)};
+#elif defined(LVE_TRANSFORM_NEON)
+  int32x4_t q = vcvtnq_s32_f32(vmulq_f32(x.v, vdupq_n_f32(TWO_OVER_PI)));
+  Lanes qf{vcvtq_f32_s32(q)};
+#else
+  Lanes qf{std::nearbyint(x.v * TWO_OVER_PI)};
+  int32_t q = static_cast<int32_t>(qf.v);
+#endif
+  Lanes r = x - qf * Lanes::splat(PI_OVER_2_HI) - qf * Lanes::splat(PI_OVER_2_MID) -
+            qf * Lanes::splat(PI_OVER_2_LO);
+
+  Lanes sinR, cosR;
+  sinCosPolynomials(r, sinR, cosR);
+
+#if defined(LVE_TRANSFORM_SSE2)
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i two = _mm_set1_epi32(2);
+  __m128 noSwap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), _mm_setzero_si128()));
+  __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, two), 30));
+  __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, one), two), 30));
+  __m128 s = _mm_or_ps(_mm_and_ps(noSwap, sinR.v), _mm_andnot_ps(noSwap, cosR.v));
+  __m128 c = _mm_or_ps(_mm_and_ps(noSwap, cosR.v), _mm_andnot_ps(noSwap, sinR.v));
+  sinX.v = _mm_xor_ps(s, sinSign);
+  cosX.v = _mm_xor_ps(c, cosSign);
+#elif defined(LVE_TRANSFORM_NEON)
+  const int32x4_t one = vdupq_n_s32(1);
+  const int32x4_t two = vdupq_n_s32(2);
+  uint32x4_t noSwap = vceqq_s32(vandq_s32(q, one), vdupq_n_s32(0));
+  uint32x4_t sinSign = vshlq_n_u32(vreinterpretq_u32_s32(vandq_s32(q, two)), 30);
+  uint32x4_t cosSign = vshlq_n_u32(vreinterpretq_u32_s32(vandq_s32(vaddq_s32(q, one), two)), 30);
+  float32x4_t s = vbslq_f32(noSwap, sinR.v, cosR.v);
+  float32x4_t c = vbslq_f32(noSwap, cosR.v, sinR.v);
+  sinX.v = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(s), sinSign));
+  cosX.v = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(c), cosSign));
+#else
+  bool swap = q & 1;
+  sinX.v = swap ? cosR.v : sinR.v;
+  cosX.v = swap ? sinR.v : cosR.v;
+  if (q & 2) sinX.v = -sinX.v;
+  if ((q + 1) & 2) cosX.v = -cosX.v;
+#endif
+}
+
+// Same terms as TransformComponent::updateMatrices, for Lanes::WIDTH transforms starting at i
+void evaluate(float *streams, size_t stride, size_t i) {
+  auto in = [&](int stream) { return Lanes::load(streams + stream * stride + i); };
+  auto out = [&](int stream, Lanes value) { value.store(streams + stream * stride + i); };
+
+  Lanes s1, c1, s2, c2, s3, c3;
+  sinCos(in(ROTATION_Y), s1, c1);
+  sinCos(in(ROTATION_X), s2, c2);
+  sinCos(in(ROTATION_Z), s3, c3);
+
+  const Lanes basis[9] = {
+      c1 * c3 + s1 * s2 * s3,
+      c2 * s3,
+      c1 * s2 * s3 - c3 * s1,
+      c3 * s1 * s2 - c1 * s3,
+      c2 * c3,
+      c1 * c3 * s2 + s1 * s3,
+      c2 * s1,
+      -s2,
+      c1 * c2,
+  };
+
+  const Lanes one = Lanes::splat(1.f);
+  for (int column = 0; column < 3; column++) {
+    Lanes scale = in(SCALE_X + column);
+    Lanes invScale = one / scale;
+    for (int row = 0; row < 3; row++) {
+      int term = column * 3 + row;
+      out(LOCAL_BASIS + term, basis[term] * scale);
+      out(NORMAL_BASIS + term, basis[term] * invScale);
+    }
+  }
+}
+
+}  // namespace
+
+const size_t LveTransformUpdater::SIMD_WIDTH = Lanes::WIDTH;
+
+void TransformComponent::updateMatrices() {
+  const float c3 = glm::cos(rotation.z);
+  const float s3 = glm::sin(rotation.z);
+  const float c2 = glm::cos(rotation.x);
+  const float s2 = glm::sin(rotation.x);
+  const float c1 = glm::cos(rotation.y);
+  const float s1 = glm::sin(rotation.y);
+  const glm::vec3 invScale = 1.0f / scale;
+
+  const glm::vec3 basis[3] = {
+      {c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1},
+      {c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3},
+      {c2 * s1, -s2, c1 * c2},
+  };
+  for (int column = 0; column < 3; column++) {
+    localMatrix[column] = glm::vec4{scale[column] * basis[column], 0.f};
+    localNormal[column] = invScale[column] * basis[column];
+  }
+  dirty = false;
+}
+
+size_t LveTransformUpdater::update(TransformComponent *transforms, size_t count) {
+  dirtyTransforms.clear();
+  for (size_t i = 0; i < count; i++) {
+    if (transforms[i].dirty) {
+      dirtyTransforms.push_back(&transforms[i]);
+    }
+  }
+  if (dirtyTransforms.empty()) {
+    return 0;
+  }
+
+  // pad to whole SIMD groups, the padding lanes evaluate an identity transform: zero rotation
+  // angles and unit scale
+  size_t dirtyCount = dirtyTransforms.size();
+  size_t stride = (dirtyCount + Lanes::WIDTH - 1) / Lanes::WIDTH * Lanes::WIDTH;
+  streams.assign(STREAM_COUNT * stride, 1.f);
+  std::fill_n(streams.begin() + ROTATION_X * stride, 3 * stride, 0.f);
+
+  for (size_t i = 0; i < dirtyCount; i++) {
+    const TransformComponent &transform = *dirtyTransforms[i];
+    for (int axis = 0; axis < 3; axis++) {
+      streams[(ROTATION_X + axis) * stride + i] = transform.rotation[axis];
+      streams[(SCALE_X + axis) * stride + i] = transform.scale[axis];
+    }
+  }
+
+  for (size_t i = 0; i < stride; i += Lanes::WIDTH) {
+    evaluate(streams.data(), stride, i);
+  }
+
+  for (size_t i = 0; i < dirtyCount; i++) {
+    TransformComponent &transform = *dirtyTransforms[i];
+    for (int column = 0; column < 3; column++) {
+      for (int row = 0; row < 3; row++) {
+        int term = column * 3 + row;
+        transform.localMatrix[column][row] = streams[(LOCAL_BASIS + term) * stride + i];
+        transform.localNormal[column][row] = streams[(NORMAL_BASIS + term) * stride + i];
+      }
+      transform.localMatrix[column][3] = 0.f;
+    }
+    transform.dirty = false;
+  }
+  return dirtyCount;
+}
+
+}  // namespace lve
@@ -0,0 +1,99 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// Translation, Tait-Bryan rotation and scale of an object together with its cached local and
+// normal matrices. Setters only flag the transform dirty; the matrices are rebuilt by the next
+// LveTransformUpdater pass, or lazily by mat4() / normalMatrix() if no pass ran in between.
+// Translation lands in the cached matrix directly as it needs no trigonometry.
+//
+// The transform is relative to the parent when the entity is part of an LveHierarchy, which
+// then keeps the world matrices up to date. Otherwise world and local space are the same.
+class TransformComponent {
+ public:
+  const glm::vec3 &getTranslation() const { return translation; }
+  const glm::vec3 &getRotation() const { return rotation; }
+  const glm::vec3 &getScale() const { return scale; }
+
+  void setTranslation(const glm::vec3 &value) {
+    translation = value;
+    localMatrix[3] = glm::vec4{value, 1.f};
+    moved = true;
+  }
+  void setRotation(const glm::vec3 &value) {
+    rotation = value;
+    dirty = true;
+    moved = true;
+  }
+  void setScale(const glm::vec3 &value) {
+    scale = value;
+    dirty = true;
+    moved = true;
+  }
+
+  bool isDirty() const { return dirty; }
+
+  // Matrix corrsponds to Translate * Ry * Rx * Rz * Scale
+  // Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
+  // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
+  const glm::mat4 &mat4() {
+    if (dirty) updateMatrices();
+    return localMatrix;
+  }
+
+  const glm::mat3 &normalMatrix() {
+    if (dirty) updateMatrices();
+    return localNormal;
+  }
+
+  // World space matrices as of the last LveHierarchy::propagate
+  const glm::mat4 &worldMatrix() { return inHierarchy ? world : mat4(); }
+  const glm::mat3 &worldNormalMatrix() { return inHierarchy ? worldNormal : normalMatrix(); }
+  glm::vec3 getWorldTranslation() { return glm::vec3{worldMatrix()[3]}; }
+
+ private:
+  friend class LveTransformUpdater;
+  friend class LveHierarchy;
+
+  void updateMatrices();
+
+  glm::vec3 translation{};
+  glm::vec3 scale{1.f, 1.f, 1.f};
+  glm::vec3 rotation{};
+
+  glm::mat4 localMatrix{1.f};
+  glm::mat3 localNormal{1.f};
+  bool dirty = false;
+
+  glm::mat4 world{1.f};
+  glm::mat3 worldNormal{1.f};
+  bool inHierarchy = false;
+  // local transform changed since the hierarchy last propagated it
+  bool moved = false;
+};
+
+// Rebuilds the cached matrices of all dirty transforms in one pass. Rotation and scale of the
+// dirty transforms are gathered into SoA arrays so sin / cos and the matrix terms are evaluated
+// for SIMD_WIDTH transforms at a time (SSE2 on x86, NEON on AArch64, scalar otherwise). Clean
+// transforms cost one flag test.
+class LveTransformUpdater {
+ public:
+  static const size_t SIMD_WIDTH;
+
+  // Returns how many transforms were rebuilt
+  size_t update(TransformComponent *transforms, size_t count);
+
+ private:
+  std::vector<TransformComponent *> dirtyTransforms;
+  std::vector<float> streams;
+};
+
+}  // namespace lve
@@ -0,0 +1,638 @@
+#include "lve_upload_manager.hpp"
+
+#include "lve_timeline.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace lve {
+
+LveUploadManager::LveUploadManager(LveDevice &device) : lveDevice{device} {
+  QueueFamilyIndices indices = lveDevice.findPhysicalQueueFamilies();
+  transferFamily = indices.transferFamily;
+  graphicsFamily = indices.graphicsFamily;
+  stagingRing = std::make_unique<LveStagingRing>(lveDevice);
+}
+
+LveUploadManager::~LveUploadManager() {
+  lveDevice.graphicsTimeline().wait(lastSubmitted);
+  for (auto &batch : inFlight) {
+    destroyBatch(batch);
+  }
+  inFlight.clear();
+  for (auto &batch : freeBatches) {
+    destroyBatch(batch);
+  }
+  freeBatches.clear();
+  stagingRing.reset();
+}
+
+VkCommandPool LveUploadManager::createCommandPool(uint32_t queueFamily) {
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = queueFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  VkCommandPool pool;
+  if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload command pool!");
+  }
+  return pool;
+}
+
+VkCommandBuffer LveUploadManager::allocateCommandBuffer(VkCommandPool pool) {
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = pool;
+  allocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer commandBuffer;
+  if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate upload command buffer!");
+  }
+  return commandBuffer;
+}
+
+LveUploadManager::Batch LveUploadManager::acquireBatch() {
+  if (!freeBatches.empty()) {
+    Batch batch = std::move(freeBatches.back());
+    freeBatches.pop_back();
+    return batch;
+  }
+
+  Batch batch{};
+  batch.transferPool = createCommandPool(transferFamily);
+  batch.transferCommandBuffer = allocateCommandBuffer(batch.transferPool);
+
+  // the acquire half of an ownership transfer has to be recorded for the graphics family
+  if (transferFamily != graphicsFamily) {
+    batch.graphicsPool = createCommandPool(graphicsFamily);
+    batch.graphicsCommandBuffer = allocateCommandBuffer(batch.graphicsPool);
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    if (vkCreateSemaphore(
+            lveDevice.device(),
+            &semaphoreInfo,
+            nullptr,
+            &batch.ownershipSemaphore) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create upload semaphore!");
+    }
+  }
+  return batch;
+}
+
+void LveUploadManager::copyBuffer(
+    VkBuffer srcBuffer,
+    VkBuffer dstBuffer,
+    VkDeviceSize size,
+    VkDeviceSize srcOffset,
+    VkDeviceSize dstOffset,
+    VkAccessFlags dstAccess,
+    VkPipelineStageFlags dstStage) {
+  std::lock_guard<std::recursive_mutex> lock{mutex};
+  PendingCopy copy{};
+  copy.srcBuffer = srcBuffer;
+  copy.dstBuffer = dstBuffer;
+  copy.region.srcOffset = srcOffset;
+  copy.region.dstOffset = dstOffset;
+  copy.region.size = size;
+  copy.dstAccess = dstAccess;
+  copy.dstStage = dstStage;
+  pendingCopies.push_back(copy);
+}
+
+void *LveUploadManager::allocateStaging(
+    VkDeviceSize size, VkDeviceSize alignment, VkBuffer &buffer, VkDeviceSize &offset) {
+  // oversized uploads would never fit, give them a staging buffer of their own
+  if (size > stagingRing->getCapacity()) {
+    auto stagingBuffer = std::make_unique<LveBuffer>(
+        lveDevice,
+        size,
+        1,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    stagingBuffer->map();
+    void *mapped = stagingBuffer->getMappedMemory();
+    buffer = stagingBuffer->getBuffer();
+    offset = 0;
+    retain(std::move(stagingBuffer));
+    return mapped;
+  }
+
+  LveStagingRing::Region region{};
+  while (!stagingRing->tryAllocate(size, alignment, region)) {
+    if (hasPendingCopies()) {
+      submit();
+    }
+    assert(!inFlight.empty() && "Staging ring is full but no upload is in flight");
+    wait(inFlight.front().ticket);
+  }
+  buffer = region.buffer;
+  offset = region.offset;
+  return region.mapped;
+}
+
+void LveUploadManager::uploadBuffer(
+    const void *data,
+    VkDeviceSize size,
+    VkBuffer dstBuffer,
+    VkDeviceSize dstOffset,
+    VkAccessFlags dstAccess,
+    VkPipelineStageFlags dstStage) {
+  std::lock_guard<std::recursive_mutex> lock{mutex};
+  // vkCmdCopyBuffer has no alignment requirement, 16 keeps memcpy destinations vector friendly
+  VkBuffer srcBuffer;
+  VkDeviceSize srcOffset;
+  void *mapped = allocateStaging(size, 16, srcBuffer, srcOffset);
+  memcpy(mapped, data, static_cast<size_t>(size));
+  copyBuffer(srcBuffer, dstBuffer, size, srcOffset, dstOffset, dstAccess, dstStage);
+}
+
+void LveUploadManager::uploadImage(
+    VkImage image,
+    uint32_t mipLevels,
+    const std::vector<ImageLevel> &levels,
+    VkPipelineStageFlags dstStage) {
+  assert(!levels.empty() && levels.size() <= mipLevels && "Image upload level count mismatch");
+  std::lock_guard<std::recursive_mutex> lock{mutex};
+
+  // all levels in one staging allocation, so a full ring can never split an image across
+  // batches. Offsets are multiples of 4 and of every texel block size (at most 16 bytes).
+  std::vector<VkDeviceSize> levelOffsets;
+  VkDeviceSize totalSize = 0;
+  for (auto &level : levels) {
+    levelOffsets.push_back(totalSize);
+    totalSize = LveBuffer::getAlignment(totalSize + level.size, 16);
+  }
+  VkBuffer srcBuffer;
+  VkDeviceSize srcOffset;
+  auto *mapped = static_cast<char *>(allocateStaging(totalSize, 16, srcBuffer, srcOffset));
+
+  PendingImage pending{};
+  pending.image = image;
+  pending.mipLevels = mipLevels;
+  pending.uploadedLevels = static_cast<uint32_t>(levels.size());
+  pending.lastExtent = levels.back().extent;
+  pending.dstStage = dstStage;
+  for (uint32_t level = 0; level < levels.size(); level++) {
+    memcpy(
+        mapped + levelOffsets[level],
+        levels[level].data,
+        static_cast<size_t>(levels[level].size));
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = srcOffset + levelOffsets[level];
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+    region.imageExtent = levels[level].extent;
+    pending.copies.push_back({srcBuffer, region});
+  }
+  pendingImages.push_back(std::move(pending));
+}
+
+void LveUploadManager::retain(std::unique_ptr<LveBuffer> stagingBuffer) {
+  std::lock_guard<std::recursive_mutex> lock{mutex};
+  pendingStagingBuffers.push_back(std::move(stagingBuffer));
+}
+
+void LveUploadManager::beginCommandBuffer(VkCommandBuffer commandBuffer) {
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(commandBuffer, &beginInfo);
+}
+
+void LveUploadManager::recordOwnershipRelease(VkCommandBuffer commandBuffer) {
+  std::vector<VkBufferMemoryBarrier> barriers;
+  barriers.reserve(pendingCopies.size());
+  for (auto &copy : pendingCopies) {
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = transferFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+    barrier.buffer = copy.dstBuffer;
+    barrier.offset = copy.region.dstOffset;
+    barrier.size = copy.region.size;
+    barriers.push_back(barrier);
+  }
+
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0,
+      0,
+      nullptr,
+      static_cast<uint32_t>(barriers.size()),
+      barriers.data(),
+      0,
+      nullptr);
+}
+
+void LveUploadManager::recordOwnershipAcquire(
+    VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStages) {
+  std::vector<VkBufferMemoryBarrier> barriers;
+  barriers.reserve(pendingCopies.size());
+  for (auto &copy : pendingCopies) {
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = copy.dstAccess;
+    barrier.srcQueueFamilyIndex = transferFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+    barrier.buffer = copy.dstBuffer;
+    barrier.offset = copy.region.dstOffset;
+    barrier.size = copy.region.size;
+    barriers.push_back(barrier);
+  }
+
+  // the semaphore wait happens at dstStages, so starting the barrier there chains the two
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      dstStages,
+      dstStages,
+      0,
+      0,
+      nullptr,
+      static_cast<uint32_t>(barriers.size()),
+      barriers.data(),
+      0,
+      nullptr);
+}
+
+void LveUploadManager::recordSameQueueBarrier(
+    VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStages) {
+  VkAccessFlags dstAccess = 0;
+  for (auto &copy : pendingCopies) {
+    dstAccess |= copy.dstAccess;
+  }
+
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = dstAccess;
+
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      dstStages,
+      0,
+      1,
+      &barrier,
+      0,
+      nullptr,
+      0,
+      nullptr);
+}
+
+void LveUploadManager::recordImageCopies(VkCommandBuffer commandBuffer) {
+  std::vector<VkImageMemoryBarrier> barriers;
+  barriers.reserve(pendingImages.size());
+  for (auto &pending : pendingImages) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = pending.image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pending.mipLevels, 0, 1};
+    barriers.push_back(barrier);
+  }
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      static_cast<uint32_t>(barriers.size()),
+      barriers.data());
+
+  for (auto &pending : pendingImages) {
+    for (auto &copy : pending.copies) {
+      vkCmdCopyBufferToImage(
+          commandBuffer,
+          copy.first,
+          pending.image,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          1,
+          &copy.second);
+    }
+  }
+}
+
+void LveUploadManager::recordImageOwnership(VkCommandBuffer commandBuffer, bool acquire) {
+  std::vector<VkImageMemoryBarrier> barriers;
+  barriers.reserve(pendingImages.size());
+  for (auto &pending : pendingImages) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = acquire ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask =
+        acquire ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = transferFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+    barrier.image = pending.image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pending.mipLevels, 0, 1};
+    barriers.push_back(barrier);
+  }
+  // the acquire follows the semaphore wait, which covers the transfer stage
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      acquire ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      static_cast<uint32_t>(barriers.size()),
+      barriers.data());
+}
+
+void LveUploadManager::recordImageFinish(VkCommandBuffer commandBuffer) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  auto transition = [&](VkImage image,
+                        uint32_t firstLevel,
+                        uint32_t levelCount,
+                        VkImageLayout oldLayout,
+                        VkImageLayout newLayout,
+                        VkAccessFlags srcAccess,
+                        VkAccessFlags dstAccess,
+                        VkPipelineStageFlags dstStage) {
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, firstLevel, levelCount, 0, 1};
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        dstStage,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &barrier);
+  };
+
+  for (auto &pending : pendingImages) {
+    // every generated level is blitted from the one above, which then becomes a source
+    uint32_t firstSource = pending.uploadedLevels - 1;
+    VkExtent3D extent = pending.lastExtent;
+    for (uint32_t level = firstSource; level + 1 < pending.mipLevels; level++) {
+      transition(
+          pending.image,
+          level,
+          1,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          VK_ACCESS_TRANSFER_WRITE_BIT,
+          VK_ACCESS_TRANSFER_READ_BIT,
+          VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+      VkExtent3D next{std::max(extent.width / 2, 1u), std::max(extent.height / 2, 1u), 1};
+      VkImageBlit blit{};
+      blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+      blit.srcOffsets[1] = {
+          static_cast<int32_t>(extent.width),
+          static_cast<int32_t>(extent.height),
+          1};
+      blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level + 1, 0, 1};
+      blit.dstOffsets[1] = {static_cast<int32_t>(next.width), static_cast<int32_t>(next.height), 1};
+      vkCmdBlitImage(
+          commandBuffer,
+          pending.image,
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          pending.image,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          1,
+          &blit,
+          VK_FILTER_LINEAR);
+      extent = next;
+    }
+
+    uint32_t lastLevel = pending.mipLevels - 1;
+    if (firstSource < lastLevel) {
+      transition(
+          pending.image,
+          firstSource,
+          lastLevel - firstSource,
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_ACCESS_TRANSFER_READ_BIT,
+          VK_ACCESS_SHADER_READ_BIT,
+          pending.dstStage);
+    }
+    // the uploaded levels above the first source, and the last level
+    if (firstSource > 0) {
+      transition(
+          pending.image,
+          0,
+          firstSource,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_ACCESS_TRANSFER_WRITE_BIT,
+          VK_ACCESS_SHADER_READ_BIT,
+          pending.dstStage);
+    }
+    transition(
+        pending.image,
+        lastLevel,
+        1,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT,
+        pending.dstStage);
+  }
+}
+
+LveUploadManager::Ticket LveUploadManager::submit() {
+  std::lock_guard<std::recursive_mutex> lock{mutex};
+  collectCompleted();
+  if (pendingCopies.empty() && pendingImages.empty()) {
+    // nothing recorded, but staging buffers handed to us must still outlive earlier batches
+    if (!pendingStagingBuffers.empty() && !inFlight.empty()) {
+      auto &last = inFlight.back().stagingBuffers;
+      std::move(
+          pendingStagingBuffers.begin(),
+          pendingStagingBuffers.end(),
+          std::back_inserter(last));
+    }
+    pendingStagingBuffers.clear();
+    return lastSubmitted;
+  }
+
+  Batch batch = acquireBatch();
+  batch.stagingBuffers = std::move(pendingStagingBuffers);
+  pendingStagingBuffers.clear();
+
+  VkPipelineStageFlags dstStages = 0;
+  for (auto &copy : pendingCopies) {
+    dstStages |= copy.dstStage;
+  }
+  for (auto &pending : pendingImages) {
+    dstStages |= pending.dstStage;
+  }
+  if (dstStages == 0) {
+    dstStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  }
+
+  beginCommandBuffer(batch.transferCommandBuffer);
+  for (auto &copy : pendingCopies) {
+    vkCmdCopyBuffer(batch.transferCommandBuffer, copy.srcBuffer, copy.dstBuffer, 1, &copy.region);
+  }
+  bool hasImages = !pendingImages.empty();
+  if (hasImages) {
+    recordImageCopies(batch.transferCommandBuffer);
+  }
+
+  VkSubmitInfo transferSubmit{};
+  transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  transferSubmit.commandBufferCount = 1;
+  transferSubmit.pCommandBuffers = &batch.transferCommandBuffer;
+
+  if (transferFamily == graphicsFamily) {
+    recordSameQueueBarrier(batch.transferCommandBuffer, dstStages);
+    if (hasImages) {
+      recordImageFinish(batch.transferCommandBuffer);
+    }
+    vkEndCommandBuffer(batch.transferCommandBuffer);
+
+    // the same family only has the one queue, which is the graphics queue
+    batch.ticket = lveDevice.graphicsTimeline().submit(transferSubmit);
+  } else {
+    recordOwnershipRelease(batch.transferCommandBuffer);
+    if (hasImages) {
+      recordImageOwnership(batch.transferCommandBuffer, false);
+    }
+    vkEndCommandBuffer(batch.transferCommandBuffer);
+
+    // blits need a graphics queue, so mips are generated after the acquire
+    beginCommandBuffer(batch.graphicsCommandBuffer);
+    recordOwnershipAcquire(batch.graphicsCommandBuffer, dstStages);
+    if (hasImages) {
+      recordImageOwnership(batch.graphicsCommandBuffer, true);
+      recordImageFinish(batch.graphicsCommandBuffer);
+    }
+    vkEndCommandBuffer(batch.graphicsCommandBuffer);
+
+    // the acquire waits for the release, so completing it completes the whole batch
+    transferSubmit.signalSemaphoreCount = 1;
+    transferSubmit.pSignalSemaphores = &batch.ownershipSemaphore;
+    {
+      std::lock_guard<std::mutex> queueLock{lveDevice.queueMutex()};
+      if (vkQueueSubmit(lveDevice.transferQueue(), 1, &transferSubmit, VK_NULL_HANDLE) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("failed to submit upload batch!");
+      }
+    }
+
+    // image acquires and blits run at the transfer stage
+    VkPipelineStageFlags waitStages = dstStages;
+    if (hasImages) {
+      waitStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    VkSubmitInfo acquireSubmit{};
+    acquireSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    acquireSubmit.waitSemaphoreCount = 1;
+    acquireSubmit.pWaitSemaphores = &batch.ownershipSemaphore;
+    acquireSubmit.pWaitDstStageMask = &waitStages;
+    acquireSubmit.commandBufferCount = 1;
+    acquireSubmit.pCommandBuffers = &batch.graphicsCommandBuffer;
+    batch.ticket = lveDevice.graphicsTimeline().submit(acquireSubmit);
+  }
+
+  pendingCopies.clear();
+  pendingImages.clear();
+  stagingRing->tag(batch.ticket);
+  lastSubmitted = batch.ticket;
+  inFlight.push_back(std::move(batch));
+  return lastSubmitted;
+}
+
+bool LveUploadManager::hasPendingCopies() const {
+  std::lock_guard<std::recursive_mutex> lock{mutex};
+  return !pendingCopies.empty() || !pendingImages.empty();
+}
+
+bool LveUploadManager::isComplete(Ticket ticket) {
+  std::lock_guard<std::recursive_mutex> lock{mutex};
+  collectCompleted();
+  if (ticket > lastSubmitted) {
+    return false;
+  }
+  return lveDevice.graphicsTimeline().isComplete(ticket);
+}
+
+void LveUploadManager::wait(Ticket ticket) {
+  std::lock_guard<std::recursive_mutex> lock{mutex};
+  assert(ticket <= lastSubmitted && "Waiting on an upload ticket that was never submitted");
+
+  lveDevice.graphicsTimeline().wait(ticket);
+  collectCompleted();
+}
+
+void LveUploadManager::collectCompleted() {
+  // tickets increase in submission order and the timeline completes them in order
+  LveTimeline &timeline = lveDevice.graphicsTimeline();
+  auto it = inFlight.begin();
+  while (it != inFlight.end() && timeline.isComplete(it->ticket)) {
+    recycleBatch(*it);
+    ++it;
+  }
+  inFlight.erase(inFlight.begin(), it);
+  stagingRing->release(completedUpTo());
+}
+
+LveUploadManager::Ticket LveUploadManager::completedUpTo() const {
+  Ticket oldest = lastSubmitted + 1;
+  for (auto &batch : inFlight) {
+    oldest = std::min(oldest, batch.ticket);
+  }
+  return oldest - 1;
+}
+
+void LveUploadManager::recycleBatch(Batch &batch) {
+  vkResetCommandPool(lveDevice.device(), batch.transferPool, 0);
+  if (batch.graphicsPool != VK_NULL_HANDLE) {
+    vkResetCommandPool(lveDevice.device(), batch.graphicsPool, 0);
+  }
+  batch.stagingBuffers.clear();
+  freeBatches.push_back(std::move(batch));
+}
+
+void LveUploadManager::destroyBatch(Batch &batch) {
+  // destroying a pool frees its command buffers
+  vkDestroyCommandPool(lveDevice.device(), batch.transferPool, nullptr);
+  if (batch.graphicsPool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(lveDevice.device(), batch.graphicsPool, nullptr);
+  }
+  if (batch.ownershipSemaphore != VK_NULL_HANDLE) {
+    vkDestroySemaphore(lveDevice.device(), batch.ownershipSemaphore, nullptr);
+  }
+  batch.stagingBuffers.clear();
+}
+
+}  // namespace lve
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+#include "lve_staging_ring.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+// Batches buffer and image copies into a single submission on the transfer queue. When the
+// transfer queue belongs to a different family than graphics, ownership is released on the
+// transfer queue and acquired on the graphics queue, so destinations are ready to use by graphics
+// work submitted after the batch completes.
+//
+// Every batch owns its command pools and semaphore and is recycled once the graphics timeline
+// passed its ticket: the pools are reset in bulk, so steady state uploads allocate no Vulkan
+// objects. Tickets are values of LveDevice::graphicsTimeline, the acquire half of a batch runs on
+// the graphics queue and the transfer half completes before it.
+// All calls are thread safe, so uploads may be recorded and submitted off the render thread.
+class LveUploadManager {
+ public:
+  using Ticket = uint64_t;
+
+  LveUploadManager(LveDevice &device);
+  ~LveUploadManager();
+
+  LveUploadManager(const LveUploadManager &) = delete;
+  LveUploadManager &operator=(const LveUploadManager &) = delete;
+
+  // Records a copy into the pending batch. dstAccess / dstStage describe how the graphics queue
+  // will first consume dstBuffer (eg VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT at VERTEX_INPUT).
+  void copyBuffer(
+      VkBuffer srcBuffer,
+      VkBuffer dstBuffer,
+      VkDeviceSize size,
+      VkDeviceSize srcOffset,
+      VkDeviceSize dstOffset,
+      VkAccessFlags dstAccess,
+      VkPipelineStageFlags dstStage);
+
+  // Copies size bytes of data into the staging ring and records a transfer of them into dstBuffer.
+  // Only blocks if the ring is exhausted, in which case the oldest batch is waited on.
+  void uploadBuffer(
+      const void *data,
+      VkDeviceSize size,
+      VkBuffer dstBuffer,
+      VkDeviceSize dstOffset,
+      VkAccessFlags dstAccess,
+      VkPipelineStageFlags dstStage);
+
+  // One level of an image upload, largest first
+  struct ImageLevel {
+    const void *data;
+    VkDeviceSize size;
+    VkExtent3D extent;
+  };
+
+  // Stages levels[i] into mip i of a single layer color image with mipLevels levels. Mips past
+  // the given ones are generated by blitting each from the one above on the graphics queue, the
+  // format must support linear blits then. Every level starts out undefined and ends up in
+  // SHADER_READ_ONLY_OPTIMAL, first read at dstStage.
+  void uploadImage(
+      VkImage image,
+      uint32_t mipLevels,
+      const std::vector<ImageLevel> &levels,
+      VkPipelineStageFlags dstStage);
+
+  // Keeps a staging buffer alive until the pending batch has finished executing
+  void retain(std::unique_ptr<LveBuffer> stagingBuffer);
+
+  // Submits all pending copies and returns the ticket identifying them. Returns the last
+  // submitted ticket if there was nothing to submit.
+  Ticket submit();
+  bool isComplete(Ticket ticket);
+  void wait(Ticket ticket);
+  void waitIdle() { wait(lastSubmitted); }
+
+  bool hasPendingCopies() const;
+
+ private:
+  struct PendingCopy {
+    VkBuffer srcBuffer;
+    VkBuffer dstBuffer;
+    VkBufferCopy region;
+    VkAccessFlags dstAccess;
+    VkPipelineStageFlags dstStage;
+  };
+
+  struct PendingImage {
+    VkImage image;
+    uint32_t mipLevels;
+    uint32_t uploadedLevels;
+    // of the last uploaded level, where generated mips start from
+    VkExtent3D lastExtent;
+    VkPipelineStageFlags dstStage;
+    std::vector<std::pair<VkBuffer, VkBufferImageCopy>> copies;
+  };
+
+  struct Batch {
+    Ticket ticket;  // graphics timeline value signaled by the batch's last submission
+    VkCommandPool transferPool = VK_NULL_HANDLE;
+    VkCommandPool graphicsPool = VK_NULL_HANDLE;
+    VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+    VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+    VkSemaphore ownershipSemaphore = VK_NULL_HANDLE;
+    std::vector<std::unique_ptr<LveBuffer>> stagingBuffers;
+  };
+
+  // Staging memory from the ring, or a dedicated staging buffer when it could never fit
+  void *allocateStaging(
+      VkDeviceSize size, VkDeviceSize alignment, VkBuffer &buffer, VkDeviceSize &offset);
+  Batch acquireBatch();
+  VkCommandPool createCommandPool(uint32_t queueFamily);
+  VkCommandBuffer allocateCommandBuffer(VkCommandPool pool);
+  void beginCommandBuffer(VkCommandBuffer commandBuffer);
+  void recordOwnershipRelease(VkCommandBuffer commandBuffer);
+  void recordOwnershipAcquire(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStages);
+  void recordSameQueueBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStages);
+  void recordImageCopies(VkCommandBuffer commandBuffer);
+  // release / acquire halves of the images' queue family transfer, layouts stay TRANSFER_DST
+  void recordImageOwnership(VkCommandBuffer commandBuffer, bool acquire);
+  // generates missing mips and moves every level to SHADER_READ_ONLY_OPTIMAL
+  void recordImageFinish(VkCommandBuffer commandBuffer);
+  void collectCompleted();
+  // returns a completed batch's objects to freeBatches
+  void recycleBatch(Batch &batch);
+  void destroyBatch(Batch &batch);
+  Ticket completedUpTo() const;
+
+  LveDevice &lveDevice;
+  uint32_t transferFamily;
+  uint32_t graphicsFamily;
+
+  // public calls nest, uploadBuffer submits and waits when the staging ring is full
+  mutable std::recursive_mutex mutex;
+  std::vector<PendingCopy> pendingCopies;
+  std::vector<PendingImage> pendingImages;
+  std::vector<std::unique_ptr<LveBuffer>> pendingStagingBuffers;
+  std::vector<Batch> inFlight;
+  std::vector<Batch> freeBatches;
+  std::unique_ptr<LveStagingRing> stagingRing;
+
+  Ticket lastSubmitted = 0;
+};
+
+}  // namespace lve
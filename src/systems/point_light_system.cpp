@@ -1,5 +1,8 @@
 #include "point_light_system.hpp"
 
+#include "lve_gpu_profiler.hpp"
+#include "lve_pipeline_registry.hpp"
+
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -7,18 +10,13 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <stdexcept>
 
 namespace lve {
 
-struct PointLightPushConstants {
-  glm::vec4 position{};
-  glm::vec4 color{};
-  float radius;
-};
-
 PointLightSystem::PointLightSystem(
     LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
     : lveDevice{device} {
@@ -31,19 +29,15 @@ PointLightSystem::~PointLightSystem() {
 }
 
 void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-  VkPushConstantRange pushConstantRange{};
-  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-  pushConstantRange.offset = 0;
-  pushConstantRange.size = sizeof(PointLightPushConstants);
-
+  // the billboards read their lights from the global set's light buffer
   std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
   pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-  pipelineLayoutInfo.pushConstantRangeCount = 1;
-  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  pipelineLayoutInfo.pushConstantRangeCount = 0;
+  pipelineLayoutInfo.pPushConstantRanges = nullptr;
   if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to create pipeline layout!");
@@ -59,35 +53,62 @@ void PointLightSystem::createPipeline(VkRenderPass renderPass) {
   pipelineConfig.bindingDescriptions.clear();
   pipelineConfig.renderPass = renderPass;
   pipelineConfig.pipelineLayout = pipelineLayout;
-  lvePipeline = std::make_unique<LvePipeline>(
-      lveDevice,
+  lvePipeline = lveDevice.pipelineRegistry().requestGraphics(
       "shaders/point_light.vert.spv",
       "shaders/point_light.frag.spv",
       pipelineConfig);
 }
 
-void PointLightSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo) {
+void PointLightSystem::animate(FrameInfo& frameInfo) {
   auto rotateLight = glm::rotate(glm::mat4(1.f), 0.5f * frameInfo.frameTime, {0.f, -1.f, 0.f});
-  int lightIndex = 0;
-  for (auto& kv : frameInfo.gameObjects) {
-    auto& obj = kv.second;
-    if (obj.pointLight == nullptr) continue;
-
-    assert(lightIndex < MAX_LIGHTS && "Point lights exceed maximum specified");
-
-    // update light position
-    obj.transform.translation = glm::vec3(rotateLight * glm::vec4(obj.transform.translation, 1.f));
-
-    // copy light to ubo
-    ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.f);
-    ubo.pointLights[lightIndex].color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
+  auto& scene = frameInfo.scene;
+  for (size_t i = 0; i < scene.pointLights.size(); i++) {
+    auto& transform = scene.transforms.get(scene.pointLights.getEntity(i));
+    transform.setTranslation(
+        glm::vec3(rotateLight * glm::vec4(transform.getTranslation(), 1.f)));
+  }
+}
 
-    lightIndex += 1;
+void PointLightSystem::update(
+    FrameInfo& frameInfo, GlobalUbo& ubo, LveLightClusters& lightClusters) {
+  auto& scene = frameInfo.scene;
+  for (size_t i = 0; i < scene.pointLights.size(); i++) {
+    LveEntity entity = scene.pointLights.getEntity(i);
+    auto& light = scene.pointLights.data()[i];
+    auto& transform = scene.transforms.get(entity);
+
+    PointLight pointLight{};
+    pointLight.position = glm::vec4(
+        transform.getWorldTranslation(),
+        LveLightClusters::lightRange(light.lightIntensity));
+    pointLight.color = glm::vec4(scene.colors.get(entity), light.lightIntensity);
+    pointLight.radius = transform.getScale().x;
+    lightClusters.addLight(pointLight);
   }
-  ubo.numLights = lightIndex;
+  // the clusters drop lights past MAX_LIGHTS, their billboards would read past the buffer
+  lightCount = std::min(
+      static_cast<uint32_t>(scene.pointLights.size()),
+      LveLightClusters::MAX_LIGHTS);
+  lightClusters.build(frameInfo.frameIndex, frameInfo.camera, ubo);
 }
 
 void PointLightSystem::render(FrameInfo& frameInfo) {
+  if (lightCount == 0) {
+    return;
+  }
+  LveGpuProfiler::Scope scope{frameInfo, "point lights"};
+  if (frameInfo.recorder != nullptr) {
+    frameInfo.recorder->record([&](VkCommandBuffer commandBuffer) {
+      FrameInfo secondaryInfo = frameInfo;
+      secondaryInfo.commandBuffer = commandBuffer;
+      secondaryInfo.recorder = nullptr;
+      // already timed by scope
+      secondaryInfo.profiler = nullptr;
+      render(secondaryInfo);
+    });
+    return;
+  }
+
   lvePipeline->bind(frameInfo.commandBuffer);
 
   vkCmdBindDescriptorSets(
@@ -97,27 +118,11 @@ void PointLightSystem::render(FrameInfo& frameInfo) {
       0,
       1,
       &frameInfo.globalDescriptorSet,
-      0,
-      nullptr);
-
-  for (auto& kv : frameInfo.gameObjects) {
-    auto& obj = kv.second;
-    if (obj.pointLight == nullptr) continue;
-
-    PointLightPushConstants push{};
-    push.position = glm::vec4(obj.transform.translation, 1.f);
-    push.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-    push.radius = obj.transform.scale.x;
-
-    vkCmdPushConstants(
-        frameInfo.commandBuffer,
-        pipelineLayout,
-        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-        0,
-        sizeof(PointLightPushConstants),
-        &push);
-    vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
-  }
+      1,
+      &frameInfo.globalUboOffset);
+
+  // one billboard per light in the buffer update filled
+  vkCmdDraw(frameInfo.commandBuffer, 6, lightCount, 0, 0);
 }
 
 }  // namespace lve
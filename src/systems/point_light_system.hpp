@@ -4,6 +4,7 @@
 #include "lve_device.hpp"
 #include "lve_frame_info.hpp"
 #include "lve_game_object.hpp"
+#include "lve_light_clusters.hpp"
 #include "lve_pipeline.hpp"
 
 // std
@@ -20,7 +21,12 @@ class PointLightSystem {
   PointLightSystem(const PointLightSystem &) = delete;
   PointLightSystem &operator=(const PointLightSystem &) = delete;
 
-  void update(FrameInfo &frameInfo, GlobalUbo &ubo);
+  // Moves the lights, before the scene's transforms are updated
+  void animate(FrameInfo &frameInfo);
+  // Bins the lights at their world positions into lightClusters, which fills the ubo's light
+  // fields. Call after the scene's transforms are updated, so parented lights are current.
+  void update(FrameInfo &frameInfo, GlobalUbo &ubo, LveLightClusters &lightClusters);
+  // Draws a billboard for every light of the last update in a single instanced draw
   void render(FrameInfo &frameInfo);
 
  private:
@@ -29,7 +35,8 @@ class PointLightSystem {
 
   LveDevice &lveDevice;
 
-  std::unique_ptr<LvePipeline> lvePipeline;
+  std::shared_ptr<LvePipeline> lvePipeline;
   VkPipelineLayout pipelineLayout;
+  uint32_t lightCount = 0;
 };
 }  // namespace lve
@@ -1,5 +1,9 @@
 #include "simple_render_system.hpp"
 
+#include "lve_gpu_profiler.hpp"
+#include "lve_pipeline_registry.hpp"
+#include "lve_swap_chain.hpp"
+
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -7,8 +11,10 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
 #include <stdexcept>
 
 namespace lve {
@@ -18,15 +24,109 @@ struct SimplePushConstantData {
   glm::mat4 normalMatrix{1.f};
 };
 
+// std430 layout of simple_shader_indirect.vert's ObjectBuffer entries
+struct ObjectData {
+  glm::mat4 modelMatrix{1.f};
+  glm::mat4 normalMatrix{1.f};
+};
+
+// cull.comp inputs, see the shader for field descriptions
+struct CullUbo {
+  glm::vec4 frustumPlanes[LveFrustum::PLANE_COUNT];
+  glm::mat4 occlusionViewProjection{1.f};
+  glm::vec4 cameraPosition{0.f};
+  glm::vec2 pyramidSize{1.f};
+  float lodErrorScale = 0.f;
+  uint32_t objectCount = 0;
+  uint32_t flags = 0;
+};
+
+struct CullData {
+  glm::vec4 sphere;
+  uint32_t firstLod;
+  uint32_t lodCount;
+  uint32_t run;
+  uint32_t runBase;
+};
+
+struct DrawTemplate {
+  uint32_t indexCount;
+  uint32_t firstIndex;
+  int32_t vertexOffset;
+  float error;
+};
+
+constexpr uint32_t CULL_FLAG_COMPACT = 1;
+constexpr uint32_t CULL_FLAG_OCCLUSION = 2;
+constexpr uint32_t CULL_GROUP_SIZE = 64;
+
+namespace {
+
+uint32_t nextPowerOfTwo(uint32_t value) {
+  uint32_t result = 1;
+  while (result < value) result <<= 1;
+  return result;
+}
+
+}  // namespace
+
 SimpleRenderSystem::SimpleRenderSystem(
     LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-    : lveDevice{device} {
+    : SimpleRenderSystem{device, renderPass, globalSetLayout, Shading{}} {}
+
+SimpleRenderSystem::SimpleRenderSystem(
+    LveDevice& device,
+    VkRenderPass renderPass,
+    VkDescriptorSetLayout globalSetLayout,
+    const Shading& shading)
+    : lveDevice{device}, vertexFormat{shading.vertexFormat} {
+  createObjectSetLayout();
   createPipelineLayout(globalSetLayout);
-  createPipeline(renderPass);
+  createPipelines(renderPass, shading);
+  createCullPipeline();
+  frames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (auto& frame : frames) {
+    frame.descriptorAllocator =
+        LveDescriptorAllocator::Builder(lveDevice)
+            .setInitialSets(1)
+            .addPoolRatio(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.f)
+            .addPoolRatio(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5.f)
+            .addPoolRatio(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.f)
+            .build();
+  }
+  // instancing only needs core features, the indirect paths need drawIndirectFirstInstance
+  if (supportsGpuCulling(lveDevice)) {
+    mode = Mode::GpuCulled;
+  } else {
+    mode = supportsIndirect(lveDevice) ? Mode::Indirect : Mode::Instanced;
+  }
 }
 
 SimpleRenderSystem::~SimpleRenderSystem() {
   vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+  vkDestroyPipelineLayout(lveDevice.device(), cullPipelineLayout, nullptr);
+}
+
+void SimpleRenderSystem::setMode(Mode newMode) {
+  if (newMode == Mode::Indirect && !supportsIndirect(lveDevice)) {
+    throw std::runtime_error("indirect rendering requires drawIndirectFirstInstance!");
+  }
+  if (newMode == Mode::GpuCulled && !supportsGpuCulling(lveDevice)) {
+    throw std::runtime_error("gpu culling requires draw indirect count or multiDrawIndirect!");
+  }
+  mode = newMode;
+}
+
+void SimpleRenderSystem::createObjectSetLayout() {
+  objectSetLayout =
+      LveDescriptorSetLayout::Builder(lveDevice)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+          .build();
+  objectDescriptorPool =
+      LveDescriptorPool::Builder(lveDevice)
+          .setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .build();
 }
 
 void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
@@ -35,7 +135,10 @@ void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLay
   pushConstantRange.offset = 0;
   pushConstantRange.size = sizeof(SimplePushConstantData);
 
-  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
+  // both modes share one layout, the direct shader simply ignores set 1
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+      globalSetLayout,
+      objectSetLayout->getDescriptorSetLayout()};
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -49,49 +152,657 @@ void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLay
   }
 }
 
-void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+void SimpleRenderSystem::createPipelines(VkRenderPass renderPass, const Shading& shading) {
   assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
   PipelineConfigInfo pipelineConfig{};
   LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
   pipelineConfig.renderPass = renderPass;
   pipelineConfig.pipelineLayout = pipelineLayout;
-  lvePipeline = std::make_unique<LvePipeline>(
-      lveDevice,
+  pipelineConfig.bindingDescriptions = LveModel::getBindingDescriptions(vertexFormat);
+  pipelineConfig.attributeDescriptions = LveModel::getAttributeDescriptions(vertexFormat);
+  // constant id as declared in both vertex shaders, the compact formats store octahedral normals
+  pipelineConfig.vertSpecialization.set(0, vertexFormat != LveModel::VertexFormat::Full);
+  // constant ids as declared in simple_shader.frag
+  pipelineConfig.fragSpecialization.set(0, shading.lightLimit)
+      .set(1, shading.specular)
+      .set(2, shading.vertexColor);
+  auto& registry = lveDevice.pipelineRegistry();
+  lvePipeline = registry.requestGraphics(
       "shaders/simple_shader.vert.spv",
       "shaders/simple_shader.frag.spv",
       pipelineConfig);
+  indirectPipeline = registry.requestGraphics(
+      "shaders/simple_shader_indirect.vert.spv",
+      "shaders/simple_shader.frag.spv",
+      pipelineConfig);
+}
+
+void SimpleRenderSystem::createCullPipeline() {
+  cullSetLayout =
+      LveDescriptorSetLayout::Builder(lveDevice)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .build();
+  VkDescriptorSetLayout setLayout = cullSetLayout->getDescriptorSetLayout();
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &setLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 0;
+  pipelineLayoutInfo.pPushConstantRanges = nullptr;
+  if (vkCreatePipelineLayout(
+          lveDevice.device(),
+          &pipelineLayoutInfo,
+          nullptr,
+          &cullPipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+
+  cullPipeline =
+      lveDevice.pipelineRegistry().requestCompute("shaders/cull.comp.spv", cullPipelineLayout);
+}
+
+void SimpleRenderSystem::ensureFrameCapacity(
+    FrameResources& frame, uint32_t objectCount, uint32_t runCount) {
+  // the frame's previous submission was waited on, nothing in flight still reads these buffers
+  if (objectCount > frame.objectCapacity) {
+    frame.objectCapacity = nextPowerOfTwo(objectCount);
+    frame.objectBuffer = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(ObjectData),
+        frame.objectCapacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.objectBuffer->map();
+    frame.indirectBuffer = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(VkDrawIndexedIndirectCommand),
+        frame.objectCapacity,
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.indirectBuffer->map();
+
+    auto bufferInfo = frame.objectBuffer->descriptorInfo();
+    LveDescriptorWriter writer{*objectSetLayout, *objectDescriptorPool};
+    writer.writeBuffer(0, &bufferInfo);
+    if (frame.objectDescriptorSet == VK_NULL_HANDLE) {
+      writer.build(frame.objectDescriptorSet);
+    } else {
+      writer.overwrite(frame.objectDescriptorSet);
+    }
+  }
+
+  if (lveDevice.cmdDrawIndexedIndirectCount != nullptr && runCount > frame.countCapacity) {
+    frame.countCapacity = nextPowerOfTwo(runCount);
+    frame.countBuffer = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(uint32_t),
+        frame.countCapacity,
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.countBuffer->map();
+  }
+}
+
+void SimpleRenderSystem::ensureGpuCullCapacity(
+    FrameResources& frame, uint32_t objectCount, uint32_t lodCount, uint32_t runCount) {
+  if (frame.cullUbo == nullptr) {
+    frame.cullUbo = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(CullUbo),
+        1,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.cullUbo->map();
+  }
+
+  if (objectCount > frame.gpuObjectCapacity) {
+    frame.gpuObjectCapacity = nextPowerOfTwo(objectCount);
+    frame.cullBuffer = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(CullData),
+        frame.gpuObjectCapacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.cullBuffer->map();
+    frame.gpuCommandBuffer = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(VkDrawIndexedIndirectCommand),
+        frame.gpuObjectCapacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+
+  if (lodCount > frame.lodCapacity) {
+    frame.lodCapacity = nextPowerOfTwo(lodCount);
+    frame.lodBuffer = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(DrawTemplate),
+        frame.lodCapacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    frame.lodBuffer->map();
+  }
+
+  if (runCount > frame.gpuRunCapacity) {
+    frame.gpuRunCapacity = nextPowerOfTwo(runCount);
+    frame.gpuCountBuffer = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(uint32_t),
+        frame.gpuRunCapacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+}
+
+void SimpleRenderSystem::cullGameObjects(FrameInfo& frameInfo) {
+  FrameResources& frame = frames[frameInfo.frameIndex];
+  frame.gpuCulled = false;
+  if (mode != Mode::GpuCulled || !buildBatches(frameInfo, frame, false)) return;
+
+  uint32_t objectCount = static_cast<uint32_t>(visibleObjects.size());
+  uint32_t batchCount = static_cast<uint32_t>(batches.size());
+  batchFirstLods.resize(batchCount);
+  uint32_t lodCount = 0;
+  for (uint32_t b = 0; b < batchCount; b++) {
+    batchFirstLods[b] = lodCount;
+    lodCount += static_cast<uint32_t>(batches[b].model->getLods().size());
+  }
+  ensureGpuCullCapacity(frame, objectCount, lodCount, static_cast<uint32_t>(runs.size()));
+
+  // errors in the space of the stored positions, which the object buffer's matrices scale
+  auto* lods = static_cast<DrawTemplate*>(frame.lodBuffer->getMappedMemory());
+  for (uint32_t b = 0; b < batchCount; b++) {
+    const LveModel* model = batches[b].model;
+    const LveGeometryAllocation& geometry = model->getGeometry();
+    DrawTemplate* modelLods = lods + batchFirstLods[b];
+    for (const LveModel::Lod& lod : model->getLods()) {
+      *modelLods++ = {
+          lod.indexCount,
+          geometry.firstIndex + lod.firstIndex,
+          static_cast<int32_t>(geometry.firstVertex),
+          lod.error / model->getQuantization().scale};
+    }
+  }
+
+  auto* cullData = static_cast<CullData*>(frame.cullBuffer->getMappedMemory());
+  for (uint32_t r = 0; r < runs.size(); r++) {
+    uint32_t runBase = batches[runs[r].firstBatch].firstInstance;
+    for (uint32_t b = runs[r].firstBatch; b < runs[r].firstBatch + runs[r].batchCount; b++) {
+      // the object buffer's model matrices take stored positions to world space
+      const LveModel* model = batches[b].model;
+      LveBoundingSphere sphere = model->getQuantization().toStored(model->getBoundingSphere());
+      uint32_t modelLodCount = static_cast<uint32_t>(model->getLods().size());
+      for (uint32_t i = 0; i < batches[b].instanceCount; i++) {
+        cullData[batches[b].firstInstance + i] =
+            {glm::vec4{sphere.center, sphere.radius}, batchFirstLods[b], modelLodCount, r, runBase};
+      }
+    }
+  }
+
+  LveDepthPyramid* pyramid = depthPyramid;
+  if (pyramid == nullptr) {
+    if (placeholderPyramid == nullptr) {
+      placeholderPyramid = std::make_unique<LveDepthPyramid>(lveDevice, VkExtent2D{1, 1});
+      // normally shares the already compiled reduce pipeline, making this a no-op
+      lveDevice.pipelineRegistry().compilePending();
+    }
+    pyramid = placeholderPyramid.get();
+  }
+
+  bool compact = lveDevice.cmdDrawIndexedIndirectCount != nullptr;
+  CullUbo ubo{};
+  LveFrustum frustum{frameInfo.camera.getProjection() * frameInfo.camera.getView()};
+  for (int i = 0; i < LveFrustum::PLANE_COUNT; i++) {
+    ubo.frustumPlanes[i] = frustum.getPlane(static_cast<LveFrustum::Plane>(i));
+  }
+  ubo.occlusionViewProjection = pyramid->getViewProjection();
+  ubo.cameraPosition = frameInfo.camera.getInverseView()[3];
+  ubo.pyramidSize = {
+      static_cast<float>(pyramid->getExtent().width),
+      static_cast<float>(pyramid->getExtent().height)};
+  ubo.lodErrorScale = lodErrorScale(frameInfo.camera);
+  ubo.objectCount = objectCount;
+  ubo.flags = (compact ? CULL_FLAG_COMPACT : 0) |
+              (pyramid == depthPyramid && pyramid->isValid() ? CULL_FLAG_OCCLUSION : 0);
+  frame.cullUbo->writeToBuffer(&ubo);
+
+  // allocated anew every frame since the pyramid may have been recreated, this frame slot's
+  // previous submission has completed so its sets can be recycled
+  auto uboInfo = frame.cullUbo->descriptorInfo();
+  auto objectInfo = frame.objectBuffer->descriptorInfo();
+  auto cullInfo = frame.cullBuffer->descriptorInfo();
+  auto lodInfo = frame.lodBuffer->descriptorInfo();
+  auto commandInfo = frame.gpuCommandBuffer->descriptorInfo();
+  auto countInfo = frame.gpuCountBuffer->descriptorInfo();
+  auto pyramidInfo = pyramid->descriptorInfo();
+  frame.descriptorAllocator->reset();
+  LveDescriptorWriter(*cullSetLayout, *frame.descriptorAllocator)
+      .writeBuffer(0, &uboInfo)
+      .writeBuffer(1, &objectInfo)
+      .writeBuffer(2, &cullInfo)
+      .writeBuffer(3, &lodInfo)
+      .writeBuffer(4, &commandInfo)
+      .writeBuffer(5, &countInfo)
+      .writeImage(6, &pyramidInfo)
+      .build(frame.cullDescriptorSet);
+
+  VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  if (compact) {
+    vkCmdFillBuffer(
+        commandBuffer,
+        frame.gpuCountBuffer->getBuffer(),
+        0,
+        runs.size() * sizeof(uint32_t),
+        0);
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+  }
+
+  cullPipeline->bind(commandBuffer);
+  vkCmdBindDescriptorSets(
+      commandBuffer,
+      VK_PIPELINE_BIND_POINT_COMPUTE,
+      cullPipelineLayout,
+      0,
+      1,
+      &frame.cullDescriptorSet,
+      0,
+      nullptr);
+  vkCmdDispatch(commandBuffer, LveComputePipeline::groupCount(objectCount, CULL_GROUP_SIZE), 1, 1);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+      0,
+      1,
+      &barrier,
+      0,
+      nullptr,
+      0,
+      nullptr);
+  frame.gpuCulled = true;
 }
 
 void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
-  lvePipeline->bind(frameInfo.commandBuffer);
+  LveGpuProfiler::Scope scope{frameInfo, "game objects"};
+  switch (mode) {
+    case Mode::Direct:
+      renderDirect(frameInfo);
+      break;
+    case Mode::Instanced:
+      renderInstanced(frameInfo);
+      break;
+    case Mode::Indirect:
+    case Mode::GpuCulled:
+      // a handful of indirect draws, not worth splitting across threads
+      if (frameInfo.recorder != nullptr) {
+        frameInfo.recorder->record([&](VkCommandBuffer commandBuffer) {
+          FrameInfo secondaryInfo = frameInfo;
+          secondaryInfo.commandBuffer = commandBuffer;
+          secondaryInfo.recorder = nullptr;
+          // already timed by scope
+          secondaryInfo.profiler = nullptr;
+          renderGameObjects(secondaryInfo);
+        });
+      } else if (mode == Mode::Indirect) {
+        renderIndirect(frameInfo);
+      } else {
+        renderGpuCulled(frameInfo);
+      }
+      break;
+  }
+}
+
+void SimpleRenderSystem::renderDirect(FrameInfo& frameInfo) {
+  gatherVisibleObjects(frameInfo, true);
+  uint32_t objectCount = static_cast<uint32_t>(visibleObjects.size());
+  if (frameInfo.recorder == nullptr) {
+    drawDirect(frameInfo.commandBuffer, frameInfo, 0, objectCount);
+    return;
+  }
+  frameInfo.recorder->recordParallel(
+      objectCount,
+      MIN_OBJECTS_PER_SECONDARY,
+      [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) {
+        drawDirect(commandBuffer, frameInfo, begin, end);
+      });
+}
+
+void SimpleRenderSystem::drawDirect(
+    VkCommandBuffer commandBuffer, const FrameInfo& frameInfo, uint32_t begin, uint32_t end) {
+  lvePipeline->bind(commandBuffer);
 
   vkCmdBindDescriptorSets(
-      frameInfo.commandBuffer,
+      commandBuffer,
       VK_PIPELINE_BIND_POINT_GRAPHICS,
       pipelineLayout,
       0,
       1,
       &frameInfo.globalDescriptorSet,
-      0,
-      nullptr);
+      1,
+      &frameInfo.globalUboOffset);
 
-  for (auto& kv : frameInfo.gameObjects) {
-    auto& obj = kv.second;
-    if (obj.model == nullptr) continue;
+  // every model lives in a shared geometry pool chunk, so rebinding is only needed when the chunk
+  // changes, which is almost never
+  LveGeometryPool* boundPool = nullptr;
+  uint32_t boundChunk = 0;
+
+  for (uint32_t i = begin; i < end; i++) {
+    const RenderItem& item = visibleObjects[i];
     SimplePushConstantData push{};
-    push.modelMatrix = obj.transform.mat4();
-    push.normalMatrix = obj.transform.normalMatrix();
+    push.modelMatrix = item.model->getQuantization().apply(item.transform->worldMatrix());
+    push.normalMatrix = item.transform->worldNormalMatrix();
 
     vkCmdPushConstants(
-        frameInfo.commandBuffer,
+        commandBuffer,
         pipelineLayout,
         VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
         0,
         sizeof(SimplePushConstantData),
         &push);
-    obj.model->bind(frameInfo.commandBuffer);
-    obj.model->draw(frameInfo.commandBuffer);
+    LveGeometryPool* pool = &item.model->getGeometryPool();
+    uint32_t chunk = item.model->getGeometry().chunk;
+    if (pool != boundPool || chunk != boundChunk) {
+      item.model->bind(commandBuffer);
+      boundPool = pool;
+      boundChunk = chunk;
+    }
+    item.model->draw(commandBuffer, 1, 0, item.lod);
+  }
+}
+
+float SimpleRenderSystem::lodErrorScale(const LveCamera& camera) const {
+  // [1][1] maps view space height over distance to clip space, where the viewport spans 2
+  return std::abs(camera.getProjection()[1][1]) * .5f / lodErrorThreshold;
+}
+
+void SimpleRenderSystem::gatherVisibleObjects(FrameInfo& frameInfo, bool cullOnCpu) {
+  candidates.clear();
+  visibleObjects.clear();
+  // only entities with a model are visited, their transform is looked up through its sparse set
+  auto& scene = frameInfo.scene;
+  candidates.reserve(scene.models.size());
+  for (size_t i = 0; i < scene.models.size(); i++) {
+    TransformComponent* transform = scene.transforms.tryGet(scene.models.getEntity(i));
+    if (transform != nullptr) {
+      LveModel* model = scene.models.data()[i].get();
+      assert(model->getVertexFormat() == vertexFormat && "Model vertex format mismatch");
+      candidates.push_back({model, transform, 0});
+    }
+  }
+
+  if (!cullOnCpu) {
+    visibleObjects.swap(candidates);
+    cullStats = {static_cast<uint32_t>(visibleObjects.size()), 0};
+    return;
+  }
+
+  // world space spheres in SoA layout for the batch test, and each object's lod from the
+  // distance to its sphere
+  size_t count = candidates.size();
+  sphereX.resize(count);
+  sphereY.resize(count);
+  sphereZ.resize(count);
+  sphereRadius.resize(count);
+  sphereVisible.resize(count);
+  glm::vec3 cameraPosition{frameInfo.camera.getInverseView()[3]};
+  float errorScale = lodErrorScale(frameInfo.camera);
+  for (size_t i = 0; i < count; i++) {
+    RenderItem& item = candidates[i];
+    const LveBoundingSphere& local = item.model->getBoundingSphere();
+    const glm::mat4& world = item.transform->worldMatrix();
+    glm::vec3 center{world * glm::vec4{local.center, 1.f}};
+    glm::vec3 scale{
+        glm::length(glm::vec3{world[0]}),
+        glm::length(glm::vec3{world[1]}),
+        glm::length(glm::vec3{world[2]})};
+    float maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+    sphereX[i] = center.x;
+    sphereY[i] = center.y;
+    sphereZ[i] = center.z;
+    sphereRadius[i] = local.radius * maxScale;
+
+    float distance = std::max(glm::length(center - cameraPosition) - sphereRadius[i], 1e-4f);
+    item.lod = item.model->selectLod(errorScale * maxScale / distance);
+  }
+
+  if (!frustumCulling) {
+    visibleObjects.swap(candidates);
+    cullStats = {static_cast<uint32_t>(visibleObjects.size()), 0};
+    return;
+  }
+
+  LveFrustum frustum{frameInfo.camera.getProjection() * frameInfo.camera.getView()};
+  frustum.cullSpheres(
+      sphereX.data(),
+      sphereY.data(),
+      sphereZ.data(),
+      sphereRadius.data(),
+      static_cast<uint32_t>(count),
+      sphereVisible.data());
+
+  for (size_t i = 0; i < count; i++) {
+    if (sphereVisible[i]) visibleObjects.push_back(candidates[i]);
+  }
+  cullStats.drawn = static_cast<uint32_t>(visibleObjects.size());
+  cullStats.culled = static_cast<uint32_t>(count) - cullStats.drawn;
+}
+
+bool SimpleRenderSystem::buildBatches(
+    FrameInfo& frameInfo, FrameResources& frame, bool cullOnCpu) {
+  batches.clear();
+  runs.clear();
+  gatherVisibleObjects(frameInfo, cullOnCpu);
+  if (visibleObjects.empty()) return false;
+
+  // sort by chunk, then model and lod, so each becomes one batch and every chunk one bind
+  std::sort(
+      visibleObjects.begin(),
+      visibleObjects.end(),
+      [](const RenderItem& a, const RenderItem& b) {
+        LveGeometryPool* poolA = &a.model->getGeometryPool();
+        LveGeometryPool* poolB = &b.model->getGeometryPool();
+        if (poolA != poolB) return poolA < poolB;
+        uint32_t chunkA = a.model->getGeometry().chunk;
+        uint32_t chunkB = b.model->getGeometry().chunk;
+        if (chunkA != chunkB) return chunkA < chunkB;
+        if (a.model != b.model) return a.model < b.model;
+        return a.lod < b.lod;
+      });
+
+  for (uint32_t i = 0; i < visibleObjects.size(); i++) {
+    LveModel* model = visibleObjects[i].model;
+    uint32_t lod = visibleObjects[i].lod;
+    if (batches.empty() || batches.back().model != model || batches.back().lod != lod) {
+      LveModel* previous = batches.empty() ? nullptr : batches.back().model;
+      if (previous == nullptr || &previous->getGeometryPool() != &model->getGeometryPool() ||
+          previous->getGeometry().chunk != model->getGeometry().chunk) {
+        runs.push_back({static_cast<uint32_t>(batches.size()), 0});
+      }
+      batches.push_back({model, lod, i, 0});
+      runs.back().batchCount++;
+    }
+    batches.back().instanceCount++;
+  }
+
+  uint32_t objectCount = static_cast<uint32_t>(visibleObjects.size());
+  ensureFrameCapacity(frame, objectCount, static_cast<uint32_t>(runs.size()));
+
+  auto* objectData = static_cast<ObjectData*>(frame.objectBuffer->getMappedMemory());
+  for (uint32_t i = 0; i < objectCount; i++) {
+    TransformComponent& transform = *visibleObjects[i].transform;
+    objectData[i].modelMatrix =
+        visibleObjects[i].model->getQuantization().apply(transform.worldMatrix());
+    objectData[i].normalMatrix = transform.worldNormalMatrix();
+  }
+  return true;
+}
+
+void SimpleRenderSystem::bindObjectPipeline(
+    LvePipeline& pipeline,
+    VkCommandBuffer commandBuffer,
+    const FrameInfo& frameInfo,
+    FrameResources& frame) {
+  pipeline.bind(commandBuffer);
+  std::array<VkDescriptorSet, 2> sets{frameInfo.globalDescriptorSet, frame.objectDescriptorSet};
+  // only the global ubo is bound with a dynamic offset
+  vkCmdBindDescriptorSets(
+      commandBuffer,
+      VK_PIPELINE_BIND_POINT_GRAPHICS,
+      pipelineLayout,
+      0,
+      static_cast<uint32_t>(sets.size()),
+      sets.data(),
+      1,
+      &frameInfo.globalUboOffset);
+}
+
+void SimpleRenderSystem::renderInstanced(FrameInfo& frameInfo) {
+  FrameResources& frame = frames[frameInfo.frameIndex];
+  if (!buildBatches(frameInfo, frame)) return;
+
+  uint32_t batchCount = static_cast<uint32_t>(batches.size());
+  if (frameInfo.recorder == nullptr) {
+    drawInstanced(frameInfo.commandBuffer, frameInfo, frame, 0, batchCount);
+    return;
+  }
+  frameInfo.recorder->recordParallel(
+      batchCount,
+      MIN_BATCHES_PER_SECONDARY,
+      [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) {
+        drawInstanced(commandBuffer, frameInfo, frame, begin, end);
+      });
+}
+
+void SimpleRenderSystem::drawInstanced(
+    VkCommandBuffer commandBuffer,
+    const FrameInfo& frameInfo,
+    FrameResources& frame,
+    uint32_t begin,
+    uint32_t end) {
+  bindObjectPipeline(*indirectPipeline, commandBuffer, frameInfo, frame);
+  for (const ChunkRun& run : runs) {
+    uint32_t runBegin = std::max(run.firstBatch, begin);
+    uint32_t runEnd = std::min(run.firstBatch + run.batchCount, end);
+    if (runBegin >= runEnd) continue;
+
+    batches[runBegin].model->bind(commandBuffer);
+    for (uint32_t b = runBegin; b < runEnd; b++) {
+      const Batch& batch = batches[b];
+      batch.model->draw(commandBuffer, batch.instanceCount, batch.firstInstance, batch.lod);
+    }
+  }
+}
+
+void SimpleRenderSystem::renderIndirect(FrameInfo& frameInfo) {
+  FrameResources& frame = frames[frameInfo.frameIndex];
+  if (!buildBatches(frameInfo, frame)) return;
+
+  // one command per batch, batches are never more than objects so the buffer always fits
+  auto* commands =
+      static_cast<VkDrawIndexedIndirectCommand*>(frame.indirectBuffer->getMappedMemory());
+  for (uint32_t b = 0; b < batches.size(); b++) {
+    const LveGeometryAllocation& geometry = batches[b].model->getGeometry();
+    const LveModel::Lod& lod = batches[b].model->getLods()[batches[b].lod];
+    commands[b].indexCount = lod.indexCount;
+    commands[b].instanceCount = batches[b].instanceCount;
+    commands[b].firstIndex = geometry.firstIndex + lod.firstIndex;
+    commands[b].vertexOffset = static_cast<int32_t>(geometry.firstVertex);
+    commands[b].firstInstance = batches[b].firstInstance;
+  }
+  if (lveDevice.cmdDrawIndexedIndirectCount != nullptr) {
+    auto* counts = static_cast<uint32_t*>(frame.countBuffer->getMappedMemory());
+    for (uint32_t r = 0; r < runs.size(); r++) {
+      counts[r] = runs[r].batchCount;
+    }
+  }
+
+  bindObjectPipeline(*indirectPipeline, frameInfo.commandBuffer, frameInfo, frame);
+  drawIndirectRuns(frameInfo.commandBuffer, frame, false);
+}
+
+void SimpleRenderSystem::renderGpuCulled(FrameInfo& frameInfo) {
+  FrameResources& frame = frames[frameInfo.frameIndex];
+  if (!frame.gpuCulled) {
+    // cullGameObjects wasn't recorded this frame, cull on the CPU instead
+    renderIndirect(frameInfo);
+    return;
+  }
+
+  bindObjectPipeline(*indirectPipeline, frameInfo.commandBuffer, frameInfo, frame);
+  drawIndirectRuns(frameInfo.commandBuffer, frame, true);
+  frame.gpuCulled = false;
+}
+
+void SimpleRenderSystem::drawIndirectRuns(
+    VkCommandBuffer commandBuffer, FrameResources& frame, bool gpuCommands) {
+  // GPU culling writes one command slot per object, the CPU path one command per batch
+  VkBuffer indirectBuffer =
+      gpuCommands ? frame.gpuCommandBuffer->getBuffer() : frame.indirectBuffer->getBuffer();
+  VkBuffer countBuffer = VK_NULL_HANDLE;
+  if (lveDevice.cmdDrawIndexedIndirectCount != nullptr) {
+    countBuffer = gpuCommands ? frame.gpuCountBuffer->getBuffer() : frame.countBuffer->getBuffer();
+  }
+
+  constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  for (uint32_t r = 0; r < runs.size(); r++) {
+    const ChunkRun& run = runs[r];
+    const Batch& firstBatch = batches[run.firstBatch];
+    const Batch& lastBatch = batches[run.firstBatch + run.batchCount - 1];
+    firstBatch.model->bind(commandBuffer);
+
+    // non-indexed models can't go through indexed commands, theirs are left with no indices
+    for (uint32_t b = run.firstBatch; b < run.firstBatch + run.batchCount; b++) {
+      if (batches[b].model->getGeometry().indexCount == 0) {
+        batches[b].model->draw(commandBuffer, batches[b].instanceCount, batches[b].firstInstance);
+      }
+    }
+
+    uint32_t firstCommand = gpuCommands ? firstBatch.firstInstance : run.firstBatch;
+    uint32_t maxDrawCount =
+        gpuCommands ? lastBatch.firstInstance + lastBatch.instanceCount - firstCommand
+                    : run.batchCount;
+    VkDeviceSize offset = static_cast<VkDeviceSize>(firstCommand) * stride;
+    if (countBuffer != VK_NULL_HANDLE) {
+      lveDevice.cmdDrawIndexedIndirectCount(
+          commandBuffer,
+          indirectBuffer,
+          offset,
+          countBuffer,
+          r * sizeof(uint32_t),
+          maxDrawCount,
+          stride);
+    } else if (lveDevice.enabledFeatures().multiDrawIndirect) {
+      vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, offset, maxDrawCount, stride);
+    } else {
+      for (uint32_t i = 0; i < maxDrawCount; i++) {
+        vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, offset + i * stride, 1, stride);
+      }
+    }
   }
 }
 
@@ -1,9 +1,15 @@
 #pragma once
 
+#include "lve_buffer.hpp"
 #include "lve_camera.hpp"
+#include "lve_compute_pipeline.hpp"
+#include "lve_depth_pyramid.hpp"
+#include "lve_descriptors.hpp"
 #include "lve_device.hpp"
 #include "lve_frame_info.hpp"
+#include "lve_frustum.hpp"
 #include "lve_game_object.hpp"
+#include "lve_light_clusters.hpp"
 #include "lve_pipeline.hpp"
 
 // std
@@ -13,22 +19,188 @@
 namespace lve {
 class SimpleRenderSystem {
  public:
+  enum class Mode {
+    Direct,     // push constants + one draw call per object
+    Instanced,  // per object data in a storage buffer, one instanced draw per model
+    Indirect,   // as Instanced, but the draws are sourced from an indirect buffer
+    GpuCulled,  // a compute pass culls, picks lods and writes the indirect draws on the GPU
+  };
+
+  // Compile time variant of simple_shader.frag, baked into the pipelines as specialization
+  // constants so the driver can unroll the light loop and strip the disabled terms
+  struct Shading {
+    // upper bound of the per cluster light loop
+    uint32_t lightLimit = LveLightClusters::MAX_LIGHTS_PER_CLUSTER;
+    bool specular = true;
+    bool vertexColor = true;
+    // vertex input of the pipelines, every model drawn must have been created in this format
+    LveModel::VertexFormat vertexFormat = LveModel::VertexFormat::Full;
+  };
+
   SimpleRenderSystem(
       LveDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+  SimpleRenderSystem(
+      LveDevice &device,
+      VkRenderPass renderPass,
+      VkDescriptorSetLayout globalSetLayout,
+      const Shading &shading);
   ~SimpleRenderSystem();
 
   SimpleRenderSystem(const SimpleRenderSystem &) = delete;
   SimpleRenderSystem &operator=(const SimpleRenderSystem &) = delete;
 
+  // Indirect mode needs drawIndirectFirstInstance to select each draw's object data
+  static bool supportsIndirect(LveDevice &device) {
+    return device.enabledFeatures().drawIndirectFirstInstance;
+  }
+  // GPU culling also needs either VK_KHR_draw_indirect_count to draw the compacted commands, or
+  // multiDrawIndirect to draw them uncompacted with culled draws zeroed out
+  static bool supportsGpuCulling(LveDevice &device) {
+    return supportsIndirect(device) &&
+           (device.cmdDrawIndexedIndirectCount != nullptr ||
+            device.enabledFeatures().multiDrawIndirect);
+  }
+  void setMode(Mode newMode);
+  Mode getMode() const { return mode; }
+
+  struct CullStats {
+    uint32_t drawn = 0;
+    uint32_t culled = 0;
+  };
+
+  // Objects whose world space bounding sphere is outside the camera frustum are skipped
+  void setFrustumCulling(bool enabled) { frustumCulling = enabled; }
+  bool isFrustumCullingEnabled() const { return frustumCulling; }
+  // Counts from the most recent renderGameObjects call. In GpuCulled mode the result stays on
+  // the GPU, drawn counts every object handed to the cull pass.
+  const CullStats &getCullStats() const { return cullStats; }
+
+  // GpuCulled mode: occlusion test against this pyramid once it has been built, nullptr disables
+  // occlusion culling. The pyramid must outlive the render system.
+  void setDepthPyramid(LveDepthPyramid *pyramid) { depthPyramid = pyramid; }
+  // Every mode draws each object with its coarsest lod whose simplification error, projected
+  // from the object's bounding sphere, stays within this fraction of the viewport height
+  void setLodErrorThreshold(float screenFraction) { lodErrorThreshold = screenFraction; }
+
+  // Records the GpuCulled compute pass, so must come before the render pass begins. Does
+  // nothing in the other modes.
+  void cullGameObjects(FrameInfo &frameInfo);
   void renderGameObjects(FrameInfo &frameInfo);
 
  private:
+  // a scene entity with a model, pointing into the scene's component pools for the frame
+  struct RenderItem {
+    LveModel *model;
+    TransformComponent *transform;
+    uint32_t lod;  // picked while culling on the CPU, 0 in GpuCulled mode
+  };
+
+  // objects sharing a model and lod, contiguous in the frame's object buffer
+  struct Batch {
+    LveModel *model;
+    uint32_t lod;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+  };
+
+  // batches whose models live in the same geometry pool chunk
+  struct ChunkRun {
+    uint32_t firstBatch;
+    uint32_t batchCount;
+  };
+
+  struct FrameResources {
+    std::unique_ptr<LveBuffer> objectBuffer;
+    std::unique_ptr<LveBuffer> indirectBuffer;
+    std::unique_ptr<LveBuffer> countBuffer;
+    VkDescriptorSet objectDescriptorSet = VK_NULL_HANDLE;
+    uint32_t objectCapacity = 0;
+    uint32_t countCapacity = 0;
+
+    // GpuCulled inputs (host visible) and outputs (device local)
+    std::unique_ptr<LveBuffer> cullUbo;
+    std::unique_ptr<LveBuffer> cullBuffer;
+    std::unique_ptr<LveBuffer> lodBuffer;
+    std::unique_ptr<LveBuffer> gpuCommandBuffer;
+    std::unique_ptr<LveBuffer> gpuCountBuffer;
+    VkDescriptorSet cullDescriptorSet = VK_NULL_HANDLE;
+    // sets written fresh each frame, reset once the frame's previous submission completed
+    std::unique_ptr<LveDescriptorAllocator> descriptorAllocator;
+    uint32_t gpuObjectCapacity = 0;
+    uint32_t lodCapacity = 0;
+    uint32_t gpuRunCapacity = 0;
+    bool gpuCulled = false;  // cullGameObjects recorded this frame
+  };
+
+  void createObjectSetLayout();
   void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-  void createPipeline(VkRenderPass renderPass);
+  void createPipelines(VkRenderPass renderPass, const Shading &shading);
+  void createCullPipeline();
+  void ensureFrameCapacity(FrameResources &frame, uint32_t objectCount, uint32_t runCount);
+  void ensureGpuCullCapacity(
+      FrameResources &frame, uint32_t objectCount, uint32_t lodCount, uint32_t runCount);
+  // Multiplied by a model space error and the object's scale over its distance, gives that error
+  // on screen relative to lodErrorThreshold
+  float lodErrorScale(const LveCamera &camera) const;
+  void gatherVisibleObjects(FrameInfo &frameInfo, bool cullOnCpu);
+  bool buildBatches(FrameInfo &frameInfo, FrameResources &frame, bool cullOnCpu = true);
+  void bindObjectPipeline(
+      LvePipeline &pipeline,
+      VkCommandBuffer commandBuffer,
+      const FrameInfo &frameInfo,
+      FrameResources &frame);
+
+  // Direct and Instanced split their draws across threads when recording into secondaries, the
+  // draw* functions record one range of visibleObjects / batches and only read shared state
+  void renderDirect(FrameInfo &frameInfo);
+  void drawDirect(
+      VkCommandBuffer commandBuffer, const FrameInfo &frameInfo, uint32_t begin, uint32_t end);
+  void renderInstanced(FrameInfo &frameInfo);
+  void drawInstanced(
+      VkCommandBuffer commandBuffer,
+      const FrameInfo &frameInfo,
+      FrameResources &frame,
+      uint32_t begin,
+      uint32_t end);
+  void renderIndirect(FrameInfo &frameInfo);
+  void renderGpuCulled(FrameInfo &frameInfo);
+  void drawIndirectRuns(VkCommandBuffer commandBuffer, FrameResources &frame, bool gpuCommands);
+
+  // below this many draws per secondary buffer the submission overhead outweighs the gain
+  static constexpr uint32_t MIN_OBJECTS_PER_SECONDARY = 256;
+  static constexpr uint32_t MIN_BATCHES_PER_SECONDARY = 64;
 
   LveDevice &lveDevice;
+  Mode mode = Mode::Direct;
+  LveModel::VertexFormat vertexFormat = LveModel::VertexFormat::Full;
 
-  std::unique_ptr<LvePipeline> lvePipeline;
+  std::shared_ptr<LvePipeline> lvePipeline;
+  std::shared_ptr<LvePipeline> indirectPipeline;
   VkPipelineLayout pipelineLayout;
+
+  std::unique_ptr<LveDescriptorSetLayout> objectSetLayout;
+  std::unique_ptr<LveDescriptorPool> objectDescriptorPool;
+  std::vector<FrameResources> frames;
+
+  std::unique_ptr<LveDescriptorSetLayout> cullSetLayout;
+  VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+  std::shared_ptr<LveComputePipeline> cullPipeline;
+  LveDepthPyramid *depthPyramid = nullptr;
+  // bound in place of a missing pyramid, the cull shader always declares one
+  std::unique_ptr<LveDepthPyramid> placeholderPyramid;
+  float lodErrorThreshold = 1.f / 1024.f;
+
+  bool frustumCulling = true;
+  CullStats cullStats{};
+
+  // rebuilt every frame, kept as members to reuse their storage
+  std::vector<RenderItem> candidates;
+  std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+  std::vector<uint8_t> sphereVisible;
+  std::vector<RenderItem> visibleObjects;
+  std::vector<Batch> batches;
+  std::vector<ChunkRun> runs;
+  // GpuCulled: each batch's first entry in the frame's lod buffer
+  std::vector<uint32_t> batchFirstLods;
 };
 }  // namespace lve
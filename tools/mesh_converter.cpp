@@ -0,0 +1,50 @@
+// Offline OBJ -> .lvemesh converter. Produces the same cache LveModel::createModelFromFile writes
+// on first load, so shipped builds never have to parse OBJ text.
+//
+// usage: MeshConverter <input.obj> [output.lvemesh]
+
+#include "lve_mesh_cache.hpp"
+#include "lve_model.hpp"
+
+// std
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    std::cerr << "usage: " << argv[0] << " <input.obj> [output.lvemesh]\n";
+    return EXIT_FAILURE;
+  }
+
+  std::string inputPath = argv[1];
+  std::string outputPath = argc == 3 ? argv[2] : lve::LveMeshCache::getCachePath(inputPath);
+
+  lve::LveModel::Builder builder{};
+  try {
+    builder.loadModel(inputPath);
+    // the runtime cache is written optimized, with its lod chain
+    builder.optimize();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  if (!lve::LveMeshCache::write(
+          outputPath,
+          builder.vertices.data(),
+          static_cast<uint32_t>(builder.vertices.size()),
+          builder.indices.data(),
+          static_cast<uint32_t>(builder.indices.size()),
+          builder.lods.data(),
+          static_cast<uint32_t>(builder.lods.size()))) {
+    std::cerr << "failed to write " << outputPath << '\n';
+    return EXIT_FAILURE;
+  }
+
+  std::cout << inputPath << " -> " << outputPath << " (" << builder.vertices.size()
+            << " vertices, " << builder.indices.size() << " indices, " << builder.lods.size()
+            << " lods)\n";
+  return EXIT_SUCCESS;
+}